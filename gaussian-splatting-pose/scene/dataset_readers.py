@@ -123,7 +123,17 @@ def fetchPly(path):
     positions = np.vstack([vertices['x'], vertices['y'], vertices['z']]).T
     colors = np.vstack([vertices['red'], vertices['green'], vertices['blue']]).T / 255.0
     normals = np.vstack([vertices['nx'], vertices['ny'], vertices['nz']]).T
-    return BasicPointCloud(points=positions, colors=colors, normals=normals)
+    # Gaussian parameters of the PLY written by the SLAM exporter, stored like GaussianModel.save_ply
+    names = [p.name for p in vertices.properties]
+    scales = rotations = opacities = None
+    if all('scale_{}'.format(i) in names for i in range(3)):
+        scales = np.exp(np.vstack([vertices['scale_{}'.format(i)] for i in range(3)]).T)
+    if all('rot_{}'.format(i) in names for i in range(4)):
+        rotations = np.vstack([vertices['rot_{}'.format(i)] for i in range(4)]).T
+    if 'opacity' in names:
+        opacities = 1.0 / (1.0 + np.exp(-np.asarray(vertices['opacity'])))
+    return BasicPointCloud(points=positions, colors=colors, normals=normals,
+                           scales=scales, rotations=rotations, opacities=opacities)
 
 def storePly(path, xyz, rgb):
     # Define the dtype for the structured array
@@ -217,6 +227,15 @@ def readColmapSceneInfo(path, images, depths, eval, train_test_exp, llffhold=8):
     except:
         pcd = None
 
+    # Scales computed by the SLAM exporter, one per line of points3D.txt
+    scales_path = os.path.join(path, "sparse/0/points3D_scales.txt")
+    if pcd is not None and pcd.scales is None and os.path.exists(scales_path):
+        scales = np.loadtxt(scales_path, comments="#", ndmin=1)
+        if scales.shape[0] == pcd.points.shape[0]:
+            pcd = pcd._replace(scales=scales)
+        else:
+            print("Ignoring {}: {} scales for {} points".format(scales_path, scales.shape[0], pcd.points.shape[0]))
+
     scene_info = SceneInfo(point_cloud=pcd,
                            train_cameras=train_cam_infos,
                            test_cameras=test_cam_infos,
@@ -156,12 +156,23 @@ class GaussianModel:
 
         print("Number of points at initialisation : ", fused_point_cloud.shape[0])
 
-        dist2 = torch.clamp_min(distCUDA2(torch.from_numpy(np.asarray(pcd.points)).float().cuda()), 0.0000001)
-        scales = torch.log(torch.sqrt(dist2))[...,None].repeat(1, 3)
-        rots = torch.zeros((fused_point_cloud.shape[0], 4), device="cuda")
-        rots[:, 0] = 1
+        if pcd.scales is not None:
+            scales = torch.log(torch.tensor(np.asarray(pcd.scales)).float().cuda())
+            if scales.dim() == 1:
+                scales = scales[...,None].repeat(1, 3)
+        else:
+            dist2 = torch.clamp_min(distCUDA2(torch.from_numpy(np.asarray(pcd.points)).float().cuda()), 0.0000001)
+            scales = torch.log(torch.sqrt(dist2))[...,None].repeat(1, 3)
+        if pcd.rotations is not None:
+            rots = torch.nn.functional.normalize(torch.tensor(np.asarray(pcd.rotations)).float().cuda(), dim=1)
+        else:
+            rots = torch.zeros((fused_point_cloud.shape[0], 4), device="cuda")
+            rots[:, 0] = 1
 
-        opacities = self.inverse_opacity_activation(0.1 * torch.ones((fused_point_cloud.shape[0], 1), dtype=torch.float, device="cuda"))
+        if pcd.opacities is not None:
+            opacities = self.inverse_opacity_activation(torch.tensor(np.asarray(pcd.opacities)).float().cuda()[...,None])
+        else:
+            opacities = self.inverse_opacity_activation(0.1 * torch.ones((fused_point_cloud.shape[0], 1), dtype=torch.float, device="cuda"))
 
         self._xyz = nn.Parameter(fused_point_cloud.requires_grad_(True))
         self._features_dc = nn.Parameter(features[:,:,0:1].transpose(1, 2).contiguous().requires_grad_(True))
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#ifndef CPU_RASTERIZER_AUXILIARY_H_INCLUDED
+#define CPU_RASTERIZER_AUXILIARY_H_INCLUDED
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include "../cuda_rasterizer/config.h"
+
+#define BLOCK_SIZE (BLOCK_X * BLOCK_Y)
+
+namespace CpuRasterizer
+{
+	// Host counterparts of the CUDA vector types, same layout
+	struct float2 { float x, y; };
+	struct float3 { float x, y, z; };
+	struct float4 { float x, y, z, w; };
+	struct uint2 { uint32_t x, y; };
+	struct dim3 { uint32_t x, y, z; };
+
+	// Spherical harmonics coefficients
+	constexpr float SH_C0 = 0.28209479177387814f;
+	constexpr float SH_C1 = 0.4886025119029199f;
+	constexpr float SH_C2[] = {
+		1.0925484305920792f,
+		-1.0925484305920792f,
+		0.31539156525252005f,
+		-1.0925484305920792f,
+		0.5462742152960396f
+	};
+	constexpr float SH_C3[] = {
+		-0.5900435899266435f,
+		2.890611442640554f,
+		-0.4570457994644658f,
+		0.3731763325901154f,
+		-0.4570457994644658f,
+		1.445305721320277f,
+		-0.5900435899266435f
+	};
+
+	inline float ndc2Pix(float v, int S)
+	{
+		return ((v + 1.0) * S - 1.0) * 0.5;
+	}
+
+	inline void getRect(const float2 p, int max_radius, uint2& rect_min, uint2& rect_max, dim3 grid)
+	{
+		rect_min = {
+			std::min(grid.x, (uint32_t)std::max((int)0, (int)((p.x - max_radius) / BLOCK_X))),
+			std::min(grid.y, (uint32_t)std::max((int)0, (int)((p.y - max_radius) / BLOCK_Y)))
+		};
+		rect_max = {
+			std::min(grid.x, (uint32_t)std::max((int)0, (int)((p.x + max_radius + BLOCK_X - 1) / BLOCK_X))),
+			std::min(grid.y, (uint32_t)std::max((int)0, (int)((p.y + max_radius + BLOCK_Y - 1) / BLOCK_Y)))
+		};
+	}
+
+	inline float3 transformPoint4x3(const float3& p, const float* matrix)
+	{
+		float3 transformed = {
+			matrix[0] * p.x + matrix[4] * p.y + matrix[8] * p.z + matrix[12],
+			matrix[1] * p.x + matrix[5] * p.y + matrix[9] * p.z + matrix[13],
+			matrix[2] * p.x + matrix[6] * p.y + matrix[10] * p.z + matrix[14],
+		};
+		return transformed;
+	}
+
+	inline float4 transformPoint4x4(const float3& p, const float* matrix)
+	{
+		float4 transformed = {
+			matrix[0] * p.x + matrix[4] * p.y + matrix[8] * p.z + matrix[12],
+			matrix[1] * p.x + matrix[5] * p.y + matrix[9] * p.z + matrix[13],
+			matrix[2] * p.x + matrix[6] * p.y + matrix[10] * p.z + matrix[14],
+			matrix[3] * p.x + matrix[7] * p.y + matrix[11] * p.z + matrix[15]
+		};
+		return transformed;
+	}
+
+	inline float3 transformVec4x3Transpose(const float3& p, const float* matrix)
+	{
+		float3 transformed = {
+			matrix[0] * p.x + matrix[1] * p.y + matrix[2] * p.z,
+			matrix[4] * p.x + matrix[5] * p.y + matrix[6] * p.z,
+			matrix[8] * p.x + matrix[9] * p.y + matrix[10] * p.z,
+		};
+		return transformed;
+	}
+
+	inline float3 dnormvdv(float3 v, float3 dv)
+	{
+		float sum2 = v.x * v.x + v.y * v.y + v.z * v.z;
+		float invsum32 = 1.0f / std::sqrt(sum2 * sum2 * sum2);
+
+		float3 dnormvdv;
+		dnormvdv.x = ((+sum2 - v.x * v.x) * dv.x - v.y * v.x * dv.y - v.z * v.x * dv.z) * invsum32;
+		dnormvdv.y = (-v.x * v.y * dv.x + (sum2 - v.y * v.y) * dv.y - v.z * v.y * dv.z) * invsum32;
+		dnormvdv.z = (-v.x * v.z * dv.x - v.y * v.z * dv.y + (sum2 - v.z * v.z) * dv.z) * invsum32;
+		return dnormvdv;
+	}
+
+	// a x b, which is also skew(a) * b and -skew(a)^T * b with the skew_symmetric of math.h
+	inline float3 cross(const float3& a, const float3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// expf for x <= 0 within 2 ulp (Cephes polynomial), without calls or branches so that the
+	// blending loop vectorizes. Underflows to 0 below -87.
+	inline float expNonPositive(float x)
+	{
+		x = std::max(x, -87.0f);
+		const float n = std::floor(x * 1.44269504088896341f + 0.5f);
+		float r = x - n * 0.693359375f;
+		r = r + n * 2.12194440e-4f;
+		const float r2 = r * r;
+		float p = 1.9875691500E-4f;
+		p = p * r + 1.3981999507E-3f;
+		p = p * r + 8.3334519073E-3f;
+		p = p * r + 4.1665795894E-2f;
+		p = p * r + 1.6666665459E-1f;
+		p = p * r + 5.0000001201E-1f;
+		p = p * r2 + r + 1.0f;
+		int32_t bits;
+		const int32_t e = ((int32_t)n + 127) << 23;
+		std::memcpy(&bits, &p, sizeof(bits));
+		bits += e - (127 << 23);
+		std::memcpy(&p, &bits, sizeof(bits));
+		return p;
+	}
+
+	// Pixels of the tile where a Gaussian can reach alpha >= 1/255, that is inside the ellipse
+	// d^T conic d <= 2 ln(255 opacity), grown by one pixel against rounding. The pixels left out
+	// would be skipped by the blending anyway. Returns false if there are none.
+	inline bool footprint(const float2 xy, const float4 con_o, const uint2 pix_min, int& x0, int& x1, int& y0, int& y1)
+	{
+		x0 = 0;
+		x1 = BLOCK_X - 1;
+		y0 = 0;
+		y1 = BLOCK_Y - 1;
+		if (con_o.w < 1.0f / 255.0f)
+			return false;
+
+		// Not positive definite, keep the whole tile
+		const float det = con_o.x * con_o.z - con_o.y * con_o.y;
+		if (!(det > 0.0f) || !(con_o.x > 0.0f))
+			return true;
+
+		const float t = 2.0f * std::log(255.0f * con_o.w);
+		const float ext_x = std::sqrt(t * con_o.z / det) + 1.0f;
+		const float ext_y = std::sqrt(t * con_o.x / det) + 1.0f;
+		x0 = std::max(x0, (int)std::floor(xy.x - ext_x - pix_min.x));
+		x1 = std::min(x1, (int)std::ceil(xy.x + ext_x - pix_min.x));
+		y0 = std::max(y0, (int)std::floor(xy.y - ext_y - pix_min.y));
+		y1 = std::min(y1, (int)std::ceil(xy.y + ext_y - pix_min.y));
+		return x0 <= x1 && y0 <= y1;
+	}
+
+	// Same test as the CUDA in_frustum: only near culling
+	inline bool in_frustum(const float3& p_view)
+	{
+		return p_view.z > 0.2f;
+	}
+};
+
+#endif
@@ -0,0 +1,773 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "backward.h"
+#include "parallel.h"
+#include <memory>
+
+using namespace CpuRasterizer;
+
+// Gaussians per chunk below which a pass is not split further
+#define GRAIN_SIZE 4096
+
+namespace
+{
+	inline float sq(float x) { return x * x; }
+
+	// Backward pass for conversion of spherical harmonics to RGB for
+	// each Gaussian.
+	void computeColorFromSH(int idx, int deg, int max_coeffs, const float3* means, float3 campos, const float* shs, const bool* clamped, const float* dL_dcolor, float3* dL_dmeans, float* dL_dshs, float* dL_dtau)
+	{
+		// Compute intermediate values, as it is done during forward
+		const float3 pos = means[idx];
+		const float3 dir_orig = { pos.x - campos.x, pos.y - campos.y, pos.z - campos.z };
+		const float len = std::sqrt(dir_orig.x * dir_orig.x + dir_orig.y * dir_orig.y + dir_orig.z * dir_orig.z);
+		const float x = dir_orig.x / len;
+		const float y = dir_orig.y / len;
+		const float z = dir_orig.z / len;
+
+		const float* sh = shs + idx * max_coeffs * 3;
+
+		// Target location for this Gaussian to write SH gradients to
+		float* dL_dsh = dL_dshs + idx * max_coeffs * 3;
+
+		// Gradient of the loss w.r.t. the (normalized) view direction
+		float3 dL_ddir = { 0.f, 0.f, 0.f };
+		for (int ch = 0; ch < 3; ch++)
+		{
+			// Use PyTorch rule for clamping: if clamping was applied,
+			// gradient becomes 0.
+			const float dL_dRGB = clamped[3 * idx + ch] ? 0.f : dL_dcolor[3 * idx + ch];
+
+			float dRGBdx = 0.f;
+			float dRGBdy = 0.f;
+			float dRGBdz = 0.f;
+
+			// No tricks here, just high school-level calculus.
+			dL_dsh[ch] = SH_C0 * dL_dRGB;
+			if (deg > 0)
+			{
+				dL_dsh[3 + ch] = -SH_C1 * y * dL_dRGB;
+				dL_dsh[6 + ch] = SH_C1 * z * dL_dRGB;
+				dL_dsh[9 + ch] = -SH_C1 * x * dL_dRGB;
+
+				dRGBdx = -SH_C1 * sh[9 + ch];
+				dRGBdy = -SH_C1 * sh[3 + ch];
+				dRGBdz = SH_C1 * sh[6 + ch];
+
+				if (deg > 1)
+				{
+					const float xx = x * x, yy = y * y, zz = z * z;
+					const float xy = x * y, yz = y * z, xz = x * z;
+
+					dL_dsh[12 + ch] = SH_C2[0] * xy * dL_dRGB;
+					dL_dsh[15 + ch] = SH_C2[1] * yz * dL_dRGB;
+					dL_dsh[18 + ch] = SH_C2[2] * (2.f * zz - xx - yy) * dL_dRGB;
+					dL_dsh[21 + ch] = SH_C2[3] * xz * dL_dRGB;
+					dL_dsh[24 + ch] = SH_C2[4] * (xx - yy) * dL_dRGB;
+
+					dRGBdx += SH_C2[0] * y * sh[12 + ch] + SH_C2[2] * 2.f * -x * sh[18 + ch] + SH_C2[3] * z * sh[21 + ch] + SH_C2[4] * 2.f * x * sh[24 + ch];
+					dRGBdy += SH_C2[0] * x * sh[12 + ch] + SH_C2[1] * z * sh[15 + ch] + SH_C2[2] * 2.f * -y * sh[18 + ch] + SH_C2[4] * 2.f * -y * sh[24 + ch];
+					dRGBdz += SH_C2[1] * y * sh[15 + ch] + SH_C2[2] * 2.f * 2.f * z * sh[18 + ch] + SH_C2[3] * x * sh[21 + ch];
+
+					if (deg > 2)
+					{
+						dL_dsh[27 + ch] = SH_C3[0] * y * (3.f * xx - yy) * dL_dRGB;
+						dL_dsh[30 + ch] = SH_C3[1] * xy * z * dL_dRGB;
+						dL_dsh[33 + ch] = SH_C3[2] * y * (4.f * zz - xx - yy) * dL_dRGB;
+						dL_dsh[36 + ch] = SH_C3[3] * z * (2.f * zz - 3.f * xx - 3.f * yy) * dL_dRGB;
+						dL_dsh[39 + ch] = SH_C3[4] * x * (4.f * zz - xx - yy) * dL_dRGB;
+						dL_dsh[42 + ch] = SH_C3[5] * z * (xx - yy) * dL_dRGB;
+						dL_dsh[45 + ch] = SH_C3[6] * x * (xx - 3.f * yy) * dL_dRGB;
+
+						dRGBdx += (
+							SH_C3[0] * sh[27 + ch] * 3.f * 2.f * xy +
+							SH_C3[1] * sh[30 + ch] * yz +
+							SH_C3[2] * sh[33 + ch] * -2.f * xy +
+							SH_C3[3] * sh[36 + ch] * -3.f * 2.f * xz +
+							SH_C3[4] * sh[39 + ch] * (-3.f * xx + 4.f * zz - yy) +
+							SH_C3[5] * sh[42 + ch] * 2.f * xz +
+							SH_C3[6] * sh[45 + ch] * 3.f * (xx - yy));
+
+						dRGBdy += (
+							SH_C3[0] * sh[27 + ch] * 3.f * (xx - yy) +
+							SH_C3[1] * sh[30 + ch] * xz +
+							SH_C3[2] * sh[33 + ch] * (-3.f * yy + 4.f * zz - xx) +
+							SH_C3[3] * sh[36 + ch] * -3.f * 2.f * yz +
+							SH_C3[4] * sh[39 + ch] * -2.f * xy +
+							SH_C3[5] * sh[42 + ch] * -2.f * yz +
+							SH_C3[6] * sh[45 + ch] * -3.f * 2.f * xy);
+
+						dRGBdz += (
+							SH_C3[1] * sh[30 + ch] * xy +
+							SH_C3[2] * sh[33 + ch] * 4.f * 2.f * yz +
+							SH_C3[3] * sh[36 + ch] * 3.f * (2.f * zz - xx - yy) +
+							SH_C3[4] * sh[39 + ch] * 4.f * 2.f * xz +
+							SH_C3[5] * sh[42 + ch] * (xx - yy));
+					}
+				}
+			}
+
+			// The view direction is an input to the computation. View direction
+			// is influenced by the Gaussian's mean, so SHs gradients
+			// must propagate back into 3D position.
+			dL_ddir.x += dRGBdx * dL_dRGB;
+			dL_ddir.y += dRGBdy * dL_dRGB;
+			dL_ddir.z += dRGBdz * dL_dRGB;
+		}
+
+		// Account for normalization of direction
+		const float3 dL_dmean = dnormvdv(dir_orig, dL_ddir);
+
+		// Gradients of loss w.r.t. Gaussian means, but only the portion
+		// that is caused because the mean affects the view-dependent color.
+		// Additional mean gradient is accumulated in below methods.
+		dL_dmeans[idx].x += dL_dmean.x;
+		dL_dmeans[idx].y += dL_dmean.y;
+		dL_dmeans[idx].z += dL_dmean.z;
+
+		// As in backward.cu, the camera position is moved against the mean
+		dL_dtau[6 * idx + 0] += -dL_dmean.x;
+		dL_dtau[6 * idx + 1] += -dL_dmean.y;
+		dL_dtau[6 * idx + 2] += -dL_dmean.z;
+	}
+
+	// Backward version of INVERSE 2D covariance matrix computation, with the glm
+	// products of computeCov2DCUDA written out. T = W J has the rows A and B of
+	// the forward computeCov2D as its first two columns.
+	void computeCov2D(int idx,
+		const float3* means,
+		const float* cov3Ds,
+		const float h_x, float h_y,
+		const float tan_fovx, float tan_fovy,
+		const float* view_matrix,
+		const float* opacities,
+		const float* dL_dconics,
+		float* dL_dopacity,
+		float3* dL_dmeans,
+		float* dL_dcov,
+		float* dL_dtau,
+		bool antialiasing)
+	{
+		// Reading location of 3D covariance for this Gaussian
+		const float* cov3D = cov3Ds + 6 * idx;
+
+		// Fetch gradients, recompute 2D covariance and relevant
+		// intermediate forward results needed in the backward.
+		const float3 mean = means[idx];
+		const float3 dL_dconic = { dL_dconics[4 * idx], dL_dconics[4 * idx + 1], dL_dconics[4 * idx + 3] };
+		float3 t = transformPoint4x3(mean, view_matrix);
+
+		const float limx = 1.3f * tan_fovx;
+		const float limy = 1.3f * tan_fovy;
+		const float txtz = t.x / t.z;
+		const float tytz = t.y / t.z;
+		t.x = std::min(limx, std::max(-limx, txtz)) * t.z;
+		t.y = std::min(limy, std::max(-limy, tytz)) * t.z;
+
+		const float x_grad_mul = txtz < -limx || txtz > limx ? 0 : 1;
+		const float y_grad_mul = tytz < -limy || tytz > limy ? 0 : 1;
+
+		// Non-zero entries of J
+		const float J00 = h_x / t.z, J02 = -(h_x * t.x) / (t.z * t.z);
+		const float J11 = h_y / t.z, J12 = -(h_y * t.y) / (t.z * t.z);
+
+		// T[0] = A, T[1] = B, T[2] = 0
+		const float A[3] = {
+			J00 * view_matrix[0] + J02 * view_matrix[2],
+			J00 * view_matrix[4] + J02 * view_matrix[6],
+			J00 * view_matrix[8] + J02 * view_matrix[10] };
+		const float B[3] = {
+			J11 * view_matrix[1] + J12 * view_matrix[2],
+			J11 * view_matrix[5] + J12 * view_matrix[6],
+			J11 * view_matrix[9] + J12 * view_matrix[10] };
+
+		// Vrk A and Vrk B
+		const float VA[3] = {
+			cov3D[0] * A[0] + cov3D[1] * A[1] + cov3D[2] * A[2],
+			cov3D[1] * A[0] + cov3D[3] * A[1] + cov3D[4] * A[2],
+			cov3D[2] * A[0] + cov3D[4] * A[1] + cov3D[5] * A[2] };
+		const float VB[3] = {
+			cov3D[0] * B[0] + cov3D[1] * B[1] + cov3D[2] * B[2],
+			cov3D[1] * B[0] + cov3D[3] * B[1] + cov3D[4] * B[2],
+			cov3D[2] * B[0] + cov3D[4] * B[1] + cov3D[5] * B[2] };
+
+		// Use helper variables for 2D covariance entries. More compact.
+		// The forward computeCov2D already applies the 0.3 low-pass filter before
+		// h_var is added on top, so the same covariance is rebuilt here. The CUDA
+		// backward drops it and differentiates a slightly smaller footprint.
+		float c_xx = A[0] * VA[0] + A[1] * VA[1] + A[2] * VA[2] + 0.3f;
+		float c_xy = A[0] * VB[0] + A[1] * VB[1] + A[2] * VB[2];
+		float c_yy = B[0] * VB[0] + B[1] * VB[1] + B[2] * VB[2] + 0.3f;
+
+		constexpr float h_var = 0.3f;
+		float d_inside_root = 0.f;
+		if (antialiasing)
+		{
+			const float det_cov = c_xx * c_yy - c_xy * c_xy;
+			c_xx += h_var;
+			c_yy += h_var;
+			const float det_cov_plus_h_cov = c_xx * c_yy - c_xy * c_xy;
+			const float h_convolution_scaling = std::sqrt(std::max(0.000025f, det_cov / det_cov_plus_h_cov)); // max for numerical stability
+			const float dL_dopacity_v = dL_dopacity[idx];
+			const float d_h_convolution_scaling = dL_dopacity_v * opacities[idx];
+			dL_dopacity[idx] = dL_dopacity_v * h_convolution_scaling;
+			d_inside_root = (det_cov / det_cov_plus_h_cov) <= 0.000025f ? 0.f : d_h_convolution_scaling / (2 * h_convolution_scaling);
+		}
+		else
+		{
+			c_xx += h_var;
+			c_yy += h_var;
+		}
+
+		float dL_dc_xx = 0;
+		float dL_dc_xy = 0;
+		float dL_dc_yy = 0;
+		if (antialiasing)
+		{
+			const float x = c_xx;
+			const float y = c_yy;
+			const float z = c_xy;
+			const float w = h_var;
+			const float denom_f = d_inside_root / sq(w * w + w * (x + y) + x * y - z * z);
+			dL_dc_xx = w * (w * y + y * y + z * z) * denom_f;
+			dL_dc_yy = w * (w * x + x * x + z * z) * denom_f;
+			dL_dc_xy = -2.f * w * z * (w + x + y) * denom_f;
+		}
+
+		const float denom = c_xx * c_yy - c_xy * c_xy;
+		const float denom2inv = 1.0f / ((denom * denom) + 0.0000001f);
+
+		float* dL_dcov3D = dL_dcov + 6 * idx;
+		if (denom2inv != 0)
+		{
+			// Gradients of loss w.r.t. entries of 2D covariance matrix,
+			// given gradients of loss w.r.t. conic matrix (inverse covariance matrix).
+			// e.g., dL / da = dL / d_conic_a * d_conic_a / d_a
+			dL_dc_xx += denom2inv * (-c_yy * c_yy * dL_dconic.x + 2 * c_xy * c_yy * dL_dconic.y + (denom - c_xx * c_yy) * dL_dconic.z);
+			dL_dc_yy += denom2inv * (-c_xx * c_xx * dL_dconic.z + 2 * c_xx * c_xy * dL_dconic.y + (denom - c_xx * c_yy) * dL_dconic.x);
+			dL_dc_xy += denom2inv * 2 * (c_xy * c_yy * dL_dconic.x - (denom + 2 * c_xy * c_xy) * dL_dconic.y + c_xx * c_xy * dL_dconic.z);
+
+			// Gradients of loss L w.r.t. each 3D covariance matrix (Vrk) entry,
+			// given gradients w.r.t. 2D covariance matrix (diagonal).
+			dL_dcov3D[0] = (A[0] * A[0] * dL_dc_xx + A[0] * B[0] * dL_dc_xy + B[0] * B[0] * dL_dc_yy);
+			dL_dcov3D[3] = (A[1] * A[1] * dL_dc_xx + A[1] * B[1] * dL_dc_xy + B[1] * B[1] * dL_dc_yy);
+			dL_dcov3D[5] = (A[2] * A[2] * dL_dc_xx + A[2] * B[2] * dL_dc_xy + B[2] * B[2] * dL_dc_yy);
+
+			// Gradients of loss L w.r.t. each 3D covariance matrix (Vrk) entry,
+			// given gradients w.r.t. 2D covariance matrix (off-diagonal).
+			// Off-diagonal elements appear twice --> double the gradient.
+			dL_dcov3D[1] = 2 * A[0] * A[1] * dL_dc_xx + (A[0] * B[1] + A[1] * B[0]) * dL_dc_xy + 2 * B[0] * B[1] * dL_dc_yy;
+			dL_dcov3D[2] = 2 * A[0] * A[2] * dL_dc_xx + (A[0] * B[2] + A[2] * B[0]) * dL_dc_xy + 2 * B[0] * B[2] * dL_dc_yy;
+			dL_dcov3D[4] = 2 * A[2] * A[1] * dL_dc_xx + (A[1] * B[2] + A[2] * B[1]) * dL_dc_xy + 2 * B[1] * B[2] * dL_dc_yy;
+		}
+		else
+		{
+			for (int i = 0; i < 6; i++)
+				dL_dcov3D[i] = 0;
+		}
+
+		// Gradients of loss w.r.t. upper 2x3 portion of intermediate matrix T
+		float dL_dA[3], dL_dB[3];
+		for (int i = 0; i < 3; i++)
+		{
+			dL_dA[i] = 2 * VA[i] * dL_dc_xx + VB[i] * dL_dc_xy;
+			dL_dB[i] = 2 * VB[i] * dL_dc_yy + VA[i] * dL_dc_xy;
+		}
+
+		// Gradients of loss w.r.t. upper 3x2 non-zero entries of Jacobian matrix
+		// T = W * J
+		const float dL_dJ00 = view_matrix[0] * dL_dA[0] + view_matrix[4] * dL_dA[1] + view_matrix[8] * dL_dA[2];
+		const float dL_dJ02 = view_matrix[2] * dL_dA[0] + view_matrix[6] * dL_dA[1] + view_matrix[10] * dL_dA[2];
+		const float dL_dJ11 = view_matrix[1] * dL_dB[0] + view_matrix[5] * dL_dB[1] + view_matrix[9] * dL_dB[2];
+		const float dL_dJ12 = view_matrix[2] * dL_dB[0] + view_matrix[6] * dL_dB[1] + view_matrix[10] * dL_dB[2];
+
+		const float tz = 1.f / t.z;
+		const float tz2 = tz * tz;
+		const float tz3 = tz2 * tz;
+
+		// Gradients of loss w.r.t. transformed Gaussian mean t
+		const float3 dL_dt = {
+			x_grad_mul * -h_x * tz2 * dL_dJ02,
+			y_grad_mul * -h_y * tz2 * dL_dJ12,
+			-h_x * tz2 * dL_dJ00 - h_y * tz2 * dL_dJ11 + (2 * h_x * t.x) * tz3 * dL_dJ02 + (2 * h_y * t.y) * tz3 * dL_dJ12 };
+
+		// Camera pose, left perturbation of T_CW: dt/drho = I, dt/dtheta = -skew(t)
+		const float3 dL_dtheta_t = cross(t, dL_dt);
+		dL_dtau[6 * idx + 0] += dL_dt.x;
+		dL_dtau[6 * idx + 1] += dL_dt.y;
+		dL_dtau[6 * idx + 2] += dL_dt.z;
+		dL_dtau[6 * idx + 3] += dL_dtheta_t.x;
+		dL_dtau[6 * idx + 4] += dL_dtheta_t.y;
+		dL_dtau[6 * idx + 5] += dL_dtheta_t.z;
+
+		// Account for transformation of mean to t
+		// t = transformPoint4x3(mean, view_matrix);
+		// Gradients of loss w.r.t. Gaussian means, but only the portion
+		// that is caused because the mean affects the covariance matrix.
+		// Additional mean gradient is accumulated in preprocessGaussian.
+		dL_dmeans[idx] = transformVec4x3Transpose(dL_dt, view_matrix);
+
+		// Gradients of loss w.r.t. W, by column of the view rotation R
+		const float3 dL_dW[3] = {
+			{ J00 * dL_dA[0], J11 * dL_dB[0], J02 * dL_dA[0] + J12 * dL_dB[0] },
+			{ J00 * dL_dA[1], J11 * dL_dB[1], J02 * dL_dA[1] + J12 * dL_dB[1] },
+			{ J00 * dL_dA[2], J11 * dL_dB[2], J02 * dL_dA[2] + J12 * dL_dB[2] } };
+
+		// Rotating the camera by theta moves column c of R by theta x c
+		float3 dL_dtheta = { 0.f, 0.f, 0.f };
+		for (int c = 0; c < 3; c++)
+		{
+			const float3 col = { view_matrix[4 * c], view_matrix[4 * c + 1], view_matrix[4 * c + 2] };
+			const float3 d = cross(col, dL_dW[c]);
+			dL_dtheta.x += d.x;
+			dL_dtheta.y += d.y;
+			dL_dtheta.z += d.z;
+		}
+		dL_dtau[6 * idx + 3] += dL_dtheta.x;
+		dL_dtau[6 * idx + 4] += dL_dtheta.y;
+		dL_dtau[6 * idx + 5] += dL_dtheta.z;
+	}
+
+	// Backward pass for the conversion of scale and rotation to a
+	// 3D covariance matrix for each Gaussian. Matrices are indexed
+	// [column][row] as the glm ones of backward.cu.
+	void computeCov3D(int idx, const float3 scale, float mod, const float4 rot, const float* dL_dcov3Ds, float3* dL_dscales, float4* dL_drots)
+	{
+		// Recompute (intermediate) results for the 3D covariance computation.
+		const float r = rot.x;
+		const float x = rot.y;
+		const float y = rot.z;
+		const float z = rot.w;
+
+		const float R[3][3] = {
+			{ 1.f - 2.f * (y * y + z * z), 2.f * (x * y - r * z), 2.f * (x * z + r * y) },
+			{ 2.f * (x * y + r * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - r * x) },
+			{ 2.f * (x * z - r * y), 2.f * (y * z + r * x), 1.f - 2.f * (x * x + y * y) } };
+
+		const float s[3] = { mod * scale.x, mod * scale.y, mod * scale.z };
+
+		// M = S * R
+		float M[3][3];
+		for (int c = 0; c < 3; c++)
+			for (int k = 0; k < 3; k++)
+				M[c][k] = s[k] * R[c][k];
+
+		// Convert per-element covariance loss gradients to matrix form
+		const float* dL_dcov3D = dL_dcov3Ds + 6 * idx;
+		const float dL_dSigma[3][3] = {
+			{ dL_dcov3D[0], 0.5f * dL_dcov3D[1], 0.5f * dL_dcov3D[2] },
+			{ 0.5f * dL_dcov3D[1], dL_dcov3D[3], 0.5f * dL_dcov3D[4] },
+			{ 0.5f * dL_dcov3D[2], 0.5f * dL_dcov3D[4], dL_dcov3D[5] } };
+
+		// Compute loss gradient w.r.t. matrix M
+		// dSigma_dM = 2 * M
+		float dL_dM[3][3];
+		for (int c = 0; c < 3; c++)
+			for (int k = 0; k < 3; k++)
+				dL_dM[c][k] = 2.0f * (M[0][k] * dL_dSigma[c][0] + M[1][k] * dL_dSigma[c][1] + M[2][k] * dL_dSigma[c][2]);
+
+		// Gradients of loss w.r.t. scale
+		float3* dL_dscale = dL_dscales + idx;
+		dL_dscale->x = R[0][0] * dL_dM[0][0] + R[1][0] * dL_dM[1][0] + R[2][0] * dL_dM[2][0];
+		dL_dscale->y = R[0][1] * dL_dM[0][1] + R[1][1] * dL_dM[1][1] + R[2][1] * dL_dM[2][1];
+		dL_dscale->z = R[0][2] * dL_dM[0][2] + R[1][2] * dL_dM[1][2] + R[2][2] * dL_dM[2][2];
+
+		// transpose(dL_dM), with column c scaled by s[c]
+		float dL_dMt[3][3];
+		for (int c = 0; c < 3; c++)
+			for (int k = 0; k < 3; k++)
+				dL_dMt[c][k] = dL_dM[k][c] * s[c];
+
+		// Gradients of loss w.r.t. normalized quaternion
+		float4 dL_dq;
+		dL_dq.x = 2 * z * (dL_dMt[0][1] - dL_dMt[1][0]) + 2 * y * (dL_dMt[2][0] - dL_dMt[0][2]) + 2 * x * (dL_dMt[1][2] - dL_dMt[2][1]);
+		dL_dq.y = 2 * y * (dL_dMt[1][0] + dL_dMt[0][1]) + 2 * z * (dL_dMt[2][0] + dL_dMt[0][2]) + 2 * r * (dL_dMt[1][2] - dL_dMt[2][1]) - 4 * x * (dL_dMt[2][2] + dL_dMt[1][1]);
+		dL_dq.z = 2 * x * (dL_dMt[1][0] + dL_dMt[0][1]) + 2 * r * (dL_dMt[2][0] - dL_dMt[0][2]) + 2 * z * (dL_dMt[1][2] + dL_dMt[2][1]) - 4 * y * (dL_dMt[2][2] + dL_dMt[0][0]);
+		dL_dq.w = 2 * r * (dL_dMt[0][1] - dL_dMt[1][0]) + 2 * x * (dL_dMt[2][0] + dL_dMt[0][2]) + 2 * y * (dL_dMt[1][2] + dL_dMt[2][1]) - 4 * z * (dL_dMt[1][1] + dL_dMt[0][0]);
+
+		// Gradients of loss w.r.t. unnormalized quaternion, which the
+		// rasterizer takes as normalized, as in backward.cu
+		dL_drots[idx] = dL_dq;
+	}
+
+	// Backward pass of the preprocessing steps, except
+	// for the covariance computation and inversion
+	// (those are handled by computeCov2D before)
+	void preprocessGaussian(int idx, int D, int M,
+		const float3* means,
+		const float* shs,
+		const bool* clamped,
+		const float3* scales,
+		const float4* rotations,
+		const float scale_modifier,
+		const float* viewmatrix,
+		const float* proj,
+		const float* proj_raw,
+		const float3* campos,
+		const float3* dL_dmean2D,
+		float3* dL_dmeans,
+		float* dL_dcolor,
+		const float* dL_ddepth,
+		const float* dL_dcov3D,
+		float* dL_dsh,
+		float3* dL_dscale,
+		float4* dL_drot,
+		float* dL_dtau)
+	{
+		const float3 m = means[idx];
+
+		// Taking care of gradients from the screenspace points
+		const float4 m_hom = transformPoint4x4(m, proj);
+		const float m_w = 1.0f / (m_hom.w + 0.0000001f);
+
+		// Compute loss gradient w.r.t. 3D means due to gradients of 2D means
+		// from rendering procedure
+		const float3 dL_dm2D = dL_dmean2D[idx];
+		const float mul1 = (proj[0] * m.x + proj[4] * m.y + proj[8] * m.z + proj[12]) * m_w * m_w;
+		const float mul2 = (proj[1] * m.x + proj[5] * m.y + proj[9] * m.z + proj[13]) * m_w * m_w;
+
+		// That's the second part of the mean gradient. Previous computation
+		// of cov2D and following SH conversion also affects it.
+		dL_dmeans[idx].x += (proj[0] * m_w - proj[3] * mul1) * dL_dm2D.x + (proj[1] * m_w - proj[3] * mul2) * dL_dm2D.y;
+		dL_dmeans[idx].y += (proj[4] * m_w - proj[7] * mul1) * dL_dm2D.x + (proj[5] * m_w - proj[7] * mul2) * dL_dm2D.y;
+		dL_dmeans[idx].z += (proj[8] * m_w - proj[11] * mul1) * dL_dm2D.x + (proj[9] * m_w - proj[11] * mul2) * dL_dm2D.y;
+
+		// Derivatives of the projected mean w.r.t. the camera space mean p_C,
+		// from the entries of the raw projection matrix
+		const float alpha = 1.0f * m_w;
+		const float beta = -m_hom.x * m_w * m_w;
+		const float gamma = -m_hom.y * m_w * m_w;
+
+		const float a = proj_raw[0];
+		const float b = proj_raw[5];
+		const float e = proj_raw[11];
+
+		const float3 p_C = transformPoint4x3(m, viewmatrix);
+		const float3 d_proj_dp_C1 = { alpha * a, 0.f, beta * e };
+		const float3 d_proj_dp_C2 = { 0.f, alpha * b, gamma * e };
+
+		// dp_C/drho = I and dp_C/dtheta = -skew(p_C)
+		const float3 d_proj_dp_C1_d_theta = cross(p_C, d_proj_dp_C1);
+		const float3 d_proj_dp_C2_d_theta = cross(p_C, d_proj_dp_C2);
+
+		float* dL_dt = dL_dtau + 6 * idx;
+		dL_dt[0] += dL_dm2D.x * d_proj_dp_C1.x + dL_dm2D.y * d_proj_dp_C2.x;
+		dL_dt[1] += dL_dm2D.x * d_proj_dp_C1.y + dL_dm2D.y * d_proj_dp_C2.y;
+		dL_dt[2] += dL_dm2D.x * d_proj_dp_C1.z + dL_dm2D.y * d_proj_dp_C2.z;
+		dL_dt[3] += dL_dm2D.x * d_proj_dp_C1_d_theta.x + dL_dm2D.y * d_proj_dp_C2_d_theta.x;
+		dL_dt[4] += dL_dm2D.x * d_proj_dp_C1_d_theta.y + dL_dm2D.y * d_proj_dp_C2_d_theta.y;
+		dL_dt[5] += dL_dm2D.x * d_proj_dp_C1_d_theta.z + dL_dm2D.y * d_proj_dp_C2_d_theta.z;
+
+		// Compute gradient update due to computing depths
+		// p_orig = m
+		// p_view = transformPoint4x3(p_orig, viewmatrix);
+		// depth = p_view.z;
+		const float dL_dpCz = dL_ddepth[idx];
+		dL_dmeans[idx].x += dL_dpCz * viewmatrix[2];
+		dL_dmeans[idx].y += dL_dpCz * viewmatrix[6];
+		dL_dmeans[idx].z += dL_dpCz * viewmatrix[10];
+
+		dL_dt[2] += dL_dpCz;
+		dL_dt[3] += dL_dpCz * p_C.y;
+		dL_dt[4] += dL_dpCz * -p_C.x;
+
+		// Compute gradient updates due to computing colors from SHs
+		if (shs)
+			computeColorFromSH(idx, D, M, means, *campos, shs, clamped, dL_dcolor, dL_dmeans, dL_dsh, dL_dtau);
+
+		// Compute gradient updates due to computing covariance from scale/rotation
+		if (scales)
+			computeCov3D(idx, scales[idx], scale_modifier, rotations[idx], dL_dcov3D, dL_dscale, dL_drot);
+	}
+
+	// Gradients of one Gaussian summed over the pixels of one tile. Three
+	// color channels, as the reduction of the CUDA kernel.
+	struct TileGradient
+	{
+		float dL_dmean2D[2];
+		float dL_dconic2D[3];
+		float dL_dopacity;
+		float dL_dcolors[3];
+		float dL_ddepth;
+	};
+}
+
+void BACKWARD::preprocess(
+	int P, int D, int M,
+	const float3* means3D,
+	const int* radii,
+	const float* shs,
+	const bool* clamped,
+	const float* opacities,
+	const float3* scales,
+	const float4* rotations,
+	const float scale_modifier,
+	const float* cov3Ds,
+	const float* viewmatrix,
+	const float* projmatrix,
+	const float* projmatrix_raw,
+	const float focal_x, float focal_y,
+	const float tan_fovx, float tan_fovy,
+	const float3* campos,
+	const float3* dL_dmean2D,
+	const float* dL_dconic,
+	float* dL_dopacity,
+	float3* dL_dmean3D,
+	float* dL_dcolor,
+	float* dL_ddepth,
+	float* dL_dcov3D,
+	float* dL_dsh,
+	float3* dL_dscale,
+	float4* dL_drot,
+	float* dL_dtau,
+	bool antialiasing)
+{
+	parallelChunks(P, GRAIN_SIZE, [&](int, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx < end; idx++)
+		{
+			if (!(radii[idx] > 0))
+				continue;
+
+			// Propagate gradients for the path of 2D conic matrix computation.
+			// When done, loss gradient w.r.t. 3D means has been modified and
+			// gradient w.r.t. 3D covariance matrix has been computed.
+			computeCov2D(idx, means3D, cov3Ds, focal_x, focal_y, tan_fovx, tan_fovy, viewmatrix, opacities,
+				dL_dconic, dL_dopacity, dL_dmean3D, dL_dcov3D, dL_dtau, antialiasing);
+
+			// Propagate gradients for remaining steps: finish 3D mean gradients,
+			// propagate color gradients to SH (if desireD), propagate 3D covariance
+			// matrix gradients to scale and rotation.
+			preprocessGaussian(idx, D, M, means3D, shs, clamped, scales, rotations, scale_modifier,
+				viewmatrix, projmatrix, projmatrix_raw, campos, dL_dmean2D, dL_dmean3D, dL_dcolor, dL_ddepth,
+				dL_dcov3D, dL_dsh, dL_dscale, dL_drot, dL_dtau);
+		}
+	});
+}
+
+// Backward version of the rendering procedure. Each task goes through the Gaussians of
+// one tile back to front, applying each one to the pixels of its footprint at once as the
+// forward render does. The gradients a Gaussian gets from a tile go to the slot of that
+// (Gaussian, tile) pair, the slots of a Gaussian are then summed in tile order. No two
+// tasks write the same memory and the result does not depend on the number of threads.
+void BACKWARD::render(
+	const dim3 grid,
+	const uint2* ranges,
+	const uint32_t* point_list,
+	int W, int H,
+	const float* bg_color,
+	const float2* means2D,
+	const float4* conic_opacity,
+	const float* colors,
+	const float* depths,
+	const float* final_Ts,
+	const uint32_t* n_contrib,
+	const int P,
+	const int* radii,
+	const uint32_t* point_offsets,
+	const float* dL_dpixels,
+	const float* dL_dpixels_depth,
+	float3* dL_dmean2D,
+	float4* dL_dconic2D,
+	float* dL_dopacity,
+	float* dL_dcolors,
+	float* dL_ddepths)
+{
+	// Slots are laid out as the keys before sorting: by Gaussian, then by tile in row order
+	const uint32_t num_rendered = P > 0 ? point_offsets[P - 1] : 0;
+	std::unique_ptr<TileGradient[]> tile_gradients(new TileGradient[num_rendered]);
+
+	// Gradient of pixel coordinate w.r.t. normalized
+	// screen-space viewport corrdinates (-1 to 1)
+	const float ddelx_dx = 0.5f * W;
+	const float ddely_dy = 0.5f * H;
+
+	parallelTasks(grid.x * grid.y, [&](int tile)
+	{
+		const uint32_t tile_x = tile % grid.x, tile_y = tile / grid.x;
+		const uint2 pix_min = { tile_x * BLOCK_X, tile_y * BLOCK_Y };
+
+		alignas(64) float pixx[BLOCK_SIZE], pixy[BLOCK_SIZE];
+		alignas(64) float T[BLOCK_SIZE], T_final[BLOCK_SIZE];
+		alignas(64) uint32_t last_contributor[BLOCK_SIZE];
+		alignas(64) float dL_dpixel[NUM_CHANNELS][BLOCK_SIZE], dL_dpixel_depth[BLOCK_SIZE], bg_dot_dpixel[BLOCK_SIZE];
+		alignas(64) float accum_rec[NUM_CHANNELS][BLOCK_SIZE], last_color[NUM_CHANNELS][BLOCK_SIZE];
+		alignas(64) float accum_rec_depth[BLOCK_SIZE], last_depth[BLOCK_SIZE], last_alpha[BLOCK_SIZE];
+
+		// In the forward, we stored the final value for T, the
+		// product of all (1 - alpha) factors, and the number of the
+		// last contributing Gaussian. Pixels outside the image have none.
+		for (int p = 0; p < BLOCK_SIZE; p++)
+		{
+			const uint32_t x = pix_min.x + p % BLOCK_X, y = pix_min.y + p / BLOCK_X;
+			const bool inside = x < (uint32_t)W && y < (uint32_t)H;
+			const uint32_t pix_id = W * y + x;
+			pixx[p] = (float)x;
+			pixy[p] = (float)y;
+			T_final[p] = inside ? final_Ts[pix_id] : 0.f;
+			T[p] = T_final[p];
+			last_contributor[p] = inside ? n_contrib[pix_id] : 0;
+			bg_dot_dpixel[p] = 0.f;
+			for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			{
+				dL_dpixel[ch][p] = inside ? dL_dpixels[ch * H * W + pix_id] : 0.f;
+				bg_dot_dpixel[p] += bg_color[ch] * dL_dpixel[ch][p];
+				accum_rec[ch][p] = 0.f;
+				last_color[ch][p] = 0.f;
+			}
+			dL_dpixel_depth[p] = inside ? dL_dpixels_depth[pix_id] : 0.f;
+			accum_rec_depth[p] = 0.f;
+			last_depth[p] = 0.f;
+			last_alpha[p] = 0.f;
+		}
+
+		// Traverse all Gaussians, start in the BACK
+		const uint2 range = ranges[tile];
+		for (uint32_t contributor = range.y - range.x; contributor-- > 0;)
+		{
+			const uint32_t id = point_list[range.x + contributor];
+			const float2 xy = means2D[id];
+			const float4 con_o = conic_opacity[id];
+			const float* color = colors + id * NUM_CHANNELS;
+			const float depth = depths[id];
+
+			float dL_dmean2D_x = 0.f, dL_dmean2D_y = 0.f;
+			float dL_dconic_x = 0.f, dL_dconic_y = 0.f, dL_dconic_w = 0.f;
+			float dL_dopacity_acc = 0.f, dL_ddepth_acc = 0.f;
+			float dL_dcolors_acc_x = 0.f, dL_dcolors_acc_y = 0.f, dL_dcolors_acc_z = 0.f;
+
+			int x0, x1, y0, y1;
+			if (footprint(xy, con_o, pix_min, x0, x1, y0, y1))
+			{
+				for (int py = y0; py <= y1; py++)
+				{
+#pragma omp simd reduction(+:dL_dmean2D_x, dL_dmean2D_y, dL_dconic_x, dL_dconic_y, dL_dconic_w, dL_dopacity_acc, dL_ddepth_acc, dL_dcolors_acc_x, dL_dcolors_acc_y, dL_dcolors_acc_z)
+					for (int p = py * BLOCK_X + x0; p <= py * BLOCK_X + x1; p++)
+					{
+						// Compute blending values, as before. Skip this Gaussian
+						// if it is behind the last contributor for this pixel.
+						const float dx = xy.x - pixx[p], dy = xy.y - pixy[p];
+						const float power = -0.5f * (con_o.x * dx * dx + con_o.z * dy * dy) - con_o.y * dx * dy;
+						const float G = expNonPositive(std::min(power, 0.0f));
+						const float alpha = std::min(0.99f, con_o.w * G);
+						const bool skip = (contributor >= last_contributor[p]) | (power > 0.0f) | (alpha < 1.0f / 255.0f);
+
+						const float T_before = T[p] / (1.f - alpha);
+						T[p] = skip ? T[p] : T_before;
+						const float dchannel_dcolor = alpha * T[p];
+
+						// Propagate gradients to per-Gaussian colors and keep
+						// gradients w.r.t. alpha (blending factor for a Gaussian/pixel
+						// pair).
+						float dL_dalpha = 0.0f;
+						float local_dL_dcolors[3];
+						for (int ch = 0; ch < NUM_CHANNELS; ch++)
+						{
+							// Update last color (to be used in the next iteration)
+							accum_rec[ch][p] = skip ? accum_rec[ch][p] : last_alpha[p] * last_color[ch][p] + (1.f - last_alpha[p]) * accum_rec[ch][p];
+							last_color[ch][p] = skip ? last_color[ch][p] : color[ch];
+
+							dL_dalpha += (color[ch] - accum_rec[ch][p]) * dL_dpixel[ch][p];
+							local_dL_dcolors[ch] = dchannel_dcolor * dL_dpixel[ch][p];
+						}
+
+						accum_rec_depth[p] = skip ? accum_rec_depth[p] : last_alpha[p] * last_depth[p] + (1.f - last_alpha[p]) * accum_rec_depth[p];
+						last_depth[p] = skip ? last_depth[p] : depth;
+						dL_dalpha += (depth - accum_rec_depth[p]) * dL_dpixel_depth[p];
+						const float local_dL_ddepth = dchannel_dcolor * dL_dpixel_depth[p];
+
+						dL_dalpha *= T[p];
+						// Update last alpha (to be used in the next iteration)
+						last_alpha[p] = skip ? last_alpha[p] : alpha;
+
+						// Account for fact that alpha also influences how much of
+						// the background color is added if nothing left to blend
+						dL_dalpha += (-T_final[p] / (1.f - alpha)) * bg_dot_dpixel[p];
+
+						// Helpful reusable temporary variables
+						const float dL_dG = con_o.w * dL_dalpha;
+						const float gdx = G * dx;
+						const float gdy = G * dy;
+						const float dG_ddelx = -gdx * con_o.x - gdy * con_o.y;
+						const float dG_ddely = -gdy * con_o.z - gdx * con_o.y;
+
+						const float local_dL_dmean2D_x = dL_dG * dG_ddelx * ddelx_dx;
+						const float local_dL_dmean2D_y = dL_dG * dG_ddely * ddely_dy;
+						const float local_dL_dconic_x = -0.5f * gdx * dx * dL_dG;
+						const float local_dL_dconic_y = -0.5f * gdx * dy * dL_dG;
+						const float local_dL_dconic_w = -0.5f * gdy * dy * dL_dG;
+						const float local_dL_dopacity = G * dL_dalpha;
+
+						// Sum the pixels that were not skipped. The values are computed for all
+						// of them and selected, a conditional computation would not vectorize.
+						dL_dmean2D_x += skip ? 0.f : local_dL_dmean2D_x;
+						dL_dmean2D_y += skip ? 0.f : local_dL_dmean2D_y;
+						dL_dconic_x += skip ? 0.f : local_dL_dconic_x;
+						dL_dconic_y += skip ? 0.f : local_dL_dconic_y;
+						dL_dconic_w += skip ? 0.f : local_dL_dconic_w;
+						dL_dopacity_acc += skip ? 0.f : local_dL_dopacity;
+						dL_dcolors_acc_x += skip ? 0.f : local_dL_dcolors[0];
+						dL_dcolors_acc_y += skip ? 0.f : local_dL_dcolors[1];
+						dL_dcolors_acc_z += skip ? 0.f : local_dL_dcolors[2];
+						dL_ddepth_acc += skip ? 0.f : local_dL_ddepth;
+					}
+				}
+			}
+
+			uint2 rect_min, rect_max;
+			getRect(xy, radii[id], rect_min, rect_max, grid);
+			const uint32_t slot = (id == 0 ? 0 : point_offsets[id - 1]) + (tile_y - rect_min.y) * (rect_max.x - rect_min.x) + (tile_x - rect_min.x);
+			TileGradient& g = tile_gradients[slot];
+			g.dL_dmean2D[0] = dL_dmean2D_x;
+			g.dL_dmean2D[1] = dL_dmean2D_y;
+			g.dL_dconic2D[0] = dL_dconic_x;
+			g.dL_dconic2D[1] = dL_dconic_y;
+			g.dL_dconic2D[2] = dL_dconic_w;
+			g.dL_dopacity = dL_dopacity_acc;
+			g.dL_dcolors[0] = dL_dcolors_acc_x;
+			g.dL_dcolors[1] = dL_dcolors_acc_y;
+			g.dL_dcolors[2] = dL_dcolors_acc_z;
+			g.dL_ddepth = dL_ddepth_acc;
+		}
+	});
+
+	// Sum up the tiles of each Gaussian
+	parallelChunks(P, GRAIN_SIZE, [&](int, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx < end; idx++)
+		{
+			TileGradient sum = {};
+			for (uint32_t slot = idx == 0 ? 0 : point_offsets[idx - 1]; slot < point_offsets[idx]; slot++)
+			{
+				const TileGradient& g = tile_gradients[slot];
+				sum.dL_dmean2D[0] += g.dL_dmean2D[0];
+				sum.dL_dmean2D[1] += g.dL_dmean2D[1];
+				for (int i = 0; i < 3; i++)
+					sum.dL_dconic2D[i] += g.dL_dconic2D[i];
+				sum.dL_dopacity += g.dL_dopacity;
+				for (int ch = 0; ch < 3; ch++)
+					sum.dL_dcolors[ch] += g.dL_dcolors[ch];
+				sum.dL_ddepth += g.dL_ddepth;
+			}
+
+			dL_dmean2D[idx].x += sum.dL_dmean2D[0];
+			dL_dmean2D[idx].y += sum.dL_dmean2D[1];
+			dL_dconic2D[idx].x += sum.dL_dconic2D[0];
+			dL_dconic2D[idx].y += sum.dL_dconic2D[1];
+			dL_dconic2D[idx].w += sum.dL_dconic2D[2];
+			dL_dopacity[idx] += sum.dL_dopacity;
+			for (int ch = 0; ch < 3; ch++)
+				dL_dcolors[idx * NUM_CHANNELS + ch] += sum.dL_dcolors[ch];
+			dL_ddepths[idx] += sum.dL_ddepth;
+		}
+	});
+}
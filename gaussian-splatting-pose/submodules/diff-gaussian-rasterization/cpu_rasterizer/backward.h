@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#ifndef CPU_RASTERIZER_BACKWARD_H_INCLUDED
+#define CPU_RASTERIZER_BACKWARD_H_INCLUDED
+
+#include "auxiliary.h"
+
+namespace CpuRasterizer
+{
+namespace BACKWARD
+{
+	// Per-Gaussian gradients are accumulated into the outputs, which the caller zeroes.
+	// radii and point_offsets are the ones of the forward pass, they locate the tiles
+	// of each Gaussian so that the tile sums are added up in a fixed order.
+	void render(
+		const dim3 grid,
+		const uint2* ranges,
+		const uint32_t* point_list,
+		int W, int H,
+		const float* bg_color,
+		const float2* means2D,
+		const float4* conic_opacity,
+		const float* colors,
+		const float* depths,
+		const float* final_Ts,
+		const uint32_t* n_contrib,
+		const int P,
+		const int* radii,
+		const uint32_t* point_offsets,
+		const float* dL_dpixels,
+		const float* dL_dpixels_depth,
+		float3* dL_dmean2D,
+		float4* dL_dconic2D,
+		float* dL_dopacity,
+		float* dL_dcolors,
+		float* dL_ddepths);
+
+	void preprocess(
+		int P, int D, int M,
+		const float3* means,
+		const int* radii,
+		const float* shs,
+		const bool* clamped,
+		const float* opacities,
+		const float3* scales,
+		const float4* rotations,
+		const float scale_modifier,
+		const float* cov3Ds,
+		const float* view,
+		const float* proj,
+		const float* proj_raw,
+		const float focal_x, float focal_y,
+		const float tan_fovx, float tan_fovy,
+		const float3* campos,
+		const float3* dL_dmean2D,
+		const float* dL_dconics,
+		float* dL_dopacity,
+		float3* dL_dmeans,
+		float* dL_dcolor,
+		float* dL_ddepth,
+		float* dL_dcov3D,
+		float* dL_dsh,
+		float3* dL_dscale,
+		float4* dL_drot,
+		float* dL_dtau,
+		bool antialiasing);
+}
+};
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+// Throughput of the CPU rasterizer on a synthetic scene, per number of threads.
+// The images of every run are compared with the single threaded one, and with the
+// CUDA rasterizer when built with it (WITH_CUDA). With --backward the backward pass
+// is timed instead, for random image gradients, and its gradients have to be the
+// same bit for bit whatever the number of threads.
+//
+// Usage: cpu_rasterizer_benchmark [--gaussians N] [--width W] [--height H] [--sh-degree D]
+//                                 [--threads 1,2,4,...] [--iterations N] [--tolerance T]
+//                                 [--backward]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rasterizer.h"
+#include "parallel.h"
+
+#ifdef WITH_CUDA
+#include <cuda_runtime_api.h>
+#include "../cuda_rasterizer/rasterizer.h"
+#endif
+
+namespace
+{
+	struct Scene
+	{
+		int P, D, M, width, height;
+		float tan_fovx, tan_fovy;
+		std::vector<float> means3D, shs, opacities, scales, rotations;
+		float viewmatrix[16], projmatrix[16], campos[3], background[3];
+		std::vector<float> dL_dpix, dL_dpix_depth;
+	};
+
+	// Gaussians spread in front of a camera at the origin looking along +z, with the view and
+	// projection matrices laid out as the Python side passes them (column major).
+	Scene makeScene(int P, int width, int height, int degree)
+	{
+		Scene s;
+		s.P = P;
+		s.D = degree;
+		s.M = (degree + 1) * (degree + 1);
+		s.width = width;
+		s.height = height;
+		s.tan_fovx = 0.6f;
+		s.tan_fovy = s.tan_fovx * height / width;
+
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> uni(0.f, 1.f);
+		std::normal_distribution<float> normal(0.f, 1.f);
+		for (int i = 0; i < P; i++)
+		{
+			const float z = 1.f + 9.f * uni(rng);
+			s.means3D.push_back((2.f * uni(rng) - 1.f) * 1.2f * s.tan_fovx * z);
+			s.means3D.push_back((2.f * uni(rng) - 1.f) * 1.2f * s.tan_fovy * z);
+			s.means3D.push_back(z);
+			for (int k = 0; k < 3; k++)
+				s.scales.push_back(0.005f * std::exp(3.f * uni(rng)));
+			float q[4], norm = 0.f;
+			for (int k = 0; k < 4; k++)
+			{
+				q[k] = normal(rng);
+				norm += q[k] * q[k];
+			}
+			for (int k = 0; k < 4; k++)
+				s.rotations.push_back(q[k] / std::sqrt(norm));
+			s.opacities.push_back(0.05f + 0.94f * uni(rng));
+			for (int k = 0; k < s.M * 3; k++)
+				s.shs.push_back(k < 3 ? normal(rng) : 0.2f * normal(rng));
+		}
+
+		const float znear = 0.01f, zfar = 100.f;
+		std::memset(s.viewmatrix, 0, sizeof(s.viewmatrix));
+		std::memset(s.projmatrix, 0, sizeof(s.projmatrix));
+		for (int k = 0; k < 4; k++)
+			s.viewmatrix[5 * k] = 1.f;
+		s.projmatrix[0] = 1.f / s.tan_fovx;
+		s.projmatrix[5] = 1.f / s.tan_fovy;
+		s.projmatrix[10] = zfar / (zfar - znear);
+		s.projmatrix[11] = 1.f;
+		s.projmatrix[14] = -(zfar * znear) / (zfar - znear);
+		s.campos[0] = s.campos[1] = s.campos[2] = 0.f;
+		s.background[0] = s.background[1] = s.background[2] = 0.f;
+
+		// Image gradients of the backward pass
+		for (int i = 0; i < 3 * width * height; i++)
+			s.dL_dpix.push_back(2.f * uni(rng) - 1.f);
+		for (int i = 0; i < width * height; i++)
+			s.dL_dpix_depth.push_back(0.1f * (2.f * uni(rng) - 1.f));
+		return s;
+	}
+
+	struct Output
+	{
+		std::vector<float> color, depth, opacity;
+		std::vector<int> radii;
+		int rendered = 0;
+	};
+
+	std::function<char*(size_t N)> resizeFunctional(std::vector<char>& buffer)
+	{
+		return [&buffer](size_t N) {
+			buffer.resize(N);
+			return buffer.data();
+		};
+	}
+
+	void renderCPU(const Scene& s, std::vector<char>& geom, std::vector<char>& binning, std::vector<char>& image, Output& out)
+	{
+		const size_t N = (size_t)s.width * s.height;
+		out.color.resize(3 * N);
+		out.depth.resize(N);
+		out.opacity.resize(N);
+		out.radii.resize(s.P);
+		out.rendered = CpuRasterizer::Rasterizer::forward(
+			resizeFunctional(geom), resizeFunctional(binning), resizeFunctional(image),
+			s.P, s.D, s.M, s.background, s.width, s.height,
+			s.means3D.data(), s.shs.data(), nullptr, s.opacities.data(), s.scales.data(), 1.f, s.rotations.data(), nullptr,
+			s.viewmatrix, s.projmatrix, s.campos, s.tan_fovx, s.tan_fovy, false,
+			out.color.data(), out.depth.data(), out.opacity.data(), false, out.radii.data());
+	}
+
+	struct Gradients
+	{
+		std::vector<float> mean2D, conic, opacity, color, depth, mean3D, cov3D, sh, scale, rot, tau;
+	};
+
+	// The identity view matrix makes projmatrix the raw projection as well
+	void backwardCPU(const Scene& s, std::vector<char>& geom, std::vector<char>& binning, std::vector<char>& image, const Output& out, Gradients& g)
+	{
+		g.mean2D.assign(3 * s.P, 0.f);
+		g.conic.assign(4 * s.P, 0.f);
+		g.opacity.assign(s.P, 0.f);
+		g.color.assign(3 * s.P, 0.f);
+		g.depth.assign(s.P, 0.f);
+		g.mean3D.assign(3 * s.P, 0.f);
+		g.cov3D.assign(6 * s.P, 0.f);
+		g.sh.assign(3 * s.M * s.P, 0.f);
+		g.scale.assign(3 * s.P, 0.f);
+		g.rot.assign(4 * s.P, 0.f);
+		g.tau.assign(6 * s.P, 0.f);
+		CpuRasterizer::Rasterizer::backward(s.P, s.D, s.M, out.rendered, s.background, s.width, s.height,
+			s.means3D.data(), s.shs.data(), nullptr, s.opacities.data(), s.scales.data(), 1.f, s.rotations.data(), nullptr,
+			s.viewmatrix, s.projmatrix, s.projmatrix, s.campos, s.tan_fovx, s.tan_fovy, out.radii.data(),
+			geom.data(), binning.data(), image.data(), s.dL_dpix.data(), s.dL_dpix_depth.data(),
+			g.mean2D.data(), g.conic.data(), g.opacity.data(), g.color.data(), g.depth.data(), g.mean3D.data(),
+			g.cov3D.data(), g.sh.data(), g.scale.data(), g.rot.data(), g.tau.data(), false);
+	}
+
+#ifdef WITH_CUDA
+	template <typename T>
+	T* toDevice(const T* data, size_t n)
+	{
+		T* ptr = nullptr;
+		cudaMalloc(&ptr, n * sizeof(T));
+		if (data != nullptr)
+			cudaMemcpy(ptr, data, n * sizeof(T), cudaMemcpyHostToDevice);
+		return ptr;
+	}
+
+	std::function<char*(size_t N)> deviceFunctional(char*& buffer, size_t& size)
+	{
+		return [&buffer, &size](size_t N) {
+			if (N > size)
+			{
+				cudaFree(buffer);
+				cudaMalloc(&buffer, N);
+				size = N;
+			}
+			return buffer;
+		};
+	}
+
+	void renderCUDA(const Scene& s, Output& out)
+	{
+		const size_t N = (size_t)s.width * s.height;
+		float* means3D = toDevice(s.means3D.data(), s.means3D.size());
+		float* shs = toDevice(s.shs.data(), s.shs.size());
+		float* opacities = toDevice(s.opacities.data(), s.opacities.size());
+		float* scales = toDevice(s.scales.data(), s.scales.size());
+		float* rotations = toDevice(s.rotations.data(), s.rotations.size());
+		float* viewmatrix = toDevice(s.viewmatrix, 16);
+		float* projmatrix = toDevice(s.projmatrix, 16);
+		float* campos = toDevice(s.campos, 3);
+		float* background = toDevice(s.background, 3);
+		float* color = toDevice<float>(nullptr, 3 * N);
+		float* depth = toDevice<float>(nullptr, N);
+		float* opacity = toDevice<float>(nullptr, N);
+		int* radii = toDevice<int>(nullptr, s.P);
+		int* n_touched = toDevice<int>(nullptr, s.P);
+		cudaMemset(n_touched, 0, s.P * sizeof(int));
+
+		char* geom = nullptr, *binning = nullptr, *image = nullptr;
+		size_t geomSize = 0, binningSize = 0, imageSize = 0;
+		out.rendered = CudaRasterizer::Rasterizer::forward(
+			deviceFunctional(geom, geomSize), deviceFunctional(binning, binningSize), deviceFunctional(image, imageSize),
+			s.P, s.D, s.M, background, s.width, s.height,
+			means3D, shs, nullptr, opacities, scales, 1.f, rotations, nullptr,
+			viewmatrix, projmatrix, campos, s.tan_fovx, s.tan_fovy, false,
+			color, depth, opacity, false, radii, n_touched, true);
+
+		out.color.resize(3 * N);
+		out.depth.resize(N);
+		out.opacity.resize(N);
+		out.radii.resize(s.P);
+		cudaMemcpy(out.color.data(), color, 3 * N * sizeof(float), cudaMemcpyDeviceToHost);
+		cudaMemcpy(out.depth.data(), depth, N * sizeof(float), cudaMemcpyDeviceToHost);
+		cudaMemcpy(out.opacity.data(), opacity, N * sizeof(float), cudaMemcpyDeviceToHost);
+		cudaMemcpy(out.radii.data(), radii, s.P * sizeof(int), cudaMemcpyDeviceToHost);
+
+		for (void* ptr : { (void*)means3D, (void*)shs, (void*)opacities, (void*)scales, (void*)rotations, (void*)viewmatrix,
+			(void*)projmatrix, (void*)campos, (void*)background, (void*)color, (void*)depth, (void*)opacity, (void*)radii,
+			(void*)n_touched, (void*)geom, (void*)binning, (void*)image })
+			cudaFree(ptr);
+	}
+#endif
+
+	// Largest absolute differences of the images and the number of different radii
+	bool compare(const char* name, const Output& a, const Output& b, float tolerance)
+	{
+		float colorDiff = 0.f, depthDiff = 0.f, opacityDiff = 0.f;
+		for (size_t i = 0; i < a.color.size(); i++)
+			colorDiff = std::max(colorDiff, std::fabs(a.color[i] - b.color[i]));
+		for (size_t i = 0; i < a.depth.size(); i++)
+		{
+			depthDiff = std::max(depthDiff, std::fabs(a.depth[i] - b.depth[i]));
+			opacityDiff = std::max(opacityDiff, std::fabs(a.opacity[i] - b.opacity[i]));
+		}
+		size_t radiiDiff = 0;
+		for (size_t i = 0; i < a.radii.size(); i++)
+			radiiDiff += a.radii[i] != b.radii[i];
+
+		const bool ok = colorDiff <= tolerance && opacityDiff <= tolerance && depthDiff <= tolerance * 10.f && radiiDiff == 0;
+		std::printf("%-28s max |diff| color %.2e depth %.2e opacity %.2e, radii differing %zu, rendered %d vs %d: %s\n",
+			name, colorDiff, depthDiff, opacityDiff, radiiDiff, a.rendered, b.rendered, ok ? "ok" : "MISMATCH");
+		return ok;
+	}
+
+	// Number of gradient values that differ at all
+	bool compare(const char* name, const Gradients& a, const Gradients& b)
+	{
+		size_t differing = 0;
+		const std::vector<float> Gradients::* members[] = { &Gradients::mean2D, &Gradients::conic, &Gradients::opacity,
+			&Gradients::color, &Gradients::depth, &Gradients::mean3D, &Gradients::cov3D, &Gradients::sh, &Gradients::scale,
+			&Gradients::rot, &Gradients::tau };
+		for (auto member : members)
+			for (size_t i = 0; i < (a.*member).size(); i++)
+				differing += std::memcmp(&(a.*member)[i], &(b.*member)[i], sizeof(float)) != 0;
+
+		std::printf("%-28s gradients differing %zu: %s\n", name, differing, differing == 0 ? "ok" : "MISMATCH");
+		return differing == 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int P = 200000, width = 1280, height = 720, degree = 3, iterations = 10;
+	float tolerance = 1e-3f;
+	bool backward = false;
+	std::vector<int> threads;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--backward")
+		{
+			backward = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		if (arg == "--gaussians")
+			P = std::atoi(argv[++i]);
+		else if (arg == "--width")
+			width = std::atoi(argv[++i]);
+		else if (arg == "--height")
+			height = std::atoi(argv[++i]);
+		else if (arg == "--sh-degree")
+			degree = std::atoi(argv[++i]);
+		else if (arg == "--iterations")
+			iterations = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--tolerance")
+			tolerance = std::atof(argv[++i]);
+		else if (arg == "--threads")
+		{
+			std::stringstream ss(argv[++i]);
+			std::string n;
+			while (std::getline(ss, n, ','))
+				threads.push_back(std::max(1, std::atoi(n.c_str())));
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+	if (threads.empty())
+	{
+		for (int n = 1; n < CpuRasterizer::numThreads(); n *= 2)
+			threads.push_back(n);
+		threads.push_back(CpuRasterizer::numThreads());
+	}
+
+	const Scene scene = makeScene(P, width, height, degree);
+	std::printf("%d Gaussians, SH degree %d, %dx%d, %s pass\n", P, degree, width, height, backward ? "backward" : "forward");
+
+	bool ok = true;
+	Output reference;
+	Gradients referenceGradients;
+	double referenceMs = 0.0;
+	std::vector<char> geom, binning, image;
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		CpuRasterizer::setNumThreads(threads[t]);
+
+		// Warm up, which also sizes the buffers
+		Output out;
+		Gradients gradients;
+		renderCPU(scene, geom, binning, image, out);
+		if (backward)
+			backwardCPU(scene, geom, binning, image, out, gradients);
+
+		// The backward pass reuses the buffers of the last forward pass
+		std::vector<double> times;
+		for (int it = 0; it < iterations; it++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			if (backward)
+				backwardCPU(scene, geom, binning, image, out, gradients);
+			else
+				renderCPU(scene, geom, binning, image, out);
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		std::sort(times.begin(), times.end());
+		const double median = times[times.size() / 2];
+		if (t == 0)
+		{
+			reference = out;
+			referenceGradients = gradients;
+			referenceMs = median;
+		}
+
+		std::printf("threads %3d: median %8.2f ms (min %8.2f), %6.2f fps, %7.2f M Gaussians/s, %7.2f M splats/s, speedup %.2fx\n",
+			threads[t], median, times.front(), 1e3 / median, P / median * 1e-3, out.rendered / median * 1e-3, referenceMs / median);
+		if (t > 0)
+		{
+			ok &= compare(("  vs " + std::to_string(threads[0]) + " thread(s)").c_str(), out, reference, 0.f);
+			if (backward)
+				ok &= compare(("  vs " + std::to_string(threads[0]) + " thread(s)").c_str(), gradients, referenceGradients);
+		}
+	}
+
+#ifdef WITH_CUDA
+	Output cuda;
+	renderCUDA(scene, cuda);
+	ok &= compare("CPU vs CUDA", reference, cuda, tolerance);
+#else
+	(void)tolerance;
+#endif
+
+	return ok ? 0 : 1;
+}
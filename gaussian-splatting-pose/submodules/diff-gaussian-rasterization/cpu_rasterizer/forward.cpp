@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "forward.h"
+#include "parallel.h"
+#include <atomic>
+#include <stdexcept>
+
+using namespace CpuRasterizer;
+
+// Gaussians per preprocessing batch. A batch is processed one stage at a time with loops
+// over the whole batch, written without early exits so that the compiler vectorizes them.
+#define PREPROCESS_BATCH 256
+
+namespace
+{
+	// Forward method for converting scale and rotation properties of each
+	// Gaussian to a 3D covariance matrix in world space, as computeCov3D of
+	// forward.cu written out: Sigma = R^T S^2 R with the glm column-major R.
+	inline void computeCov3D(const float* scale, float mod, const float* rot, float* cov3D)
+	{
+		const float r = rot[0];
+		const float x = rot[1];
+		const float y = rot[2];
+		const float z = rot[3];
+
+		// R[c][k], column c of the glm matrix
+		const float R00 = 1.f - 2.f * (y * y + z * z), R01 = 2.f * (x * y - r * z), R02 = 2.f * (x * z + r * y);
+		const float R10 = 2.f * (x * y + r * z), R11 = 1.f - 2.f * (x * x + z * z), R12 = 2.f * (y * z - r * x);
+		const float R20 = 2.f * (x * z - r * y), R21 = 2.f * (y * z + r * x), R22 = 1.f - 2.f * (x * x + y * y);
+
+		// M = S * R
+		const float s0 = mod * scale[0], s1 = mod * scale[1], s2 = mod * scale[2];
+		const float M00 = s0 * R00, M01 = s1 * R01, M02 = s2 * R02;
+		const float M10 = s0 * R10, M11 = s1 * R11, M12 = s2 * R12;
+		const float M20 = s0 * R20, M21 = s1 * R21, M22 = s2 * R22;
+
+		// Sigma = M^T * M, upper right
+		cov3D[0] = M00 * M00 + M01 * M01 + M02 * M02;
+		cov3D[1] = M00 * M10 + M01 * M11 + M02 * M12;
+		cov3D[2] = M00 * M20 + M01 * M21 + M02 * M22;
+		cov3D[3] = M10 * M10 + M11 * M11 + M12 * M12;
+		cov3D[4] = M10 * M20 + M11 * M21 + M12 * M22;
+		cov3D[5] = M20 * M20 + M21 * M21 + M22 * M22;
+	}
+
+	// Forward version of 2D covariance matrix computation (EWA splatting), cov = (J W) Vrk (J W)^T
+	// with J the Jacobian of the projection at the clamped view space mean and W the view rotation.
+	inline float3 computeCov2D(const float3& mean, float focal_x, float focal_y, float tan_fovx, float tan_fovy, const float* cov3D, const float* viewmatrix)
+	{
+		float3 t = transformPoint4x3(mean, viewmatrix);
+
+		const float limx = 1.3f * tan_fovx;
+		const float limy = 1.3f * tan_fovy;
+		const float txtz = t.x / t.z;
+		const float tytz = t.y / t.z;
+		t.x = std::min(limx, std::max(-limx, txtz)) * t.z;
+		t.y = std::min(limy, std::max(-limy, tytz)) * t.z;
+
+		const float a = focal_x / t.z, b = -(focal_x * t.x) / (t.z * t.z);
+		const float c = focal_y / t.z, d = -(focal_y * t.y) / (t.z * t.z);
+
+		// Rows of T^T = J W
+		const float A0 = a * viewmatrix[0] + b * viewmatrix[2];
+		const float A1 = a * viewmatrix[4] + b * viewmatrix[6];
+		const float A2 = a * viewmatrix[8] + b * viewmatrix[10];
+		const float B0 = c * viewmatrix[1] + d * viewmatrix[2];
+		const float B1 = c * viewmatrix[5] + d * viewmatrix[6];
+		const float B2 = c * viewmatrix[9] + d * viewmatrix[10];
+
+		const float VA0 = cov3D[0] * A0 + cov3D[1] * A1 + cov3D[2] * A2;
+		const float VA1 = cov3D[1] * A0 + cov3D[3] * A1 + cov3D[4] * A2;
+		const float VA2 = cov3D[2] * A0 + cov3D[4] * A1 + cov3D[5] * A2;
+		const float VB0 = cov3D[0] * B0 + cov3D[1] * B1 + cov3D[2] * B2;
+		const float VB1 = cov3D[1] * B0 + cov3D[3] * B1 + cov3D[4] * B2;
+		const float VB2 = cov3D[2] * B0 + cov3D[4] * B1 + cov3D[5] * B2;
+
+		// Apply low-pass filter: every Gaussian should be at least
+		// one pixel wide/high.
+		return { A0 * VA0 + A1 * VA1 + A2 * VA2 + 0.3f, A0 * VB0 + A1 * VB1 + A2 * VB2, B0 * VB0 + B1 * VB1 + B2 * VB2 + 0.3f };
+	}
+
+	// Forward method for converting the input spherical harmonics
+	// coefficients of each Gaussian to a simple RGB color.
+	inline void computeColorFromSH(int idx, int deg, int max_coeffs, const float* means, const float* campos, const float* shs, bool* clamped, float* rgb)
+	{
+		float dir_x = means[3 * idx + 0] - campos[0];
+		float dir_y = means[3 * idx + 1] - campos[1];
+		float dir_z = means[3 * idx + 2] - campos[2];
+		const float inv_len = 1.0f / std::sqrt(dir_x * dir_x + dir_y * dir_y + dir_z * dir_z);
+		const float x = dir_x * inv_len, y = dir_y * inv_len, z = dir_z * inv_len;
+
+		const float* sh = shs + idx * max_coeffs * 3;
+		for (int ch = 0; ch < 3; ch++)
+		{
+			float result = SH_C0 * sh[ch];
+			if (deg > 0)
+			{
+				result = result - SH_C1 * y * sh[3 + ch] + SH_C1 * z * sh[6 + ch] - SH_C1 * x * sh[9 + ch];
+
+				if (deg > 1)
+				{
+					const float xx = x * x, yy = y * y, zz = z * z;
+					const float xy = x * y, yz = y * z, xz = x * z;
+					result = result +
+						SH_C2[0] * xy * sh[12 + ch] +
+						SH_C2[1] * yz * sh[15 + ch] +
+						SH_C2[2] * (2.0f * zz - xx - yy) * sh[18 + ch] +
+						SH_C2[3] * xz * sh[21 + ch] +
+						SH_C2[4] * (xx - yy) * sh[24 + ch];
+
+					if (deg > 2)
+					{
+						result = result +
+							SH_C3[0] * y * (3.0f * xx - yy) * sh[27 + ch] +
+							SH_C3[1] * xy * z * sh[30 + ch] +
+							SH_C3[2] * y * (4.0f * zz - xx - yy) * sh[33 + ch] +
+							SH_C3[3] * z * (2.0f * zz - 3.0f * xx - 3.0f * yy) * sh[36 + ch] +
+							SH_C3[4] * x * (4.0f * zz - xx - yy) * sh[39 + ch] +
+							SH_C3[5] * z * (xx - yy) * sh[42 + ch] +
+							SH_C3[6] * x * (xx - 3.0f * yy) * sh[45 + ch];
+					}
+				}
+			}
+			result += 0.5f;
+
+			// RGB colors are clamped to positive values. If values are
+			// clamped, we need to keep track of this for the backward pass.
+			clamped[3 * idx + ch] = (result < 0);
+			rgb[3 * idx + ch] = std::max(result, 0.0f);
+		}
+	}
+}
+
+void FORWARD::preprocess(int P, int D, int M,
+	const float* orig_points,
+	const float* scales,
+	const float scale_modifier,
+	const float* rotations,
+	const float* opacities,
+	const float* shs,
+	bool* clamped,
+	const float* cov3D_precomp,
+	const float* colors_precomp,
+	const float* viewmatrix,
+	const float* projmatrix,
+	const float* cam_pos,
+	const int W, int H,
+	const float focal_x, float focal_y,
+	const float tan_fovx, float tan_fovy,
+	int* radii,
+	float2* points_xy_image,
+	float* depths,
+	float* cov3Ds,
+	float* rgb,
+	float4* conic_opacity,
+	const dim3 grid,
+	uint32_t* tiles_touched,
+	bool prefiltered,
+	bool antialiasing)
+{
+	// The CUDA kernel only derives an (unused) convolution scaling from antialiasing, the output does not depend on it
+	(void)antialiasing;
+	std::atomic<bool> culledPrefiltered(false);
+
+	const int numBatches = (P + PREPROCESS_BATCH - 1) / PREPROCESS_BATCH;
+	parallelTasks(numBatches, [&](int batch)
+	{
+		const int begin = batch * PREPROCESS_BATCH;
+		const int end = std::min(P, begin + PREPROCESS_BATCH);
+
+		// If 3D covariance matrix is precomputed, use it, otherwise compute
+		// from scaling and rotation parameters.
+		const float* cov3D_batch = cov3D_precomp;
+		if (cov3D_precomp == nullptr)
+		{
+#pragma omp simd
+			for (int idx = begin; idx < end; idx++)
+				computeCov3D(scales + 3 * idx, scale_modifier, rotations + 4 * idx, cov3Ds + 6 * idx);
+			cov3D_batch = cov3Ds;
+		}
+
+		bool culled = false;
+#pragma omp simd reduction(|:culled)
+		for (int idx = begin; idx < end; idx++)
+		{
+			// Perform near culling
+			const float3 p_orig = { orig_points[3 * idx], orig_points[3 * idx + 1], orig_points[3 * idx + 2] };
+			const float3 p_view = transformPoint4x3(p_orig, viewmatrix);
+			const bool visible = in_frustum(p_view);
+			culled |= !visible;
+
+			// Transform point by projecting
+			const float4 p_hom = transformPoint4x4(p_orig, projmatrix);
+			const float p_w = 1.0f / (p_hom.w + 0.0000001f);
+			const float3 p_proj = { p_hom.x * p_w, p_hom.y * p_w, p_hom.z * p_w };
+
+			// Compute 2D screen-space covariance matrix
+			float3 cov = computeCov2D(p_orig, focal_x, focal_y, tan_fovx, tan_fovy, cov3D_batch + 6 * idx, viewmatrix);
+			constexpr float h_var = 0.3f;
+			cov.x += h_var;
+			cov.z += h_var;
+
+			// Invert covariance (EWA algorithm)
+			const float det = cov.x * cov.z - cov.y * cov.y;
+			const float det_inv = det != 0.0f ? 1.f / det : 0.0f;
+			const float3 conic = { cov.z * det_inv, -cov.y * det_inv, cov.x * det_inv };
+
+			// Compute extent in screen space (by finding eigenvalues of
+			// 2D covariance matrix). Use extent to compute a bounding rectangle
+			// of screen-space tiles that this Gaussian overlaps with.
+			const float mid = 0.5f * (cov.x + cov.z);
+			const float lambda1 = mid + std::sqrt(std::max(0.1f, mid * mid - det));
+			const float lambda2 = mid - std::sqrt(std::max(0.1f, mid * mid - det));
+			const float my_radius = std::ceil(3.f * std::sqrt(std::max(lambda1, lambda2)));
+			const float2 point_image = { ndc2Pix(p_proj.x, W), ndc2Pix(p_proj.y, H) };
+			uint2 rect_min, rect_max;
+			getRect(point_image, my_radius, rect_min, rect_max, grid);
+			const uint32_t tiles = (rect_max.y - rect_min.y) * (rect_max.x - rect_min.x);
+
+			// Radius and touched tiles stay 0 for Gaussians that are not processed further.
+			const bool valid = visible && det != 0.0f && tiles != 0;
+			radii[idx] = valid ? (int)my_radius : 0;
+			tiles_touched[idx] = valid ? tiles : 0;
+
+			// Store some useful helper data for the next steps.
+			depths[idx] = p_view.z;
+			points_xy_image[idx] = point_image;
+			// Inverse 2D covariance and opacity neatly pack into one float4
+			conic_opacity[idx] = { conic.x, conic.y, conic.z, opacities[idx] };
+		}
+		if (prefiltered && culled)
+			culledPrefiltered = true;
+
+		// If colors have been precomputed, use them, otherwise convert
+		// spherical harmonics coefficients to RGB color.
+		if (colors_precomp == nullptr)
+		{
+#pragma omp simd
+			for (int idx = begin; idx < end; idx++)
+			{
+				if (radii[idx] > 0)
+					computeColorFromSH(idx, D, M, orig_points, cam_pos, shs, clamped, rgb);
+			}
+		}
+	});
+
+	if (culledPrefiltered)
+		throw std::runtime_error("Point is filtered although prefiltered is set. This shouldn't happen!");
+}
+
+// Main rasterization method. Each task blends one tile: the Gaussians of the tile
+// are visited front to back, and each one is applied to the pixels of its footprint
+// in the tile at once, so that the inner loop runs over pixels and vectorizes.
+void FORWARD::render(
+	const dim3 grid,
+	const uint2* ranges,
+	const uint32_t* point_list,
+	int W, int H,
+	const float2* points_xy_image,
+	const float* features,
+	const float4* conic_opacity,
+	float* final_T,
+	uint32_t* n_contrib,
+	const float* bg_color,
+	float* out_color,
+	const float* depth,
+	float* out_depth,
+	float* out_opacity,
+	int* n_touched)
+{
+	parallelTasks(grid.x * grid.y, [&](int tile)
+	{
+		const uint32_t tile_x = tile % grid.x, tile_y = tile / grid.x;
+		const uint2 pix_min = { tile_x * BLOCK_X, tile_y * BLOCK_Y };
+
+		alignas(64) float pixx[BLOCK_SIZE], pixy[BLOCK_SIZE];
+		alignas(64) float T[BLOCK_SIZE], C[NUM_CHANNELS][BLOCK_SIZE], Dep[BLOCK_SIZE];
+		alignas(64) uint32_t last_contributor[BLOCK_SIZE];
+		alignas(64) uint8_t done[BLOCK_SIZE];
+
+		// Pixels outside the image are done from the start
+		for (int p = 0; p < BLOCK_SIZE; p++)
+		{
+			const uint32_t x = pix_min.x + p % BLOCK_X, y = pix_min.y + p / BLOCK_X;
+			pixx[p] = (float)x;
+			pixy[p] = (float)y;
+			T[p] = 1.0f;
+			for (int ch = 0; ch < NUM_CHANNELS; ch++)
+				C[ch][p] = 0.0f;
+			Dep[p] = 0.0f;
+			last_contributor[p] = 0;
+			done[p] = !(x < (uint32_t)W && y < (uint32_t)H);
+		}
+
+		const uint2 range = ranges[tile];
+		for (uint32_t i = range.x; i < range.y; i++)
+		{
+			// End if the entire tile is done rasterizing, checked once per batch as the CUDA kernel
+			if ((i - range.x) % BLOCK_SIZE == 0)
+			{
+				int num_done = 0;
+				for (int p = 0; p < BLOCK_SIZE; p++)
+					num_done += done[p];
+				if (num_done == BLOCK_SIZE)
+					break;
+			}
+
+			const uint32_t id = point_list[i];
+			const uint32_t contributor = i - range.x + 1;
+			const float2 xy = points_xy_image[id];
+			const float4 con_o = conic_opacity[id];
+			const float* feature = features + id * NUM_CHANNELS;
+			const float d = depth[id];
+
+			int x0, x1, y0, y1;
+			if (!footprint(xy, con_o, pix_min, x0, x1, y0, y1))
+				continue;
+
+			int touched = 0;
+			for (int py = y0; py <= y1; py++)
+			{
+#pragma omp simd reduction(+:touched)
+				for (int p = py * BLOCK_X + x0; p <= py * BLOCK_X + x1; p++)
+				{
+					// Resample using conic matrix (cf. "Surface
+					// Splatting" by Zwicker et al., 2001)
+					const float dx = xy.x - pixx[p], dy = xy.y - pixy[p];
+					const float power = -0.5f * (con_o.x * dx * dx + con_o.z * dy * dy) - con_o.y * dx * dy;
+
+					// Eq. (2) from 3D Gaussian splatting paper.
+					const float alpha = std::min(0.99f, con_o.w * expNonPositive(std::min(power, 0.0f)));
+					const float test_T = T[p] * (1 - alpha);
+					const bool valid = !done[p] & (power <= 0.0f) & (alpha >= 1.0f / 255.0f);
+					const bool finished = valid & (test_T < 0.0001f);
+					const bool blend = valid & !finished;
+
+					// Eq. (3) from 3D Gaussian splatting paper.
+					for (int ch = 0; ch < NUM_CHANNELS; ch++)
+						C[ch][p] += blend ? feature[ch] * alpha * T[p] : 0.0f;
+					Dep[p] += blend ? d * alpha * T[p] : 0.0f;
+					touched += (blend & (test_T > 0.5f)) ? 1 : 0;
+					last_contributor[p] = blend ? contributor : last_contributor[p];
+					T[p] = blend ? test_T : T[p];
+					done[p] |= finished;
+				}
+			}
+
+			// Keep track of how many pixels touched this Gaussian.
+			if (n_touched != nullptr && touched > 0)
+				__atomic_fetch_add(&n_touched[id], touched, __ATOMIC_RELAXED);
+		}
+
+		// Write out the final rendering data of the pixels inside the image
+		for (int p = 0; p < BLOCK_SIZE; p++)
+		{
+			const uint32_t x = pix_min.x + p % BLOCK_X, y = pix_min.y + p / BLOCK_X;
+			if (x >= (uint32_t)W || y >= (uint32_t)H)
+				continue;
+			const uint32_t pix_id = W * y + x;
+			final_T[pix_id] = T[p];
+			n_contrib[pix_id] = last_contributor[p];
+			for (int ch = 0; ch < NUM_CHANNELS; ch++)
+				out_color[ch * H * W + pix_id] = C[ch][p] + T[p] * bg_color[ch];
+			out_depth[pix_id] = Dep[p];
+			out_opacity[pix_id] = 1 - T[p];
+		}
+	});
+}
@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+// Finite difference check of CpuRasterizer::Rasterizer::backward on a small synthetic scene,
+// for the loss L = sum(w * color) + sum(w_depth * depth) with random per-pixel weights.
+//
+// Each check perturbs the parameters of one Gaussian along a random direction and compares
+// (L(x + eps d) - L(x - eps d)) / 2 eps with the analytic directional derivative. Perturbing
+// one Gaussian at a time keeps the pixels that change, and so the Gaussians that cross the
+// alpha >= 1/255 threshold of the blending, few. A check whose differences at eps, eps / 2 and
+// eps / 4 disagree straddles such a step of the loss and is repeated along another direction;
+// a Gaussian that straddles one in every direction tried is skipped rather than compared.
+//
+// The camera pose gradient dL_dtau of a Gaussian is checked by applying the inverse of the camera
+// motion T_CW^-1 Exp(tau) T_CW to that Gaussian alone, which gives it the same camera space mean
+// and covariance as moving the camera.
+//
+// backward.cu only approximates the camera center part of the view dependent color gradient,
+// so the pose is checked on the scene with the SH coefficients above degree 0 set to zero.
+//
+// Usage: cpu_rasterizer_gradcheck [--gaussians N] [--width W] [--height H] [--sh-degree D]
+//                                 [--checks N] [--eps E] [--tolerance T] [--min-pass F] [--max-skipped F]
+//
+// --eps and --tolerance replace the step and tolerance of every group. By default all compared
+// checks must pass (--min-pass 1) and at most a tenth of the Gaussians may be skipped.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "rasterizer.h"
+
+namespace
+{
+	struct Scene
+	{
+		int P, D, M, width, height;
+		float tan_fovx, tan_fovy;
+		std::vector<float> means3D, shs, opacities, scales, rotations;
+		double Rcw[3][3], tcw[3];
+		float viewmatrix[16], projmatrix[16], projmatrix_raw[16], campos[3], background[3];
+		std::vector<float> dL_dpix, dL_dpix_depth;
+	};
+
+	// Column major view matrix, full projection and camera center from the pose T_CW
+	void setPose(Scene& s)
+	{
+		std::memset(s.viewmatrix, 0, sizeof(s.viewmatrix));
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+				s.viewmatrix[4 * c + r] = (float)s.Rcw[r][c];
+			s.viewmatrix[12 + r] = (float)s.tcw[r];
+		}
+		s.viewmatrix[15] = 1.f;
+
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+			{
+				float sum = 0.f;
+				for (int k = 0; k < 4; k++)
+					sum += s.projmatrix_raw[4 * k + r] * s.viewmatrix[4 * c + k];
+				s.projmatrix[4 * c + r] = sum;
+			}
+
+		for (int r = 0; r < 3; r++)
+			s.campos[r] = (float)-(s.Rcw[0][r] * s.tcw[0] + s.Rcw[1][r] * s.tcw[1] + s.Rcw[2][r] * s.tcw[2]);
+	}
+
+	// Gaussians in front of a rotated and translated camera
+	Scene makeScene(int P, int width, int height, int degree)
+	{
+		Scene s;
+		s.P = P;
+		s.D = degree;
+		s.M = (degree + 1) * (degree + 1);
+		s.width = width;
+		s.height = height;
+		s.tan_fovx = 0.6f;
+		s.tan_fovy = s.tan_fovx * height / width;
+
+		const double angle = 0.4, axis[3] = { 0.36, 0.48, 0.8 };
+		const double c = std::cos(angle), sn = std::sin(angle);
+		for (int r = 0; r < 3; r++)
+			for (int k = 0; k < 3; k++)
+				s.Rcw[r][k] = (r == k ? c : 0.0) + (1.0 - c) * axis[r] * axis[k];
+		s.Rcw[0][1] -= sn * axis[2];
+		s.Rcw[0][2] += sn * axis[1];
+		s.Rcw[1][0] += sn * axis[2];
+		s.Rcw[1][2] -= sn * axis[0];
+		s.Rcw[2][0] -= sn * axis[1];
+		s.Rcw[2][1] += sn * axis[0];
+		s.tcw[0] = 0.3;
+		s.tcw[1] = -0.2;
+		s.tcw[2] = 0.5;
+
+		const float znear = 0.01f, zfar = 100.f;
+		std::memset(s.projmatrix_raw, 0, sizeof(s.projmatrix_raw));
+		s.projmatrix_raw[0] = 1.f / s.tan_fovx;
+		s.projmatrix_raw[5] = 1.f / s.tan_fovy;
+		s.projmatrix_raw[10] = zfar / (zfar - znear);
+		s.projmatrix_raw[11] = 1.f;
+		s.projmatrix_raw[14] = -(zfar * znear) / (zfar - znear);
+		setPose(s);
+
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> uni(0.f, 1.f);
+		std::normal_distribution<float> normal(0.f, 1.f);
+		for (int i = 0; i < P; i++)
+		{
+			// Camera space position, to world
+			const double z = 2.0 + 4.0 * uni(rng);
+			const double p_C[3] = { (2.0 * uni(rng) - 1.0) * 0.9 * s.tan_fovx * z, (2.0 * uni(rng) - 1.0) * 0.9 * s.tan_fovy * z, z };
+			for (int r = 0; r < 3; r++)
+				s.means3D.push_back((float)(s.Rcw[0][r] * (p_C[0] - s.tcw[0]) + s.Rcw[1][r] * (p_C[1] - s.tcw[1]) + s.Rcw[2][r] * (p_C[2] - s.tcw[2])));
+
+			for (int k = 0; k < 3; k++)
+				s.scales.push_back(0.04f + 0.12f * uni(rng));
+			float q[4], norm = 0.f;
+			for (int k = 0; k < 4; k++)
+			{
+				q[k] = normal(rng);
+				norm += q[k] * q[k];
+			}
+			for (int k = 0; k < 4; k++)
+				s.rotations.push_back(q[k] / std::sqrt(norm));
+			s.opacities.push_back(0.2f + 0.7f * uni(rng));
+
+			// Colors away from the clamping at 0
+			for (int k = 0; k < s.M * 3; k++)
+				s.shs.push_back(k < 3 ? 0.8f * (2.f * uni(rng) - 1.f) : 0.1f * normal(rng));
+		}
+		s.background[0] = 0.1f;
+		s.background[1] = 0.2f;
+		s.background[2] = 0.3f;
+
+		for (int i = 0; i < 3 * width * height; i++)
+			s.dL_dpix.push_back(2.f * uni(rng) - 1.f);
+		for (int i = 0; i < width * height; i++)
+			s.dL_dpix_depth.push_back(0.1f * (2.f * uni(rng) - 1.f));
+		return s;
+	}
+
+	std::function<char*(size_t N)> resizeFunctional(std::vector<char>& buffer)
+	{
+		return [&buffer](size_t N) {
+			buffer.resize(N);
+			return buffer.data();
+		};
+	}
+
+	struct Buffers
+	{
+		std::vector<char> geom, binning, image;
+		std::vector<float> color, depth, opacity;
+		std::vector<int> radii;
+	};
+
+	int render(const Scene& s, Buffers& b)
+	{
+		const size_t N = (size_t)s.width * s.height;
+		b.color.resize(3 * N);
+		b.depth.resize(N);
+		b.opacity.resize(N);
+		b.radii.resize(s.P);
+		return CpuRasterizer::Rasterizer::forward(
+			resizeFunctional(b.geom), resizeFunctional(b.binning), resizeFunctional(b.image),
+			s.P, s.D, s.M, s.background, s.width, s.height,
+			s.means3D.data(), s.shs.data(), nullptr, s.opacities.data(), s.scales.data(), 1.f, s.rotations.data(), nullptr,
+			s.viewmatrix, s.projmatrix, s.campos, s.tan_fovx, s.tan_fovy, false,
+			b.color.data(), b.depth.data(), b.opacity.data(), false, b.radii.data());
+	}
+
+	// The loss, accumulated in double
+	double loss(const Scene& s)
+	{
+		Buffers b;
+		render(s, b);
+		double L = 0.0;
+		for (size_t i = 0; i < b.color.size(); i++)
+			L += (double)s.dL_dpix[i] * b.color[i];
+		for (size_t i = 0; i < b.depth.size(); i++)
+			L += (double)s.dL_dpix_depth[i] * b.depth[i];
+		return L;
+	}
+
+	struct Gradients
+	{
+		std::vector<float> mean2D, conic, opacity, color, depth, mean3D, cov3D, sh, scale, rot, tau;
+	};
+
+	Gradients gradients(const Scene& s)
+	{
+		Buffers b;
+		const int R = render(s, b);
+		Gradients g;
+		g.mean2D.assign(3 * s.P, 0.f);
+		g.conic.assign(4 * s.P, 0.f);
+		g.opacity.assign(s.P, 0.f);
+		g.color.assign(3 * s.P, 0.f);
+		g.depth.assign(s.P, 0.f);
+		g.mean3D.assign(3 * s.P, 0.f);
+		g.cov3D.assign(6 * s.P, 0.f);
+		g.sh.assign(3 * s.M * s.P, 0.f);
+		g.scale.assign(3 * s.P, 0.f);
+		g.rot.assign(4 * s.P, 0.f);
+		g.tau.assign(6 * s.P, 0.f);
+		CpuRasterizer::Rasterizer::backward(s.P, s.D, s.M, R, s.background, s.width, s.height,
+			s.means3D.data(), s.shs.data(), nullptr, s.opacities.data(), s.scales.data(), 1.f, s.rotations.data(), nullptr,
+			s.viewmatrix, s.projmatrix, s.projmatrix_raw, s.campos, s.tan_fovx, s.tan_fovy, b.radii.data(),
+			b.geom.data(), b.binning.data(), b.image.data(), s.dL_dpix.data(), s.dL_dpix_depth.data(),
+			g.mean2D.data(), g.conic.data(), g.opacity.data(), g.color.data(), g.depth.data(), g.mean3D.data(),
+			g.cov3D.data(), g.sh.data(), g.scale.data(), g.rot.data(), g.tau.data(), false);
+		return g;
+	}
+
+	// Moves Gaussian i as the camera motion T_CW -> Exp(tau) T_CW would, seen from the camera:
+	// p_C -> Exp(tau) p_C and the rotation premultiplied by R_CW^T R(theta) R_CW.
+	void moveWithCamera(Scene& s, int i, const double tau[6])
+	{
+		const double* rho = tau;
+		const double* theta = tau + 3;
+		const double angle = std::sqrt(theta[0] * theta[0] + theta[1] * theta[1] + theta[2] * theta[2]);
+		double axis[3] = { 1.0, 0.0, 0.0 };
+		if (angle > 0.0)
+			for (int k = 0; k < 3; k++)
+				axis[k] = theta[k] / angle;
+
+		// Rodrigues, and V = I + W / 2 + W^2 / 6 for the translation of Exp
+		const double c = std::cos(angle), sn = std::sin(angle);
+		double Rd[3][3], W[3][3] = { { 0, -theta[2], theta[1] }, { theta[2], 0, -theta[0] }, { -theta[1], theta[0], 0 } };
+		for (int r = 0; r < 3; r++)
+			for (int k = 0; k < 3; k++)
+				Rd[r][k] = (r == k ? c : 0.0) + (1.0 - c) * axis[r] * axis[k];
+		Rd[0][1] -= sn * axis[2];
+		Rd[0][2] += sn * axis[1];
+		Rd[1][0] += sn * axis[2];
+		Rd[1][2] -= sn * axis[0];
+		Rd[2][0] -= sn * axis[1];
+		Rd[2][1] += sn * axis[0];
+		double td[3];
+		for (int r = 0; r < 3; r++)
+		{
+			td[r] = rho[r];
+			for (int k = 0; k < 3; k++)
+			{
+				double W2 = 0.0;
+				for (int j = 0; j < 3; j++)
+					W2 += W[r][j] * W[j][k];
+				td[r] += (0.5 * W[r][k] + W2 / 6.0) * rho[k];
+			}
+		}
+
+		double p_C[3], q_C[3];
+		for (int r = 0; r < 3; r++)
+			p_C[r] = s.Rcw[r][0] * s.means3D[3 * i] + s.Rcw[r][1] * s.means3D[3 * i + 1] + s.Rcw[r][2] * s.means3D[3 * i + 2] + s.tcw[r];
+		for (int r = 0; r < 3; r++)
+			q_C[r] = Rd[r][0] * p_C[0] + Rd[r][1] * p_C[1] + Rd[r][2] * p_C[2] + td[r] - s.tcw[r];
+		for (int r = 0; r < 3; r++)
+			s.means3D[3 * i + r] = (float)(s.Rcw[0][r] * q_C[0] + s.Rcw[1][r] * q_C[1] + s.Rcw[2][r] * q_C[2]);
+
+		// Quaternion of the world space rotation by angle about R_CW^T axis, applied first
+		double qm[4] = { std::cos(0.5 * angle), 0.0, 0.0, 0.0 };
+		for (int r = 0; r < 3; r++)
+			qm[1 + r] = std::sin(0.5 * angle) * (s.Rcw[0][r] * axis[0] + s.Rcw[1][r] * axis[1] + s.Rcw[2][r] * axis[2]);
+		const double q[4] = { s.rotations[4 * i], s.rotations[4 * i + 1], s.rotations[4 * i + 2], s.rotations[4 * i + 3] };
+		s.rotations[4 * i + 0] = (float)(qm[0] * q[0] - qm[1] * q[1] - qm[2] * q[2] - qm[3] * q[3]);
+		s.rotations[4 * i + 1] = (float)(qm[0] * q[1] + qm[1] * q[0] + qm[2] * q[3] - qm[3] * q[2]);
+		s.rotations[4 * i + 2] = (float)(qm[0] * q[2] - qm[1] * q[3] + qm[2] * q[0] + qm[3] * q[1]);
+		s.rotations[4 * i + 3] = (float)(qm[0] * q[3] + qm[1] * q[2] - qm[2] * q[1] + qm[3] * q[0]);
+	}
+
+	void addStep(std::vector<float>& values, int size, int i, const double* step)
+	{
+		for (int k = 0; k < size; k++)
+			values[size * i + k] += (float)step[k];
+	}
+
+	// A parameter group: its size per Gaussian, the analytic gradient, how to perturb it, and the
+	// step and relative tolerance of its checks
+	struct Group
+	{
+		std::string name;
+		int size;
+		const std::vector<float>* gradient;
+		std::function<void(Scene&, int, const double*)> perturb;
+		double eps, tolerance;
+	};
+
+	// A check outside the tolerance, reported by Gaussian
+	struct Failure
+	{
+		int gaussian;
+		double analytic, numeric, error;
+	};
+
+	struct Result
+	{
+		int checked = 0, passed = 0, skipped = 0;
+		std::vector<double> errors;
+		std::vector<Failure> failures;
+	};
+
+	double centralDifference(const Scene& scene, const Group& group, int i, const std::vector<double>& d, double eps)
+	{
+		std::vector<double> step(group.size);
+		Scene plus = scene, minus = scene;
+		for (int k = 0; k < group.size; k++)
+			step[k] = eps * d[k];
+		group.perturb(plus, i, step.data());
+		for (int k = 0; k < group.size; k++)
+			step[k] = -eps * d[k];
+		group.perturb(minus, i, step.data());
+		return (loss(plus) - loss(minus)) / (2.0 * eps);
+	}
+
+	Result check(const Scene& scene, const Group& group, const std::vector<int>& gaussians, std::mt19937& rng)
+	{
+		const double eps = group.eps, tolerance = group.tolerance;
+
+		// Errors relative to the larger of the two, with a floor at a hundredth of the largest gradient
+		// of the group: the float rendering noise is absolute and Gaussians without gradient would fail
+		double scale = 0.0;
+		for (int i : gaussians)
+		{
+			double norm = 0.0;
+			for (int k = 0; k < group.size; k++)
+				norm += (double)(*group.gradient)[group.size * i + k] * (*group.gradient)[group.size * i + k];
+			scale = std::max(scale, std::sqrt(norm));
+		}
+		const double floor = std::max(1e-2 * scale, 1e-12);
+
+		// The loss is only piecewise smooth, a pixel crossing the alpha cutoff or the footprint
+		// changing moves it by a step. Differences at eps, eps / 2 and eps / 4 that disagree straddle
+		// one (two steps can make a pair agree), the Gaussian is then checked along another direction
+		// and skipped after a few.
+		const int attempts = 8;
+		std::normal_distribution<double> normal(0.0, 1.0);
+		Result result;
+		for (int i : gaussians)
+		{
+			result.checked++;
+			bool smooth = false;
+			double analytic = 0.0, halfStep = 0.0;
+			for (int attempt = 0; attempt < attempts && !smooth; attempt++)
+			{
+				std::vector<double> d(group.size);
+				double norm = 0.0;
+				for (double& v : d)
+				{
+					v = normal(rng);
+					norm += v * v;
+				}
+				analytic = 0.0;
+				for (int k = 0; k < group.size; k++)
+				{
+					d[k] /= std::sqrt(norm);
+					analytic += (*group.gradient)[group.size * i + k] * d[k];
+				}
+
+				const double numeric = centralDifference(scene, group, i, d, eps);
+				halfStep = centralDifference(scene, group, i, d, 0.5 * eps);
+				const double quarterStep = centralDifference(scene, group, i, d, 0.25 * eps);
+				smooth = std::fabs(numeric - halfStep) <= tolerance * std::max({ std::fabs(numeric), std::fabs(halfStep), floor }) &&
+					std::fabs(quarterStep - halfStep) <= tolerance * std::max({ std::fabs(quarterStep), std::fabs(halfStep), floor });
+			}
+			if (!smooth)
+			{
+				result.skipped++;
+				continue;
+			}
+
+			const double error = std::fabs(analytic - halfStep) / std::max({ std::fabs(analytic), std::fabs(halfStep), floor });
+			result.errors.push_back(error);
+			if (error <= tolerance)
+				result.passed++;
+			else
+				result.failures.push_back({ i, analytic, halfStep, error });
+		}
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int P = 64, width = 128, height = 96, degree = 3, checks = 32;
+	double eps = 0.0, tolerance = 0.0, minPass = 1.0, maxSkipped = 0.1;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		if (arg == "--gaussians")
+			P = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--width")
+			width = std::atoi(argv[++i]);
+		else if (arg == "--height")
+			height = std::atoi(argv[++i]);
+		else if (arg == "--sh-degree")
+			degree = std::min(3, std::max(0, std::atoi(argv[++i])));
+		else if (arg == "--checks")
+			checks = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--eps")
+			eps = std::atof(argv[++i]);
+		else if (arg == "--tolerance")
+			tolerance = std::atof(argv[++i]);
+		else if (arg == "--min-pass")
+			minPass = std::atof(argv[++i]);
+		else if (arg == "--max-skipped")
+			maxSkipped = std::atof(argv[++i]);
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	const Scene scene = makeScene(P, width, height, degree);
+	const Gradients g = gradients(scene);
+
+	// Same scene without view dependent colors for the pose
+	Scene poseScene = scene;
+	for (int i = 0; i < P; i++)
+		for (int k = 3; k < 3 * scene.M; k++)
+			poseScene.shs[3 * scene.M * i + k] = 0.f;
+	const Gradients gPose = gradients(poseScene);
+
+	// The image is rendered in float, a smaller step gives more rounding noise and a larger one
+	// more steps of the loss. The colors are linear in the SH coefficients, which take a large step.
+	std::vector<Group> groups = {
+		{ "means3D", 3, &g.mean3D, [](Scene& s, int i, const double* step) { addStep(s.means3D, 3, i, step); }, 2e-4, 3e-2 },
+		{ "scales", 3, &g.scale, [](Scene& s, int i, const double* step) { addStep(s.scales, 3, i, step); }, 1e-4, 3e-2 },
+		{ "rotations", 4, &g.rot, [](Scene& s, int i, const double* step) { addStep(s.rotations, 4, i, step); }, 4e-4, 3e-2 },
+		{ "opacities", 1, &g.opacity, [](Scene& s, int i, const double* step) { addStep(s.opacities, 1, i, step); }, 4e-4, 2e-2 },
+		{ "shs", 3 * scene.M, &g.sh, [](Scene& s, int i, const double* step) { addStep(s.shs, 3 * s.M, i, step); }, 1e-2, 5e-3 },
+		{ "pose rho", 3, nullptr, nullptr, 1e-4, 4e-2 },
+		{ "pose theta", 3, nullptr, nullptr, 5e-5, 3e-2 },
+	};
+	for (Group& group : groups)
+	{
+		if (eps > 0.0)
+			group.eps = eps;
+		if (tolerance > 0.0)
+			group.tolerance = tolerance;
+	}
+
+	// The pose groups read the rho or theta half of dL_dtau
+	std::vector<float> rho(3 * P), theta(3 * P);
+	for (int i = 0; i < P; i++)
+		for (int k = 0; k < 3; k++)
+		{
+			rho[3 * i + k] = gPose.tau[6 * i + k];
+			theta[3 * i + k] = gPose.tau[6 * i + 3 + k];
+		}
+
+	// Gaussians to check, the visible ones
+	Buffers b;
+	render(scene, b);
+	std::vector<int> visible;
+	for (int i = 0; i < P; i++)
+		if (b.radii[i] > 0)
+			visible.push_back(i);
+	std::mt19937 rng(11);
+	std::shuffle(visible.begin(), visible.end(), rng);
+	if ((int)visible.size() > checks)
+		visible.resize(checks);
+
+	std::printf("%d Gaussians (%zu checked), SH degree %d, %dx%d\n", P, visible.size(), degree, width, height);
+	bool ok = !visible.empty();
+	for (size_t k = 0; k < groups.size(); k++)
+	{
+		Group group = groups[k];
+		const Scene* s = &scene;
+		if (group.name == "pose rho" || group.name == "pose theta")
+		{
+			const bool isRho = group.name == "pose rho";
+			group.gradient = isRho ? &rho : &theta;
+			group.perturb = [isRho](Scene& s, int i, const double* step) {
+				double tau[6] = { 0, 0, 0, 0, 0, 0 };
+				for (int j = 0; j < 3; j++)
+					tau[(isRho ? 0 : 3) + j] = step[j];
+				moveWithCamera(s, i, tau);
+			};
+			s = &poseScene;
+		}
+
+		Result r = check(*s, group, visible, rng);
+		std::sort(r.errors.begin(), r.errors.end());
+
+		// Skipping more than a few Gaussians would hide a wrong gradient behind the steps, that fails as well
+		const int compared = r.checked - r.skipped;
+		const bool pass = compared > 0 && r.skipped <= maxSkipped * r.checked && r.passed >= minPass * compared;
+		std::printf("%-12s %3d/%3d within %.0e at eps %.0e (%d skipped), relative error median %.2e max %.2e: %s\n", group.name.c_str(), r.passed,
+			compared, group.tolerance, group.eps, r.skipped, compared > 0 ? r.errors[compared / 2] : 0.0, compared > 0 ? r.errors.back() : 0.0,
+			pass ? "ok" : "MISMATCH");
+		for (const Failure& f : r.failures)
+			std::printf("  Gaussian %3d: analytic %+.6e numeric %+.6e relative error %.2e\n", f.gaussian, f.analytic, f.numeric, f.error);
+		ok &= pass;
+	}
+
+	return ok ? 0 : 1;
+}
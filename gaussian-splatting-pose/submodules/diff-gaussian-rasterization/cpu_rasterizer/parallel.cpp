@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(int n) : generation(0), stop(false)
+		{
+			resize(n);
+		}
+
+		~ThreadPool()
+		{
+			resize(1);
+		}
+
+		int size() const
+		{
+			return (int)workers.size() + 1;
+		}
+
+		void resize(int n)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				stop = true;
+			}
+			cond.notify_all();
+			for (std::thread& th : workers)
+				th.join();
+			workers.clear();
+			stop = false;
+			for (int i = 1; i < std::max(1, n); i++)
+				workers.emplace_back(&ThreadPool::work, this, generation);
+		}
+
+		void run(int n, const std::function<void(int)>& func)
+		{
+			if (n <= 0)
+				return;
+			if (n == 1 || workers.empty())
+			{
+				for (int i = 0; i < n; i++)
+					func(i);
+				return;
+			}
+
+			// Only one pass runs at a time
+			std::unique_lock<std::mutex> runLock(runMutex);
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				task = &func;
+				numTasks = n;
+				nextTask = 0;
+				pending = n;
+				generation++;
+			}
+			cond.notify_all();
+
+			execute();
+
+			std::unique_lock<std::mutex> lock(mutex);
+			doneCond.wait(lock, [&] { return pending == 0; });
+			task = nullptr;
+		}
+
+	private:
+		void work(uint64_t seen)
+		{
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cond.wait(lock, [&] { return stop || generation != seen; });
+					if (stop)
+						return;
+					seen = generation;
+				}
+				execute();
+			}
+		}
+
+		void execute()
+		{
+			int done = 0;
+			for (int i = nextTask++; i < numTasks; i = nextTask++)
+			{
+				(*task)(i);
+				done++;
+			}
+			if (done > 0)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				pending -= done;
+				if (pending == 0)
+					doneCond.notify_all();
+			}
+		}
+
+		std::vector<std::thread> workers;
+		std::mutex runMutex;
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::condition_variable doneCond;
+		const std::function<void(int)>* task = nullptr;
+		int numTasks = 0;
+		std::atomic<int> nextTask{0};
+		int pending = 0;
+		uint64_t generation;
+		bool stop;
+	};
+
+	int defaultThreads()
+	{
+		const char* env = std::getenv("CPU_RASTERIZER_THREADS");
+		if (env != nullptr && std::atoi(env) > 0)
+			return std::atoi(env);
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	ThreadPool& pool()
+	{
+		static ThreadPool instance(defaultThreads());
+		return instance;
+	}
+}
+
+int CpuRasterizer::numThreads()
+{
+	return pool().size();
+}
+
+void CpuRasterizer::setNumThreads(int n)
+{
+	pool().resize(n);
+}
+
+void CpuRasterizer::parallelTasks(int n, const std::function<void(int)>& task)
+{
+	pool().run(n, task);
+}
+
+int CpuRasterizer::parallelChunks(size_t n, size_t grain, const std::function<void(int, size_t, size_t)>& func)
+{
+	const size_t chunks = std::max<size_t>(1, std::min<size_t>(numThreads(), (n + grain - 1) / std::max<size_t>(1, grain)));
+	const size_t chunk = (n + chunks - 1) / chunks;
+	pool().run((int)chunks, [&](int i) {
+		const size_t begin = std::min(n, i * chunk);
+		const size_t end = std::min(n, begin + chunk);
+		func(i, begin, end);
+	});
+	return (int)chunks;
+}
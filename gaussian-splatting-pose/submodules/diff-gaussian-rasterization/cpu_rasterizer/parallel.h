@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#ifndef CPU_RASTERIZER_PARALLEL_H_INCLUDED
+#define CPU_RASTERIZER_PARALLEL_H_INCLUDED
+
+#include <cstddef>
+#include <functional>
+
+namespace CpuRasterizer
+{
+	// Persistent worker threads shared by all the passes of the rasterizer, so that a pass
+	// does not pay for thread creation. The number of threads is the hardware concurrency,
+	// or CPU_RASTERIZER_THREADS if set, and can be changed with setNumThreads.
+	int numThreads();
+	void setNumThreads(int n);
+
+	// Runs task(i) for every i in [0, n) on the pool and the calling thread, returns once all are done.
+	// Tasks are handed out dynamically, in increasing order.
+	void parallelTasks(int n, const std::function<void(int)>& task);
+
+	// Splits [0, n) into one contiguous chunk per thread (at least grain elements each) and runs
+	// func(chunk, begin, end) on them. Returns the number of chunks.
+	int parallelChunks(size_t n, size_t grain, const std::function<void(int, size_t, size_t)>& func);
+};
+
+#endif
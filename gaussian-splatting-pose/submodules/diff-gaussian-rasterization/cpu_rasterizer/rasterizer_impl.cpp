@@ -0,0 +1,525 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "rasterizer_impl.h"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.h"
+#include "forward.h"
+#include "backward.h"
+
+using namespace CpuRasterizer;
+
+// Elements per chunk below which a pass is not split further
+#define GRAIN_SIZE 4096
+
+namespace
+{
+	// Helper function to find the next-highest bit of the MSB
+	// on the CPU.
+	uint32_t getHigherMsb(uint32_t n)
+	{
+		uint32_t msb = sizeof(n) * 4;
+		uint32_t step = msb;
+		while (step > 1)
+		{
+			step /= 2;
+			if (n >> msb)
+				msb += step;
+			else
+				msb -= step;
+		}
+		if (n >> msb)
+			msb++;
+		return msb;
+	}
+
+	// Inclusive prefix sum, one chunk per thread: chunk totals, then each chunk is
+	// scanned from the sum of the previous ones.
+	void inclusiveSum(const uint32_t* in, uint32_t* out, size_t n)
+	{
+		const int chunks = std::max(1, std::min(numThreads(), (int)((n + GRAIN_SIZE - 1) / GRAIN_SIZE)));
+		const size_t chunk = (n + chunks - 1) / chunks;
+		std::vector<uint32_t> totals(chunks + 1, 0);
+		parallelTasks(chunks, [&](int c)
+		{
+			uint32_t sum = 0;
+			for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+				sum += in[i];
+			totals[c + 1] = sum;
+		});
+		for (int c = 0; c < chunks; c++)
+			totals[c + 1] += totals[c];
+		parallelTasks(chunks, [&](int c)
+		{
+			uint32_t sum = totals[c];
+			for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+			{
+				sum += in[i];
+				out[i] = sum;
+			}
+		});
+	}
+
+	// Stable LSD radix sort of (key, value) pairs on the low 'bits' bits of the keys, 8 bits
+	// per pass. Each pass builds one digit histogram per chunk in parallel, turns them into
+	// per-chunk scatter offsets and scatters the chunks in parallel. Passes where all keys
+	// share the digit are skipped. The sorted pairs end up in keys_out/values_out, the input
+	// arrays are used as scratch.
+	void sortPairs(uint64_t* keys_in, uint64_t* keys_out, uint32_t* values_in, uint32_t* values_out, size_t n, int bits)
+	{
+		const int RADIX = 256;
+		const int chunks = std::max(1, std::min(numThreads(), (int)((n + GRAIN_SIZE - 1) / GRAIN_SIZE)));
+		const size_t chunk = (n + chunks - 1) / chunks;
+		std::vector<size_t> histograms(chunks * RADIX);
+
+		uint64_t* src_keys = keys_in, *dst_keys = keys_out;
+		uint32_t* src_values = values_in, *dst_values = values_out;
+		for (int shift = 0; shift < bits; shift += 8)
+		{
+			parallelTasks(chunks, [&](int c)
+			{
+				size_t* hist = histograms.data() + c * RADIX;
+				std::fill(hist, hist + RADIX, 0);
+				for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+					hist[(src_keys[i] >> shift) & (RADIX - 1)]++;
+			});
+
+			// Exclusive offsets, digit major then chunk
+			size_t offset = 0;
+			bool single_digit = false;
+			for (int d = 0; d < RADIX; d++)
+			{
+				size_t count = 0;
+				for (int c = 0; c < chunks; c++)
+				{
+					const size_t h = histograms[c * RADIX + d];
+					histograms[c * RADIX + d] = offset;
+					offset += h;
+					count += h;
+				}
+				single_digit |= count == n;
+			}
+			if (single_digit)
+				continue;
+
+			parallelTasks(chunks, [&](int c)
+			{
+				size_t* offsets = histograms.data() + c * RADIX;
+				for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+				{
+					const size_t dst = offsets[(src_keys[i] >> shift) & (RADIX - 1)]++;
+					dst_keys[dst] = src_keys[i];
+					dst_values[dst] = src_values[i];
+				}
+			});
+			std::swap(src_keys, dst_keys);
+			std::swap(src_values, dst_values);
+		}
+
+		if (src_keys != keys_out)
+		{
+			std::memcpy(keys_out, src_keys, n * sizeof(uint64_t));
+			std::memcpy(values_out, src_values, n * sizeof(uint32_t));
+		}
+	}
+
+	// Generates one key/value pair for all Gaussian / tile overlaps.
+	// The key is |  tile ID  |      depth      |, and the value is the ID
+	// of the Gaussian. Sorting the values with this key yields Gaussian IDs
+	// in a list, such that they are first sorted by tile and then by depth.
+	void duplicateWithKeys(
+		int P,
+		const float2* points_xy,
+		const float* depths,
+		const uint32_t* offsets,
+		uint64_t* gaussian_keys_unsorted,
+		uint32_t* gaussian_values_unsorted,
+		const int* radii,
+		dim3 grid)
+	{
+		parallelChunks(P, GRAIN_SIZE, [&](int, size_t begin, size_t end)
+		{
+			for (size_t idx = begin; idx < end; idx++)
+			{
+				// Generate no key/value pair for invisible Gaussians
+				if (radii[idx] <= 0)
+					continue;
+
+				// Find this Gaussian's offset in buffer for writing keys/values.
+				uint32_t off = (idx == 0) ? 0 : offsets[idx - 1];
+				uint2 rect_min, rect_max;
+				getRect(points_xy[idx], radii[idx], rect_min, rect_max, grid);
+
+				uint32_t depth_bits;
+				std::memcpy(&depth_bits, &depths[idx], sizeof(uint32_t));
+				for (uint32_t y = rect_min.y; y < rect_max.y; y++)
+				{
+					for (uint32_t x = rect_min.x; x < rect_max.x; x++)
+					{
+						uint64_t key = y * grid.x + x;
+						key <<= 32;
+						key |= depth_bits;
+						gaussian_keys_unsorted[off] = key;
+						gaussian_values_unsorted[off] = idx;
+						off++;
+					}
+				}
+			}
+		});
+	}
+
+	// Check keys to see if it is at the start/end of one tile's range in
+	// the full sorted list. If yes, write start/end of this tile.
+	void identifyTileRanges(int L, const uint64_t* point_list_keys, uint2* ranges)
+	{
+		parallelChunks(L, GRAIN_SIZE, [&](int, size_t begin, size_t end)
+		{
+			for (size_t idx = begin; idx < end; idx++)
+			{
+				// Read tile ID from key. Update start/end of tile range if at limit.
+				uint32_t currtile = point_list_keys[idx] >> 32;
+				if (idx == 0)
+					ranges[currtile].x = 0;
+				else
+				{
+					uint32_t prevtile = point_list_keys[idx - 1] >> 32;
+					if (currtile != prevtile)
+					{
+						ranges[prevtile].y = idx;
+						ranges[currtile].x = idx;
+					}
+				}
+				if (idx == (size_t)L - 1)
+					ranges[currtile].y = L;
+			}
+		});
+	}
+}
+
+// Mark Gaussians as visible/invisible, based on view frustum testing
+void CpuRasterizer::Rasterizer::markVisible(
+	int P,
+	float* means3D,
+	float* viewmatrix,
+	float* projmatrix,
+	bool* present)
+{
+	// The CUDA version takes projmatrix as well, in_frustum only needs the view space depth
+	(void)projmatrix;
+	parallelChunks(P, GRAIN_SIZE, [&](int, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx < end; idx++)
+		{
+			const float3 p_orig = { means3D[3 * idx], means3D[3 * idx + 1], means3D[3 * idx + 2] };
+			present[idx] = in_frustum(transformPoint4x3(p_orig, viewmatrix));
+		}
+	});
+}
+
+CpuRasterizer::GeometryState CpuRasterizer::GeometryState::fromChunk(char*& chunk, size_t P)
+{
+	GeometryState geom;
+	obtain(chunk, geom.depths, P, 128);
+	obtain(chunk, geom.clamped, P * 3, 128);
+	obtain(chunk, geom.internal_radii, P, 128);
+	obtain(chunk, geom.means2D, P, 128);
+	obtain(chunk, geom.cov3D, P * 6, 128);
+	obtain(chunk, geom.conic_opacity, P, 128);
+	obtain(chunk, geom.rgb, P * 3, 128);
+	obtain(chunk, geom.tiles_touched, P, 128);
+	obtain(chunk, geom.point_offsets, P, 128);
+	return geom;
+}
+
+CpuRasterizer::ImageState CpuRasterizer::ImageState::fromChunk(char*& chunk, size_t N)
+{
+	ImageState img;
+	obtain(chunk, img.accum_alpha, N, 128);
+	obtain(chunk, img.n_contrib, N, 128);
+	obtain(chunk, img.ranges, N, 128);
+	return img;
+}
+
+CpuRasterizer::BinningState CpuRasterizer::BinningState::fromChunk(char*& chunk, size_t P)
+{
+	BinningState binning;
+	obtain(chunk, binning.point_list, P, 128);
+	obtain(chunk, binning.point_list_unsorted, P, 128);
+	obtain(chunk, binning.point_list_keys, P, 128);
+	obtain(chunk, binning.point_list_keys_unsorted, P, 128);
+	return binning;
+}
+
+// Forward rendering procedure for differentiable rasterization
+// of Gaussians.
+int CpuRasterizer::Rasterizer::forward(
+	std::function<char* (size_t)> geometryBuffer,
+	std::function<char* (size_t)> binningBuffer,
+	std::function<char* (size_t)> imageBuffer,
+	const int P, int D, int M,
+	const float* background,
+	const int width, int height,
+	const float* means3D,
+	const float* shs,
+	const float* colors_precomp,
+	const float* opacities,
+	const float* scales,
+	const float scale_modifier,
+	const float* rotations,
+	const float* cov3D_precomp,
+	const float* viewmatrix,
+	const float* projmatrix,
+	const float* cam_pos,
+	const float tan_fovx, float tan_fovy,
+	const bool prefiltered,
+	float* out_color,
+	float* out_depth,
+	float* out_opacity,
+	bool antialiasing,
+	int* radii,
+	int* n_touched,
+	bool debug)
+{
+	const float focal_y = height / (2.0f * tan_fovy);
+	const float focal_x = width / (2.0f * tan_fovx);
+
+	size_t chunk_size = required<GeometryState>(P);
+	char* chunkptr = geometryBuffer(chunk_size);
+	GeometryState geomState = GeometryState::fromChunk(chunkptr, P);
+
+	if (radii == nullptr)
+	{
+		radii = geomState.internal_radii;
+	}
+
+	const dim3 tile_grid = { (uint32_t)(width + BLOCK_X - 1) / BLOCK_X, (uint32_t)(height + BLOCK_Y - 1) / BLOCK_Y, 1 };
+
+	// Dynamically resize image-based auxiliary buffers during training
+	size_t img_chunk_size = required<ImageState>(width * height);
+	char* img_chunkptr = imageBuffer(img_chunk_size);
+	ImageState imgState = ImageState::fromChunk(img_chunkptr, width * height);
+
+	if (NUM_CHANNELS != 3 && colors_precomp == nullptr)
+	{
+		throw std::runtime_error("For non-RGB, provide precomputed Gaussian colors!");
+	}
+
+	// Run preprocessing per-Gaussian (transformation, bounding, conversion of SHs to RGB)
+	FORWARD::preprocess(
+		P, D, M,
+		means3D,
+		scales,
+		scale_modifier,
+		rotations,
+		opacities,
+		shs,
+		geomState.clamped,
+		cov3D_precomp,
+		colors_precomp,
+		viewmatrix, projmatrix,
+		cam_pos,
+		width, height,
+		focal_x, focal_y,
+		tan_fovx, tan_fovy,
+		radii,
+		geomState.means2D,
+		geomState.depths,
+		geomState.cov3D,
+		geomState.rgb,
+		geomState.conic_opacity,
+		tile_grid,
+		geomState.tiles_touched,
+		prefiltered,
+		antialiasing);
+
+	// Compute prefix sum over full list of touched tile counts by Gaussians
+	// E.g., [2, 3, 0, 2, 1] -> [2, 5, 5, 7, 8]
+	inclusiveSum(geomState.tiles_touched, geomState.point_offsets, P);
+
+	// Retrieve total number of Gaussian instances to launch and resize aux buffers
+	int num_rendered = P > 0 ? geomState.point_offsets[P - 1] : 0;
+
+	size_t binning_chunk_size = required<BinningState>(num_rendered);
+	char* binning_chunkptr = binningBuffer(binning_chunk_size);
+	BinningState binningState = BinningState::fromChunk(binning_chunkptr, num_rendered);
+
+	// For each instance to be rendered, produce adequate [ tile | depth ] key
+	// and corresponding dublicated Gaussian indices to be sorted
+	duplicateWithKeys(
+		P,
+		geomState.means2D,
+		geomState.depths,
+		geomState.point_offsets,
+		binningState.point_list_keys_unsorted,
+		binningState.point_list_unsorted,
+		radii,
+		tile_grid);
+
+	int bit = getHigherMsb(tile_grid.x * tile_grid.y);
+
+	// Sort complete list of (duplicated) Gaussian indices by keys
+	sortPairs(
+		binningState.point_list_keys_unsorted, binningState.point_list_keys,
+		binningState.point_list_unsorted, binningState.point_list,
+		num_rendered, 32 + bit);
+
+	std::memset(imgState.ranges, 0, tile_grid.x * tile_grid.y * sizeof(uint2));
+
+	// Identify start and end of per-tile workloads in sorted list
+	if (num_rendered > 0)
+		identifyTileRanges(
+			num_rendered,
+			binningState.point_list_keys,
+			imgState.ranges);
+
+	// Let each tile blend its range of Gaussians independently in parallel
+	const float* feature_ptr = colors_precomp != nullptr ? colors_precomp : geomState.rgb;
+	FORWARD::render(
+		tile_grid,
+		imgState.ranges,
+		binningState.point_list,
+		width, height,
+		geomState.means2D,
+		feature_ptr,
+		geomState.conic_opacity,
+		imgState.accum_alpha,
+		imgState.n_contrib,
+		background,
+		out_color,
+		geomState.depths,
+		out_depth,
+		out_opacity,
+		n_touched);
+
+	(void)debug;
+	return num_rendered;
+}
+
+// Produce necessary gradients for optimization, corresponding
+// to forward render pass
+void CpuRasterizer::Rasterizer::backward(
+	const int P, int D, int M, int R,
+	const float* background,
+	const int width, int height,
+	const float* means3D,
+	const float* shs,
+	const float* colors_precomp,
+	const float* opacities,
+	const float* scales,
+	const float scale_modifier,
+	const float* rotations,
+	const float* cov3D_precomp,
+	const float* viewmatrix,
+	const float* projmatrix,
+	const float* projmatrix_raw,
+	const float* campos,
+	const float tan_fovx, float tan_fovy,
+	const int* radii,
+	char* geom_buffer,
+	char* binning_buffer,
+	char* img_buffer,
+	const float* dL_dpix,
+	const float* dL_dpix_depth,
+	float* dL_dmean2D,
+	float* dL_dconic,
+	float* dL_dopacity,
+	float* dL_dcolor,
+	float* dL_ddepth,
+	float* dL_dmean3D,
+	float* dL_dcov3D,
+	float* dL_dsh,
+	float* dL_dscale,
+	float* dL_drot,
+	float* dL_dtau,
+	bool antialiasing,
+	bool debug)
+{
+	GeometryState geomState = GeometryState::fromChunk(geom_buffer, P);
+	BinningState binningState = BinningState::fromChunk(binning_buffer, R);
+	ImageState imgState = ImageState::fromChunk(img_buffer, width * height);
+
+	if (radii == nullptr)
+	{
+		radii = geomState.internal_radii;
+	}
+
+	const float focal_y = height / (2.0f * tan_fovy);
+	const float focal_x = width / (2.0f * tan_fovx);
+
+	const dim3 tile_grid = { (uint32_t)(width + BLOCK_X - 1) / BLOCK_X, (uint32_t)(height + BLOCK_Y - 1) / BLOCK_Y, 1 };
+
+	// Compute loss gradients w.r.t. 2D mean position, conic matrix,
+	// opacity and RGB of Gaussians from per-pixel loss gradients.
+	// If we were given precomputed colors and not SHs, use them.
+	const float* color_ptr = (colors_precomp != nullptr) ? colors_precomp : geomState.rgb;
+	const float* depth_ptr = geomState.depths;
+
+	BACKWARD::render(
+		tile_grid,
+		imgState.ranges,
+		binningState.point_list,
+		width, height,
+		background,
+		geomState.means2D,
+		geomState.conic_opacity,
+		color_ptr,
+		depth_ptr,
+		imgState.accum_alpha,
+		imgState.n_contrib,
+		P,
+		radii,
+		geomState.point_offsets,
+		dL_dpix,
+		dL_dpix_depth,
+		(float3*)dL_dmean2D,
+		(float4*)dL_dconic,
+		dL_dopacity,
+		dL_dcolor,
+		dL_ddepth);
+
+	// Take care of the rest of preprocessing. Was the precomputed covariance
+	// given to us or a scales/rot pair? If precomputed, pass that. If not,
+	// use the one we computed ourselves.
+	const float* cov3D_ptr = (cov3D_precomp != nullptr) ? cov3D_precomp : geomState.cov3D;
+	BACKWARD::preprocess(P, D, M,
+		(float3*)means3D,
+		radii,
+		shs,
+		geomState.clamped,
+		opacities,
+		(float3*)scales,
+		(float4*)rotations,
+		scale_modifier,
+		cov3D_ptr,
+		viewmatrix,
+		projmatrix,
+		projmatrix_raw,
+		focal_x, focal_y,
+		tan_fovx, tan_fovy,
+		(float3*)campos,
+		(float3*)dL_dmean2D,
+		dL_dconic,
+		dL_dopacity,
+		(float3*)dL_dmean3D,
+		dL_dcolor,
+		dL_ddepth,
+		dL_dcov3D,
+		dL_dsh,
+		(float3*)dL_dscale,
+		(float4*)dL_drot,
+		dL_dtau,
+		antialiasing);
+
+	(void)debug;
+}
@@ -0,0 +1,257 @@
+// Benchmark of the CPU SSIM against a naive implementation, on a noisy render of a synthetic image.
+//
+// The naive version convolves the products of the images with the full 11x11 window, one moment
+// after the other, as the PyTorch reference does with conv2d. Both must agree on the SSIM map, its
+// derivatives and the gradient of the backward pass. The gradient of the SSIM/L1 loss is also
+// checked against finite differences on a few pixels.
+//
+// Usage: ./fused_ssim_cpu_benchmark [width] [height] [channels] [runs] [threads,...]
+//   default 1920 x 1080 x 3, 5 runs, 1 thread and the hardware threads
+
+#include "ssim_cpu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const float C1 = 0.01f * 0.01f;
+const float C2 = 0.03f * 0.03f;
+
+const float GAUSS[11] = {
+  0.001028380123898387f, 0.0075987582094967365f, 0.036000773310661316f, 0.10936068743467331f,
+  0.21300552785396576f, 0.26601171493530273f, 0.21300552785396576f, 0.10936068743467331f,
+  0.036000773310661316f, 0.0075987582094967365f, 0.001028380123898387f
+};
+
+// 11x11 "same" convolution of one plane, 0 outside, summed in double to serve as the reference
+void conv2d_naive(const float* in, int H, int W, float* out) {
+  for (int y = 0; y < H; y++) {
+    for (int x = 0; x < W; x++) {
+      double acc = 0.0;
+      for (int i = 0; i < 11; i++) {
+        const int yy = y + i - 5;
+        if (yy < 0 || yy >= H)
+          continue;
+        for (int j = 0; j < 11; j++) {
+          const int xx = x + j - 5;
+          if (xx >= 0 && xx < W)
+            acc += GAUSS[i] * GAUSS[j] * in[(size_t)yy * W + xx];
+        }
+      }
+      out[(size_t)y * W + x] = (float)acc;
+    }
+  }
+}
+
+void forward_naive(int planes, int H, int W, const float* img1, const float* img2,
+                   float* ssim_map, float* dm_dmu1, float* dm_dsigma1_sq, float* dm_dsigma12) {
+  const size_t n = (size_t)H * W;
+  std::vector<float> prod(n), mu1(n), mu2(n), e11(n), e22(n), e12(n);
+  for (int p = 0; p < planes; p++) {
+    const float* a = img1 + p * n;
+    const float* b = img2 + p * n;
+    conv2d_naive(a, H, W, mu1.data());
+    conv2d_naive(b, H, W, mu2.data());
+    for (size_t i = 0; i < n; i++) prod[i] = a[i] * a[i];
+    conv2d_naive(prod.data(), H, W, e11.data());
+    for (size_t i = 0; i < n; i++) prod[i] = b[i] * b[i];
+    conv2d_naive(prod.data(), H, W, e22.data());
+    for (size_t i = 0; i < n; i++) prod[i] = a[i] * b[i];
+    conv2d_naive(prod.data(), H, W, e12.data());
+
+    for (size_t i = 0; i < n; i++) {
+      const float m1 = mu1[i], m2 = mu2[i];
+      const float s11 = e11[i] - m1 * m1, s22 = e22[i] - m2 * m2, s12 = e12[i] - m1 * m2;
+      const float C = 2.0f * m1 * m2 + C1, D = 2.0f * s12 + C2;
+      const float A = m1 * m1 + m2 * m2 + C1, B = s11 + s22 + C2;
+      ssim_map[p * n + i] = C * D / (A * B);
+      dm_dmu1[p * n + i] = (m2 * 2.0f * D) / (A * B) - (m2 * 2.0f * C) / (A * B)
+                         - (m1 * 2.0f * C * D) / (A * A * B) + (m1 * 2.0f * C * D) / (A * B * B);
+      dm_dsigma1_sq[p * n + i] = (-C * D) / (A * B * B);
+      dm_dsigma12[p * n + i] = (2.0f * C) / (A * B);
+    }
+  }
+}
+
+void backward_naive(int planes, int H, int W, const float* img1, const float* img2, const float* dL_dmap,
+                    const float* dm_dmu1, const float* dm_dsigma1_sq, const float* dm_dsigma12, float* dL_dimg1) {
+  const size_t n = (size_t)H * W;
+  std::vector<float> prod(n), c1(n), c2(n), c3(n);
+  for (int p = 0; p < planes; p++) {
+    const size_t o = p * n;
+    for (size_t i = 0; i < n; i++) prod[i] = dL_dmap[o + i] * dm_dmu1[o + i];
+    conv2d_naive(prod.data(), H, W, c1.data());
+    for (size_t i = 0; i < n; i++) prod[i] = dL_dmap[o + i] * dm_dsigma1_sq[o + i];
+    conv2d_naive(prod.data(), H, W, c2.data());
+    for (size_t i = 0; i < n; i++) prod[i] = dL_dmap[o + i] * dm_dsigma12[o + i];
+    conv2d_naive(prod.data(), H, W, c3.data());
+    for (size_t i = 0; i < n; i++)
+      dL_dimg1[o + i] = c1[i] + 2.0f * img1[o + i] * c2[i] + img2[o + i] * c3[i];
+  }
+}
+
+double time_ms(int runs, const std::function<void()>& f) {
+  std::vector<double> times;
+  for (int r = 0; r < runs; r++) {
+    const auto t1 = std::chrono::steady_clock::now();
+    f();
+    const auto t2 = std::chrono::steady_clock::now();
+    times.push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+float max_abs_diff(const std::vector<float>& a, const std::vector<float>& b) {
+  float diff = 0.0f;
+  for (size_t i = 0; i < a.size(); i++)
+    diff = std::max(diff, std::fabs(a[i] - b[i]));
+  return diff;
+}
+
+float max_abs(const std::vector<float>& a) {
+  float m = 0.0f;
+  for (float v : a)
+    m = std::max(m, std::fabs(v));
+  return m;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int W = argc > 1 ? std::max(16, atoi(argv[1])) : 1920;
+  const int H = argc > 2 ? std::max(16, atoi(argv[2])) : 1080;
+  const int CH = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+  const int runs = argc > 4 ? std::max(1, atoi(argv[4])) : 5;
+  std::vector<int> thread_counts;
+  if (argc > 5) {
+    std::stringstream ss(argv[5]);
+    std::string n;
+    while (std::getline(ss, n, ','))
+      thread_counts.push_back(std::max(1, atoi(n.c_str())));
+  } else {
+    thread_counts.push_back(1);
+    if (std::thread::hardware_concurrency() > 1)
+      thread_counts.push_back(std::thread::hardware_concurrency());
+  }
+
+  // Smooth gradients and edges for the reference image, the render adds noise and a small shift
+  const size_t N = (size_t)CH * H * W;
+  std::vector<float> img1(N), img2(N), dL_dmap(N);
+  std::mt19937 rng(42);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  std::uniform_real_distribution<float> uni(-1.0f, 1.0f);
+  for (int c = 0; c < CH; c++) {
+    for (int y = 0; y < H; y++) {
+      for (int x = 0; x < W; x++) {
+        const size_t i = ((size_t)c * H + y) * W + x;
+        const float v = 0.5f + 0.3f * std::sin(0.02f * x + 0.5f * c) * std::cos(0.03f * y) + ((x / 64 + y / 64) % 2 ? 0.15f : -0.15f);
+        const float shifted = 0.5f + 0.3f * std::sin(0.02f * (x + 1) + 0.5f * c) * std::cos(0.03f * y) + ((x / 64 + y / 64) % 2 ? 0.15f : -0.15f);
+        img2[i] = std::min(1.0f, std::max(0.0f, v));
+        img1[i] = std::min(1.0f, std::max(0.0f, shifted + noise(rng)));
+        dL_dmap[i] = uni(rng);
+      }
+    }
+  }
+  printf("%d x %d x %d, median of %d runs\n", W, H, CH, runs);
+
+  // Naive reference, run once: it is slow
+  std::vector<float> map_ref(N), d1_ref(N), d2_ref(N), d3_ref(N), grad_ref(N);
+  const double naive_fwd = time_ms(1, [&]() {
+    forward_naive(CH, H, W, img1.data(), img2.data(), map_ref.data(), d1_ref.data(), d2_ref.data(), d3_ref.data());
+  });
+  const double naive_bwd = time_ms(1, [&]() {
+    backward_naive(CH, H, W, img1.data(), img2.data(), dL_dmap.data(), d1_ref.data(), d2_ref.data(), d3_ref.data(), grad_ref.data());
+  });
+  printf("naive            : forward %9.2f ms, backward %9.2f ms\n", naive_fwd, naive_bwd);
+
+  bool ok = true;
+  std::vector<float> map(N), d1(N), d2(N), d3(N), grad(N), map_first, grad_first;
+  for (size_t t = 0; t < thread_counts.size(); t++) {
+    const int threads = thread_counts[t];
+    const double fwd = time_ms(runs, [&]() {
+      fusedssim_cpu(C1, C2, 1, CH, H, W, img1.data(), img2.data(), map.data(), d1.data(), d2.data(), d3.data(), threads);
+    });
+    const double inference = time_ms(runs, [&]() {
+      fusedssim_cpu(C1, C2, 1, CH, H, W, img1.data(), img2.data(), map.data(), nullptr, nullptr, nullptr, threads);
+    });
+    const double bwd = time_ms(runs, [&]() {
+      fusedssim_backward_cpu(C1, C2, 1, CH, H, W, img1.data(), img2.data(), dL_dmap.data(), d1.data(), d2.data(), d3.data(), grad.data(), threads);
+    });
+    SSIML1Loss loss;
+    const double fused_loss = time_ms(runs, [&]() {
+      loss = ssim_l1_loss_cpu(0.2f, 1, CH, H, W, img1.data(), img2.data(), nullptr, threads);
+    });
+    printf("fused, %3d thread(s): forward %9.2f ms (%.1fx), inference %9.2f ms, backward %9.2f ms (%.1fx), loss %9.2f ms\n",
+           threads, fwd, naive_fwd / fwd, inference, bwd, naive_bwd / bwd, fused_loss);
+
+    // The variances are differences of float moments, as in ssim.cu: in flat regions their rounding
+    // shows in the map at 1e-4. The derivatives are compared relative to their largest magnitude.
+    const float e_map = max_abs_diff(map, map_ref), e_d1 = max_abs_diff(d1, d1_ref) / max_abs(d1_ref);
+    const float e_d2 = max_abs_diff(d2, d2_ref) / max_abs(d2_ref), e_d3 = max_abs_diff(d3, d3_ref) / max_abs(d3_ref);
+    const float e_grad = max_abs_diff(grad, grad_ref) / max_abs(grad_ref);
+    const bool same = e_map < 1e-3f && e_d1 < 5e-3f && e_d2 < 5e-3f && e_d3 < 5e-3f && e_grad < 5e-3f;
+    printf("  vs naive: map %.2e, dm_dmu1 %.2e, dm_dsigma1_sq %.2e, dm_dsigma12 %.2e, dL_dimg1 %.2e (relative): %s\n",
+           e_map, e_d1, e_d2, e_d3, e_grad, same ? "ok" : "MISMATCH");
+    ok &= same;
+    if (t == 0) {
+      map_first = map;
+      grad_first = grad;
+    } else {
+      const bool deterministic = map == map_first && grad == grad_first;
+      printf("  same as %d thread(s): %s\n", thread_counts[0], deterministic ? "yes" : "NO");
+      ok &= deterministic;
+    }
+  }
+
+  // Gradient of the loss on a small crop against central differences
+  {
+    const int h = 24, w = 28, ch = 2;
+    const size_t n = (size_t)ch * h * w;
+    std::vector<float> a(n), b(n), g(n);
+    for (int c = 0; c < ch; c++)
+      for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) {
+          a[((size_t)c * h + y) * w + x] = img1[((size_t)c * H + y + 100) * W + x + 100];
+          b[((size_t)c * h + y) * w + x] = img2[((size_t)c * H + y + 100) * W + x + 100];
+        }
+    const float lambda = 0.2f;
+    ssim_l1_loss_cpu(lambda, 1, ch, h, w, a.data(), b.data(), g.data(), 1);
+
+    std::mt19937 pick_rng(7);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    int passed = 0, checked = 0;
+    for (int s = 0; s < 50; s++) {
+      const size_t i = pick(pick_rng);
+      const float eps = 1e-3f;
+      // The L1 term has a kink where the images are equal
+      if (std::fabs(a[i] - b[i]) < 2.0f * eps)
+        continue;
+      const float v = a[i];
+      a[i] = v + eps;
+      const double plus = ssim_l1_loss_cpu(lambda, 1, ch, h, w, a.data(), b.data(), nullptr, 1).loss;
+      a[i] = v - eps;
+      const double minus = ssim_l1_loss_cpu(lambda, 1, ch, h, w, a.data(), b.data(), nullptr, 1).loss;
+      a[i] = v;
+      const double fd = (plus - minus) / (2.0 * eps);
+      checked++;
+      if (std::fabs(fd - g[i]) <= 2e-2 * std::fabs(fd) + 1e-6)
+        passed++;
+    }
+    const bool fd_ok = checked > 0 && passed == checked;
+    printf("loss gradient vs finite differences: %d/%d pixels match: %s\n", passed, checked, fd_ok ? "ok" : "MISMATCH");
+    ok &= fd_ok;
+  }
+
+  return ok ? 0 : 1;
+}
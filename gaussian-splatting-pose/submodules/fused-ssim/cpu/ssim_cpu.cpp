@@ -0,0 +1,311 @@
+#include "ssim_cpu.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SSIM_CPU_HAS_AVX2_PATH 1
+#else
+#define SSIM_CPU_HAS_AVX2_PATH 0
+#endif
+
+namespace {
+
+// Same taps as G_00 ... G_10 in ssim.cu
+const float GAUSS[11] = {
+  0.001028380123898387f, 0.0075987582094967365f, 0.036000773310661316f, 0.10936068743467331f,
+  0.21300552785396576f, 0.26601171493530273f, 0.21300552785396576f, 0.10936068743467331f,
+  0.036000773310661316f, 0.0075987582094967365f, 0.001028380123898387f
+};
+
+// Rows per task: the 10 rows of border a band convolves again cost 15% at this height
+const int BAND_ROWS = 64;
+
+// One image plane (b, ch) and what the passes read and write of it
+struct PlaneArgs {
+  int H, W;
+  float C1, C2;
+  const float* img1;
+  const float* img2;
+
+  // forward
+  float* ssim_map;
+  float* dm_dmu1;
+  float* dm_dsigma1_sq;
+  float* dm_dsigma12;
+
+  // backward, dL_dmap_const is used where dL_dmap is null
+  const float* dL_dmap;
+  float dL_dmap_const;
+  const float* dm_dmu1_in;
+  const float* dm_dsigma1_sq_in;
+  const float* dm_dsigma12_in;
+  float* dL_dimg1;
+  float l1_weight;
+};
+
+struct BandSums {
+  double ssim = 0.0;
+  double l1 = 0.0;
+};
+
+// Per thread buffers, reused from band to band
+struct Scratch {
+  std::vector<float> pad1, pad2, pad3;
+  std::vector<float> ring;
+  std::vector<float> moments;
+  std::vector<float> row;
+};
+
+}  // namespace
+
+#if SSIM_CPU_HAS_AVX2_PATH
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+#define SSIM_CPU_NAMESPACE avx2
+#define SSIM_CPU_AVX2 1
+#include "ssim_cpu_kernels.inl"
+#undef SSIM_CPU_AVX2
+#undef SSIM_CPU_NAMESPACE
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
+
+#define SSIM_CPU_NAMESPACE generic
+#define SSIM_CPU_AVX2 0
+#include "ssim_cpu_kernels.inl"
+#undef SSIM_CPU_AVX2
+#undef SSIM_CPU_NAMESPACE
+
+namespace {
+
+bool use_avx2() {
+#if SSIM_CPU_HAS_AVX2_PATH && defined(__GNUC__)
+  static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+int resolve_threads(int num_threads) {
+  if (num_threads > 0)
+    return num_threads;
+  if (const char* env = std::getenv("FUSED_SSIM_THREADS")) {
+    const int n = std::atoi(env);
+    if (n > 0)
+      return n;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls f(task, scratch) for every task from num_threads threads, the caller included
+template <typename F>
+void parallel_tasks(int num_tasks, int num_threads, F f) {
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    Scratch scratch;
+    for (int task = next.fetch_add(1); task < num_tasks; task = next.fetch_add(1))
+      f(task, scratch);
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < std::min(num_threads, num_tasks); i++)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread& t : threads)
+    t.join();
+}
+
+// Runs the forward pass over all the planes; the sums of the bands are added in task order so that
+// the means do not depend on the number of threads
+BandSums run_forward(int planes, const PlaneArgs& args, int num_threads) {
+  const int bands = (args.H + BAND_ROWS - 1) / BAND_ROWS;
+  const size_t plane_size = (size_t)args.H * args.W;
+  std::vector<BandSums> sums((size_t)planes * bands);
+  const bool avx2 = use_avx2();
+
+  parallel_tasks(planes * bands, resolve_threads(num_threads), [&](int task, Scratch& s) {
+    const size_t offset = (size_t)(task / bands) * plane_size;
+    const int y0 = (task % bands) * BAND_ROWS;
+    const int y1 = std::min(args.H, y0 + BAND_ROWS);
+    PlaneArgs p = args;
+    p.img1 += offset;
+    p.img2 += offset;
+    if (p.ssim_map)
+      p.ssim_map += offset;
+    if (p.dm_dmu1) {
+      p.dm_dmu1 += offset;
+      p.dm_dsigma1_sq += offset;
+      p.dm_dsigma12 += offset;
+    }
+#if SSIM_CPU_HAS_AVX2_PATH
+    if (avx2) {
+      sums[task] = avx2::forward_band(p, y0, y1, s);
+      return;
+    }
+#endif
+    (void)avx2;
+    sums[task] = generic::forward_band(p, y0, y1, s);
+  });
+
+  BandSums total;
+  for (const BandSums& band : sums) {
+    total.ssim += band.ssim;
+    total.l1 += band.l1;
+  }
+  return total;
+}
+
+void run_backward(int planes, const PlaneArgs& args, int num_threads) {
+  const int bands = (args.H + BAND_ROWS - 1) / BAND_ROWS;
+  const size_t plane_size = (size_t)args.H * args.W;
+  const bool avx2 = use_avx2();
+
+  parallel_tasks(planes * bands, resolve_threads(num_threads), [&](int task, Scratch& s) {
+    const size_t offset = (size_t)(task / bands) * plane_size;
+    const int y0 = (task % bands) * BAND_ROWS;
+    const int y1 = std::min(args.H, y0 + BAND_ROWS);
+    PlaneArgs p = args;
+    p.img1 += offset;
+    p.img2 += offset;
+    if (p.dL_dmap)
+      p.dL_dmap += offset;
+    p.dm_dmu1_in += offset;
+    p.dm_dsigma1_sq_in += offset;
+    p.dm_dsigma12_in += offset;
+    p.dL_dimg1 += offset;
+#if SSIM_CPU_HAS_AVX2_PATH
+    if (avx2) {
+      avx2::backward_band(p, y0, y1, s);
+      return;
+    }
+#endif
+    (void)avx2;
+    generic::backward_band(p, y0, y1, s);
+  });
+}
+
+PlaneArgs make_args(float C1, float C2, int H, int W, const float* img1, const float* img2) {
+  PlaneArgs args;
+  std::memset(&args, 0, sizeof(args));
+  args.H = H;
+  args.W = W;
+  args.C1 = C1;
+  args.C2 = C2;
+  args.img1 = img1;
+  args.img2 = img2;
+  return args;
+}
+
+}  // namespace
+
+void fusedssim_cpu(
+  float C1,
+  float C2,
+  int B,
+  int CH,
+  int H,
+  int W,
+  const float* img1,
+  const float* img2,
+  float* ssim_map,
+  float* dm_dmu1,
+  float* dm_dsigma1_sq,
+  float* dm_dsigma12,
+  int num_threads
+) {
+  if (B * CH * H * W == 0)
+    return;
+  PlaneArgs args = make_args(C1, C2, H, W, img1, img2);
+  args.ssim_map = ssim_map;
+  if (dm_dmu1) {
+    args.dm_dmu1 = dm_dmu1;
+    args.dm_dsigma1_sq = dm_dsigma1_sq;
+    args.dm_dsigma12 = dm_dsigma12;
+  }
+  run_forward(B * CH, args, num_threads);
+}
+
+void fusedssim_backward_cpu(
+  float C1,
+  float C2,
+  int B,
+  int CH,
+  int H,
+  int W,
+  const float* img1,
+  const float* img2,
+  const float* dL_dmap,
+  const float* dm_dmu1,
+  const float* dm_dsigma1_sq,
+  const float* dm_dsigma12,
+  float* dL_dimg1,
+  int num_threads
+) {
+  if (B * CH * H * W == 0)
+    return;
+  PlaneArgs args = make_args(C1, C2, H, W, img1, img2);
+  args.dL_dmap = dL_dmap;
+  args.dm_dmu1_in = dm_dmu1;
+  args.dm_dsigma1_sq_in = dm_dsigma1_sq;
+  args.dm_dsigma12_in = dm_dsigma12;
+  args.dL_dimg1 = dL_dimg1;
+  run_backward(B * CH, args, num_threads);
+}
+
+SSIML1Loss ssim_l1_loss_cpu(
+  float lambda,
+  int B,
+  int CH,
+  int H,
+  int W,
+  const float* img1,
+  const float* img2,
+  float* dL_dimg1,
+  int num_threads
+) {
+  SSIML1Loss result = {1.0, 0.0, 0.0};
+  const size_t N = (size_t)B * CH * H * W;
+  if (N == 0)
+    return result;
+
+  const float C1 = 0.01f * 0.01f, C2 = 0.03f * 0.03f;
+  PlaneArgs args = make_args(C1, C2, H, W, img1, img2);
+  std::vector<float> dm;
+  if (dL_dimg1) {
+    dm.resize(3 * N);
+    args.dm_dmu1 = dm.data();
+    args.dm_dsigma1_sq = dm.data() + N;
+    args.dm_dsigma12 = dm.data() + 2 * N;
+  }
+  const BandSums sums = run_forward(B * CH, args, num_threads);
+  result.ssim = sums.ssim / N;
+  result.l1 = sums.l1 / N;
+  result.loss = (1.0 - lambda) * result.l1 + lambda * (1.0 - result.ssim);
+
+  if (dL_dimg1) {
+    // d loss / d map is -lambda / N everywhere, d loss / d img1 of the L1 term (1 - lambda) sign(x - y) / N
+    args.dL_dmap_const = -lambda / N;
+    args.l1_weight = (1.0f - lambda) / N;
+    args.dm_dmu1_in = args.dm_dmu1;
+    args.dm_dsigma1_sq_in = args.dm_dsigma1_sq;
+    args.dm_dsigma12_in = args.dm_dsigma12;
+    args.dL_dimg1 = dL_dimg1;
+    run_backward(B * CH, args, num_threads);
+  }
+  return result;
+}
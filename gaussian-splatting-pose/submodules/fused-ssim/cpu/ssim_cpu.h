@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+
+// CPU version of the fused SSIM of ssim.cu, for images of B x CH x H x W floats.
+//
+// The five moments (mu1, mu2, E[x^2], E[y^2], E[xy]) are accumulated together by one separable
+// 11-tap pass: each row is convolved horizontally, the last 11 rows are kept in a ring and
+// convolved vertically, so nothing but the outputs is written per pixel. Pixels outside the
+// image are 0, as in the CUDA kernels. The convolutions use AVX2 and FMA when the CPU has them
+// (checked at run time), otherwise plain loops. Rows are split in bands over the threads.
+//
+// num_threads <= 0 uses the hardware concurrency, or FUSED_SSIM_THREADS when set.
+
+// Same outputs as fusedssim(): the SSIM map and, when dm_dmu1 is not null, the derivatives of the
+// map needed by the backward pass.
+void fusedssim_cpu(
+  float C1,
+  float C2,
+  int B,
+  int CH,
+  int H,
+  int W,
+  const float* img1,
+  const float* img2,
+  float* ssim_map,
+  float* dm_dmu1 = nullptr,
+  float* dm_dsigma1_sq = nullptr,
+  float* dm_dsigma12 = nullptr,
+  int num_threads = 0
+);
+
+// Same output as fusedssim_backward(): dL/dimg1 from dL/dmap.
+void fusedssim_backward_cpu(
+  float C1,
+  float C2,
+  int B,
+  int CH,
+  int H,
+  int W,
+  const float* img1,
+  const float* img2,
+  const float* dL_dmap,
+  const float* dm_dmu1,
+  const float* dm_dsigma1_sq,
+  const float* dm_dsigma12,
+  float* dL_dimg1,
+  int num_threads = 0
+);
+
+struct SSIML1Loss {
+  double ssim;  // mean of the SSIM map ("same" padding)
+  double l1;    // mean absolute difference
+  double loss;  // (1 - lambda) * l1 + lambda * (1 - ssim)
+};
+
+// The 3DGS photometric loss (1 - lambda) * L1 + lambda * (1 - SSIM) of img1 against img2, with the
+// L1 term accumulated by the same pass over the pixels as the SSIM moments. With dL_dimg1 not null
+// the gradient of the loss with respect to img1 is written there.
+SSIML1Loss ssim_l1_loss_cpu(
+  float lambda,
+  int B,
+  int CH,
+  int H,
+  int W,
+  const float* img1,
+  const float* img2,
+  float* dL_dimg1 = nullptr,
+  int num_threads = 0
+);
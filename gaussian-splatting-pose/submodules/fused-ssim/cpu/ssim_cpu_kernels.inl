@@ -0,0 +1,233 @@
+// Row kernels of the CPU SSIM, included by ssim_cpu.cpp once per instruction set with
+// SSIM_CPU_NAMESPACE and SSIM_CPU_AVX2 set. Not a header of its own.
+
+namespace SSIM_CPU_NAMESPACE {
+
+#if SSIM_CPU_AVX2
+struct Vec {
+  static constexpr int N = 8;
+  __m256 v;
+  Vec() = default;
+  Vec(__m256 v) : v(v) {}
+  static Vec load(const float* p) { return _mm256_loadu_ps(p); }
+  static Vec set1(float x) { return _mm256_set1_ps(x); }
+  void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline Vec operator+(Vec a, Vec b) { return _mm256_add_ps(a.v, b.v); }
+inline Vec operator-(Vec a, Vec b) { return _mm256_sub_ps(a.v, b.v); }
+inline Vec operator*(Vec a, Vec b) { return _mm256_mul_ps(a.v, b.v); }
+inline Vec operator/(Vec a, Vec b) { return _mm256_div_ps(a.v, b.v); }
+inline Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline Vec sign(Vec a) {
+  const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+  return _mm256_sub_ps(_mm256_and_ps(_mm256_cmp_ps(a.v, zero, _CMP_GT_OQ), one),
+                       _mm256_and_ps(_mm256_cmp_ps(a.v, zero, _CMP_LT_OQ), one));
+}
+#else
+struct Vec {
+  static constexpr int N = 1;
+  float v;
+  Vec() = default;
+  Vec(float v) : v(v) {}
+  static Vec load(const float* p) { return *p; }
+  static Vec set1(float x) { return x; }
+  void store(float* p) const { *p = v; }
+};
+
+inline Vec operator+(Vec a, Vec b) { return a.v + b.v; }
+inline Vec operator-(Vec a, Vec b) { return a.v - b.v; }
+inline Vec operator*(Vec a, Vec b) { return a.v * b.v; }
+inline Vec operator/(Vec a, Vec b) { return a.v / b.v; }
+inline Vec fmadd(Vec a, Vec b, Vec c) { return a.v * b.v + c.v; }
+inline Vec sign(Vec a) { return float((a.v > 0.0f) - (a.v < 0.0f)); }
+#endif
+
+inline int padded_width(int W) {
+  return (W + Vec::N - 1) / Vec::N * Vec::N;
+}
+
+// Copies a row between zero borders of 5 pixels, the rest of the padded row stays 0
+inline void load_row(const float* row, int W, float* padded) {
+  std::memcpy(padded + 5, row, W * sizeof(float));
+}
+
+// The five moments of a row pair: x, y, x^2, y^2 and xy, convolved horizontally
+inline void horizontal5(const float* a, const float* b, int Wv, float* out) {
+  for (int x = 0; x < Wv; x += Vec::N) {
+    Vec m0 = Vec::set1(0.0f), m1 = m0, m2 = m0, m3 = m0, m4 = m0;
+    for (int k = 0; k < 11; k++) {
+      const Vec g = Vec::set1(GAUSS[k]);
+      const Vec va = Vec::load(a + x + k), vb = Vec::load(b + x + k);
+      const Vec ga = g * va, gb = g * vb;
+      m0 = m0 + ga;
+      m1 = m1 + gb;
+      m2 = fmadd(ga, va, m2);
+      m3 = fmadd(gb, vb, m3);
+      m4 = fmadd(ga, vb, m4);
+    }
+    m0.store(out + x);
+    m1.store(out + Wv + x);
+    m2.store(out + 2 * Wv + x);
+    m3.store(out + 3 * Wv + x);
+    m4.store(out + 4 * Wv + x);
+  }
+}
+
+// Three rows convolved horizontally, for the backward pass
+inline void horizontal3(const float* p0, const float* p1, const float* p2, int Wv, float* out) {
+  for (int x = 0; x < Wv; x += Vec::N) {
+    Vec m0 = Vec::set1(0.0f), m1 = m0, m2 = m0;
+    for (int k = 0; k < 11; k++) {
+      const Vec g = Vec::set1(GAUSS[k]);
+      m0 = fmadd(g, Vec::load(p0 + x + k), m0);
+      m1 = fmadd(g, Vec::load(p1 + x + k), m1);
+      m2 = fmadd(g, Vec::load(p2 + x + k), m2);
+    }
+    m0.store(out + x);
+    m1.store(out + Wv + x);
+    m2.store(out + 2 * Wv + x);
+  }
+}
+
+// Vertical convolution of the M moments of the 11 rows of the ring starting at slot0
+inline void vertical(const float* ring, int slot0, int M, int Wv, float* out) {
+  const float* rows[11];
+  for (int k = 0; k < 11; k++)
+    rows[k] = ring + (size_t)((slot0 + k) % 11) * M * Wv;
+  for (int m = 0; m < M; m++) {
+    for (int x = 0; x < Wv; x += Vec::N) {
+      Vec acc = Vec::set1(0.0f);
+      for (int k = 0; k < 11; k++)
+        acc = fmadd(Vec::set1(GAUSS[k]), Vec::load(rows[k] + m * Wv + x), acc);
+      acc.store(out + m * Wv + x);
+    }
+  }
+}
+
+// Runs the separable convolution of the rows [y0, y1) of a plane: horizontal(r, slot) fills the ring
+// slot of input row r (all 0 outside the image), output(y, moments) receives the convolved moments.
+template <typename Horizontal, typename Output>
+inline void convolve_band(int H, int y0, int y1, int M, int Wv, Scratch& s, Horizontal horizontal, Output output) {
+  s.ring.resize((size_t)11 * M * Wv);
+  s.moments.resize((size_t)M * Wv);
+  for (int r = y0 - 5; r < y1 + 5; r++) {
+    const int slot = (r - (y0 - 5)) % 11;
+    float* h = s.ring.data() + (size_t)slot * M * Wv;
+    if (r < 0 || r >= H)
+      std::fill(h, h + (size_t)M * Wv, 0.0f);
+    else
+      horizontal(r, h);
+
+    const int y = r - 5;
+    if (y >= y0) {
+      vertical(s.ring.data(), (y - y0) % 11, M, Wv, s.moments.data());
+      output(y, s.moments.data());
+    }
+  }
+}
+
+inline BandSums forward_band(const PlaneArgs& p, int y0, int y1, Scratch& s) {
+  const int W = p.W, Wv = padded_width(W);
+  s.pad1.assign(Wv + 10, 0.0f);
+  s.pad2.assign(Wv + 10, 0.0f);
+  s.row.resize((size_t)4 * Wv);
+  BandSums sums;
+
+  const Vec C1 = Vec::set1(p.C1), C2 = Vec::set1(p.C2), two = Vec::set1(2.0f);
+  auto horizontal = [&](int r, float* h) {
+    load_row(p.img1 + (size_t)r * W, W, s.pad1.data());
+    load_row(p.img2 + (size_t)r * W, W, s.pad2.data());
+    horizontal5(s.pad1.data(), s.pad2.data(), Wv, h);
+  };
+  auto output = [&](int y, const float* mom) {
+    float* m_row = s.row.data();
+    float* d1_row = m_row + Wv;
+    float* d2_row = m_row + 2 * Wv;
+    float* d3_row = m_row + 3 * Wv;
+    for (int x = 0; x < Wv; x += Vec::N) {
+      const Vec mu1 = Vec::load(mom + x), mu2 = Vec::load(mom + Wv + x);
+      const Vec mu1_sq = mu1 * mu1, mu2_sq = mu2 * mu2, mu1_mu2 = mu1 * mu2;
+      const Vec sigma1_sq = Vec::load(mom + 2 * Wv + x) - mu1_sq;
+      const Vec sigma2_sq = Vec::load(mom + 3 * Wv + x) - mu2_sq;
+      const Vec sigma12 = Vec::load(mom + 4 * Wv + x) - mu1_mu2;
+
+      const Vec C = fmadd(two, mu1_mu2, C1);
+      const Vec D = fmadd(two, sigma12, C2);
+      const Vec A = mu1_sq + mu2_sq + C1;
+      const Vec B = sigma1_sq + sigma2_sq + C2;
+      const Vec AB = A * B;
+      (C * D / AB).store(m_row + x);
+      if (p.dm_dmu1) {
+        const Vec CD = C * D;
+        (two * mu2 * D / AB - two * mu2 * C / AB - two * mu1 * CD / (A * AB) + two * mu1 * CD / (AB * B)).store(d1_row + x);
+        ((Vec::set1(0.0f) - CD) / (AB * B)).store(d2_row + x);
+        (two * C / AB).store(d3_row + x);
+      }
+    }
+
+    const size_t offset = (size_t)y * W;
+    const float* a = s.pad1.data() + 5;
+    const float* b = s.pad2.data() + 5;
+    load_row(p.img1 + offset, W, s.pad1.data());
+    load_row(p.img2 + offset, W, s.pad2.data());
+    float ssim_row = 0.0f, l1_row = 0.0f;
+    for (int x = 0; x < W; x++) {
+      ssim_row += m_row[x];
+      l1_row += std::fabs(a[x] - b[x]);
+    }
+    sums.ssim += ssim_row;
+    sums.l1 += l1_row;
+
+    if (p.ssim_map)
+      std::memcpy(p.ssim_map + offset, m_row, W * sizeof(float));
+    if (p.dm_dmu1) {
+      std::memcpy(p.dm_dmu1 + offset, d1_row, W * sizeof(float));
+      std::memcpy(p.dm_dsigma1_sq + offset, d2_row, W * sizeof(float));
+      std::memcpy(p.dm_dsigma12 + offset, d3_row, W * sizeof(float));
+    }
+  };
+
+  convolve_band(p.H, y0, y1, 5, Wv, s, horizontal, output);
+  return sums;
+}
+
+inline void backward_band(const PlaneArgs& p, int y0, int y1, Scratch& s) {
+  const int W = p.W, Wv = padded_width(W);
+  s.pad1.assign(Wv + 10, 0.0f);
+  s.pad2.assign(Wv + 10, 0.0f);
+  s.pad3.assign(Wv + 10, 0.0f);
+
+  // dL/dmap times the derivatives of the map, between zero borders
+  auto horizontal = [&](int r, float* h) {
+    const size_t offset = (size_t)r * W;
+    float* q1 = s.pad1.data() + 5;
+    float* q2 = s.pad2.data() + 5;
+    float* q3 = s.pad3.data() + 5;
+    for (int x = 0; x < W; x++) {
+      const float d = p.dL_dmap ? p.dL_dmap[offset + x] : p.dL_dmap_const;
+      q1[x] = d * p.dm_dmu1_in[offset + x];
+      q2[x] = d * p.dm_dsigma1_sq_in[offset + x];
+      q3[x] = d * p.dm_dsigma12_in[offset + x];
+    }
+    horizontal3(s.pad1.data(), s.pad2.data(), s.pad3.data(), Wv, h);
+  };
+  auto output = [&](int y, const float* mom) {
+    const size_t offset = (size_t)y * W;
+    for (int x = 0; x + Vec::N <= W; x += Vec::N) {
+      const Vec a = Vec::load(p.img1 + offset + x), b = Vec::load(p.img2 + offset + x);
+      Vec grad = fmadd(Vec::set1(2.0f) * a, Vec::load(mom + Wv + x), Vec::load(mom + x));
+      grad = fmadd(b, Vec::load(mom + 2 * Wv + x), grad);
+      grad = fmadd(Vec::set1(p.l1_weight), sign(a - b), grad);
+      grad.store(p.dL_dimg1 + offset + x);
+    }
+    for (int x = W / Vec::N * Vec::N; x < W; x++) {
+      const float a = p.img1[offset + x], b = p.img2[offset + x];
+      p.dL_dimg1[offset + x] = mom[x] + 2.0f * a * mom[Wv + x] + b * mom[2 * Wv + x] + p.l1_weight * float((a > b) - (a < b));
+    }
+  };
+
+  convolve_band(p.H, y0, y1, 3, Wv, s, horizontal, output);
+}
+
+}  // namespace SSIM_CPU_NAMESPACE
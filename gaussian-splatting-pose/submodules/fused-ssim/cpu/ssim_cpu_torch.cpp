@@ -0,0 +1,84 @@
+#include <torch/extension.h>
+#include "../ssim.h"
+#include "ssim_cpu.h"
+
+std::tuple<torch::Tensor,torch::Tensor,torch::Tensor,torch::Tensor>
+fusedssim_cpu(
+  float C1,
+  float C2,
+  torch::Tensor &img1,
+  torch::Tensor &img2,
+  bool train
+)
+{
+  int B = img1.size(0);
+  int CH = img1.size(1);
+  int H = img1.size(2);
+  int W = img1.size(3);
+  torch::Tensor img1_c = img1.contiguous();
+  torch::Tensor img2_c = img2.contiguous();
+
+  torch::Tensor target = torch::empty_like(img1_c);
+  torch::Tensor dm_dmu1 = train ? torch::empty_like(img1_c) : torch::empty(0);
+  torch::Tensor dm_dsigma1_sq = train ? torch::empty_like(img1_c) : torch::empty(0);
+  torch::Tensor dm_dsigma12 = train ? torch::empty_like(img1_c) : torch::empty(0);
+  fusedssim_cpu(
+    C1,
+    C2,
+    B,
+    CH,
+    H,
+    W,
+    img1_c.data_ptr<float>(),
+    img2_c.data_ptr<float>(),
+    target.data_ptr<float>(),
+    train ? dm_dmu1.data_ptr<float>() : nullptr,
+    train ? dm_dsigma1_sq.data_ptr<float>() : nullptr,
+    train ? dm_dsigma12.data_ptr<float>() : nullptr
+  );
+
+  return std::make_tuple(target, dm_dmu1, dm_dsigma1_sq, dm_dsigma12);
+}
+
+torch::Tensor
+fusedssim_backward_cpu(
+  float C1,
+  float C2,
+  torch::Tensor &img1,
+  torch::Tensor &img2,
+  torch::Tensor &dL_dmap,
+  torch::Tensor &dm_dmu1,
+  torch::Tensor &dm_dsigma1_sq,
+  torch::Tensor &dm_dsigma12
+)
+{
+  int B = img1.size(0);
+  int CH = img1.size(1);
+  int H = img1.size(2);
+  int W = img1.size(3);
+  torch::Tensor img1_c = img1.contiguous();
+  torch::Tensor img2_c = img2.contiguous();
+  torch::Tensor dL_dmap_c = dL_dmap.contiguous();
+  torch::Tensor dm_dmu1_c = dm_dmu1.contiguous();
+  torch::Tensor dm_dsigma1_sq_c = dm_dsigma1_sq.contiguous();
+  torch::Tensor dm_dsigma12_c = dm_dsigma12.contiguous();
+
+  torch::Tensor dL_dimg1 = torch::empty_like(img1_c);
+  fusedssim_backward_cpu(
+    C1,
+    C2,
+    B,
+    CH,
+    H,
+    W,
+    img1_c.data_ptr<float>(),
+    img2_c.data_ptr<float>(),
+    dL_dmap_c.data_ptr<float>(),
+    dm_dmu1_c.data_ptr<float>(),
+    dm_dsigma1_sq_c.data_ptr<float>(),
+    dm_dsigma12_c.data_ptr<float>(),
+    dL_dimg1.data_ptr<float>()
+  );
+
+  return dL_dimg1;
+}
@@ -4,4 +4,6 @@
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   m.def("fusedssim", &fusedssim);
   m.def("fusedssim_backward", &fusedssim_backward);
+  m.def("fusedssim_cpu", &fusedssim_cpu);
+  m.def("fusedssim_backward_cpu", &fusedssim_backward_cpu);
 }
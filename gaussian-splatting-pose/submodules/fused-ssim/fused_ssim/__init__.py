@@ -1,14 +1,16 @@
 from typing import NamedTuple
 import torch.nn as nn
 import torch
-from fused_ssim_cuda import fusedssim, fusedssim_backward
+from fused_ssim_cuda import fusedssim, fusedssim_backward, fusedssim_cpu, fusedssim_backward_cpu
 
 allowed_padding = ["same", "valid"]
 
 class FusedSSIMMap(torch.autograd.Function):
     @staticmethod
     def forward(ctx, C1, C2, img1, img2, padding="same", train=True):
-        ssim_map, dm_dmu1, dm_dsigma1_sq, dm_dsigma12 = fusedssim(C1, C2, img1, img2, train)
+        # CPU tensors go to the kernels of cpu/ssim_cpu.cpp
+        forward = fusedssim if img1.is_cuda else fusedssim_cpu
+        ssim_map, dm_dmu1, dm_dsigma1_sq, dm_dsigma12 = forward(C1, C2, img1, img2, train)
 
         if padding == "valid":
             ssim_map = ssim_map[:, :, 5:-5, 5:-5]
@@ -28,7 +30,8 @@ class FusedSSIMMap(torch.autograd.Function):
         if padding == "valid":
             dL_dmap = torch.zeros_like(img1)
             dL_dmap[:, :, 5:-5, 5:-5] = opt_grad
-        grad = fusedssim_backward(C1, C2, img1, img2, dL_dmap, dm_dmu1, dm_dsigma1_sq, dm_dsigma12)
+        backward = fusedssim_backward if img1.is_cuda else fusedssim_backward_cpu
+        grad = backward(C1, C2, img1, img2, dL_dmap, dm_dmu1, dm_dsigma1_sq, dm_dsigma12)
         return None, None, grad, None, None, None
 
 def fused_ssim(img1, img2, padding="same", train=True):
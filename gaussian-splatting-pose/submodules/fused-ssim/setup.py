@@ -9,7 +9,10 @@ setup(
             name="fused_ssim_cuda",
             sources=[
             "ssim.cu",
-            "ext.cpp"])
+            "cpu/ssim_cpu.cpp",
+            "cpu/ssim_cpu_torch.cpp",
+            "ext.cpp"],
+            extra_compile_args={"cxx": ["-O3"]})
         ],
     cmdclass={
         'build_ext': BuildExtension
@@ -24,3 +24,25 @@ fusedssim_backward(
     torch::Tensor &dm_dsigma1_sq,
     torch::Tensor &dm_dsigma12
 );
+
+// Same as above on CPU tensors, see cpu/ssim_cpu.h
+std::tuple<torch::Tensor,torch::Tensor,torch::Tensor,torch::Tensor>
+fusedssim_cpu(
+    float C1,
+    float C2,
+    torch::Tensor &img1,
+    torch::Tensor &img2,
+    bool train
+);
+
+torch::Tensor
+fusedssim_backward_cpu(
+    float C1,
+    float C2,
+    torch::Tensor &img1,
+    torch::Tensor &img2,
+    torch::Tensor &dL_dmap,
+    torch::Tensor &dm_dmu1,
+    torch::Tensor &dm_dsigma1_sq,
+    torch::Tensor &dm_dsigma12
+);
@@ -18,6 +18,9 @@ class BasicPointCloud(NamedTuple):
     points : np.array
     colors : np.array
     normals : np.array
+    scales : np.array = None  # initial Gaussian scales written by the SLAM exporter, if any: (N,) or (N, 3)
+    rotations : np.array = None  # initial quaternions (w, x, y, z) of the exported PLY, if any
+    opacities : np.array = None  # initial opacities of the exported PLY, if any
 
 def geom_transform_points(points, transf_matrix):
     P, _ = points.shape
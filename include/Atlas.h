@@ -107,6 +107,9 @@ public:
 
     vector<Map*> GetAllMaps();
 
+    // Footprint of all the maps, per category
+    MemoryUsage GetMemoryUsage();
+
     int CountMaps();
 
     void clearMap();
@@ -0,0 +1,77 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEPTHDENSIFIER_H
+#define DEPTHDENSIFIER_H
+
+#include <vector>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+#include "PointCloudFilter.h"
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Dense points for the 3DGS initialization from stereo between covisible keyframes. Each keyframe is paired
+// with its nNeighbours best covisible keyframes. The images of a pair are taken from the image store at
+// pyramid level nLevel (each level halves the resolution), rectified with the optimized relative pose,
+// and matched by semi-global matching (cv::StereoSGBM). The disparity range comes from the depths of the
+// map points the keyframe sees. Every nStep-th pixel is triangulated into a voxel grid. Only the voxels
+// reached by at least nMinSupport pairs are kept, with the mean position and color of their points, so depths
+// that the pairs do not agree on are dropped.
+//
+// Pairs run on nThreads threads, one pair per thread; the voxels of a batch of pairs are merged in pair
+// order, which keeps the result independent of the number of threads. Memory is bounded by the batch and by
+// nMaxPoints voxels. Only pinhole keyframes are used.
+class DepthDensifier
+{
+public:
+    struct Options
+    {
+        Options(): nNeighbours(2), nLevel(1), nStep(2), nMinSupport(2), nMaxPoints(2000000), voxelSize(0.f),
+                   minParallaxDeg(1.f) {}
+
+        int nNeighbours;
+        int nLevel;
+        int nStep;
+        int nMinSupport;
+        int nMaxPoints;
+        // 0: the footprint of nStep pixels at the median depth of the map points
+        float voxelSize;
+        // Pairs with a smaller angle between the viewing rays of their map points are skipped
+        float minParallaxDeg;
+    };
+
+    // getImage returns the image of a keyframe, empty when it is not kept
+    DepthDensifier(const Options &options, const std::function<cv::Mat(KeyFrame*)> &getImage);
+
+    // Dense points of the given keyframes, nObs is the number of pairs that reached the voxel plus one
+    std::vector<PointCloudFilter::Point> Densify(const std::vector<KeyFrame*> &vpKFs, const int nThreads = 0);
+
+private:
+    Options mOptions;
+    std::function<cv::Mat(KeyFrame*)> mGetImage;
+};
+
+} //namespace ORB_SLAM
+
+#endif // DEPTHDENSIFIER_H
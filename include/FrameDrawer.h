@@ -28,6 +28,8 @@
 #include<opencv2/features2d/features2d.hpp>
 
 #include<mutex>
+#include<atomic>
+#include<chrono>
 #include <unordered_set>
 
 
@@ -50,6 +52,16 @@ public:
     cv::Mat DrawFrame(float imageScale=1.f);
     cv::Mat DrawRightFrame(float imageScale=1.f);
 
+    // Headless mode: without a viewer the tracking state is only copied (Update) when a
+    // snapshot has been requested, so tracking does not pay for the drawing.
+    void SetViewerActive(const bool bActive);
+    bool NeedUpdate();
+
+    // Ask for a copy of the state of the next processed frame. Requests less than minPeriod
+    // seconds after the previous snapshot are rejected.
+    bool RequestSnapshot(const double minPeriod);
+    bool isSnapshotReady();
+
     bool both;
 
 protected:
@@ -74,6 +86,11 @@ protected:
     std::mutex mMutex;
     vector<pair<cv::Point2f, cv::Point2f> > mvTracks;
 
+    std::atomic<bool> mbViewerActive;
+    std::atomic<bool> mbSnapshotRequested;
+    bool mbSnapshotReady;
+    std::chrono::steady_clock::time_point mtLastSnapshot;
+
     Frame mCurrentFrame;
     vector<MapPoint*> mvpLocalMap;
     vector<cv::KeyPoint> mvMatchedKeys;
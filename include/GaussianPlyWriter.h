@@ -0,0 +1,67 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GAUSSIANPLYWRITER_H
+#define GAUSSIANPLYWRITER_H
+
+#include <vector>
+#include <string>
+
+#include <Eigen/Core>
+
+namespace ORB_SLAM3
+{
+
+// Binary little-endian PLY of the initial Gaussians, read by fetchPly of the trainer in place of the points3D.ply
+// it converts from points3D.txt. The vertices have the properties of storePly: x, y, z, nx, ny, nz as floats and
+// red, green, blue as uchar. They are followed by the optional Gaussian parameters, in the activation spaces that
+// GaussianModel.save_ply uses: opacity (logit), scale_0..2 (log) and rot_0..3 (quaternion w, x, y, z).
+//
+// Without rotations the scales are the isotropic k-nearest neighbour scales. With rotations, the axes are those
+// of the local PCA of the nPcaNeighbours nearest points: the normals are the axes of least variance, and the
+// scales follow the spread along each axis, with the largest one at the isotropic scale and none below
+// minScaleRatio of it. The vertices are written CHUNK_VERTICES at a time, one write per chunk.
+class GaussianPlyWriter
+{
+public:
+    static const int CHUNK_VERTICES = 65536;
+
+    struct Options
+    {
+        Options(): bScales(true), bRotations(false), bOpacity(true), opacity(0.1f), nPcaNeighbours(16),
+                   minScaleRatio(0.1f) {}
+
+        bool bScales;
+        bool bRotations;
+        bool bOpacity;
+        // Initial opacity, 0.1 as in GaussianModel.create_from_pcd
+        float opacity;
+        int nPcaNeighbours;
+        float minScaleRatio;
+    };
+
+    // vColors are RGB in 0-255, vScales the scales of PointCloudKnn::InitialScales (only read with bScales).
+    // nThreads <= 0 uses all the hardware threads for the PCA.
+    static bool Save(const std::string &filename, const std::vector<Eigen::Vector3f> &vPoints,
+                     const std::vector<Eigen::Vector3f> &vColors, const std::vector<float> &vScales,
+                     const Options &options, const int nThreads = 0);
+};
+
+} //namespace ORB_SLAM
+
+#endif // GAUSSIANPLYWRITER_H
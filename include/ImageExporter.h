@@ -0,0 +1,150 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEEXPORTER_H
+#define IMAGEEXPORTER_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+#include "MemoryUsage.h"
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Encodes and writes the keyframe images of the export on a pool of worker threads fed by a bounded queue.
+// The images are PNG (nPngLevel, lossless), JPEG (nJpegQuality) or lossless WebP, named after the timestamp of
+// their keyframe with 6 decimals, as images.txt refers to them.
+//
+// With nMatureKeyFrames > 0 the images are also encoded during SLAM: local mapping reports each new keyframe, and a
+// keyframe is encoded once nMatureKeyFrames newer ones exist, when it has left the local window. The encoded
+// images are kept in memory and Write only writes them to disk. This never blocks local mapping: a keyframe is
+// left for Write when the queue is full. Images encoded by Write are not kept. The images of keyframes that leave
+// the atlas, culled or in a map that was reset, are dropped at the next keyframe. The kept images take at most
+// nMaxEncodedMB, the oldest are dropped beyond it or when local mapping is over its memory budget; Write encodes the
+// dropped ones again.
+class ImageExporter
+{
+public:
+    enum Format
+    {
+        PNG = 0,
+        JPEG = 1,
+        WEBP = 2
+    };
+
+    struct Options
+    {
+        Options(): format(PNG), nPngLevel(1), nJpegQuality(95), nThreads(0), nMaxQueued(32), nMatureKeyFrames(0),
+            nMaxEncodedMB(1024) {}
+
+        Format format;
+        int nPngLevel;
+        int nJpegQuality;
+        // <= 0: all the hardware threads. Read when the workers start, at the first image.
+        int nThreads;
+        int nMaxQueued;
+        int nMatureKeyFrames;
+        // <= 0: no limit
+        int nMaxEncodedMB;
+    };
+
+    // getImage returns the image of a keyframe as it must be written, empty when it is not kept
+    ImageExporter(const std::function<cv::Mat(KeyFrame*)> &getImage);
+    ~ImageExporter();
+
+    // Drops the images encoded with the previous options when the format changes
+    void SetOptions(const Options &options);
+    Options GetOptions();
+
+    std::string Filename(KeyFrame* pKF);
+
+    // New keyframe from local mapping, encodes the keyframe that matures with it
+    void AddKeyFrame(KeyFrame* pKF);
+
+    // Writes the images of vpKFs to directory and returns the number written, once they are all on disk
+    size_t Write(const std::vector<KeyFrame*> &vpKFs, const std::string &directory);
+
+    // Drops the encoded images, e.g. once the undistortion of the export has changed. The encodings in progress
+    // are not kept either, so images made with what getImage returned before the call are never kept.
+    void Clear();
+
+    // Adds the footprint of the encoded images to usage
+    void AddMemoryUsage(MemoryUsage &usage);
+
+    // Drops the oldest encoded images until at least nBytes are freed or none is left
+    void ReleaseOldest(const size_t nBytes);
+
+private:
+    bool Submit(const std::function<void()> &task, const bool bBlock);
+    void WaitIdle();
+    void Run();
+
+    // The encoded image of pKF, from memory or encoded now; kept when bKeep
+    bool GetEncoded(KeyFrame* pKF, const bool bKeep, std::vector<uchar> &buffer);
+    bool Encode(KeyFrame* pKF, const Options &options, std::vector<uchar> &buffer);
+
+    // Forgets the keyframes that are bad or no longer in a map
+    void DropRemovedKeyFrames();
+
+    // mMutexEncoded must be locked
+    void ClearEncoded();
+    void EraseOldestEncoded();
+
+    std::function<cv::Mat(KeyFrame*)> mGetImage;
+
+    Options mOptions;
+    std::deque<KeyFrame*> mdpYoungKeyFrames;
+    std::mutex mMutexOptions;
+
+    // Worker pool
+    std::vector<std::thread> mvWorkers;
+    std::deque<std::function<void()> > mqTasks;
+    size_t mnPending;
+    bool mbStop;
+    std::mutex mMutexQueue;
+    std::condition_variable mCondTask;
+    std::condition_variable mCondSpace;
+    std::condition_variable mCondIdle;
+
+    // Encoded images, oldest first in mdpEncoded, and the keyframes being encoded. Encodings started before a
+    // Clear are not kept.
+    std::map<KeyFrame*, std::vector<uchar> > mmEncoded;
+    std::deque<KeyFrame*> mdpEncoded;
+    size_t mnEncodedBytes;
+    std::set<KeyFrame*> mspEncoding;
+    unsigned long mnGeneration;
+    bool mbEncodeErrorShown;
+    std::mutex mMutexEncoded;
+    std::condition_variable mCondEncoded;
+};
+
+} //namespace ORB_SLAM
+
+#endif // IMAGEEXPORTER_H
@@ -0,0 +1,56 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEUNDISTORTER_H
+#define IMAGEUNDISTORTER_H
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+// Undistortion of the exported keyframe images for a pinhole camera with radial-tangential distortion.
+// The images are undistorted with the calibration matrix itself, so they match the undistorted keypoints
+// (mvKeysUn). With bCrop the images are cut to the largest rectangle without invalid pixels, and the
+// principal point and the keypoints are shifted accordingly. The remap tables are built once.
+class ImageUndistorter
+{
+public:
+    ImageUndistorter(const float fx, const float fy, const float cx, const float cy, const cv::Mat &distCoef,
+                     const cv::Size &imageSize, const bool bCrop);
+
+    // Thread safe
+    void Undistort(const cv::Mat &im, cv::Mat &imOut) const;
+
+    // Undistorted keypoint coordinates in the exported image
+    cv::Point2f Map(const cv::Point2f &ptUn) const;
+    bool IsInside(const cv::Point2f &pt) const;
+
+    // Pinhole camera of the exported images
+    float fx, fy, cx, cy;
+    cv::Size mSize;
+
+private:
+    bool mbIdentity;
+    cv::Mat mMap1, mMap2;
+    cv::Rect mROI;
+};
+
+} //namespace ORB_SLAM
+
+#endif // IMAGEUNDISTORTER_H
@@ -0,0 +1,80 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMURINGBUFFER_H
+#define IMURINGBUFFER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "ImuTypes.h"
+
+namespace ORB_SLAM3
+{
+
+// Preallocated single-producer/single-consumer queue of IMU samples ordered by timestamp.
+// Push is called by the thread that grabs the IMU data, every other method by the tracking thread.
+class ImuRingBuffer
+{
+public:
+    // The capacity is rounded up to a power of two
+    ImuRingBuffer(const size_t capacity = 1<<14);
+
+    // Producer side. Returns false if the buffer is full or the sample is older than the last pushed one.
+    bool Push(const IMU::Point &imuMeasurement);
+
+    // Consumer side. Copies the samples needed to integrate from t0 to t1: the ones with t0 <= t < t1
+    // and the first one with t >= t1, if already received. Samples before t1 are released.
+    void ExtractWindow(const double t0, const double t1, std::vector<IMU::Point> &vImu);
+
+    // Consumer side. Drops every sample received so far and starts a new stream: the next sample pushed is
+    // accepted whatever its timestamp, e.g. after a dataset restart.
+    void Clear();
+
+    size_t Size() const;
+    size_t Capacity() const;
+
+    // Samples rejected by Push since the creation of the buffer
+    size_t Dropped() const;
+
+protected:
+    // First sample in [first,last) with timestamp >= t
+    uint64_t LowerBound(uint64_t first, uint64_t last, const double t) const;
+
+    std::vector<IMU::Point> mvBuffer;
+    const uint64_t mnMask;
+
+    // Monotonic positions, the slot is position & mnMask. Head is written by the producer only,
+    // tail by the consumer only. Each lives on its own cache line.
+    alignas(64) std::atomic<uint64_t> mnHead;
+    alignas(64) std::atomic<uint64_t> mnTail;
+
+    // Incremented by Clear, the producer restarts the timestamp order when it changes
+    std::atomic<uint64_t> mnStream;
+
+    // Producer state
+    alignas(64) double mLastTimestamp;
+    uint64_t mnLastStream;
+    std::atomic<size_t> mnDropped;
+};
+
+} //namespace ORB_SLAM
+
+#endif // IMURINGBUFFER_H
@@ -135,6 +135,7 @@ public:
 public:
     float deltaT; //integration time
     Eigen::Matrix3f deltaR;
+    Eigen::Quaternionf deltaQ; // deltaR as a quaternion
     Eigen::Matrix3f rightJ; // right jacobian
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -0,0 +1,219 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace ORB_SLAM3
+{
+
+// Per-stage latency and complexity histograms and a timeline of the SLAM threads, toggled at runtime.
+// Every thread records into its own log-linear (HDR) histograms and event buffer without locking.
+// When both are disabled a timer costs one relaxed atomic load.
+class Instrumentation
+{
+public:
+    enum eStage
+    {
+        // Tracking
+        TRACK_RECT_STEREO=0,
+        TRACK_RESIZE_IMAGE,
+        TRACK_ORB_EXTRACT,
+        TRACK_STEREO_MATCH,
+        TRACK_IMU_PREINT,
+        TRACK_POSE_PRED,
+        TRACK_LOCAL_MAP,
+        TRACK_NEW_KF,
+        TRACK_TOTAL,
+
+        // Local Mapping
+        LM_KF_INSERT,
+        LM_MP_CULLING,
+        LM_MP_CREATION,
+        LM_LBA,
+        LM_LBA_ABORTED,
+        LM_KF_CULLING,
+        LM_TOTAL,
+        LM_LBA_EDGES,
+        LM_LBA_KF_OPT,
+        LM_LBA_KF_FIXED,
+        LM_LBA_MPS,
+
+        // Place recognition and loop closing
+        LC_DB_QUERY,
+        LC_EST_SIM3,
+        LC_PR_TOTAL,
+        LC_LOOP_FUSION,
+        LC_LOOP_OPT_ESS,
+        LC_LOOP_TOTAL,
+        LC_MERGE_MAPS,
+        LC_MERGE_WELDING_BA,
+        LC_MERGE_OPT_ESS,
+        LC_MERGE_TOTAL,
+        LC_MERGE_KFS,
+        LC_MERGE_MPS,
+        LC_GBA,
+        LC_GBA_ABORTED,
+        LC_GBA_UPDATE_MAP,
+        LC_GBA_TOTAL,
+        LC_GBA_KFS,
+        LC_GBA_MPS,
+
+        NUM_STAGES
+    };
+
+    // Nanoseconds on the steady clock, 0 when the instrumentation is disabled
+    typedef int64_t TimePoint;
+
+    struct StageStats
+    {
+        eStage stage;
+        std::string name;
+        std::string unit;   // "ms" for latencies, "#" for complexity counts
+        uint64_t count;
+        double mean;
+        double p50;
+        double p99;
+        double max;
+    };
+
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(const eStage stage): mStage(stage), mStart(Now()) {}
+        ~ScopedTimer() { RecordInterval(mStage,mStart,Now()); }
+
+    private:
+        ScopedTimer(const ScopedTimer&);
+        ScopedTimer& operator=(const ScopedTimer&);
+
+        const eStage mStage;
+        const TimePoint mStart;
+    };
+
+    // Timeline-only span, name must outlive the trace (string literal)
+    class ScopedTrace
+    {
+    public:
+        ScopedTrace(const char* name): mName(name), mStart(Now()) {}
+        ~ScopedTrace() { Trace(mName,mStart,Now()); }
+
+    private:
+        ScopedTrace(const ScopedTrace&);
+        ScopedTrace& operator=(const ScopedTrace&);
+
+        const char* mName;
+        const TimePoint mStart;
+    };
+
+    // Histograms
+    static void SetEnabled(const bool bEnabled);
+    // Timeline events of every stage, span and lock wait
+    static void SetTracing(const bool bTracing);
+
+    static inline bool IsEnabled()
+    {
+        return mnFlags.load(std::memory_order_relaxed) & HISTOGRAMS;
+    }
+
+    static inline bool IsTracing()
+    {
+        return mnFlags.load(std::memory_order_relaxed) & TRACING;
+    }
+
+    static inline TimePoint Now()
+    {
+        if(!mnFlags.load(std::memory_order_relaxed))
+            return 0;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Intervals that started or ended while disabled are dropped
+    static inline void RecordInterval(const eStage stage, const TimePoint start, const TimePoint end)
+    {
+        if(start && end)
+            RecordStage(stage,start,end);
+    }
+
+    static inline void Trace(const char* name, const TimePoint start, const TimePoint end)
+    {
+        if(start && end)
+            TraceEvent(name,"span",start,end);
+    }
+
+    // Lock or synchronization wait that started at start and ends now. Uncontended waits are not traced.
+    static inline void TraceWait(const char* name, const TimePoint start)
+    {
+        if(start)
+            TraceWaitEnd(name,start);
+    }
+
+    // Name of the calling thread in the timeline
+    static void SetThreadName(const std::string &name);
+
+    // Latency measured outside the library (e.g. image preprocessing in the node)
+    static void RecordTime(const eStage stage, const double ms);
+
+    // Complexity counts (keyframes, edges, ...)
+    static void RecordCount(const eStage stage, const uint64_t n);
+
+    // Cumulative statistics of every stage with at least one sample
+    static std::vector<StageStats> GetStats();
+
+    static const char* StageName(const eStage stage);
+
+    // Writes "time,stage,unit,count,mean,p50,p99,max" rows for the samples taken in each period to
+    // filename (if not empty) and passes them to the callback (if any), e.g. to publish them.
+    static void StartExport(const std::string &filename, const double period,
+                            const std::function<void(const std::vector<StageStats>&)> &callback = nullptr);
+    static void StopExport();
+
+    // Cumulative summary to stdout and filename (if not empty)
+    static void PrintSummary(const std::string &filename);
+
+    // Chrome trace (JSON) of the last events of every thread, opens in chrome://tracing and Perfetto.
+    // It can be written while the threads run, the oldest events of a full buffer may then be torn.
+    static bool WriteTrace(const std::string &filename);
+
+protected:
+    enum eFlags
+    {
+        HISTOGRAMS=1,
+        TRACING=2
+    };
+
+    // Values are stored in microseconds for latencies
+    static void Record(const eStage stage, const uint64_t value);
+    static void RecordStage(const eStage stage, const TimePoint start, const TimePoint end);
+    static void TraceEvent(const char* name, const char* category, const TimePoint start, const TimePoint end);
+    static void TraceWaitEnd(const char* name, const TimePoint start);
+
+    static std::atomic<int> mnFlags;
+};
+
+} //namespace ORB_SLAM
+
+#endif // INSTRUMENTATION_H
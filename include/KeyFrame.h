@@ -31,6 +31,7 @@
 
 #include "GeometricCamera.h"
 #include "SerializationUtils.h"
+#include "MemoryUsage.h"
 
 #include <mutex>
 
@@ -259,6 +260,15 @@ public:
 
     // KeyPoint functions
     std::vector<size_t> GetFeaturesInArea(const float &x, const float  &y, const float  &r, const bool bRight = false) const;
+
+    // Frees the feature grids, GetFeaturesInArea rebuilds them from the keypoints when needed
+    void ReleaseGrid();
+    bool HasGrid();
+    // Moves out the keyframes whose released grid has been rebuilt since the last call
+    static void TakeRebuiltGrids(std::vector<KeyFrame*> &vpKFs);
+
+    // Adds the heap footprint of this keyframe to usage
+    void AddMemoryUsage(MemoryUsage &usage);
     bool UnprojectStereo(int i, Eigen::Vector3f &x3D);
 
     // Image
@@ -454,8 +464,14 @@ protected:
     KeyFrameDatabase* mpKeyFrameDB;
     ORBVocabulary* mpORBvocabulary;
 
-    // Grid over the image to speed up feature matching
-    std::vector< std::vector <std::vector<size_t> > > mGrid;
+    // Grid over the image to speed up feature matching. It may be released for old keyframes.
+    mutable std::vector< std::vector <std::vector<size_t> > > mGrid;
+    mutable std::mutex mMutexGrid;
+    mutable bool mbGridReleased;
+    static std::vector<KeyFrame*> mvpRebuiltGrids;
+    static std::mutex mMutexRebuiltGrids;
+
+    void AssignFeaturesToGrid() const;
 
     std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
     std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
@@ -515,7 +531,7 @@ public:
 
     const int NLeft, NRight;
 
-    std::vector< std::vector <std::vector<size_t> > > mGridRight;
+    mutable std::vector< std::vector <std::vector<size_t> > > mGridRight;
 
     Sophus::SE3<float> GetRightPose();
     Sophus::SE3<float> GetRightPoseInverse();
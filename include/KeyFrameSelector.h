@@ -0,0 +1,95 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KEYFRAMESELECTOR_H
+#define KEYFRAMESELECTOR_H
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Selection of the keyframes exported for 3DGS training. The map points are the surface samples: a
+// keyframe brings a map point when fewer than nTargetViews selected keyframes see it, and none of them
+// within minParallaxDeg of its viewing ray, so near-duplicate views (small baseline, same frustum) bring
+// nothing. Keyframes are picked greedily by the number of points they bring, weighted by their sharpness
+// (variance of the Laplacian of the image relative to the median), until no keyframe brings at least
+// minNewPointsRatio of its points. Ties go to the oldest keyframe, the result does not depend on the
+// number of threads.
+class KeyFrameSelector
+{
+public:
+    struct Options
+    {
+        Options(): nTargetViews(3), minParallaxDeg(5.f), minNewPointsRatio(0.1f), minBlurRatio(0.3f) {}
+
+        int nTargetViews;
+        float minParallaxDeg;
+        float minNewPointsRatio;
+        // Keyframes sharper than this fraction of the median only
+        float minBlurRatio;
+    };
+
+    enum eDecision
+    {
+        KEPT = 0,
+        REDUNDANT = 1,
+        BLURRED = 2,
+        NO_POINTS = 3
+    };
+
+    struct Entry
+    {
+        KeyFrame* pKF;
+        eDecision decision;
+        int nPoints;
+        int nNewPoints; // points brought when selected, or when last scored
+        float blur;     // -1 without image
+        int order;      // rank in the selection, -1 when dropped
+    };
+
+    // getImage returns the image of a keyframe, empty when it is not kept
+    KeyFrameSelector(const Options &options, const std::function<cv::Mat(KeyFrame*)> &getImage);
+
+    // Bad keyframes are ignored. Returns the kept keyframes in id order.
+    std::vector<KeyFrame*> Select(const std::vector<KeyFrame*> &vpKFs, const int nThreads = 0);
+
+    // Of the last selection
+    const std::vector<Entry>& GetEntries() const { return mvEntries; }
+    void PrintSummary() const;
+    bool SaveReport(const std::string &filename) const;
+
+private:
+    Options mOptions;
+    std::function<cv::Mat(KeyFrame*)> mGetImage;
+
+    std::vector<Entry> mvEntries;
+    int mnMapPoints;
+    int mnSeen;     // map points seen by a kept keyframe
+    int mnAtTarget; // map points seen by nTargetViews kept keyframes, or by all the keyframes that see them
+};
+
+} //namespace ORB_SLAM
+
+#endif // KEYFRAMESELECTOR_H
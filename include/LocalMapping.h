@@ -27,6 +27,7 @@
 #include "KeyFrameDatabase.h"
 #include "Settings.h"
 #include <opencv2/core.hpp>      // 用于基础数据结构 (如 cv::Mat)
+#ifdef WITH_ROS
 #include <geometry_msgs/PoseStamped.h>  // 用于发布相机位姿
 #include <sensor_msgs/PointCloud2.h>
 #include <pcl_ros/point_cloud.h>
@@ -34,6 +35,7 @@
 #include <pcl_conversions/pcl_conversions.h>
 #include <ros/ros.h>
 #include <cv_bridge/cv_bridge.h>
+#endif
 #include <opencv2/core/core.hpp>
 #include <mutex>
 
@@ -45,6 +47,7 @@ class System;
 class Tracking;
 class LoopClosing;
 class Atlas;
+class ImageExporter;
 
 class LocalMapping
 {
@@ -57,6 +60,12 @@ public:
 
     void SetTracker(Tracking* pTracker);
 
+    // Memory report and release of old keyframe grids, see MemoryUsage.h
+    void SetMemoryPolicy(const MemoryPolicy &policy);
+
+    // Told about every processed keyframe, to encode the export images of the mature ones
+    void SetImageExporter(ImageExporter* pImageExporter);
+
     // Main function
     void Run();
 
@@ -90,7 +99,9 @@ public:
     double GetCurrKFTime();
     KeyFrame* GetCurrKF();
 
+#ifdef WITH_ROS
     std::unordered_map<int, std::tuple<sensor_msgs::Image, geometry_msgs::PoseStamped, sensor_msgs::PointCloud2>> mKeyFrameData;//wanglian
+#endif
 
     std::mutex mMutexImuInit;
 
@@ -127,24 +138,6 @@ public:
     bool mbFarPoints;
     float mThFarPoints;
 
-#ifdef REGISTER_TIMES
-    vector<double> vdKFInsert_ms;
-    vector<double> vdMPCulling_ms;
-    vector<double> vdMPCreation_ms;
-    vector<double> vdLBA_ms;
-    vector<double> vdKFCulling_ms;
-    vector<double> vdLMTotal_ms;
-
-
-    vector<double> vdLBASync_ms;
-    vector<double> vdKFCullingSync_ms;
-    vector<int> vnLBA_edges;
-    vector<int> vnLBA_KFopt;
-    vector<int> vnLBA_KFfixed;
-    vector<int> vnLBA_MPs;
-    int nLBA_exec;
-    int nLBA_abort;
-#endif
 protected:
 
     bool CheckNewKeyFrames();
@@ -155,6 +148,8 @@ protected:
     void SearchInNeighbors();
     void KeyFrameCulling();
 
+    void ApplyMemoryPolicy();
+
     System *mpSystem;
 
     bool mbMonocular;
@@ -194,6 +189,15 @@ protected:
     bool mbAcceptKeyFrames;
     std::mutex mMutexAccept;
 
+    MemoryPolicy mMemoryPolicy;
+    std::mutex mMutexMemoryPolicy;
+    // Processed keyframes that may still have their grid, oldest first
+    std::list<KeyFrame*> mlpGridKeyFrames;
+    unsigned long mnMemoryPolicyKFs;
+    bool mbOverBudget;
+
+    ImageExporter* mpImageExporter;
+
     void InitializeIMU(float priorG = 1e2, float priorA = 1e6, bool bFirst = false);
     void ScaleRefinement();
 
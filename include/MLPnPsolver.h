@@ -51,12 +51,15 @@
 
 #include "MapPoint.h"
 #include "Frame.h"
+#include "Ransac.h"
 
 #include<Eigen/Dense>
 #include<Eigen/Sparse>
 
 namespace ORB_SLAM3{
     class MLPnPsolver {
+        template<class Solver> friend class Ransac;
+
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
@@ -67,6 +70,9 @@ namespace ORB_SLAM3{
         void SetRansacParameters(double probability = 0.99, int minInliers = 8, int maxIterations = 300, int minSet = 6, float epsilon = 0.4,
                                  float th2 = 5.991);
 
+        // Seed of the RANSAC samples, call before SetRansacParameters
+        void SetSeed(unsigned int seed);
+
         //Find metod is necessary?
 
         bool iterate(int nIterations, bool &bNoMore, vector<bool> &vbInliers, int &nInliers, Eigen::Matrix4f &Tout);
@@ -122,12 +128,19 @@ namespace ORB_SLAM3{
         /** A 3-vector describing a translation/camera position */
         typedef Eigen::Vector3d translation_t;
 
+        // Hypothesis evaluated by the RANSAC engine
+        typedef transformation_t Model;
+
 
 
     private:
         void CheckInliers();
         bool Refine();
 
+        // Minimal solver interface used by Ransac
+        bool ComputeModel(const std::vector<size_t> &vSample, Model &model);
+        bool IsInlier(const Model &model, const size_t idx);
+
         //Functions from de original MLPnP code
 
         /*
@@ -201,6 +214,9 @@ namespace ORB_SLAM3{
         // Index in Frame
         vector<size_t> mvKeyPointIndices;
 
+        // Descriptor distance between each keypoint and its map point (PROSAC ordering)
+        vector<float> mvDescDist;
+
         // Current Estimation
         double mRi[3][3];
         double mti[3];
@@ -222,9 +238,6 @@ namespace ORB_SLAM3{
         // Number of Correspondences
         int N;
 
-        // Indices for random selection [0 .. N-1]
-        vector<size_t> mvAllIndices;
-
         // RANSAC probability
         double mRansacProb;
 
@@ -246,6 +259,9 @@ namespace ORB_SLAM3{
         // Max square error associated with scale level. Max error = th*th*sigma(level)*sigma(level)
         vector<float> mvMaxError;
 
+        // Hypothesize-and-verify loop (PROSAC sampling, SPRT, adaptive iterations)
+        Ransac<MLPnPsolver> mRansac;
+
         GeometricCamera* mpCamera;
     };
 
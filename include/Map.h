@@ -88,6 +88,9 @@ public:
     long unsigned int MapPointsInMap();
     long unsigned  KeyFramesInMap();
 
+    // Adds the footprint of the keyframes and map points of this map to usage
+    void AddMemoryUsage(MemoryUsage &usage);
+
     long unsigned int GetId();
 
     long unsigned int GetInitKFid();
@@ -112,6 +115,10 @@ public:
     int GetLastMapChange();
     void SetLastMapChange(int currentChangeId);
 
+    // Index related to any change of the keyframes or their map points (new/culled KF, fusion, BA)
+    int GetLocalMapChangeIdx();
+    void InformLocalMapChange();
+
     void SetImuInitialized();
     bool isImuInitialized();
 
@@ -186,6 +193,9 @@ protected:
     // Index related to a big change in the map (loop closure, global BA)
     int mnBigChangeIdx;
 
+    // Index used by Tracking to know when its cached local map is outdated
+    int mnLocalMapChangeIdx;
+
 
     // View of the map in aerial sight (for the AtlasViewer)
     GLubyte* mThumbnail;
@@ -27,6 +27,7 @@
 #include<pangolin/pangolin.h>
 
 #include<mutex>
+#include<unordered_map>
 
 namespace ORB_SLAM3
 {
@@ -50,10 +51,26 @@ public:
     void SetReferenceKeyFrame(KeyFrame *pKF);
     void GetCurrentOpenGLCameraMatrix(pangolin::OpenGlMatrix &M, pangolin::OpenGlMatrix &MOw);
 
+    // Top view (x-z plane) of the active map rendered on the CPU, it does not need an OpenGL context
+    cv::Mat DrawMapImage(const int size);
+
 private:
 
     bool ParseViewerParamFile(cv::FileStorage &fSettings);
 
+    // Retained mode rendering. The map is kept in vertex buffers that are updated from the
+    // map change indices, so a redraw does not lock every MapPoint and KeyFrame.
+    void UpdateMapPointBuffers(Map* pMap);
+    void UpdateKeyFrameBuffers(Map* pActiveMap, const bool bDrawKF, const bool bDrawGraph, const bool bDrawInertialGraph, const bool bDrawOptLba);
+    void AddPointSlot(MapPoint* pMP);
+    void RemovePointSlot(const size_t slot);
+    void SetPointSlotPosition(const size_t slot, const Eigen::Vector3f &pos);
+    void SetPointSlotColor(const size_t slot, const bool bReference);
+    void AddFrustum(const Sophus::SE3f &Twc, vector<float> &vVertices);
+    void UploadPointSlots();
+    void UploadBuffer(pangolin::GlBuffer &buffer, const GLvoid* data, const size_t nElements, const GLenum datatype, const GLuint count, const size_t elementBytes);
+    void DrawBuffer(pangolin::GlBuffer &vbo, pangolin::GlBuffer *pCbo, const GLenum mode, const size_t nVertices);
+
     float mKeyFrameSize;
     float mKeyFrameLineWidth;
     float mGraphLineWidth;
@@ -65,6 +82,39 @@ private:
 
     std::mutex mMutexCamera;
 
+    // Map point layer: each point of the active map owns a slot of the vertex and color buffers
+    Map* mpPointsMap;
+    int mnPointsBigChangeIdx;
+    int mnPointsChangeIdx;
+    int mnPointsLocalChangeIdx;
+    long unsigned int mnPointsInMap;
+    std::vector<MapPoint*> mvpPointSlots;
+    std::unordered_map<MapPoint*,size_t> mmPointSlots;
+    std::vector<float> mvPointVertices;
+    std::vector<unsigned char> mvPointColors;
+    std::vector<MapPoint*> mvpRefPoints;
+    std::vector<size_t> mvDirtyPointSlots;
+    size_t mnPointRefreshCursor;
+    pangolin::GlBuffer mPointVbo;
+    pangolin::GlBuffer mPointCbo;
+
+    // KeyFrame layers, rebuilt when the keyframes or the drawing options change
+    Map* mpKFsMap;
+    int mnKFsBigChangeIdx;
+    int mnKFsChangeIdx;
+    int mnKFsLocalChangeIdx;
+    size_t mnKFsNumMaps;
+    int mnKFsOptions;
+    size_t mnKFVertices;
+    size_t mnOriginKFVertices;
+    size_t mnGraphVertices;
+    size_t mnInertialVertices;
+    pangolin::GlBuffer mKFVbo;
+    pangolin::GlBuffer mKFCbo;
+    pangolin::GlBuffer mOriginKFVbo;
+    pangolin::GlBuffer mGraphVbo;
+    pangolin::GlBuffer mInertialVbo;
+
     float mfFrameColors[6][3] = {{0.0f, 0.0f, 1.0f},
                                 {0.8f, 0.4f, 1.0f},
                                 {1.0f, 0.2f, 0.4f},
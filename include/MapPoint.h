@@ -26,6 +26,7 @@
 #include "Converter.h"
 
 #include "SerializationUtils.h"
+#include "MemoryUsage.h"
 
 #include <opencv2/core/core.hpp>
 #include <mutex>
@@ -145,6 +146,9 @@ public:
 
     cv::Mat GetDescriptor();
 
+    // Adds the heap footprint of this map point to usage
+    void AddMemoryUsage(MemoryUsage &usage);
+
     void UpdateNormalAndDepth();
 
     float GetMinDistanceInvariance();
@@ -0,0 +1,103 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace ORB_SLAM3
+{
+
+// Approximate heap footprint of the atlas and the images kept for export, in bytes per category.
+// Containers are counted by capacity, tree nodes with the usual red-black node overhead.
+struct MemoryUsage
+{
+    MemoryUsage();
+
+    size_t nKeyFrames;
+    size_t nMapPoints;
+    size_t nImages;
+
+    size_t keyFrameBase;        // KeyFrame objects, preintegration and map point matches
+    size_t keyFrameKeyPoints;   // mvKeys, mvKeysUn, mvKeysRight, mvuRight, mvDepth
+    size_t keyFrameDescriptors;
+    size_t keyFrameGrid;        // mGrid and mGridRight
+    size_t keyFrameBoW;         // mBowVec and mFeatVec
+    size_t keyFrameGraph;       // covisibility, spanning tree, loop and merge edges
+    size_t mapPointBase;
+    size_t mapPointDescriptors;
+    size_t mapPointObservations;
+    size_t images;              // BGR images kept by Tracking
+    size_t encodedImages;       // export images encoded ahead by the ImageExporter
+
+    size_t Total() const;
+    MemoryUsage& operator+=(const MemoryUsage &other);
+
+    // One line per category in MB
+    std::string ToString() const;
+
+    template<class T>
+    static size_t VectorBytes(const std::vector<T> &v)
+    {
+        return v.capacity()*sizeof(T);
+    }
+
+    template<class K, class V>
+    static size_t MapBytes(const std::map<K,V> &m)
+    {
+        return m.size()*(sizeof(std::pair<const K,V>)+nTreeNodeOverhead);
+    }
+
+    template<class K>
+    static size_t SetBytes(const std::set<K> &s)
+    {
+        return s.size()*(sizeof(K)+nTreeNodeOverhead);
+    }
+
+    static const size_t nTreeNodeOverhead = 32;
+};
+
+// What may be released to keep long sessions in a bounded footprint. Everything is off by default.
+struct MemoryPolicy
+{
+    MemoryPolicy();
+
+    // Print the usage every n keyframes (0 = never)
+    int nReportPeriod;
+
+    // Release the feature grids of keyframes that are more than n keyframes old (0 = never). They are
+    // rebuilt from the keypoints when an old keyframe is matched again, e.g. after a loop closure.
+    int nGridWindow;
+
+    // Above this many bytes the grids are released even without nGridWindow (0 = no budget)
+    size_t nBudgetBytes;
+
+    // Drop the image of every frame that does not become a keyframe
+    bool bKeyFrameImagesOnly;
+};
+
+} //namespace ORB_SLAM
+
+#endif // MEMORYUSAGE_H
@@ -0,0 +1,66 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace ORB_SLAM3
+{
+
+// Number of threads of the export helpers: nThreads, or all the hardware threads when <= 0
+inline int ResolveThreads(const int nThreads)
+{
+    return nThreads > 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls f(begin, end) on chunks of grain items from nThreads threads (see ResolveThreads), the caller included
+inline void ParallelFor(const size_t n, const size_t grain, const int nThreads, const std::function<void(size_t, size_t)> &f)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for(size_t begin = next.fetch_add(grain); begin < n; begin = next.fetch_add(grain))
+            f(begin, std::min(n, begin + grain));
+    };
+
+    std::vector<std::thread> vThreads;
+    const size_t nChunks = (n + grain - 1) / grain;
+    for(size_t i = 1; i < std::min<size_t>(ResolveThreads(nThreads), nChunks); i++)
+        vThreads.emplace_back(worker);
+    worker();
+    for(std::thread &th : vThreads)
+        th.join();
+}
+
+// Calls f(i) for i in [0, n), one item at a time
+inline void ParallelFor(const size_t n, const int nThreads, const std::function<void(size_t)> &f)
+{
+    ParallelFor(n, 1, nThreads, [&f](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++)
+            f(i);
+    });
+}
+
+} //namespace ORB_SLAM
+
+#endif // PARALLELFOR_H
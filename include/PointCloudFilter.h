@@ -0,0 +1,68 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POINTCLOUDFILTER_H
+#define POINTCLOUDFILTER_H
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace ORB_SLAM3
+{
+
+// Clean-up of the exported point cloud before 3DGS training, the stages of scripts/point_cloud in the
+// exporter: points seen by too few keyframes are dropped, then the statistical outliers (mean distance to
+// the k nearest neighbours beyond mean + ratio * std over the cloud, as remove_statistical_outlier of
+// Open3D), and the remaining points are averaged per voxel, colors included. Each stage is off when its
+// parameter is 0.
+class PointCloudFilter
+{
+public:
+    struct Point
+    {
+        Eigen::Vector3f pos;
+        Eigen::Vector3f color; // RGB in [0, 255]
+        int nObs;
+    };
+
+    struct Options
+    {
+        Options(): nMinObservations(0), nOutlierNeighbours(0), outlierStdRatio(2.f), voxelSize(0.f) {}
+
+        bool Enabled() const { return nMinObservations > 0 || nOutlierNeighbours > 0 || voxelSize > 0.f; }
+
+        int nMinObservations;
+        int nOutlierNeighbours;
+        float outlierStdRatio;
+        float voxelSize;
+    };
+
+    // Runs the enabled stages in order and prints the number of points left by each
+    static void Apply(const Options &options, std::vector<Point> &vPoints, const int nThreads = 0);
+
+    static void FilterObservations(std::vector<Point> &vPoints, const int nMinObservations);
+    static void RemoveStatisticalOutliers(std::vector<Point> &vPoints, const int k, const float stdRatio,
+                                          const int nThreads = 0);
+    // The points of a voxel are replaced by their mean, in the order of the first point of each voxel
+    static void VoxelDownsample(std::vector<Point> &vPoints, const float voxelSize);
+};
+
+} //namespace ORB_SLAM
+
+#endif // POINTCLOUDFILTER_H
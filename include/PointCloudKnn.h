@@ -0,0 +1,67 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POINTCLOUDKNN_H
+#define POINTCLOUDKNN_H
+
+#include <vector>
+#include <string>
+
+#include <Eigen/Core>
+
+namespace ORB_SLAM3
+{
+
+// Nearest neighbour distances of a point cloud, the CPU counterpart of SimpleKNN::knn (simple-knn) used
+// to initialize the Gaussian scales. As there the points are sorted along a Morton curve and cut into
+// boxes of BOX_SIZE consecutive points, and a point only visits the boxes closer than its current K-th
+// neighbour, which gives the exact nearest neighbours. Instead of testing every box, the boxes are merged
+// pairwise into a hierarchy that is walked from the top, nearer half first.
+class PointCloudKnn
+{
+public:
+    static const int K = 3;
+    static const int MAX_K = 64;
+    static const int BOX_SIZE = 32;
+
+    // Mean squared distance of each point to its K nearest neighbours, like distCUDA2.
+    // nThreads <= 0 uses all the hardware threads.
+    static void MeanSquaredDistances(const std::vector<Eigen::Vector3f> &vPoints, std::vector<float> &vMeanDist2,
+                                     const int nThreads = 0);
+
+    // Mean distance of each point to its k nearest neighbours (k <= MAX_K), for the statistical outlier removal.
+    // Points with fewer than k neighbours get FLT_MAX.
+    static void MeanDistances(const std::vector<Eigen::Vector3f> &vPoints, const int k, std::vector<float> &vMeanDist,
+                              const int nThreads = 0);
+
+    // Indices of the k nearest neighbours of each point (k <= MAX_K), nearest first: k entries per point, -1 past
+    // the last neighbour when there are fewer than k.
+    static void Neighbours(const std::vector<Eigen::Vector3f> &vPoints, const int k, std::vector<int> &vNeighbours,
+                           const int nThreads = 0);
+
+    // Initial Gaussian scales as the trainer computes them from distCUDA2: sqrt(max(dist2, 1e-7))
+    static void InitialScales(const std::vector<Eigen::Vector3f> &vPoints, std::vector<float> &vScales,
+                              const int nThreads = 0);
+
+    // One scale per line, in the order of the points of the points3D.txt written next to it
+    static bool SaveScales(const std::string &filename, const std::vector<float> &vScales);
+};
+
+} //namespace ORB_SLAM
+
+#endif // POINTCLOUDKNN_H
@@ -0,0 +1,76 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POSEREFINER_H
+#define POSEREFINER_H
+
+#include <vector>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+#include "sophus/se3.hpp"
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Photometric refinement of the keyframe poses for the export, after bundle adjustment. Each keyframe is aligned
+// to its nNeighbours best covisible keyframes, which keep their BA poses, by inverse compositional Lucas-Kanade:
+// 4x4 patches around the map points the keyframe sees are back-projected at the depth of their map point, and
+// the keyframe pose is updated so that the patches warped into the neighbours match their intensities. The
+// Jacobians are those of the keyframe image, computed once per pyramid level. The alignment runs from the
+// coarsest of nLevels pyramid levels down to nFinestLevel, with Huber weights and a brightness offset per
+// neighbour.
+//
+// A refined pose is kept only when it lowers the photometric error at the finest level and moves less than
+// maxTranslationRatio of the median depth of the keyframe and maxRotationDeg; otherwise the BA pose stays.
+// Keyframes run on nThreads threads, the result does not depend on their number. The map is not modified.
+class PoseRefiner
+{
+public:
+    struct Options
+    {
+        Options(): nNeighbours(3), nLevels(4), nFinestLevel(0), nIterations(10), huberDelta(20.f),
+                   maxTranslationRatio(0.05f), maxRotationDeg(2.f) {}
+
+        int nNeighbours;
+        int nLevels;
+        int nFinestLevel;
+        // Gauss-Newton iterations per level
+        int nIterations;
+        // Intensity residual, in 0-255 gray levels, over which the weights decrease
+        float huberDelta;
+        float maxTranslationRatio;
+        float maxRotationDeg;
+    };
+
+    // getImage returns the image of a keyframe, empty when it is not kept
+    PoseRefiner(const Options &options, const std::function<cv::Mat(KeyFrame*)> &getImage);
+
+    // Tcw of each keyframe, refined or the BA pose
+    std::vector<Sophus::SE3f> Refine(const std::vector<KeyFrame*> &vpKFs, const int nThreads = 0);
+
+private:
+    Options mOptions;
+    std::function<cv::Mat(KeyFrame*)> mGetImage;
+};
+
+} //namespace ORB_SLAM
+
+#endif // POSEREFINER_H
@@ -0,0 +1,46 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PYRAMIDCAMERA_H
+#define PYRAMIDCAMERA_H
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Pinhole calibration of a keyframe at a level of its image pyramid, each level halved by cv::pyrDown, for
+// the photometric steps of the export (dense stereo, pose refinement)
+struct PyramidCamera
+{
+    PyramidCamera(KeyFrame* pKF, const int level);
+
+    // Keyframes these steps handle: not bad and with a pinhole camera
+    static bool IsSupported(KeyFrame* pKF);
+
+    // 3x3 CV_64F camera matrix
+    cv::Mat K() const;
+
+    float fx, fy, cx, cy;
+};
+
+} //namespace ORB_SLAM
+
+#endif // PYRAMIDCAMERA_H
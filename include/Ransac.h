@@ -0,0 +1,421 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RANSAC_H
+#define RANSAC_H
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <random>
+
+#include <Eigen/Core>
+
+
+namespace ORB_SLAM3
+{
+
+// Number of RANSAC iterations needed to draw an all-inlier minimal set with the given probability
+inline int RansacIterations(const double probability, const double inlierRatio, const int minSet, const int maxIterations)
+{
+    if(inlierRatio>=1.0)
+        return 1;
+    if(inlierRatio<=0.0)
+        return maxIterations;
+
+    const double pGood = std::pow(inlierRatio,minSet);
+    if(pGood<=std::numeric_limits<double>::epsilon())
+        return maxIterations;
+
+    const double nIterations = std::ceil(std::log(1.0-probability)/std::log(1.0-pGood));
+    if(nIterations>=maxIterations)
+        return maxIterations;
+
+    return std::max(1,static_cast<int>(nIterations));
+}
+
+// Hypothesize-and-verify loop shared by the minimal solvers (MLPnPsolver, Sim3Solver).
+// - PROSAC: if a quality per correspondence is given, samples are drawn from the best ones first.
+//   Chum and Matas, Matching with PROSAC - Progressive Sample Consensus, CVPR 2005.
+// - SPRT: hypotheses are verified in random order and discarded as soon as they are likely to be bad.
+//   Matas and Chum, Randomized RANSAC with Sequential Probability Ratio Test, ICCV 2005.
+// - Adaptive number of iterations from the inlier ratio of the best hypothesis.
+//
+// Samples are drawn from a generator owned by the instance, so that concurrent instances neither share
+// state nor depend on each other's interleaving. The same seed gives the same hypotheses.
+//
+// The minimal solver is plugged in as template argument and must provide:
+//   typedef ... Model;
+//   bool ComputeModel(const std::vector<size_t> &vSample, Model &model);   // false if the sample is degenerate
+//   bool IsInlier(const Model &model, const size_t idx);
+template<class Solver>
+class Ransac
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef typename Solver::Model Model;
+
+    Ransac(Solver* pSolver);
+
+    // N correspondences, minimal sets of minSet elements
+    void SetRansacParameters(int nData, int minSet, double probability, int minInliers, int maxIterations);
+
+    // Quality of each correspondence, lower is better (e.g. descriptor distance). Enables PROSAC sampling
+    void SetQuality(const std::vector<float> &vQuality);
+
+    // Restarts the sample generator; call before SetRansacParameters to also fix the verification order
+    void SetSeed(unsigned int seed) { mRng.seed(seed); }
+
+    // tM is the cost of computing a model measured in single correspondence verifications
+    void SetSPRT(bool bUseSPRT, double tM = 100.0, double delta = 0.05);
+
+    // Evaluate at most nIterations hypotheses (the counter is decreased with the evaluated ones).
+    // Returns true as soon as a hypothesis with at least nMinInliers inliers becomes the best one.
+    // bNoMore is set when the total (adaptive) number of iterations is reached.
+    bool Iterate(int &nIterations, const int nMinInliers, bool &bNoMore);
+
+    const Model &GetBestModel() const { return mBestModel; }
+    const std::vector<bool> &GetBestInliers() const { return mvbBestInliers; }
+    int GetBestNumInliers() const { return mnBestInliers; }
+    int GetNumIterations() const { return mnIterations; }
+    int GetMaxIterations() const { return mRansacMaxIts; }
+
+protected:
+
+    void DrawSample(std::vector<size_t> &vSample);
+    void DrawFromFirst(const int n, const int m, std::vector<size_t> &vSample);
+
+    // Uniform integer in [min, max]
+    int RandomInt(const int min, const int max);
+
+    // Returns false if the SPRT rejected the hypothesis before checking all correspondences
+    bool Verify(const Model &model, std::vector<bool> &vbInliers, int &nInliers);
+
+    void ComputeSPRTThreshold();
+
+protected:
+
+    Solver* mpSolver;
+
+    std::mt19937 mRng;
+
+    int N;
+    int mnMinSet;
+
+    double mRansacProb;
+    int mRansacMinInliers;
+    int mRansacMaxIts;
+    int mnIterations;
+
+    // PROSAC state. Correspondences sorted by quality, current size of the sampling set and growth function
+    bool mbProsac;
+    std::vector<size_t> mvSortedIndices;
+    int mnProsacN;
+    double mProsacTn;
+    double mProsacTnPrime;
+
+    // SPRT state. epsilon: inlier ratio of good models, delta: inlier ratio of bad models, A: decision threshold
+    bool mbSPRT;
+    double mSPRTtM;
+    double mSPRTEpsilon;
+    double mSPRTDelta;
+    double mSPRTA;
+    double mSPRTDeltaSum;
+    int mnSPRTRejected;
+    std::vector<size_t> mvVerificationOrder;
+
+    // Best hypothesis
+    Model mBestModel;
+    std::vector<bool> mvbBestInliers;
+    int mnBestInliers;
+
+    // Scratch buffers
+    std::vector<size_t> mvSample;
+    std::vector<bool> mvbCurrentInliers;
+};
+
+
+template<class Solver>
+Ransac<Solver>::Ransac(Solver* pSolver):
+    mpSolver(pSolver), mRng(0), N(0), mnMinSet(0), mRansacProb(0.99), mRansacMinInliers(0), mRansacMaxIts(0), mnIterations(0),
+    mbProsac(false), mnProsacN(0), mProsacTn(0.0), mProsacTnPrime(0.0),
+    mbSPRT(false), mSPRTtM(100.0), mSPRTEpsilon(0.5), mSPRTDelta(0.05), mSPRTA(std::numeric_limits<double>::max()),
+    mSPRTDeltaSum(0.0), mnSPRTRejected(0), mnBestInliers(0)
+{
+}
+
+template<class Solver>
+void Ransac<Solver>::SetRansacParameters(int nData, int minSet, double probability, int minInliers, int maxIterations)
+{
+    N = nData;
+    mnMinSet = minSet;
+    mRansacProb = probability;
+    mRansacMinInliers = minInliers;
+    mRansacMaxIts = std::max(1,maxIterations);
+    mnIterations = 0;
+
+    mvbCurrentInliers = std::vector<bool>(N,false);
+    mvbBestInliers = std::vector<bool>(N,false);
+    mnBestInliers = 0;
+    mvSample.resize(mnMinSet);
+
+    // Uniform sampling until a quality is given
+    mbProsac = false;
+    mvSortedIndices.resize(N);
+    for(int i=0; i<N; i++)
+        mvSortedIndices[i] = i;
+
+    // Random verification order, required by the SPRT
+    mvVerificationOrder = mvSortedIndices;
+    for(int i=N-1; i>0; i--)
+    {
+        const int j = RandomInt(0,i);
+        std::swap(mvVerificationOrder[i],mvVerificationOrder[j]);
+    }
+
+    mSPRTEpsilon = N>0 ? std::max(0.01,std::min(0.99,static_cast<double>(mRansacMinInliers)/N)) : 0.5;
+    mSPRTDeltaSum = 0.0;
+    mnSPRTRejected = 0;
+    ComputeSPRTThreshold();
+}
+
+template<class Solver>
+void Ransac<Solver>::SetQuality(const std::vector<float> &vQuality)
+{
+    if(static_cast<int>(vQuality.size())!=N || N<mnMinSet || mnMinSet<=0)
+        return;
+
+    for(int i=0; i<N; i++)
+        mvSortedIndices[i] = i;
+    std::stable_sort(mvSortedIndices.begin(),mvSortedIndices.end(),[&vQuality](const size_t a, const size_t b){
+        return vQuality[a]<vQuality[b];
+    });
+
+    // The growth function reaches the whole set at the end of the iteration budget,
+    // so PROSAC ends up behaving as RANSAC if the best correspondences are not enough
+    mnProsacN = mnMinSet;
+    mProsacTn = mRansacMaxIts;
+    for(int i=0; i<mnMinSet; i++)
+        mProsacTn *= static_cast<double>(mnMinSet-i)/(N-i);
+    mProsacTnPrime = 1.0;
+    mbProsac = true;
+}
+
+template<class Solver>
+void Ransac<Solver>::SetSPRT(bool bUseSPRT, double tM, double delta)
+{
+    mbSPRT = bUseSPRT;
+    mSPRTtM = tM;
+    mSPRTDelta = delta;
+    ComputeSPRTThreshold();
+}
+
+template<class Solver>
+void Ransac<Solver>::ComputeSPRTThreshold()
+{
+    const double eps = mSPRTEpsilon;
+    const double delta = mSPRTDelta;
+
+    // The test is useless if bad models are expected to have as many inliers as good ones
+    if(delta<=0.0 || delta>=eps)
+    {
+        mSPRTA = std::numeric_limits<double>::max();
+        return;
+    }
+
+    // A = K + 1 + log(A), with K = tM * C (one model per sample)
+    const double C = (1.0-delta)*std::log((1.0-delta)/(1.0-eps)) + delta*std::log(delta/eps);
+    const double K = mSPRTtM*C;
+    double A = K + 1.0;
+    for(int i=0; i<10; i++)
+        A = K + 1.0 + std::log(A);
+
+    mSPRTA = A;
+}
+
+template<class Solver>
+int Ransac<Solver>::RandomInt(const int min, const int max)
+{
+    return std::uniform_int_distribution<int>(min,max)(mRng);
+}
+
+template<class Solver>
+void Ransac<Solver>::DrawFromFirst(const int n, const int m, std::vector<size_t> &vSample)
+{
+    // Rejection sampling, the minimal sets are small
+    for(int i=0; i<m; i++)
+    {
+        bool bRepeated = true;
+        size_t idx = 0;
+        while(bRepeated)
+        {
+            idx = mvSortedIndices[RandomInt(0,n-1)];
+            bRepeated = false;
+            for(int j=0; j<i; j++)
+            {
+                if(vSample[j]==idx)
+                {
+                    bRepeated = true;
+                    break;
+                }
+            }
+        }
+        vSample[i] = idx;
+    }
+}
+
+template<class Solver>
+void Ransac<Solver>::DrawSample(std::vector<size_t> &vSample)
+{
+    if(!mbProsac)
+    {
+        DrawFromFirst(N,mnMinSet,vSample);
+        return;
+    }
+
+    const double t = mnIterations;
+
+    if(t>mProsacTnPrime && mnProsacN<N)
+    {
+        const double Tn1 = mProsacTn*(mnProsacN+1)/(mnProsacN+1-mnMinSet);
+        mProsacTnPrime += std::ceil(Tn1-mProsacTn);
+        mProsacTn = Tn1;
+        mnProsacN++;
+    }
+
+    if(mProsacTnPrime<t)
+    {
+        DrawFromFirst(mnProsacN,mnMinSet,vSample);
+    }
+    else
+    {
+        // The newest correspondence of the sampling set is always included
+        DrawFromFirst(mnProsacN-1,mnMinSet-1,vSample);
+        vSample[mnMinSet-1] = mvSortedIndices[mnProsacN-1];
+    }
+}
+
+template<class Solver>
+bool Ransac<Solver>::Verify(const Model &model, std::vector<bool> &vbInliers, int &nInliers)
+{
+    nInliers = 0;
+
+    const bool bTest = mbSPRT && mSPRTA<std::numeric_limits<double>::max();
+    const double fIn = mSPRTDelta/mSPRTEpsilon;
+    const double fOut = (1.0-mSPRTDelta)/(1.0-mSPRTEpsilon);
+    double lambda = 1.0;
+
+    for(int j=0; j<N; j++)
+    {
+        const size_t idx = mvVerificationOrder[j];
+        const bool bIn = mpSolver->IsInlier(model,idx);
+        vbInliers[idx] = bIn;
+
+        if(bIn)
+            nInliers++;
+
+        if(bTest)
+        {
+            lambda *= bIn ? fIn : fOut;
+            if(lambda>mSPRTA)
+            {
+                // Bad model. Update the estimation of the inlier ratio of bad models
+                mSPRTDeltaSum += static_cast<double>(nInliers)/(j+1);
+                mnSPRTRejected++;
+                const double delta = mSPRTDeltaSum/mnSPRTRejected;
+                if(std::fabs(delta-mSPRTDelta)>0.1*mSPRTDelta)
+                {
+                    mSPRTDelta = std::max(0.001,delta);
+                    ComputeSPRTThreshold();
+                }
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template<class Solver>
+bool Ransac<Solver>::Iterate(int &nIterations, const int nMinInliers, bool &bNoMore)
+{
+    bNoMore = false;
+
+    if(N<mnMinSet || N<mRansacMinInliers)
+    {
+        bNoMore = true;
+        return false;
+    }
+
+    Model model;
+    int nInliers;
+
+    while(mnIterations<mRansacMaxIts && nIterations>0)
+    {
+        nIterations--;
+        mnIterations++;
+
+        DrawSample(mvSample);
+
+        if(!mpSolver->ComputeModel(mvSample,model))
+            continue;
+
+        if(!Verify(model,mvbCurrentInliers,nInliers))
+            continue;
+
+        if(nInliers<=mnBestInliers)
+            continue;
+
+        mBestModel = model;
+        mvbBestInliers.swap(mvbCurrentInliers);
+        mnBestInliers = nInliers;
+
+        // The best hypothesis bounds the inlier ratio of good models
+        const double eps = static_cast<double>(mnBestInliers)/N;
+        if(eps>mSPRTEpsilon)
+        {
+            mSPRTEpsilon = std::min(0.99,eps);
+            ComputeSPRTThreshold();
+        }
+
+        // Good samples are also rejected by the SPRT with probability 1/A
+        double inlierRatio = eps;
+        if(mbSPRT && mSPRTA<std::numeric_limits<double>::max())
+            inlierRatio *= std::pow(1.0-1.0/mSPRTA,1.0/mnMinSet);
+        mRansacMaxIts = std::min(mRansacMaxIts,std::max(mnIterations,RansacIterations(mRansacProb,inlierRatio,mnMinSet,mRansacMaxIts)));
+
+        if(mnBestInliers>=nMinInliers)
+        {
+            if(mnIterations>=mRansacMaxIts)
+                bNoMore = true;
+            return true;
+        }
+    }
+
+    if(mnIterations>=mRansacMaxIts)
+        bNoMore = true;
+
+    return false;
+}
+
+} //namespace ORB_SLAM3
+
+#endif // RANSAC_H
@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "KeyFrame.h"
+#include "Ransac.h"
 
 
 
@@ -32,8 +33,21 @@ namespace ORB_SLAM3
 
 class Sim3Solver
 {
+    template<class Solver> friend class Ransac;
+
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    // Hypothesis evaluated by the RANSAC engine
+    struct Model
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        Eigen::Matrix3f R12;
+        Eigen::Vector3f t12;
+        float s12;
+        Eigen::Matrix4f T12;
+        Eigen::Matrix4f T21;
+    };
     Sim3Solver(KeyFrame* pKF1, KeyFrame* pKF2, const std::vector<MapPoint*> &vpMatched12, const bool bFixScale = true,
                const vector<KeyFrame*> vpKeyFrameMatchedMP = vector<KeyFrame*>());
 
@@ -55,7 +69,9 @@ protected:
 
     void ComputeSim3(Eigen::Matrix3f &P1, Eigen::Matrix3f &P2);
 
-    void CheckInliers();
+    // Minimal solver interface used by Ransac
+    bool ComputeModel(const std::vector<size_t> &vSample, Model &model);
+    bool IsInlier(const Model &model, const size_t idx);
 
     void Project(const std::vector<Eigen::Vector3f> &vP3Dw, std::vector<Eigen::Vector2f> &vP2D, Eigen::Matrix4f Tcw, GeometricCamera* pCamera);
     void FromCameraToImage(const std::vector<Eigen::Vector3f> &vP3Dc, std::vector<Eigen::Vector2f> &vP2D, GeometricCamera* pCamera);
@@ -87,8 +103,6 @@ protected:
     float ms12i;
     Eigen::Matrix4f mT12i;
     Eigen::Matrix4f mT21i;
-    std::vector<bool> mvbInliersi;
-    int mnInliersi;
 
     // Current Ransac State
     int mnIterations;
@@ -102,8 +116,11 @@ protected:
     // Scale is fixed to 1 in the stereo/RGBD case
     bool mbFixScale;
 
-    // Indices for random selection
-    std::vector<size_t> mvAllIndices;
+    // Descriptor distance between the matched map points (PROSAC ordering)
+    std::vector<float> mvDescDist;
+
+    // Hypothesize-and-verify loop (PROSAC sampling, SPRT, adaptive iterations)
+    Ransac<Sim3Solver> mRansac;
 
     // Projections
     std::vector<Eigen::Vector2f> mvP1im1;
@@ -31,6 +31,7 @@
 #include <unordered_map>
 #include <Map.h>
 #include <map>
+#include <memory>
 
 #include "Tracking.h"
 #include "FrameDrawer.h"
@@ -43,6 +44,14 @@
 #include "Viewer.h"
 #include "ImuTypes.h"
 #include "Settings.h"
+#include "MemoryUsage.h"
+#include "ImageUndistorter.h"
+#include "PointCloudFilter.h"
+#include "KeyFrameSelector.h"
+#include "DepthDensifier.h"
+#include "PoseRefiner.h"
+#include "GaussianPlyWriter.h"
+#include "ImageExporter.h"
 
 
 namespace ORB_SLAM3
@@ -117,6 +126,12 @@ public:
     ORB_SLAM3::Atlas* GetAtlas() {
             return mpAtlas;
         }
+    ORBVocabulary* GetVocabulary() {
+            return mpVocabulary;
+        }
+    KeyFrameDatabase* GetKeyFrameDatabase() {
+            return mpKeyFrameDatabase;
+        }
     // Proccess the given stereo frame. Images must be synchronized and rectified.
     // Input images: RGB (CV_8UC3) or grayscale (CV_8U). RGB is converted to grayscale.
     // Returns the camera pose (empty if tracking fails).
@@ -164,6 +179,10 @@ public:
     // Call first Shutdown()
     // See format details at: http://vision.in.tum.de/data/datasets/rgbd-dataset
     void SaveKeyFrameTrajectoryTUM(const string &filename);
+
+    // Timestamps and camera centers of the keyframes of the active map, in creation order.
+    // Call first Shutdown()
+    void GetKeyFrameTrajectory(vector<double> &vTimestamps, vector<Eigen::Vector3f> &vTwc);
     
     // Define Point3dIDMap type for convenience
     // std::vector<cv::Mat> mImages; //wanglian
@@ -175,7 +194,50 @@ public:
     void GeneratePointIDMap();// wanglian
     void SaveKeyPointsAndMapPoints(const string &filename);// wanglian
     void SavePointcloud(const string &filename);// wanglian
+    // Also writes the initial Gaussian scale of every point next to it (points3D.txt -> points3D_scales.txt).
+    // With a point cloud filter set, each map point is written once, with its color averaged over the
+    // keyframes, after the filter.
     void SavePointcloudFromKeyframes(const std::string &filename, const std::string &filename2);// wanglian
+    // COLMAP PINHOLE camera of the exported keyframe images
+    bool SaveCameraCOLMAP(const std::string &filename);
+
+    // Undistort the exported keyframe images (pinhole cameras only) and optionally crop them to the valid
+    // pixels, so they match the PINHOLE camera and the undistorted keypoints of the COLMAP workspace.
+    // Also set with System.ExportUndistort and System.ExportCropToValid in the settings.
+    void SetExportUndistortion(const bool bUndistort, const bool bCropToValid);
+
+    // Format and worker pool of the exported images, see ImageExporter. Also set with System.ExportImageFormat
+    // (png, jpg or webp), System.ExportPngLevel, System.ExportJpegQuality, System.ExportImageThreads,
+    // System.ExportImageQueue and System.ExportEncodeAfterKeyFrames in the settings.
+    void SetExportImageOptions(const ImageExporter::Options &options);
+
+    // Clean-up of the exported point cloud, see PointCloudFilter. Also set with System.ExportMinObservations,
+    // System.ExportOutlierNeighbours, System.ExportOutlierStdRatio and System.ExportVoxelSize in the settings.
+    void SetExportPointCloudFilter(const PointCloudFilter::Options &options);
+
+    // Export only the keyframes chosen by KeyFrameSelector instead of all of them, and write the decision of
+    // each keyframe to view_selection.txt next to images.txt. Also enabled with System.ExportViewSelection: 1,
+    // with System.ExportViewTargetViews, System.ExportViewMinParallax (degrees), System.ExportViewMinNewPoints
+    // and System.ExportViewMinBlurRatio in the settings.
+    void SetExportViewSelection(const bool bSelect, const KeyFrameSelector::Options &options = KeyFrameSelector::Options());
+
+    // Add the dense points of DepthDensifier, from stereo between covisible keyframes, to points3D.txt. Also
+    // enabled with System.ExportDensify: 1, with System.ExportDensifyNeighbours, System.ExportDensifyLevel,
+    // System.ExportDensifyStep, System.ExportDensifyMinSupport, System.ExportDensifyMaxPoints and
+    // System.ExportDensifyVoxelSize in the settings.
+    void SetExportDensification(const bool bDensify, const DepthDensifier::Options &options = DepthDensifier::Options());
+
+    // Write the keyframe poses refined by PoseRefiner, by photometric alignment to the covisible keyframes, to
+    // images.txt instead of the BA poses. The map keeps the BA poses. Also enabled with System.ExportRefinePoses: 1,
+    // with System.ExportRefineNeighbours, System.ExportRefineLevels and System.ExportRefineIterations in the settings.
+    void SetExportPoseRefinement(const bool bRefine, const PoseRefiner::Options &options = PoseRefiner::Options());
+
+    // Also write the exported points as the binary PLY of the initial Gaussians, next to points3D.txt with the .ply
+    // extension, see GaussianPlyWriter. Also enabled with System.ExportPly: 1, with System.ExportPlyScales (0/1),
+    // System.ExportPlyRotations (0/1), System.ExportPlyOpacity (0 for none, else the opacity) and
+    // System.ExportPlyPcaNeighbours in the settings.
+    void SetExportGaussianPly(const bool bPly, const GaussianPlyWriter::Options &options = GaussianPlyWriter::Options());
+
     float CalculateReprojectionErrorForMapPoint(MapPoint* pMP);// wanglian
     void SavePointIDMapToFile(const std::string& filename);//wanglian
 
@@ -213,6 +275,13 @@ public:
 
     float GetImageScale();
 
+    // Snapshot of the last processed frame (with the tracked features) and a top view of the map.
+    // It works without viewer: the state is copied with the next frame processed after RequestSnapshot,
+    // which returns false if the previous snapshot is more recent than minPeriod seconds.
+    // GetSnapshot returns false until the requested snapshot is available.
+    bool RequestSnapshot(const double minPeriod = 1.0);
+    bool GetSnapshot(cv::Mat &imFrame, cv::Mat &imMap, const int mapSize = 640);
+
     // Local Mapper. It manages the local map and performs local bundle adjustment.
     LocalMapping* mpLocalMapper;
     // Tracker. It receives a frame and computes the associated camera pose.
@@ -220,11 +289,29 @@ public:
     // performs relocalization if tracking fails.
     Tracking* mpTracker;
     LoopClosing* mpLoopCloser;
-#ifdef REGISTER_TIMES
+
+    // Per-stage latency histograms of the tracking, mapping and loop closing threads (see Instrumentation.h).
+    // Also enabled with System.Instrumentation: 1 in the settings. If strExportFile is given, the count,
+    // mean, p50, p99 and max of every stage are appended to it each period seconds. The summary printed at
+    // Shutdown is then also written to LatencyStats.txt in the folder of strExportFile.
+    void EnableInstrumentation(const bool bEnable, const string &strExportFile = string(), const double period = 1.0);
+
+    // Timeline of the tracking, mapping, loop closing, global BA and viewer threads with their stages and
+    // lock waits. Also enabled with System.Tracing: 1 (and System.TraceFile) in the settings. The last
+    // events of every thread are written to strTraceFile at Shutdown, or at any time with SaveTrace.
+    // The JSON opens in chrome://tracing and ui.perfetto.dev.
+    void EnableTracing(const bool bEnable, const string &strTraceFile = "Trace.json");
+    bool SaveTrace(const string &filename);
+
+    // Approximate footprint of the atlas and the kept images, per category
+    MemoryUsage GetMemoryUsage();
+    // Periodic report and release of non-essential data, also set with System.MemoryReportKeyFrames,
+    // System.KeyFrameGridWindow, System.MemoryBudgetMB and System.KeyFrameImagesOnly in the settings
+    void SetMemoryPolicy(const MemoryPolicy &policy);
+
+    // Preprocessing done by the caller before TrackStereo/TrackMonocular/TrackRGBD
     void InsertRectTime(double& time);
     void InsertResizeTime(double& time);
-    void InsertTrackTime(double& time);
-#endif
 
 private:
 
@@ -289,6 +376,33 @@ private:
     string mStrLoadAtlasFromFile;
     string mStrSaveAtlasToFile;
 
+    string mStrTraceFile;
+    string mStrLatencySummaryFile;
+
+    // Undistortion of the exported images, built with the first export. Shared so that the image exporter
+    // workers keep using theirs while SetExportUndistortion replaces it.
+    std::shared_ptr<ImageUndistorter> GetExportUndistorter();
+    std::mutex mMutexExport;
+    bool mbExportUndistort;
+    bool mbExportCropToValid;
+    std::shared_ptr<ImageUndistorter> mpExportUndistorter;
+    PointCloudFilter::Options mExportFilterOptions;
+
+    // Keyframes of vpKFs kept by the view selection, which runs once on all the keyframes of the atlas
+    std::vector<KeyFrame*> GetExportKeyFrames(const std::vector<KeyFrame*> &vpKFs);
+    bool mbExportViewSelection;
+    KeyFrameSelector::Options mExportViewOptions;
+    KeyFrameSelector* mpExportSelector;
+    std::vector<KeyFrame*> mvpExportSelectionInput;
+    std::set<KeyFrame*> mspExportKeyFrames;
+    bool mbExportDensify;
+    DepthDensifier::Options mExportDensifyOptions;
+    bool mbExportRefinePoses;
+    PoseRefiner::Options mExportRefineOptions;
+    bool mbExportPly;
+    GaussianPlyWriter::Options mExportPlyOptions;
+    ImageExporter* mpImageExporter;
+
     string mStrVocabularyFilePath;
 
     Settings* settings_;
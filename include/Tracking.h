@@ -35,11 +35,16 @@
 #include "MapDrawer.h"
 #include "System.h"
 #include "ImuTypes.h"
+#include "ImuRingBuffer.h"
 #include "Settings.h"
 
 #include "GeometricCamera.h"
 
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <functional>
 #include <unordered_set>
 
 namespace ORB_SLAM3
@@ -97,6 +102,14 @@ public:
     void CreateMapInAtlas();
     //std::mutex mMutexTracks;
 
+    // BGR image of a frame kept for the map export (empty if none)
+    cv::Mat GetFrameImage(const long unsigned int frameId);
+    void EraseFrameImage(const long unsigned int frameId);
+
+    // Adds the footprint of the kept images to usage
+    void AddMemoryUsage(MemoryUsage &usage);
+    void SetMemoryPolicy(const MemoryPolicy &policy);
+
     //--
     void NewDataset();
     int GetNumberDataset();
@@ -108,6 +121,9 @@ public:
 
     float GetImageScale();
 
+    // Number of relocalization candidates processed concurrently (1 processes them serially)
+    void SetRelocalizationThreads(const int nThreads);
+
 #ifdef REGISTER_LOOP
     void RequestStop();
     bool isStopped();
@@ -139,6 +155,11 @@ public:
     Frame mLastFrame;
     
     std::unordered_map<int, cv::Mat> mnIdToBGRMap;//wanglian mnid->rgb
+    std::mutex mMutexBGRMap;
+    std::atomic<bool> mbKeyFrameImagesOnly;
+    // Reference frame of the monocular initialization, whose image is kept until it becomes a keyframe or is dropped
+    bool mbInitialImageKept;
+    long unsigned int mnInitialImageId;
 
     cv::Mat mImGray;
 
@@ -178,22 +199,6 @@ public:
 
     bool mbWriteStats;
     bool newKeyFrame = false;
-    
-#ifdef REGISTER_TIMES
-    void LocalMapStats2File();
-    void TrackStats2File();
-    void PrintTimeStats();
-
-    vector<double> vdRectStereo_ms;
-    vector<double> vdResizeImage_ms;
-    vector<double> vdORBExtract_ms;
-    vector<double> vdStereoMatch_ms;
-    vector<double> vdIMUInteg_ms;
-    vector<double> vdPosePred_ms;
-    vector<double> vdLMTrack_ms;
-    vector<double> vdNewKF_ms;
-    vector<double> vdTrackTotal_ms;
-#endif
 
 protected:
 
@@ -215,6 +220,11 @@ protected:
     bool PredictStateIMU();
 
     bool Relocalization();
+    Frame* RelocalizeFromCandidate(KeyFrame* pKF, const std::atomic<bool> &bStop);
+
+    // Runs task on the relocalization workers and in the calling thread, returns when all are done
+    void RunRelocalizationTask(const std::function<void()> &task);
+    void StopRelocalizationWorkers();
 
     void UpdateLocalMap();
     void UpdateLocalPoints();
@@ -237,12 +247,11 @@ protected:
     // Imu preintegration from last frame
     IMU::Preintegrated *mpImuPreintegratedFromLastKF;
 
-    // Queue of IMU measurements between frames
-    std::list<IMU::Point> mlQueueImuData;
+    // Lock-free queue of IMU measurements between frames
+    ImuRingBuffer mImuBuffer;
 
     // Vector of IMU measurements from previous to current frame (to be filled by PreintegrateIMU)
     std::vector<IMU::Point> mvImuFromLastFrame;
-    std::mutex mMutexImuQueue;
 
     // Imu calibration parameters
     IMU::Calib *mpImuCalib;
@@ -276,6 +285,33 @@ protected:
     KeyFrame* mpReferenceKF;
     std::vector<KeyFrame*> mvpLocalKeyFrames;
     std::vector<MapPoint*> mvpLocalMapPoints;
+
+    // Local map cache. The local map of the previous frame is reused while the keyframes voted
+    // by the tracked points and the map (Map::GetLocalMapChangeIdx) do not change.
+    enum eLocalMapUpdate{
+        LOCAL_MAP_REBUILD=0,
+        LOCAL_MAP_EXTEND=1,
+        LOCAL_MAP_REUSE=2
+    };
+
+    eLocalMapUpdate mLocalMapUpdate;
+    bool mbLocalMapCacheValid;
+    Map* mpLocalMapCacheMap;
+    int mnLocalMapCacheChangeIdx;
+    KeyFrame* mpLocalMapCacheLastKF;
+    std::vector<KeyFrame*> mvpLocalMapCacheSeedKFs;
+    std::vector<KeyFrame*> mvpLocalKeyFramesAdded;
+
+    // Relocalization workers, started at the first relocalization and kept until the tracker is destroyed
+    int mnRelocThreads;
+    std::vector<std::thread> mvRelocWorkers;
+    std::function<void()> mRelocTask;
+    unsigned long mnRelocTask;
+    int mnRelocRunning;
+    bool mbRelocStop;
+    std::mutex mMutexReloc;
+    std::condition_variable mCondRelocTask;
+    std::condition_variable mCondRelocDone;
     
     // System
     System* mpSystem;
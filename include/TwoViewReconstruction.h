@@ -47,12 +47,21 @@ namespace ORB_SLAM3
         void FindHomography(std::vector<bool> &vbMatchesInliers, float &score, Eigen::Matrix3f &H21);
         void FindFundamental(std::vector<bool> &vbInliers, float &score, Eigen::Matrix3f &F21);
 
+        // Compute, score and count the inliers of the RANSAC hypotheses [itBegin,itEnd). Several ranges are evaluated in parallel
+        void EvaluateHomographies(const int itBegin, const int itEnd, const std::vector<cv::Point2f> &vPn1, const std::vector<cv::Point2f> &vPn2,
+                                  const Eigen::Matrix3f &T1, const Eigen::Matrix3f &T2inv, std::vector<Eigen::Matrix3f> &vH21, std::vector<float> &vScores,
+                                  std::vector<int> &vnInliers);
+        void EvaluateFundamentals(const int itBegin, const int itEnd, const std::vector<cv::Point2f> &vPn1, const std::vector<cv::Point2f> &vPn2,
+                                  const Eigen::Matrix3f &T1, const Eigen::Matrix3f &T2t, std::vector<Eigen::Matrix3f> &vF21, std::vector<float> &vScores,
+                                  std::vector<int> &vnInliers);
+
         Eigen::Matrix3f ComputeH21(const std::vector<cv::Point2f> &vP1, const std::vector<cv::Point2f> &vP2);
         Eigen::Matrix3f ComputeF21(const std::vector<cv::Point2f> &vP1, const std::vector<cv::Point2f> &vP2);
 
-        float CheckHomography(const Eigen::Matrix3f &H21, const Eigen::Matrix3f &H12, std::vector<bool> &vbMatchesInliers, float sigma);
+        // Matches are scored in blocks of 8 independent lanes so the compiler can vectorize the loop
+        float CheckHomography(const Eigen::Matrix3f &H21, const Eigen::Matrix3f &H12, std::vector<unsigned char> &vbMatchesInliers, float sigma);
 
-        float CheckFundamental(const Eigen::Matrix3f &F21, std::vector<bool> &vbMatchesInliers, float sigma);
+        float CheckFundamental(const Eigen::Matrix3f &F21, std::vector<unsigned char> &vbMatchesInliers, float sigma);
 
         bool ReconstructF(std::vector<bool> &vbMatchesInliers, Eigen::Matrix3f &F21, Eigen::Matrix3f &K,
                           Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated, float minParallax, int minTriangulated);
@@ -80,6 +89,9 @@ namespace ORB_SLAM3
         std::vector<Match> mvMatches12;
         std::vector<bool> mvbMatched1;
 
+        // Coordinates of the matched keypoints stored contiguously for the RANSAC scoring
+        std::vector<float> mvMatchedU1, mvMatchedV1, mvMatchedU2, mvMatchedV2;
+
         // Calibration
         Eigen::Matrix3f mK;
 
@@ -89,6 +101,9 @@ namespace ORB_SLAM3
         // Ransac max iterations
         int mMaxIterations;
 
+        // Threads used to evaluate the hypotheses of each model (homography and fundamental run concurrently)
+        int mnThreads;
+
         // Ransac sets
         std::vector<std::vector<size_t> > mvSets;
 
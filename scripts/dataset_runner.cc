@@ -0,0 +1,726 @@
+/**
+* Offline dataset runner (no ROS).
+*
+* Feeds a monocular, stereo or RGB-D sequence stored on disk to the SLAM system, either as fast as
+* possible or in real time, and writes the trajectories, the COLMAP workspace and the timing of
+* every frame. Images are read and decoded ahead of the tracking thread by a pool of I/O threads.
+*
+* Usage: ./dataset_runner mono|stereo|rgbd path_to_vocabulary path_to_settings path_to_sequence path_to_list [options]
+*
+*   --format list|euroc|kitti   layout of the sequence (default list)
+*       list:  each line of path_to_list is "timestamp image [image2]" with paths relative to the
+*              sequence folder. TUM rgb.txt and association files ("t rgb t depth") are accepted.
+*       euroc: path_to_list holds timestamps in ns, images in mav0/cam0/data and mav0/cam1/data.
+*       kitti: path_to_list is times.txt, images in image_0/%06d.png and image_1/%06d.png.
+*   --realtime                  feed frames at the rate given by their timestamps
+*   --viewer                    launch the Pangolin viewer
+*   --io-threads N              image decoding threads (default 4)
+*   --prefetch N                maximum number of frames decoded ahead (default 16)
+*   --output dir                output folder (default orb-output/<date_time>)
+*   --instrumentation           record per-stage latencies, exported every second to LatencyStats.csv
+*   --trace                     record the thread timeline, written at shutdown to Trace.json
+*   --speed S[,S...]            replay mode: a camera thread publishes the frames at S times their rate
+*                               ("max" publishes as fast as they are consumed) into a queue that drops
+*                               the oldest frame when full, like a ROS subscriber. Each speed runs in its
+*                               own process and output subfolder, Throughput.txt compares them.
+*   --queue N                   replay queue size (default 1, as ros_mono)
+*   --undistort                 undistort the exported keyframe images (System.ExportUndistort)
+*   --undistort-crop            undistort them and crop to the valid pixels (System.ExportCropToValid)
+*   --groundtruth file          TUM (t x y z qx qy qz qw) or EuRoC csv ground truth, to report the
+*                               keyframe ATE (Sim3 aligned for mono, SE3 otherwise)
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <cmath>
+#include <sys/wait.h>
+#include <boost/filesystem.hpp>
+#include <Eigen/Geometry>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../include/System.h"
+
+using namespace std;
+
+// Function to create directory with Boost
+bool createDirectoryWithBoost(const string& path) {
+    try {
+        boost::filesystem::create_directories(path);
+        return true;
+    } catch (const boost::filesystem::filesystem_error& e) {
+        cerr << "Error creating directory: " << e.what() << endl;
+        return false;
+    }
+}
+
+static bool IsNumber(const string &s, double &value) {
+    char* end = nullptr;
+    value = strtod(s.c_str(), &end);
+    return end != s.c_str() && *end == '\0';
+}
+
+// "timestamp image [timestamp] [image2]" per line, '#' lines are comments
+void LoadList(const string &strSequence, const string &strList, vector<double> &vTimestamps,
+              vector<vector<string> > &vvstrImages) {
+    ifstream f(strList.c_str());
+    string s;
+    while (getline(f, s)) {
+        if (s.empty() || s[0] == '#')
+            continue;
+        stringstream ss(s);
+        string token;
+        double t = -1.0;
+        vector<string> vstrFiles;
+        while (ss >> token) {
+            double value;
+            if (IsNumber(token, value)) {
+                if (t < 0.0)
+                    t = value;
+            }
+            else
+                vstrFiles.push_back(strSequence + "/" + token);
+        }
+        if (t < 0.0 || vstrFiles.empty())
+            continue;
+        vTimestamps.push_back(t);
+        vvstrImages.push_back(vstrFiles);
+    }
+}
+
+void LoadEuRoC(const string &strSequence, const string &strList, const bool bStereo, vector<double> &vTimestamps,
+               vector<vector<string> > &vvstrImages) {
+    ifstream f(strList.c_str());
+    string s;
+    while (getline(f, s)) {
+        if (s.empty() || s[0] == '#')
+            continue;
+        stringstream ss(s);
+        string strStamp;
+        ss >> strStamp;
+        strStamp = strStamp.substr(0, strStamp.find(','));
+        vector<string> vstrFiles;
+        vstrFiles.push_back(strSequence + "/mav0/cam0/data/" + strStamp + ".png");
+        if (bStereo)
+            vstrFiles.push_back(strSequence + "/mav0/cam1/data/" + strStamp + ".png");
+        vTimestamps.push_back(stod(strStamp) * 1e-9);
+        vvstrImages.push_back(vstrFiles);
+    }
+}
+
+void LoadKITTI(const string &strSequence, const string &strList, const bool bStereo, vector<double> &vTimestamps,
+               vector<vector<string> > &vvstrImages) {
+    ifstream f(strList.c_str());
+    string s;
+    while (getline(f, s)) {
+        if (s.empty() || s[0] == '#')
+            continue;
+        stringstream ssName;
+        ssName << setfill('0') << setw(6) << vTimestamps.size();
+        vector<string> vstrFiles;
+        vstrFiles.push_back(strSequence + "/image_0/" + ssName.str() + ".png");
+        if (bStereo)
+            vstrFiles.push_back(strSequence + "/image_1/" + ssName.str() + ".png");
+        vTimestamps.push_back(stod(s));
+        vvstrImages.push_back(vstrFiles);
+    }
+}
+
+// Reads and decodes the images of the sequence ahead of the tracking thread.
+// Frames are scheduled in order and at most nWindow frames are kept decoded ahead of the consumer.
+class ImagePrefetcher {
+public:
+    ImagePrefetcher(const vector<vector<string> > &vvstrImages, const int nThreads, const size_t nWindow)
+        : mvvstrImages(vvstrImages), mnWindow(max<size_t>(1, nWindow)), mnNext(0), mnConsumed(0), mbFinish(false) {
+        for (int i = 0; i < max(1, nThreads); i++)
+            mvThreads.emplace_back(&ImagePrefetcher::Run, this);
+    }
+
+    ~ImagePrefetcher() {
+        {
+            unique_lock<mutex> lock(mMutex);
+            mbFinish = true;
+        }
+        mCond.notify_all();
+        for (thread &th : mvThreads)
+            th.join();
+    }
+
+    // Blocks until frame i is decoded. Frames must be requested in increasing order.
+    vector<cv::Mat> Get(const size_t i) {
+        unique_lock<mutex> lock(mMutex);
+        mnConsumed = i;
+        mCond.notify_all();
+        mCond.wait(lock, [&] { return mmLoaded.count(i) > 0; });
+        vector<cv::Mat> vIms = std::move(mmLoaded[i]);
+        mmLoaded.erase(i);
+        mnConsumed = i + 1;
+        mCond.notify_all();
+        return vIms;
+    }
+
+private:
+    void Run() {
+        while (true) {
+            size_t idx;
+            {
+                unique_lock<mutex> lock(mMutex);
+                mCond.wait(lock, [&] {
+                    return mbFinish || (mnNext < mvvstrImages.size() && mnNext < mnConsumed + mnWindow);
+                });
+                if (mbFinish)
+                    return;
+                idx = mnNext++;
+            }
+
+            vector<cv::Mat> vIms;
+            for (const string &strFile : mvvstrImages[idx]) {
+                cv::Mat im = cv::imread(strFile, cv::IMREAD_UNCHANGED);
+                if (im.empty())
+                    cerr << "Failed to load image at: " << strFile << endl;
+                vIms.push_back(im);
+            }
+
+            {
+                unique_lock<mutex> lock(mMutex);
+                mmLoaded[idx] = std::move(vIms);
+            }
+            mCond.notify_all();
+        }
+    }
+
+    const vector<vector<string> > &mvvstrImages;
+    const size_t mnWindow;
+
+    mutex mMutex;
+    condition_variable mCond;
+    map<size_t, vector<cv::Mat> > mmLoaded;
+    size_t mnNext;
+    size_t mnConsumed;
+    bool mbFinish;
+
+    vector<thread> mvThreads;
+};
+
+// Camera of the replay mode. Frames are published when they are due at the given speed into a bounded
+// queue that drops its oldest frame when the consumer is behind. With speed 0 the publisher waits for a
+// free slot instead, so the sequence is played as fast as it is tracked.
+class FrameReplayer {
+public:
+    FrameReplayer(ImagePrefetcher &prefetcher, const vector<double> &vTimestamps, const double speed, const size_t nQueue)
+        : mPrefetcher(prefetcher), mvTimestamps(vTimestamps), mSpeed(speed), mnQueue(max<size_t>(1, nQueue)),
+          mvbDropped(vTimestamps.size(), false), mnDropped(0), mbFinished(false) {
+        mThread = thread(&FrameReplayer::Run, this);
+    }
+
+    ~FrameReplayer() {
+        mThread.join();
+    }
+
+    // Blocks until a frame is available. Returns false once the sequence is over.
+    bool Pop(size_t &idx, vector<cv::Mat> &vIms, chrono::steady_clock::time_point &tPublished) {
+        unique_lock<mutex> lock(mMutex);
+        mCond.wait(lock, [&] { return mbFinished || !mdQueue.empty(); });
+        if (mdQueue.empty())
+            return false;
+        idx = mdQueue.front().idx;
+        vIms = std::move(mdQueue.front().vIms);
+        tPublished = mdQueue.front().tPublished;
+        mdQueue.pop_front();
+        mCond.notify_all();
+        return true;
+    }
+
+    size_t Dropped() {
+        unique_lock<mutex> lock(mMutex);
+        return mnDropped;
+    }
+
+    bool IsDropped(const size_t idx) {
+        unique_lock<mutex> lock(mMutex);
+        return mvbDropped[idx];
+    }
+
+private:
+    struct QueuedFrame {
+        size_t idx;
+        vector<cv::Mat> vIms;
+        chrono::steady_clock::time_point tPublished;
+    };
+
+    void Run() {
+        const chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+        for (size_t i = 0; i < mvTimestamps.size(); i++) {
+            if (mSpeed > 0) {
+                const chrono::duration<double> tDue((mvTimestamps[i] - mvTimestamps[0]) / mSpeed);
+                this_thread::sleep_until(tStart + chrono::duration_cast<chrono::steady_clock::duration>(tDue));
+            }
+            vector<cv::Mat> vIms = mPrefetcher.Get(i);
+
+            unique_lock<mutex> lock(mMutex);
+            if (mSpeed > 0) {
+                if (mdQueue.size() >= mnQueue) {
+                    mvbDropped[mdQueue.front().idx] = true;
+                    mnDropped++;
+                    mdQueue.pop_front();
+                }
+            }
+            else
+                mCond.wait(lock, [&] { return mdQueue.size() < mnQueue; });
+            mdQueue.push_back({i, std::move(vIms), chrono::steady_clock::now()});
+            mCond.notify_all();
+        }
+        unique_lock<mutex> lock(mMutex);
+        mbFinished = true;
+        mCond.notify_all();
+    }
+
+    ImagePrefetcher &mPrefetcher;
+    const vector<double> &mvTimestamps;
+    const double mSpeed;
+    const size_t mnQueue;
+
+    mutex mMutex;
+    condition_variable mCond;
+    deque<QueuedFrame> mdQueue;
+    vector<bool> mvbDropped;
+    size_t mnDropped;
+    bool mbFinished;
+
+    thread mThread;
+};
+
+// TUM groundtruth.txt (t x y z qx qy qz qw) or EuRoC data.csv (t[ns],x,y,z,...), sorted by time
+bool LoadGroundTruth(const string &strFile, vector<double> &vTimestamps, vector<Eigen::Vector3d> &vPositions) {
+    ifstream f(strFile.c_str());
+    if (!f.is_open())
+        return false;
+    string s;
+    while (getline(f, s)) {
+        if (s.empty() || s[0] == '#')
+            continue;
+        replace(s.begin(), s.end(), ',', ' ');
+        stringstream ss(s);
+        double t, x, y, z;
+        if (!(ss >> t >> x >> y >> z))
+            continue;
+        if (t > 1e14)
+            t *= 1e-9;
+        vTimestamps.push_back(t);
+        vPositions.push_back(Eigen::Vector3d(x, y, z));
+    }
+    return !vTimestamps.empty();
+}
+
+// RMSE of the keyframe positions against the closest ground truth sample (within maxDt seconds),
+// after the least squares alignment of both trajectories (with scale for monocular).
+double ComputeATE(const vector<double> &vTimestamps, const vector<Eigen::Vector3f> &vTwc,
+                  const vector<double> &vGtTimestamps, const vector<Eigen::Vector3d> &vGtPositions,
+                  const bool bScale, int &nPairs, const double maxDt = 0.02) {
+    vector<Eigen::Vector3d> vEst, vGt;
+    for (size_t i = 0; i < vTimestamps.size(); i++) {
+        auto it = lower_bound(vGtTimestamps.begin(), vGtTimestamps.end(), vTimestamps[i]);
+        size_t j = it - vGtTimestamps.begin();
+        if (j > 0 && (j == vGtTimestamps.size() || vTimestamps[i] - vGtTimestamps[j-1] < vGtTimestamps[j] - vTimestamps[i]))
+            j--;
+        if (j >= vGtTimestamps.size() || fabs(vGtTimestamps[j] - vTimestamps[i]) > maxDt)
+            continue;
+        vEst.push_back(vTwc[i].cast<double>());
+        vGt.push_back(vGtPositions[j]);
+    }
+
+    nPairs = vEst.size();
+    if (nPairs < 3)
+        return -1.0;
+
+    Eigen::Matrix3Xd est(3, nPairs), gt(3, nPairs);
+    for (int i = 0; i < nPairs; i++) {
+        est.col(i) = vEst[i];
+        gt.col(i) = vGt[i];
+    }
+    const Eigen::Matrix4d T = Eigen::umeyama(est, gt, bScale);
+    const Eigen::Matrix3Xd aligned = (T.topLeftCorner<3,3>() * est).colwise() + T.topRightCorner<3,1>();
+    return sqrt((aligned - gt).colwise().squaredNorm().mean());
+}
+
+// Nearest rank percentile of a sorted vector
+static double Percentile(const vector<double> &vSorted, const double p) {
+    if (vSorted.empty())
+        return 0.0;
+    const size_t rank = (size_t)ceil(p / 100.0 * vSorted.size());
+    return vSorted[min(vSorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        cerr << endl << "Usage: ./dataset_runner mono|stereo|rgbd path_to_vocabulary path_to_settings path_to_sequence path_to_list"
+             << " [--format list|euroc|kitti] [--realtime] [--viewer] [--io-threads N] [--prefetch N] [--output dir] [--instrumentation] [--trace] [--undistort|--undistort-crop]"
+             << " [--speed S[,S...]] [--queue N] [--groundtruth file]" << endl;
+        return 1;
+    }
+
+    const string strMode = argv[1];
+    ORB_SLAM3::System::eSensor sensor;
+    if (strMode == "mono")
+        sensor = ORB_SLAM3::System::MONOCULAR;
+    else if (strMode == "stereo")
+        sensor = ORB_SLAM3::System::STEREO;
+    else if (strMode == "rgbd")
+        sensor = ORB_SLAM3::System::RGBD;
+    else {
+        cerr << "Unknown sensor " << strMode << ", use mono, stereo or rgbd" << endl;
+        return 1;
+    }
+
+    string strFormat = "list";
+    string strOutput;
+    bool bRealTime = false;
+    bool bViewer = false;
+    bool bInstrumentation = false;
+    bool bTrace = false;
+    bool bUndistort = false;
+    bool bUndistortCrop = false;
+    int nIOThreads = 4;
+    int nPrefetch = 16;
+    vector<string> vstrSpeeds;
+    int nQueue = 1;
+    string strGroundTruth;
+    for (int i = 6; i < argc; i++) {
+        const string arg = argv[i];
+        if (arg == "--realtime")
+            bRealTime = true;
+        else if (arg == "--viewer")
+            bViewer = true;
+        else if (arg == "--instrumentation")
+            bInstrumentation = true;
+        else if (arg == "--trace")
+            bTrace = true;
+        else if (arg == "--undistort")
+            bUndistort = true;
+        else if (arg == "--undistort-crop")
+            bUndistort = bUndistortCrop = true;
+        else if (arg == "--format" && i + 1 < argc)
+            strFormat = argv[++i];
+        else if (arg == "--io-threads" && i + 1 < argc)
+            nIOThreads = atoi(argv[++i]);
+        else if (arg == "--prefetch" && i + 1 < argc)
+            nPrefetch = atoi(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            strOutput = argv[++i];
+        else if (arg == "--speed" && i + 1 < argc) {
+            stringstream ss(argv[++i]);
+            string strSpeed;
+            while (getline(ss, strSpeed, ','))
+                vstrSpeeds.push_back(strSpeed);
+        }
+        else if (arg == "--queue" && i + 1 < argc)
+            nQueue = atoi(argv[++i]);
+        else if (arg == "--groundtruth" && i + 1 < argc)
+            strGroundTruth = argv[++i];
+        else {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    // Replay speeds, 0 is as fast as possible
+    vector<double> vSpeeds;
+    for (const string &strSpeed : vstrSpeeds) {
+        double speed = 0.0;
+        if (strSpeed != "max" && (!IsNumber(strSpeed, speed) || speed < 0.0)) {
+            cerr << "Invalid speed " << strSpeed << ", use a positive factor or max" << endl;
+            return 1;
+        }
+        vSpeeds.push_back(speed);
+    }
+
+    vector<double> vGtTimestamps;
+    vector<Eigen::Vector3d> vGtPositions;
+    if (!strGroundTruth.empty() && !LoadGroundTruth(strGroundTruth, vGtTimestamps, vGtPositions)) {
+        cerr << "Failed to load the ground truth " << strGroundTruth << endl;
+        return 1;
+    }
+
+    // Load the image list
+    const bool bTwoImages = sensor != ORB_SLAM3::System::MONOCULAR;
+    vector<double> vTimestamps;
+    vector<vector<string> > vvstrImages;
+    if (strFormat == "euroc")
+        LoadEuRoC(argv[4], argv[5], bTwoImages, vTimestamps, vvstrImages);
+    else if (strFormat == "kitti")
+        LoadKITTI(argv[4], argv[5], bTwoImages, vTimestamps, vvstrImages);
+    else if (strFormat == "list")
+        LoadList(argv[4], argv[5], vTimestamps, vvstrImages);
+    else {
+        cerr << "Unknown format " << strFormat << endl;
+        return 1;
+    }
+
+    const size_t nImages = vvstrImages.size();
+    if (nImages == 0) {
+        cerr << "No images found in " << argv[5] << endl;
+        return 1;
+    }
+    for (const vector<string> &vstrFiles : vvstrImages) {
+        if (bTwoImages && vstrFiles.size() < 2) {
+            cerr << "Stereo and RGB-D need two images per frame" << endl;
+            return 1;
+        }
+    }
+
+    if (strOutput.empty()) {
+        auto now = chrono::system_clock::now();
+        auto now_c = chrono::system_clock::to_time_t(now);
+        stringstream ss;
+        ss << put_time(localtime(&now_c), "%Y%m%d_%H%M%S");
+        strOutput = "orb-output/" + ss.str();
+    }
+
+    // Every replay speed runs in its own process, so each one starts with a fresh SLAM system
+    double speed = vSpeeds.empty() ? -1.0 : vSpeeds[0];
+    string strSpeed = vstrSpeeds.empty() ? string() : vstrSpeeds[0];
+    if (vSpeeds.size() > 1) {
+        vector<string> vstrRunOutputs;
+        bool bChild = false;
+        for (size_t i = 0; i < vSpeeds.size() && !bChild; i++) {
+            const string strRunOutput = strOutput + "/" + (vSpeeds[i] > 0 ? vstrSpeeds[i] + "x" : string("max"));
+            cout.flush();
+            const pid_t pid = fork();
+            if (pid < 0) {
+                cerr << "Error: fork failed" << endl;
+                return 1;
+            }
+            if (pid == 0) {
+                bChild = true;
+                speed = vSpeeds[i];
+                strSpeed = vstrSpeeds[i];
+                strOutput = strRunOutput;
+            }
+            else {
+                int status = 0;
+                waitpid(pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                    cerr << "Replay in " << strRunOutput << " failed" << endl;
+                vstrRunOutputs.push_back(strRunOutput);
+            }
+        }
+
+        if (!bChild) {
+            if (!createDirectoryWithBoost(strOutput))
+                return 1;
+            ofstream fSummary(strOutput + "/Throughput.txt");
+            cout << endl << "-------" << endl << endl;
+            for (size_t i = 0; i < vstrRunOutputs.size(); i++) {
+                ifstream fRun(vstrRunOutputs[i] + "/Throughput.txt");
+                string line;
+                while (getline(fRun, line)) {
+                    if (line.empty() || (line[0] == '#' && i > 0))
+                        continue;
+                    cout << line << endl;
+                    fSummary << line << endl;
+                }
+            }
+            return 0;
+        }
+    }
+    const bool bReplay = speed >= 0.0;
+
+    cout << endl << "-------" << endl;
+    cout << "Images in the sequence: " << nImages << endl << endl;
+
+    // Create SLAM system. It initializes all system threads and gets ready to process frames.
+    ORB_SLAM3::System SLAM(argv[2], argv[3], sensor, bViewer);
+    if (bInstrumentation && createDirectoryWithBoost(strOutput))
+        SLAM.EnableInstrumentation(true, strOutput + "/LatencyStats.csv");
+    if (bTrace && createDirectoryWithBoost(strOutput))
+        SLAM.EnableTracing(true, strOutput + "/Trace.json");
+    if (bUndistort)
+        SLAM.SetExportUndistortion(true, bUndistortCrop);
+    const float imageScale = SLAM.GetImageScale();
+    const long unsigned int nKeyFramesStart = ORB_SLAM3::KeyFrame::nNextId;
+
+    ImagePrefetcher prefetcher(vvstrImages, nIOThreads, nPrefetch);
+    unique_ptr<FrameReplayer> pReplayer;
+    if (bReplay)
+        pReplayer.reset(new FrameReplayer(prefetcher, vTimestamps, speed, nQueue));
+
+    vector<double> vWait_ms(nImages, 0.0);
+    vector<double> vTrack_ms(nImages, 0.0);
+    vector<double> vLatency_ms(nImages, 0.0);
+    vector<bool> vbProcessed(nImages, false);
+    size_t nLate = 0;
+
+    const chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+    for (size_t n = 0; bReplay || n < nImages; n++) {
+        size_t ni = n;
+        vector<cv::Mat> vIms;
+        chrono::steady_clock::time_point t0, tPublished;
+        if (bReplay) {
+            t0 = chrono::steady_clock::now();
+            if (!pReplayer->Pop(ni, vIms, tPublished))
+                break;
+        }
+        else {
+            if (bRealTime) {
+                // Do not feed a frame before its time
+                const chrono::duration<double> tDue(vTimestamps[ni] - vTimestamps[0]);
+                this_thread::sleep_until(tStart + chrono::duration_cast<chrono::steady_clock::duration>(tDue));
+            }
+            t0 = chrono::steady_clock::now();
+            tPublished = t0;
+            vIms = prefetcher.Get(ni);
+        }
+        chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+        const double tframe = vTimestamps[ni];
+
+        if (vIms[0].empty() || (bTwoImages && vIms[1].empty()))
+            continue;
+
+        if (imageScale != 1.f) {
+            chrono::steady_clock::time_point t_Start_Resize = chrono::steady_clock::now();
+            for (cv::Mat &im : vIms)
+                cv::resize(im, im, cv::Size(im.cols * imageScale, im.rows * imageScale));
+            chrono::steady_clock::time_point t_End_Resize = chrono::steady_clock::now();
+            double t_resize = chrono::duration_cast<chrono::duration<double,std::milli> >(t_End_Resize - t_Start_Resize).count();
+            SLAM.InsertResizeTime(t_resize);
+        }
+
+        chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+
+        // Pass the images to the SLAM system
+        if (sensor == ORB_SLAM3::System::MONOCULAR)
+            SLAM.TrackMonocular(vIms[0], tframe);
+        else if (sensor == ORB_SLAM3::System::STEREO)
+            SLAM.TrackStereo(vIms[0], vIms[1], tframe);
+        else
+            SLAM.TrackRGBD(vIms[0], vIms[1], tframe);
+
+        chrono::steady_clock::time_point t3 = chrono::steady_clock::now();
+
+        vWait_ms[ni] = chrono::duration_cast<chrono::duration<double,std::milli> >(t1 - t0).count();
+        vTrack_ms[ni] = chrono::duration_cast<chrono::duration<double,std::milli> >(t3 - t2).count();
+        vLatency_ms[ni] = chrono::duration_cast<chrono::duration<double,std::milli> >(t3 - tPublished).count();
+        vbProcessed[ni] = true;
+
+        // Late if the camera published the next frame before this one was tracked
+        if (bReplay && speed > 0 && nImages > 1) {
+            const size_t nj = ni + 1 < nImages ? ni + 1 : ni - 1;
+            if (vLatency_ms[ni] > 1e3 * fabs(vTimestamps[nj] - vTimestamps[ni]) / speed)
+                nLate++;
+        }
+    }
+    const double tTotal = chrono::duration_cast<chrono::duration<double> >(chrono::steady_clock::now() - tStart).count();
+    const size_t nDropped = bReplay ? pReplayer->Dropped() : 0;
+
+    // Stop all threads
+    SLAM.Shutdown();
+    const long unsigned int nKeyFrames = ORB_SLAM3::KeyFrame::nNextId - nKeyFramesStart;
+
+    // Tracking time statistics
+    vector<double> vSorted, vSortedLatency;
+    double totaltime = 0;
+    double totalwait = 0;
+    for (size_t ni = 0; ni < nImages; ni++) {
+        if (!vbProcessed[ni])
+            continue;
+        vSorted.push_back(vTrack_ms[ni]);
+        vSortedLatency.push_back(vLatency_ms[ni]);
+        totaltime += vTrack_ms[ni];
+        totalwait += vWait_ms[ni];
+    }
+    const size_t nProcessed = vSorted.size();
+    if (nProcessed == 0) {
+        cerr << "No frame could be tracked" << endl;
+        return 1;
+    }
+    sort(vSorted.begin(), vSorted.end());
+    sort(vSortedLatency.begin(), vSortedLatency.end());
+    cout << "-------" << endl << endl;
+    cout << "median tracking time: " << Percentile(vSorted, 50) << " ms" << endl;
+    cout << "mean tracking time: " << totaltime / nProcessed << " ms" << endl;
+    cout << "mean image wait time: " << totalwait / nProcessed << " ms" << endl;
+    cout << "processed " << nProcessed << " frames in " << tTotal << " s (" << nProcessed / tTotal << " fps)" << endl;
+    cout << "keyframes: " << nKeyFrames << " (" << nKeyFrames / tTotal << " per s)" << endl;
+    if (bReplay) {
+        cout << "dropped frames: " << nDropped << ", late frames: " << nLate << endl;
+        cout << "latency p50/p90/p99/max: " << Percentile(vSortedLatency, 50) << " / " << Percentile(vSortedLatency, 90)
+             << " / " << Percentile(vSortedLatency, 99) << " / " << vSortedLatency.back() << " ms" << endl;
+    }
+
+    double ate = -1.0;
+    int nAtePairs = 0;
+    if (!vGtTimestamps.empty()) {
+        vector<double> vKFTimestamps;
+        vector<Eigen::Vector3f> vKFTwc;
+        SLAM.GetKeyFrameTrajectory(vKFTimestamps, vKFTwc);
+        ate = ComputeATE(vKFTimestamps, vKFTwc, vGtTimestamps, vGtPositions, sensor == ORB_SLAM3::System::MONOCULAR, nAtePairs);
+        if (ate < 0)
+            cout << "ATE: not enough keyframes matched to the ground truth (" << nAtePairs << ")" << endl;
+        else
+            cout << "keyframe ATE RMSE: " << ate << " m over " << nAtePairs << " keyframes" << endl;
+    }
+
+    string directoryName = strOutput + "/sparse/0";
+    string imagesDirectory = strOutput + "/images";
+    if (!createDirectoryWithBoost(directoryName) || !createDirectoryWithBoost(imagesDirectory)) {
+        cerr << "Error: Failed to create the output folders in " << strOutput << endl;
+        return -1;
+    }
+
+    // Per frame timing
+    ofstream fTimes(strOutput + "/FrameTimes.txt");
+    fTimes << "# timestamp image_wait_ms track_ms latency_ms dropped" << endl;
+    fTimes << fixed;
+    for (size_t ni = 0; ni < nImages; ni++)
+        fTimes << setprecision(6) << vTimestamps[ni] << " " << setprecision(3) << vWait_ms[ni] << " " << vTrack_ms[ni]
+               << " " << vLatency_ms[ni] << " " << (bReplay && pReplayer->IsDropped(ni) ? 1 : 0) << endl;
+    fTimes.close();
+
+    // Throughput of the replay
+    if (bReplay) {
+        ofstream fThroughput(strOutput + "/Throughput.txt");
+        fThroughput << "# speed queue frames processed dropped late fps latency_p50_ms latency_p90_ms latency_p99_ms"
+                    << " latency_max_ms keyframes keyframes_per_s ate_rmse_m ate_pairs" << endl;
+        fThroughput << fixed << setprecision(3);
+        fThroughput << (speed > 0 ? strSpeed : string("max")) << " " << nQueue << " " << nImages << " "
+                    << nProcessed << " " << nDropped << " " << nLate << " " << nProcessed / tTotal << " "
+                    << Percentile(vSortedLatency, 50) << " " << Percentile(vSortedLatency, 90) << " "
+                    << Percentile(vSortedLatency, 99) << " " << vSortedLatency.back() << " " << nKeyFrames << " "
+                    << nKeyFrames / tTotal << " " << setprecision(4) << ate << " " << nAtePairs << endl;
+    }
+
+    // Trajectories
+    SLAM.SaveKeyFrameTrajectoryTUM(strOutput + "/KeyFrameTrajectory.txt");
+    if (strFormat == "euroc")
+        SLAM.SaveTrajectoryEuRoC(strOutput + "/CameraTrajectory.txt");
+    else if (sensor != ORB_SLAM3::System::MONOCULAR) {
+        if (strFormat == "kitti")
+            SLAM.SaveTrajectoryKITTI(strOutput + "/CameraTrajectory.txt");
+        else
+            SLAM.SaveTrajectoryTUM(strOutput + "/CameraTrajectory.txt");
+    }
+
+    // COLMAP workspace
+    SLAM.SaveKeyPointsAndMapPoints(directoryName + "/images.txt");
+    if (!SLAM.SaveCameraCOLMAP(directoryName + "/cameras.txt")) {
+        cerr << "Error: Failed to save camera parameters" << endl;
+        return -1;
+    }
+    SLAM.SavePointcloudFromKeyframes(directoryName + "/points3D.txt", imagesDirectory);
+
+    return 0;
+}
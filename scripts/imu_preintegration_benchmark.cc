@@ -0,0 +1,89 @@
+/**
+* IMU preintegration throughput benchmark.
+*
+* Integrates a synthetic 400 Hz IMU stream into keyframe-sized preintegrations and times the three
+* operations that run on the tracking and mapping threads: IntegrateNewMeasurement, Reintegrate after
+* a bias update and MergePrevious when a keyframe is culled.
+*
+* Usage: ./imu_preintegration_benchmark [n_preintegrations] [samples_per_preintegration]
+*/
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "ImuTypes.h"
+
+using namespace std;
+
+static double ElapsedNs(const std::chrono::steady_clock::time_point &t1, const std::chrono::steady_clock::time_point &t2)
+{
+    return std::chrono::duration_cast<std::chrono::duration<double,std::nano> >(t2 - t1).count();
+}
+
+int main(int argc, char **argv)
+{
+    const int nPreint = argc>1 ? max(1,atoi(argv[1])) : 2000;
+    const int nSamples = argc>2 ? max(1,atoi(argv[2])) : 40;
+    const float dt = 1.f/400.f;
+
+    // EuRoC-like noise densities at 400 Hz
+    const float sf = sqrt(400.f);
+    const ORB_SLAM3::IMU::Calib calib(Sophus::SE3f(), 1.7e-4f*sf, 2.0e-3f*sf, 1.9e-5f/sf, 3.0e-3f/sf);
+    const ORB_SLAM3::IMU::Bias bias;
+    const ORB_SLAM3::IMU::Bias newBias(0.01f,-0.02f,0.015f,0.001f,0.002f,-0.001f);
+
+    // Smooth hand-held motion: gravity plus sinusoidal accelerations and rotation rates
+    vector<Eigen::Vector3f> vAcc(nSamples*nPreint), vGyro(nSamples*nPreint);
+    for(size_t i=0; i<vAcc.size(); i++)
+    {
+        const float t = i*dt;
+        vAcc[i] << 0.5f*sin(1.3f*t), 0.3f*cos(0.7f*t), 9.81f+0.2f*sin(2.1f*t);
+        vGyro[i] << 0.4f*sin(0.9f*t), 0.2f*cos(1.7f*t), 0.3f*sin(0.5f*t);
+    }
+
+    vector<ORB_SLAM3::IMU::Preintegrated*> vpPreint(nPreint);
+    for(int i=0; i<nPreint; i++)
+        vpPreint[i] = new ORB_SLAM3::IMU::Preintegrated(bias,calib);
+
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    for(int i=0; i<nPreint; i++)
+        for(int j=0; j<nSamples; j++)
+            vpPreint[i]->IntegrateNewMeasurement(vAcc[i*nSamples+j],vGyro[i*nSamples+j],dt);
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    const double tIntegrate = ElapsedNs(t1,t2);
+
+    // Reintegrate only recomputes when the bias moved away from the linearization point
+    t1 = std::chrono::steady_clock::now();
+    for(int i=0; i<nPreint; i++)
+    {
+        vpPreint[i]->SetNewBias(newBias);
+        vpPreint[i]->Reintegrate();
+    }
+    t2 = std::chrono::steady_clock::now();
+    const double tReintegrate = ElapsedNs(t1,t2);
+
+    // Merge consecutive pairs, as LocalMapping::KeyFrameCulling does for inertial maps
+    t1 = std::chrono::steady_clock::now();
+    for(int i=1; i<nPreint; i+=2)
+        vpPreint[i]->MergePrevious(vpPreint[i-1]);
+    t2 = std::chrono::steady_clock::now();
+    const double tMerge = ElapsedNs(t1,t2);
+    const int nMerged = nPreint/2;
+
+    const Eigen::Matrix3f R = vpPreint[nPreint-1]->GetOriginalDeltaRotation();
+    cout << "preintegrations: " << nPreint << "  samples each: " << nSamples << endl;
+    cout << "integrate:   " << tIntegrate/(nPreint*nSamples) << " ns/sample" << endl;
+    cout << "reintegrate: " << tReintegrate/(nPreint*nSamples) << " ns/sample  "
+         << tReintegrate/nPreint/1e3 << " us/preintegration" << endl;
+    cout << "merge:       " << tMerge/(2*nMerged*nSamples) << " ns/sample  "
+         << tMerge/nMerged/1e3 << " us/merge" << endl;
+    cout << "orthonormality error: " << (R*R.transpose()-Eigen::Matrix3f::Identity()).norm() << endl;
+
+    for(int i=0; i<nPreint; i++)
+        delete vpPreint[i];
+
+    return 0;
+}
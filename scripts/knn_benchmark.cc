@@ -0,0 +1,153 @@
+/**
+* Benchmark of the nearest neighbour scale initializer (PointCloudKnn) on a synthetic point cloud.
+*
+* The points are spread over a few noisy planes and spheres, like a SLAM map of a room. Each thread count
+* is timed over a few runs and must give the same distances as the single threaded run; a sample of the
+* points is checked against brute force nearest neighbours.
+*
+* Usage: ./knn_benchmark [n_points] [runs] [threads,...]
+*   n_points      size of the cloud (default 1000000)
+*   runs          runs per thread count, the median is reported (default 5)
+*   threads       comma separated thread counts (default 1 and the hardware threads)
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+#include "PointCloudKnn.h"
+
+using namespace std;
+
+static vector<Eigen::Vector3f> MakeCloud(const size_t nPoints)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> uni(0.f, 1.f);
+    std::normal_distribution<float> noise(0.f, 0.01f);
+
+    vector<Eigen::Vector3f> vPoints;
+    vPoints.reserve(nPoints);
+    for(size_t i = 0; i < nPoints; i++)
+    {
+        const float u = uni(rng), v = uni(rng);
+        Eigen::Vector3f p;
+        switch(i % 4)
+        {
+        case 0: p << 8.f * u - 4.f, 6.f * v - 3.f, 5.f; break;        // back wall
+        case 1: p << 8.f * u - 4.f, 2.f, 1.f + 4.f * v; break;        // floor
+        case 2: p << -4.f, 6.f * v - 3.f, 1.f + 4.f * u; break;       // side wall
+        default:
+        {
+            // Objects on the floor
+            const float theta = 2.f * float(M_PI) * u, phi = std::acos(2.f * v - 1.f);
+            const Eigen::Vector3f center((i / 4) % 3 - 1.f, 1.5f, 3.f);
+            p = center + 0.4f * Eigen::Vector3f(std::sin(phi) * std::cos(theta), std::sin(phi) * std::sin(theta), std::cos(phi));
+        }
+        }
+        vPoints.push_back(p + Eigen::Vector3f(noise(rng), noise(rng), noise(rng)));
+    }
+    return vPoints;
+}
+
+static float BruteForceMeanDist2(const vector<Eigen::Vector3f> &vPoints, const size_t idx)
+{
+    float best[ORB_SLAM3::PointCloudKnn::K];
+    std::fill(best, best + ORB_SLAM3::PointCloudKnn::K, FLT_MAX);
+    for(size_t i = 0; i < vPoints.size(); i++)
+    {
+        if(i == idx)
+            continue;
+        const Eigen::Vector3f d = vPoints[i] - vPoints[idx];
+        float dist = d.x() * d.x() + d.y() * d.y() + d.z() * d.z();
+        for(int j = 0; j < ORB_SLAM3::PointCloudKnn::K; j++)
+            if(best[j] > dist)
+                std::swap(best[j], dist);
+    }
+    float sum = 0.f;
+    for(int j = 0; j < ORB_SLAM3::PointCloudKnn::K; j++)
+        sum += best[j];
+    return sum / ORB_SLAM3::PointCloudKnn::K;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t nPoints = argc>1 ? max(4,atoi(argv[1])) : 1000000;
+    const int nRuns = argc>2 ? max(1,atoi(argv[2])) : 5;
+    vector<int> vThreads;
+    if(argc>3)
+    {
+        stringstream ss(argv[3]);
+        string n;
+        while(getline(ss,n,','))
+            vThreads.push_back(max(1,atoi(n.c_str())));
+    }
+    else
+    {
+        vThreads.push_back(1);
+        if(thread::hardware_concurrency()>1)
+            vThreads.push_back(thread::hardware_concurrency());
+    }
+
+    const vector<Eigen::Vector3f> vPoints = MakeCloud(nPoints);
+    cout << nPoints << " points" << endl;
+
+    bool bOk = true;
+    vector<float> vReference;
+    double referenceMs = 0.0;
+    for(size_t t=0; t<vThreads.size(); t++)
+    {
+        vector<float> vDist2;
+        vector<double> vTimes;
+        for(int r=0; r<nRuns; r++)
+        {
+            const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            ORB_SLAM3::PointCloudKnn::MeanSquaredDistances(vPoints,vDist2,vThreads[t]);
+            const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            vTimes.push_back(std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(t2 - t1).count());
+        }
+        sort(vTimes.begin(),vTimes.end());
+        const double median = vTimes[vTimes.size()/2];
+        if(t==0)
+        {
+            vReference = vDist2;
+            referenceMs = median;
+        }
+
+        cout << "threads " << setw(3) << vThreads[t] << ": median " << fixed << setprecision(2) << setw(9) << median
+             << " ms (min " << setw(9) << vTimes.front() << "), " << setw(7) << nPoints/median*1e-3 << " M points/s, speedup "
+             << referenceMs/median << "x";
+        if(t>0)
+        {
+            const bool bSame = vDist2==vReference;
+            cout << ", same as " << vThreads[0] << " thread(s): " << (bSame ? "yes" : "NO");
+            bOk &= bSame;
+        }
+        cout << endl;
+    }
+
+    // Exact neighbours on a sample of the points
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> pick(0,nPoints-1);
+    const int nSamples = 100;
+    int nWrong = 0;
+    for(int s=0; s<nSamples; s++)
+    {
+        const size_t idx = pick(rng);
+        const float expected = BruteForceMeanDist2(vPoints,idx);
+        if(std::fabs(vReference[idx]-expected) > 1e-6f*expected)
+            nWrong++;
+    }
+    cout << "brute force check: " << nSamples-nWrong << "/" << nSamples << " points match" << endl;
+    bOk &= nWrong==0;
+
+    return bOk ? 0 : 1;
+}
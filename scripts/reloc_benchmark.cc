@@ -0,0 +1,155 @@
+/**
+* Relocalization latency benchmark.
+*
+* Loads a saved atlas (System.LoadAtlasFromFile in the settings file), activates the largest map in
+* localization mode and relocalizes every query image against it from a lost state. The query list
+* is repeated once per requested number of relocalization workers.
+*
+* Usage: ./reloc_benchmark path_to_vocabulary path_to_settings path_to_query_list [threads,...]
+*   path_to_query_list: one "timestamp image_path" pair per line (TUM rgb.txt), '#' lines are skipped.
+*   threads: comma separated worker counts, default "1,<hardware threads/2>".
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "System.h"
+
+using namespace std;
+
+static void LoadQueries(const string &strFile, vector<double> &vTimestamps, vector<string> &vstrImages)
+{
+    ifstream f(strFile.c_str());
+    string s;
+    while(getline(f,s))
+    {
+        if(s.empty() || s[0]=='#')
+            continue;
+        stringstream ss(s);
+        double t;
+        string strImage;
+        ss >> t >> strImage;
+        if(strImage.empty())
+            continue;
+        vTimestamps.push_back(t);
+        vstrImages.push_back(strImage);
+    }
+}
+
+static double Percentile(vector<double> v, const double p)
+{
+    if(v.empty())
+        return 0.0;
+    sort(v.begin(),v.end());
+    const size_t idx = min(v.size()-1, static_cast<size_t>(p*(v.size()-1)+0.5));
+    return v[idx];
+}
+
+int main(int argc, char **argv)
+{
+    if(argc<4)
+    {
+        cerr << endl << "Usage: ./reloc_benchmark path_to_vocabulary path_to_settings path_to_query_list [threads,...]" << endl;
+        return 1;
+    }
+
+    vector<int> vnThreads;
+    if(argc>4)
+    {
+        stringstream ss(argv[4]);
+        string item;
+        while(getline(ss,item,','))
+            vnThreads.push_back(max(1,atoi(item.c_str())));
+    }
+    else
+    {
+        vnThreads.push_back(1);
+        vnThreads.push_back(max(1u, thread::hardware_concurrency()/2));
+    }
+
+    vector<double> vTimestamps;
+    vector<string> vstrImages;
+    LoadQueries(argv[3],vTimestamps,vstrImages);
+    if(vstrImages.empty())
+    {
+        cerr << "No query images in " << argv[3] << endl;
+        return 1;
+    }
+
+    ORB_SLAM3::System SLAM(argv[1],argv[2],ORB_SLAM3::System::MONOCULAR,false);
+
+    // The system starts a new empty map after loading the atlas, relocalize against the largest stored one
+    ORB_SLAM3::Map* pBestMap = static_cast<ORB_SLAM3::Map*>(NULL);
+    for(ORB_SLAM3::Map* pMap : SLAM.GetAtlas()->GetAllMaps())
+        if(!pBestMap || pMap->KeyFramesInMap()>pBestMap->KeyFramesInMap())
+            pBestMap = pMap;
+
+    if(!pBestMap || pBestMap->KeyFramesInMap()<=10)
+    {
+        cerr << "The loaded atlas has no map to relocalize in" << endl;
+        SLAM.Shutdown();
+        return 1;
+    }
+    SLAM.GetAtlas()->ChangeMap(pBestMap);
+    SLAM.ActivateLocalizationMode();
+
+    vector<cv::Mat> vImages(vstrImages.size());
+    for(size_t i=0; i<vstrImages.size(); i++)
+    {
+        vImages[i] = cv::imread(vstrImages[i],cv::IMREAD_UNCHANGED);
+        if(vImages[i].empty())
+        {
+            cerr << "Failed to load image at: " << vstrImages[i] << endl;
+            SLAM.Shutdown();
+            return 1;
+        }
+    }
+
+    double tOffset = 0.0;
+    for(const int nThreads : vnThreads)
+    {
+        SLAM.mpTracker->SetRelocalizationThreads(nThreads);
+
+        vector<double> vLatency_ms;
+        int nRelocalized = 0;
+        for(size_t i=0; i<vImages.size(); i++)
+        {
+            // Every query starts lost, so the frame is localized by Tracking::Relocalization only
+            SLAM.mpTracker->mState = ORB_SLAM3::Tracking::LOST;
+
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            SLAM.TrackMonocular(vImages[i],vTimestamps[i]+tOffset);
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+            vLatency_ms.push_back(std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(t2 - t1).count());
+            if(SLAM.GetTrackingState()==ORB_SLAM3::Tracking::OK)
+                nRelocalized++;
+        }
+        // Keep timestamps increasing between passes
+        tOffset += vTimestamps.back()-vTimestamps.front()+1.0;
+
+        double total = 0.0;
+        for(const double t : vLatency_ms)
+            total += t;
+
+        cout << "threads: " << nThreads
+             << "  relocalized: " << nRelocalized << "/" << vImages.size()
+             << "  mean: " << total/vLatency_ms.size() << " ms"
+             << "  p50: " << Percentile(vLatency_ms,0.5) << " ms"
+             << "  p90: " << Percentile(vLatency_ms,0.9) << " ms"
+             << "  max: " << Percentile(vLatency_ms,1.0) << " ms" << endl;
+    }
+
+    SLAM.Shutdown();
+
+    return 0;
+}
@@ -9,12 +9,14 @@
 #include <errno.h>    // For errno
 #include <string.h>   // For strerror
 #include <geometry_msgs/PoseStamped.h>  // 用于发布相机位姿
+#include <std_msgs/String.h>
 #include <ros/ros.h>
 #include <cv_bridge/cv_bridge.h>
 #include <opencv2/core/core.hpp>
 #include <boost/filesystem.hpp> // 用于递归创建目录
 
 #include "../include/System.h"
+#include "../include/Instrumentation.h"
 
 using namespace std;
 
@@ -45,42 +47,6 @@ bool createDirectoryWithBoost(const string& path) {
     }
 }
 
-// 保存摄像头参数到文件，使用cv::FileStorage替换yaml-cpp库相关操作
-bool SaveCameraParametersToFile(const string& yamlFile, const string& outputFile) {
-    // 使用cv::FileStorage读取文件
-    cv::FileStorage fs(yamlFile, cv::FileStorage::READ);
-    if (!fs.isOpened()) {
-        cerr << "Error: Failed to open input YAML file " << yamlFile << endl;
-        return false;
-    }
-
-    // 提取参数
-    double fx = (double)fs["Camera.fx"];
-    double fy = (double)fs["Camera.fy"];
-    double cx = (double)fs["Camera.cx"];
-    double cy = (double)fs["Camera.cy"];
-    int width = (int)fs["Camera.width"];
-    int height = (int)fs["Camera.height"];
-
-    // 生成输出内容
-    string cameraInfo = "1 PINHOLE " + to_string(width) + " " + to_string(height) + " " +
-                        to_string(fx) + " " + to_string(fy) + " " +
-                        to_string(cx) + " " + to_string(cy);
-
-    // 写入到文件
-    ofstream outFile(outputFile);
-    if (!outFile) {
-        cerr << "Error: Failed to open output file " << outputFile << endl;
-        return false;
-    }
-
-    outFile << "#   CAMERA_ID, MODEL, WIDTH, HEIGHT, PARAMS[]" << endl;
-    outFile << cameraInfo << endl;
-
-    cout << "Camera parameters successfully saved to " << outputFile << endl;
-    return true;
-}
-
 class ImageGrabber {
 public:
     ImageGrabber(ORB_SLAM3::System* pSLAM) : mpSLAM(pSLAM) {}
@@ -122,6 +88,25 @@ int main(int argc, char** argv) {
     // 订阅相机图像话题
     ros::Subscriber sub = nodeHandler.subscribe("/camera/image_raw", 1, &ImageGrabber::GrabImage, &igb);
 
+    // Per-stage latency statistics (count, mean, p50, p99, max) published every second with _instrumentation:=true
+    bool bInstrumentation = false;
+    ros::param::param<bool>("~instrumentation", bInstrumentation, false);
+    ros::Publisher latencyPub;
+    if (bInstrumentation) {
+        latencyPub = nodeHandler.advertise<std_msgs::String>("/orb_slam3/latency_stats", 10);
+        ORB_SLAM3::Instrumentation::SetEnabled(true);
+        ORB_SLAM3::Instrumentation::StartExport("", 1.0, [&latencyPub](const vector<ORB_SLAM3::Instrumentation::StageStats>& vStats) {
+            stringstream ss;
+            ss << fixed << setprecision(3);
+            for (const ORB_SLAM3::Instrumentation::StageStats& stats : vStats)
+                ss << stats.name << "," << stats.unit << "," << stats.count << "," << stats.mean << ","
+                   << stats.p50 << "," << stats.p99 << "," << stats.max << "\n";
+            std_msgs::String msg;
+            msg.data = ss.str();
+            latencyPub.publish(msg);
+        });
+    }
+
     ros::spin();
 
     // Stop all threads
@@ -167,7 +152,7 @@ int main(int argc, char** argv) {
     }
 
     SLAM.SaveKeyPointsAndMapPoints(directoryName + "/images.txt");
-    if (!SaveCameraParametersToFile(argv[2], directoryName + "/cameras.txt")) {
+    if (!SLAM.SaveCameraCOLMAP(directoryName + "/cameras.txt")) {
         cerr << "Error: Failed to save camera parameters" << endl;
         return -1;
     }
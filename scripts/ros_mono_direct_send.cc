@@ -123,15 +123,14 @@ void ImageGrabber::BackgroundThread() {
 
                     // 提取 RGB 信息
                     int keyFrameId = pKF->mnId;
-                    auto it = mpSLAM->mpTracker->mnIdToBGRMap.find(keyFrameId);
-                    if (it != mpSLAM->mpTracker->mnIdToBGRMap.end()) {
-                        cv::Mat rgbImage = it->second;
+                    cv::Mat rgbImage = mpSLAM->mpTracker->GetFrameImage(keyFrameId);
+                    if (!rgbImage.empty()) {
                         // 创建并处理 RGB 消息 (假设有一个函数 CreateRosImage)
                         sensor_msgs::Image imageMsg = CreateRosImage(rgbImage, keyFrameId);
 
                         // 这里可以根据需求发布或存储 RGB 消息
                         rgbPublisher.publish(imageMsg);
-                        mpSLAM->mpTracker->mnIdToBGRMap.erase(keyFrameId);  // 删除已处理的 keyframe ID
+                        mpSLAM->mpTracker->EraseFrameImage(keyFrameId);  // 删除已处理的 keyframe ID
                     }
                 }
             }
@@ -0,0 +1,779 @@
+/**
+* Microbenchmarks of the tracking, mapping and export hot paths on fixtures from a real sequence.
+*
+* The fixtures are a map and a few frames. The map is either a saved atlas (System.LoadAtlasFromFile
+* in the settings file) or built by tracking the image list first; add System.SaveAtlasToFile to the
+* settings to record it once and reuse it in later runs. The frames are the first images of the list,
+* localized in the map through BoW matching and pose optimization.
+*
+* Each benchmark runs until it has been measured for at least --min-time seconds, like Google Benchmark,
+* and the results are printed and written in Google Benchmark's JSON format so that runs of different
+* versions can be compared with its tools.
+*
+* Usage: ./slam_benchmark path_to_vocabulary path_to_settings path_to_image_list [options]
+*   path_to_image_list: one "timestamp image_path" pair per line (TUM rgb.txt), paths relative to the list
+*   --filter text       only run the benchmarks whose name contains text
+*   --min-time s        minimum measured time per benchmark (default 0.5)
+*   --repetitions n     repeat each benchmark n times and report mean, median and stddev (default 1)
+*   --frames n          number of fixture frames (default 20)
+*   --out file          JSON output (default slam_benchmark.json)
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <cmath>
+#include <ctime>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include "System.h"
+#include "ORBmatcher.h"
+#include "Optimizer.h"
+#include "CameraModels/Pinhole.h"
+
+using namespace std;
+
+// Timing state passed to a benchmark, measures only the code between ResumeTiming and PauseTiming
+class BenchmarkState
+{
+public:
+    BenchmarkState(const size_t nIterations): mnIterations(nIterations), mnDone(0), mbStarted(false), mbRunning(false),
+        mRealNs(0.0), mCpuNs(0.0) {}
+
+    bool KeepRunning()
+    {
+        if(!mbStarted)
+        {
+            mbStarted = true;
+            ResumeTiming();
+        }
+        if(mnDone<mnIterations)
+        {
+            mnDone++;
+            return true;
+        }
+        PauseTiming();
+        return false;
+    }
+
+    void PauseTiming()
+    {
+        if(!mbRunning)
+            return;
+        mRealNs += std::chrono::duration_cast<std::chrono::duration<double,std::nano> >(std::chrono::steady_clock::now() - mRealStart).count();
+        mCpuNs += ThreadCpuNs() - mCpuStart;
+        mbRunning = false;
+    }
+
+    void ResumeTiming()
+    {
+        if(mbRunning)
+            return;
+        mRealStart = std::chrono::steady_clock::now();
+        mCpuStart = ThreadCpuNs();
+        mbRunning = true;
+    }
+
+    size_t Iterations() const { return mnIterations; }
+    double RealNs() const { return mRealNs; }
+    double CpuNs() const { return mCpuNs; }
+
+    // Summed over the iterations, reported per iteration
+    map<string,double> counters;
+
+private:
+    static double ThreadCpuNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+        return ts.tv_sec*1e9 + ts.tv_nsec;
+    }
+
+    const size_t mnIterations;
+    size_t mnDone;
+    bool mbStarted;
+    bool mbRunning;
+    std::chrono::steady_clock::time_point mRealStart;
+    double mCpuStart;
+    double mRealNs;
+    double mCpuNs;
+};
+
+struct Benchmark
+{
+    enum eFixture
+    {
+        FRAMES=0,
+        LOCALIZED_FRAMES,
+        KEYFRAME_PAIRS,
+        ATLAS,
+        KEYFRAME_IMAGES
+    };
+
+    string name;
+    eFixture fixture;
+    std::function<void(BenchmarkState&)> function;
+};
+
+struct BenchmarkResult
+{
+    string name;
+    string runType;     // "iteration" or "aggregate"
+    string aggregate;   // "mean", "median" or "stddev" for aggregates
+    size_t iterations;
+    double realNs;      // per iteration
+    double cpuNs;
+    map<string,double> counters;
+};
+
+static BenchmarkResult MakeResult(const string &name, const BenchmarkState &state)
+{
+    BenchmarkResult result;
+    result.name = name;
+    result.runType = "iteration";
+    result.iterations = state.Iterations();
+    result.realNs = state.RealNs()/state.Iterations();
+    result.cpuNs = state.CpuNs()/state.Iterations();
+    for(const pair<const string,double> &counter : state.counters)
+        result.counters[counter.first] = counter.second/state.Iterations();
+    return result;
+}
+
+static vector<BenchmarkResult> RunBenchmark(const Benchmark &benchmark, const double minTime, const int nRepetitions)
+{
+    vector<BenchmarkResult> vResults;
+
+    // Grow the iterations until the measured time reaches minTime, then repeat with that count
+    size_t nIterations = 1;
+    while(true)
+    {
+        BenchmarkState state(nIterations);
+        benchmark.function(state);
+        const double seconds = state.RealNs()*1e-9;
+        if(seconds>=minTime || nIterations>=1000000000)
+        {
+            vResults.push_back(MakeResult(benchmark.name,state));
+            break;
+        }
+        const double multiplier = seconds/minTime>0.1 ? minTime*1.4/max(seconds,1e-9) : 10.0;
+        nIterations = max(nIterations+1,static_cast<size_t>(nIterations*min(multiplier,10.0)));
+    }
+
+    for(int i=1; i<nRepetitions; i++)
+    {
+        BenchmarkState state(nIterations);
+        benchmark.function(state);
+        vResults.push_back(MakeResult(benchmark.name,state));
+    }
+
+    if(nRepetitions>1)
+    {
+        const size_t n = vResults.size();
+        vector<double> vReal, vCpu;
+        for(const BenchmarkResult &result : vResults)
+        {
+            vReal.push_back(result.realNs);
+            vCpu.push_back(result.cpuNs);
+        }
+
+        BenchmarkResult mean = vResults.front(), median = vResults.front(), stddev = vResults.front();
+        mean.realNs = mean.cpuNs = stddev.realNs = stddev.cpuNs = 0.0;
+        for(size_t i=0; i<n; i++)
+        {
+            mean.realNs += vReal[i]/n;
+            mean.cpuNs += vCpu[i]/n;
+        }
+        for(size_t i=0; i<n; i++)
+        {
+            stddev.realNs += (vReal[i]-mean.realNs)*(vReal[i]-mean.realNs)/max<size_t>(1,n-1);
+            stddev.cpuNs += (vCpu[i]-mean.cpuNs)*(vCpu[i]-mean.cpuNs)/max<size_t>(1,n-1);
+        }
+        stddev.realNs = sqrt(stddev.realNs);
+        stddev.cpuNs = sqrt(stddev.cpuNs);
+        sort(vReal.begin(),vReal.end());
+        sort(vCpu.begin(),vCpu.end());
+        median.realNs = n%2 ? vReal[n/2] : 0.5*(vReal[n/2-1]+vReal[n/2]);
+        median.cpuNs = n%2 ? vCpu[n/2] : 0.5*(vCpu[n/2-1]+vCpu[n/2]);
+
+        mean.aggregate = "mean";
+        median.aggregate = "median";
+        stddev.aggregate = "stddev";
+        for(BenchmarkResult* pResult : {&mean, &median, &stddev})
+        {
+            pResult->runType = "aggregate";
+            pResult->name += "_" + pResult->aggregate;
+            vResults.push_back(*pResult);
+        }
+    }
+
+    return vResults;
+}
+
+static string FormatTime(const double ns)
+{
+    stringstream ss;
+    ss << fixed << setprecision(ns<1e4 ? 0 : 2);
+    if(ns<1e4)
+        ss << ns << " ns";
+    else if(ns<1e7)
+        ss << ns*1e-3 << " us";
+    else
+        ss << ns*1e-6 << " ms";
+    return ss.str();
+}
+
+static void PrintResult(const BenchmarkResult &result)
+{
+    cout << left << setw(52) << result.name << right << setw(14) << FormatTime(result.realNs)
+         << setw(14) << FormatTime(result.cpuNs) << setw(12) << result.iterations;
+    for(const pair<const string,double> &counter : result.counters)
+        cout << "  " << counter.first << "=" << setprecision(4) << counter.second;
+    cout << endl;
+}
+
+static string JsonEscape(const string &str)
+{
+    string out;
+    for(const char c : str)
+    {
+        if(c=='"' || c=='\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static bool WriteJson(const string &strFile, const map<string,string> &context, const vector<BenchmarkResult> &vResults)
+{
+    ofstream f(strFile.c_str());
+    if(!f.is_open())
+        return false;
+
+    f << setprecision(10);
+    f << "{" << endl << "  \"context\": {" << endl;
+    size_t i = 0;
+    for(const pair<const string,string> &item : context)
+        f << "    \"" << JsonEscape(item.first) << "\": \"" << JsonEscape(item.second) << "\"" << (++i<context.size() ? "," : "") << endl;
+    f << "  }," << endl << "  \"benchmarks\": [" << endl;
+    for(size_t j=0; j<vResults.size(); j++)
+    {
+        const BenchmarkResult &result = vResults[j];
+        f << "    {" << endl;
+        f << "      \"name\": \"" << JsonEscape(result.name) << "\"," << endl;
+        f << "      \"run_name\": \"" << JsonEscape(result.name.substr(0,result.name.size()-(result.aggregate.empty() ? 0 : result.aggregate.size()+1))) << "\"," << endl;
+        f << "      \"run_type\": \"" << result.runType << "\"," << endl;
+        if(!result.aggregate.empty())
+            f << "      \"aggregate_name\": \"" << result.aggregate << "\"," << endl;
+        f << "      \"iterations\": " << result.iterations << "," << endl;
+        f << "      \"real_time\": " << result.realNs << "," << endl;
+        f << "      \"cpu_time\": " << result.cpuNs << "," << endl;
+        for(const pair<const string,double> &counter : result.counters)
+            f << "      \"" << JsonEscape(counter.first) << "\": " << counter.second << "," << endl;
+        f << "      \"time_unit\": \"ns\"" << endl;
+        f << "    }" << (j+1<vResults.size() ? "," : "") << endl;
+    }
+    f << "  ]" << endl << "}" << endl;
+    return true;
+}
+
+static void LoadImages(const string &strFile, vector<double> &vTimestamps, vector<string> &vstrImages)
+{
+    const size_t slash = strFile.find_last_of('/');
+    const string strDir = slash==string::npos ? string() : strFile.substr(0,slash+1);
+
+    ifstream f(strFile.c_str());
+    string s;
+    while(getline(f,s))
+    {
+        if(s.empty() || s[0]=='#')
+            continue;
+        stringstream ss(s);
+        double t;
+        string strImage;
+        ss >> t >> strImage;
+        if(strImage.empty())
+            continue;
+        vTimestamps.push_back(t);
+        vstrImages.push_back(strImage[0]=='/' ? strImage : strDir + strImage);
+    }
+}
+
+static float ReadReal(const cv::FileStorage &fSettings, const string &name, const float defaultValue)
+{
+    // Old style (Camera.fx) and version 1.0 (Camera1.fx) settings files
+    cv::FileNode node = fSettings[name];
+    if(node.empty() && name.compare(0,7,"Camera.")==0)
+        node = fSettings["Camera1." + name.substr(7)];
+    if(node.empty() || !(node.isReal() || node.isInt()))
+        return defaultValue;
+    return node.real();
+}
+
+// Frame localized in the map, with its reference keyframe and local map points
+struct PosedFrame
+{
+    ORB_SLAM3::Frame* pFrame;
+    ORB_SLAM3::KeyFrame* pKF;
+    vector<ORB_SLAM3::MapPoint*> vpLocalMapPoints;
+};
+
+static bool LocalizeFrame(ORB_SLAM3::Frame &F, ORB_SLAM3::KeyFrameDatabase* pKFDB, ORB_SLAM3::Map* pMap, PosedFrame &posed)
+{
+    const vector<ORB_SLAM3::KeyFrame*> vpCandidates = pKFDB->DetectRelocalizationCandidates(&F,pMap);
+    ORB_SLAM3::ORBmatcher matcher(0.75,true);
+    for(ORB_SLAM3::KeyFrame* pKF : vpCandidates)
+    {
+        if(pKF->isBad())
+            continue;
+        vector<ORB_SLAM3::MapPoint*> vpMatches;
+        if(matcher.SearchByBoW(pKF,F,vpMatches)<15)
+            continue;
+
+        F.mvpMapPoints = vpMatches;
+        F.SetPose(pKF->GetPose());
+        if(ORB_SLAM3::Optimizer::PoseOptimization(&F)<15)
+            continue;
+        for(int i=0; i<F.N; i++)
+            if(F.mvbOutlier[i])
+                F.mvpMapPoints[i] = static_cast<ORB_SLAM3::MapPoint*>(NULL);
+
+        posed.pFrame = new ORB_SLAM3::Frame(F);
+        posed.pKF = pKF;
+        set<ORB_SLAM3::MapPoint*> spLocal;
+        vector<ORB_SLAM3::KeyFrame*> vpLocalKFs = pKF->GetBestCovisibilityKeyFrames(10);
+        vpLocalKFs.push_back(pKF);
+        for(ORB_SLAM3::KeyFrame* pLocalKF : vpLocalKFs)
+            for(ORB_SLAM3::MapPoint* pMP : pLocalKF->GetMapPointMatches())
+                if(pMP && !pMP->isBad())
+                    spLocal.insert(pMP);
+        posed.vpLocalMapPoints.assign(spLocal.begin(),spLocal.end());
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc<4)
+    {
+        cerr << endl << "Usage: ./slam_benchmark path_to_vocabulary path_to_settings path_to_image_list"
+             << " [--filter text] [--min-time s] [--repetitions n] [--frames n] [--out file]" << endl;
+        return 1;
+    }
+
+    string strFilter;
+    string strOut = "slam_benchmark.json";
+    double minTime = 0.5;
+    int nRepetitions = 1;
+    int nFrames = 20;
+    for(int i=4; i<argc; i++)
+    {
+        const string arg = argv[i];
+        if(arg=="--filter" && i+1<argc)
+            strFilter = argv[++i];
+        else if(arg=="--min-time" && i+1<argc)
+            minTime = max(0.01,atof(argv[++i]));
+        else if(arg=="--repetitions" && i+1<argc)
+            nRepetitions = max(1,atoi(argv[++i]));
+        else if(arg=="--frames" && i+1<argc)
+            nFrames = max(1,atoi(argv[++i]));
+        else if(arg=="--out" && i+1<argc)
+            strOut = argv[++i];
+        else
+            cerr << "Ignoring unknown argument " << arg << endl;
+    }
+
+    vector<double> vTimestamps;
+    vector<string> vstrImages;
+    LoadImages(argv[3],vTimestamps,vstrImages);
+    if(vstrImages.empty())
+    {
+        cerr << "No images in " << argv[3] << endl;
+        return 1;
+    }
+
+    ORB_SLAM3::System SLAM(argv[1],argv[2],ORB_SLAM3::System::MONOCULAR,false);
+    const float imageScale = SLAM.GetImageScale();
+
+    auto LoadImage = [&](const size_t i)
+    {
+        cv::Mat im = cv::imread(vstrImages[i],cv::IMREAD_UNCHANGED);
+        if(!im.empty() && imageScale!=1.f)
+            cv::resize(im,im,cv::Size(im.cols*imageScale,im.rows*imageScale));
+        return im;
+    };
+
+    // Map fixture: the largest map of the loaded atlas, or record one from the sequence
+    auto LargestMap = [&]()
+    {
+        ORB_SLAM3::Map* pBestMap = static_cast<ORB_SLAM3::Map*>(NULL);
+        for(ORB_SLAM3::Map* pMap : SLAM.GetAtlas()->GetAllMaps())
+            if(!pBestMap || pMap->KeyFramesInMap()>pBestMap->KeyFramesInMap())
+                pBestMap = pMap;
+        return pBestMap;
+    };
+
+    ORB_SLAM3::Map* pMap = LargestMap();
+    const bool bLoadedAtlas = pMap && pMap->KeyFramesInMap()>10;
+    if(!bLoadedAtlas)
+    {
+        cout << "Recording the map from " << vstrImages.size() << " images" << endl;
+        for(size_t i=0; i<vstrImages.size(); i++)
+        {
+            const cv::Mat im = LoadImage(i);
+            if(im.empty())
+            {
+                cerr << "Failed to load image at: " << vstrImages[i] << endl;
+                SLAM.Shutdown();
+                return 1;
+            }
+            SLAM.TrackMonocular(im,vTimestamps[i]);
+        }
+    }
+
+    // No thread may change the map while it is measured (this also saves the atlas if requested)
+    SLAM.Shutdown();
+    while(!SLAM.mpLocalMapper->isFinished() || !SLAM.mpLoopCloser->isFinished() || SLAM.mpLoopCloser->isRunningGBA())
+        usleep(5000);
+
+    pMap = LargestMap();
+    if(!pMap || pMap->KeyFramesInMap()<=10)
+    {
+        cerr << "No map with more than 10 keyframes to benchmark on" << endl;
+        return 1;
+    }
+    SLAM.GetAtlas()->ChangeMap(pMap);
+
+    vector<ORB_SLAM3::KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+    vpKFs.erase(remove_if(vpKFs.begin(),vpKFs.end(),[](ORB_SLAM3::KeyFrame* pKF){return pKF->isBad();}),vpKFs.end());
+    sort(vpKFs.begin(),vpKFs.end(),ORB_SLAM3::KeyFrame::lId);
+
+    // Covisible keyframe pairs, as matched by local mapping and loop closing
+    vector<pair<ORB_SLAM3::KeyFrame*,ORB_SLAM3::KeyFrame*> > vKFPairs;
+    for(ORB_SLAM3::KeyFrame* pKF : vpKFs)
+    {
+        const vector<ORB_SLAM3::KeyFrame*> vpNeighs = pKF->GetBestCovisibilityKeyFrames(1);
+        if(!vpNeighs.empty() && !vpNeighs[0]->isBad())
+            vKFPairs.push_back(make_pair(pKF,vpNeighs[0]));
+    }
+
+    // Frame fixtures, built as Tracking builds them
+    cv::FileStorage fSettings(argv[2],cv::FileStorage::READ);
+    const float fx = ReadReal(fSettings,"Camera.fx",0.f), fy = ReadReal(fSettings,"Camera.fy",0.f);
+    const float cx = ReadReal(fSettings,"Camera.cx",0.f), cy = ReadReal(fSettings,"Camera.cy",0.f);
+    cv::Mat distCoef = cv::Mat::zeros(4,1,CV_32F);
+    distCoef.at<float>(0) = ReadReal(fSettings,"Camera.k1",0.f);
+    distCoef.at<float>(1) = ReadReal(fSettings,"Camera.k2",0.f);
+    distCoef.at<float>(2) = ReadReal(fSettings,"Camera.p1",0.f);
+    distCoef.at<float>(3) = ReadReal(fSettings,"Camera.p2",0.f);
+    const float k3 = ReadReal(fSettings,"Camera.k3",0.f);
+    if(k3!=0.f)
+    {
+        distCoef.resize(5);
+        distCoef.at<float>(4) = k3;
+    }
+    const vector<float> vCamCalib{fx*imageScale,fy*imageScale,cx*imageScale,cy*imageScale};
+    ORB_SLAM3::GeometricCamera* pCamera = new ORB_SLAM3::Pinhole(vCamCalib);
+
+    ORB_SLAM3::ORBextractor extractor(static_cast<int>(ReadReal(fSettings,"ORBextractor.nFeatures",1000.f)),
+                                      ReadReal(fSettings,"ORBextractor.scaleFactor",1.2f),
+                                      static_cast<int>(ReadReal(fSettings,"ORBextractor.nLevels",8.f)),
+                                      static_cast<int>(ReadReal(fSettings,"ORBextractor.iniThFAST",20.f)),
+                                      static_cast<int>(ReadReal(fSettings,"ORBextractor.minThFAST",7.f)));
+
+    ORB_SLAM3::ORBVocabulary* pVoc = SLAM.GetVocabulary();
+    ORB_SLAM3::KeyFrameDatabase* pKFDB = SLAM.GetKeyFrameDatabase();
+
+    vector<cv::Mat> vImGray;
+    vector<ORB_SLAM3::Frame*> vpFrames;
+    vector<PosedFrame> vPosed;
+    for(size_t i=0; i<vstrImages.size() && static_cast<int>(vImGray.size())<nFrames; i++)
+    {
+        cv::Mat im = LoadImage(i);
+        if(im.empty())
+            continue;
+        if(im.channels()==3)
+            cv::cvtColor(im,im,cv::COLOR_BGR2GRAY);
+        else if(im.channels()==4)
+            cv::cvtColor(im,im,cv::COLOR_BGRA2GRAY);
+        vImGray.push_back(im);
+
+        ORB_SLAM3::Frame* pF = new ORB_SLAM3::Frame(im,vTimestamps[i],&extractor,pVoc,pCamera,distCoef,0.f,0.f);
+        pF->ComputeBoW();
+        vpFrames.push_back(pF);
+
+        PosedFrame posed;
+        ORB_SLAM3::Frame F(*pF);
+        if(LocalizeFrame(F,pKFDB,pMap,posed))
+            vPosed.push_back(posed);
+    }
+
+    // Keyframes whose image is kept by the tracker, the exporters warn about and skip the others
+    size_t nKFImages = 0;
+    for(ORB_SLAM3::KeyFrame* pKF : vpKFs)
+        if(!SLAM.mpTracker->GetFrameImage(pKF->mnFrameId).empty())
+            nKFImages++;
+
+    cout << endl << "Fixtures: " << vpKFs.size() << " keyframes (" << nKFImages << " with images), "
+         << pMap->MapPointsInMap() << " map points, "
+         << vpFrames.size() << " frames (" << vPosed.size() << " localized in the map)" << endl << endl;
+
+    // Benchmarks, the ones that modify the map come last
+    vector<Benchmark> vBenchmarks;
+    size_t nNext = 0;
+
+    vBenchmarks.push_back({"ORBextractor/Extract", Benchmark::FRAMES, [&](BenchmarkState &state)
+    {
+        vector<cv::KeyPoint> vKeys;
+        cv::Mat descriptors;
+        vector<int> vLapping = {0,1000};
+        while(state.KeepRunning())
+        {
+            const int n = extractor(vImGray[nNext++%vImGray.size()],cv::Mat(),vKeys,descriptors,vLapping);
+            state.counters["features"] += n;
+        }
+    }});
+
+    vBenchmarks.push_back({"Frame/GetFeaturesInArea", Benchmark::FRAMES, [&](BenchmarkState &state)
+    {
+        while(state.KeepRunning())
+        {
+            const ORB_SLAM3::Frame &F = *vpFrames[nNext++%vpFrames.size()];
+            size_t nFound = 0;
+            for(int i=0; i<F.N; i++)
+                nFound += F.GetFeaturesInArea(F.mvKeysUn[i].pt.x,F.mvKeysUn[i].pt.y,15.f).size();
+            state.counters["queries"] += F.N;
+            state.counters["found"] += nFound;
+        }
+    }});
+
+    vBenchmarks.push_back({"Frame/ComputeBoW", Benchmark::FRAMES, [&](BenchmarkState &state)
+    {
+        while(state.KeepRunning())
+        {
+            state.PauseTiming();
+            ORB_SLAM3::Frame &F = *vpFrames[nNext++%vpFrames.size()];
+            F.mBowVec.clear();
+            F.mFeatVec.clear();
+            state.ResumeTiming();
+            F.ComputeBoW();
+        }
+    }});
+
+    vBenchmarks.push_back({"ORBmatcher/SearchByProjection/LocalMap", Benchmark::LOCALIZED_FRAMES, [&](BenchmarkState &state)
+    {
+        ORB_SLAM3::ORBmatcher matcher(0.8);
+        while(state.KeepRunning())
+        {
+            state.PauseTiming();
+            PosedFrame &posed = vPosed[nNext++%vPosed.size()];
+            ORB_SLAM3::Frame &F = *posed.pFrame;
+            const vector<ORB_SLAM3::MapPoint*> vpMatches = F.mvpMapPoints;
+            fill(F.mvpMapPoints.begin(),F.mvpMapPoints.end(),static_cast<ORB_SLAM3::MapPoint*>(NULL));
+            for(ORB_SLAM3::MapPoint* pMP : posed.vpLocalMapPoints)
+                F.isInFrustum(pMP,0.5);
+            state.ResumeTiming();
+
+            state.counters["matches"] += matcher.SearchByProjection(F,posed.vpLocalMapPoints,3);
+
+            state.PauseTiming();
+            F.mvpMapPoints = vpMatches;
+            state.ResumeTiming();
+        }
+    }});
+
+    vBenchmarks.push_back({"ORBmatcher/SearchByProjection/Sim3", Benchmark::LOCALIZED_FRAMES, [&](BenchmarkState &state)
+    {
+        ORB_SLAM3::ORBmatcher matcher(0.75,true);
+        while(state.KeepRunning())
+        {
+            state.PauseTiming();
+            PosedFrame &posed = vPosed[nNext++%vPosed.size()];
+            const Sophus::SE3f Tcw = posed.pKF->GetPose();
+            Sophus::Sim3f Scw(Sophus::RxSO3f(1.f,Tcw.unit_quaternion()),Tcw.translation());
+            vector<ORB_SLAM3::MapPoint*> vpMatched(posed.pKF->N,static_cast<ORB_SLAM3::MapPoint*>(NULL));
+            state.ResumeTiming();
+
+            state.counters["matches"] += matcher.SearchByProjection(posed.pKF,Scw,posed.vpLocalMapPoints,vpMatched,10,0.9);
+        }
+    }});
+
+    vBenchmarks.push_back({"ORBmatcher/SearchByBoW/KeyFrameFrame", Benchmark::LOCALIZED_FRAMES, [&](BenchmarkState &state)
+    {
+        ORB_SLAM3::ORBmatcher matcher(0.75,true);
+        vector<ORB_SLAM3::MapPoint*> vpMatches;
+        while(state.KeepRunning())
+        {
+            PosedFrame &posed = vPosed[nNext++%vPosed.size()];
+            state.counters["matches"] += matcher.SearchByBoW(posed.pKF,*posed.pFrame,vpMatches);
+        }
+    }});
+
+    vBenchmarks.push_back({"ORBmatcher/SearchByBoW/KeyFrames", Benchmark::KEYFRAME_PAIRS, [&](BenchmarkState &state)
+    {
+        ORB_SLAM3::ORBmatcher matcher(0.75,true);
+        vector<ORB_SLAM3::MapPoint*> vpMatches;
+        while(state.KeepRunning())
+        {
+            const pair<ORB_SLAM3::KeyFrame*,ORB_SLAM3::KeyFrame*> &kfPair = vKFPairs[nNext++%vKFPairs.size()];
+            state.counters["matches"] += matcher.SearchByBoW(kfPair.first,kfPair.second,vpMatches);
+        }
+    }});
+
+    vBenchmarks.push_back({"ORBmatcher/SearchForTriangulation", Benchmark::KEYFRAME_PAIRS, [&](BenchmarkState &state)
+    {
+        ORB_SLAM3::ORBmatcher matcher(0.6,false);
+        vector<pair<size_t,size_t> > vMatchedIndices;
+        while(state.KeepRunning())
+        {
+            const pair<ORB_SLAM3::KeyFrame*,ORB_SLAM3::KeyFrame*> &kfPair = vKFPairs[nNext++%vKFPairs.size()];
+            state.counters["matches"] += matcher.SearchForTriangulation(kfPair.first,kfPair.second,vMatchedIndices,false);
+        }
+    }});
+
+    vBenchmarks.push_back({"Optimizer/PoseOptimization", Benchmark::LOCALIZED_FRAMES, [&](BenchmarkState &state)
+    {
+        while(state.KeepRunning())
+        {
+            state.PauseTiming();
+            ORB_SLAM3::Frame F(*vPosed[nNext++%vPosed.size()].pFrame);
+            state.ResumeTiming();
+
+            state.counters["inliers"] += ORB_SLAM3::Optimizer::PoseOptimization(&F);
+        }
+    }});
+
+    vBenchmarks.push_back({"KeyFrameDatabase/DetectNBestCandidates", Benchmark::ATLAS, [&](BenchmarkState &state)
+    {
+        vector<ORB_SLAM3::KeyFrame*> vpLoopCand, vpMergeCand;
+        while(state.KeepRunning())
+        {
+            vpLoopCand.clear();
+            vpMergeCand.clear();
+            pKFDB->DetectNBestCandidates(vpKFs[nNext++%vpKFs.size()],vpLoopCand,vpMergeCand,3);
+            state.counters["candidates"] += vpLoopCand.size()+vpMergeCand.size();
+        }
+    }});
+
+    vBenchmarks.push_back({"KeyFrameDatabase/DetectRelocalizationCandidates", Benchmark::FRAMES, [&](BenchmarkState &state)
+    {
+        while(state.KeepRunning())
+            state.counters["candidates"] += pKFDB->DetectRelocalizationCandidates(vpFrames[nNext++%vpFrames.size()],pMap).size();
+    }});
+
+    // The exporters print their progress and warnings, both are silenced while they run
+    const string strExportDir = "/tmp/slam_benchmark_" + to_string(getpid());
+    mkdir(strExportDir.c_str(),0755);
+    mkdir((strExportDir + "/images").c_str(),0755);
+    auto ExportBenchmark = [&](const std::function<void()> &exporter)
+    {
+        return [exporter](BenchmarkState &state)
+        {
+            ofstream null;
+            streambuf* pCoutBuf = cout.rdbuf(null.rdbuf());
+            streambuf* pCerrBuf = cerr.rdbuf(null.rdbuf());
+            while(state.KeepRunning())
+                exporter();
+            cout.rdbuf(pCoutBuf);
+            cerr.rdbuf(pCerrBuf);
+        };
+    };
+
+    vBenchmarks.push_back({"Export/SaveKeyPointsAndMapPoints", Benchmark::KEYFRAME_IMAGES, ExportBenchmark([&]()
+    {
+        SLAM.SaveKeyPointsAndMapPoints(strExportDir + "/images.txt");
+    })});
+
+    vBenchmarks.push_back({"Export/SavePointcloud", Benchmark::KEYFRAME_IMAGES, ExportBenchmark([&]()
+    {
+        SLAM.SavePointcloud(strExportDir + "/points3D_colored.txt");
+    })});
+
+    vBenchmarks.push_back({"Export/SavePointcloudFromKeyframes", Benchmark::KEYFRAME_IMAGES, ExportBenchmark([&]()
+    {
+        SLAM.SavePointcloudFromKeyframes(strExportDir + "/points3D.txt",strExportDir + "/images");
+    })});
+
+    vBenchmarks.push_back({"Optimizer/LocalBundleAdjustment", Benchmark::ATLAS, [&](BenchmarkState &state)
+    {
+        // The most recent keyframes, as local mapping optimizes them
+        const size_t nRecent = min<size_t>(20,vpKFs.size());
+        while(state.KeepRunning())
+        {
+            ORB_SLAM3::KeyFrame* pKF = vpKFs[vpKFs.size()-1-nNext++%nRecent];
+            bool bStop = false;
+            int nFixed, nOpt, nMPs, nEdges;
+            ORB_SLAM3::Optimizer::LocalBundleAdjustment(pKF,&bStop,pMap,nFixed,nOpt,nMPs,nEdges);
+            state.counters["edges"] += nEdges;
+            state.counters["kfs"] += nOpt;
+        }
+    }});
+
+    cout << left << setw(52) << "Benchmark" << right << setw(14) << "Time" << setw(14) << "CPU" << setw(12) << "Iterations" << endl;
+    cout << string(92,'-') << endl;
+
+    vector<BenchmarkResult> vResults;
+    for(const Benchmark &benchmark : vBenchmarks)
+    {
+        if(!strFilter.empty() && benchmark.name.find(strFilter)==string::npos)
+            continue;
+        if((benchmark.fixture==Benchmark::LOCALIZED_FRAMES && vPosed.empty()) ||
+           (benchmark.fixture==Benchmark::KEYFRAME_PAIRS && vKFPairs.empty()) ||
+           (benchmark.fixture==Benchmark::ATLAS && vpKFs.empty()) ||
+           (benchmark.fixture==Benchmark::KEYFRAME_IMAGES && nKFImages==0))
+        {
+            cout << left << setw(52) << benchmark.name << "skipped, no fixture" << endl;
+            continue;
+        }
+
+        nNext = 0;
+        for(const BenchmarkResult &result : RunBenchmark(benchmark,minTime,nRepetitions))
+        {
+            PrintResult(result);
+            vResults.push_back(result);
+        }
+    }
+
+    boost::system::error_code error;
+    boost::filesystem::remove_all(strExportDir,error);
+
+    char date[64];
+    const time_t now = time(NULL);
+    strftime(date,sizeof(date),"%Y-%m-%dT%H:%M:%S%z",localtime(&now));
+    map<string,string> context;
+    context["date"] = date;
+    context["executable"] = argv[0];
+    context["num_cpus"] = to_string(thread::hardware_concurrency());
+    context["settings"] = argv[2];
+    context["image_list"] = argv[3];
+    context["atlas"] = bLoadedAtlas ? "loaded" : "recorded";
+    context["keyframes"] = to_string(vpKFs.size());
+    context["keyframe_images"] = to_string(nKFImages);
+    context["map_points"] = to_string(pMap->MapPointsInMap());
+    context["frames"] = to_string(vpFrames.size());
+    context["localized_frames"] = to_string(vPosed.size());
+    if(!WriteJson(strOut,context,vResults))
+    {
+        cerr << "Failed to write " << strOut << endl;
+        return 1;
+    }
+    cout << endl << "Results saved to " << strOut << endl;
+
+    return 0;
+}
@@ -206,6 +206,15 @@ std::vector<MapPoint*> Atlas::GetReferenceMapPoints()
     return mpCurrentMap->GetReferenceMapPoints();
 }
 
+MemoryUsage Atlas::GetMemoryUsage()
+{
+    MemoryUsage usage;
+    const vector<Map*> vpMaps = GetAllMaps();
+    for(Map* pMap : vpMaps)
+        pMap->AddMemoryUsage(usage);
+    return usage;
+}
+
 vector<Map*> Atlas::GetAllMaps()
 {
     unique_lock<mutex> lock(mMutexAtlas);
@@ -0,0 +1,355 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "DepthDensifier.h"
+#include "KeyFrame.h"
+#include "MapPoint.h"
+#include "ParallelFor.h"
+#include "PyramidCamera.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <unordered_map>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core/eigen.hpp>
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+
+struct VoxelSum
+{
+    Eigen::Vector3f pos;
+    Eigen::Vector3f color;
+    int n;
+};
+
+typedef std::unordered_map<uint64_t, VoxelSum> VoxelMap;
+
+// 21 bits per axis around the origin, false out of the grid
+bool VoxelKey(const Eigen::Vector3f &p, const float voxelSize, uint64_t &key)
+{
+    key = 0;
+    for(int k = 0; k < 3; k++)
+    {
+        const float c = std::floor(p[k] / voxelSize) + float(1 << 20);
+        if(!(c >= 0.f && c < float(1 << 21)))
+            return false;
+        key |= static_cast<uint64_t>(c) << (21 * k);
+    }
+    return true;
+}
+
+// Depths of the map points of a keyframe in the frame Tcw, sorted
+std::vector<float> MapPointDepths(KeyFrame* pKF, const Eigen::Matrix3f &Rrc, const Sophus::SE3f &Tcw)
+{
+    std::vector<float> vDepths;
+    for(MapPoint* pMP : pKF->GetMapPointMatches())
+    {
+        if(!pMP || pMP->isBad())
+            continue;
+        const float z = (Rrc * (Tcw * pMP->GetWorldPos())).z();
+        if(z > 0.f)
+            vDepths.push_back(z);
+    }
+    std::sort(vDepths.begin(), vDepths.end());
+    return vDepths;
+}
+
+cv::Mat Pyramid(const cv::Mat &im, const int nLevel)
+{
+    cv::Mat out = im;
+    for(int l = 0; l < nLevel; l++)
+    {
+        cv::Mat down;
+        cv::pyrDown(out, down);
+        out = down;
+    }
+    return out;
+}
+
+// Semi-global matching of one pair; the mean point and color of each voxel reached go to voxels.
+// Returns whether its disparity range had to be cut.
+bool DensifyPair(KeyFrame* pKF1, KeyFrame* pKF2, const cv::Mat &im1, const cv::Mat &im2,
+                 const DepthDensifier::Options &options, const float voxelSize, VoxelMap &voxels)
+{
+    const cv::Mat color1 = Pyramid(im1, options.nLevel), color2 = Pyramid(im2, options.nLevel);
+    if(color1.size() != color2.size() || color1.type() != CV_8UC3 || color2.type() != CV_8UC3)
+        return false;
+    const cv::Size size = color1.size();
+
+    // Rectification with the relative pose x2 = R x1 + T
+    const Sophus::SE3f T21 = pKF2->GetPose() * pKF1->GetPoseInverse();
+    cv::Mat R, T;
+    cv::eigen2cv(Eigen::Matrix3d(T21.rotationMatrix().cast<double>()), R);
+    cv::eigen2cv(Eigen::Vector3d(T21.translation().cast<double>()), T);
+    const cv::Mat K1 = PyramidCamera(pKF1, options.nLevel).K(), K2 = PyramidCamera(pKF2, options.nLevel).K();
+    cv::Mat R1, R2, P1, P2, Q;
+    cv::stereoRectify(K1, pKF1->mDistCoef, K2, pKF2->mDistCoef, size, R, T, R1, R2, P1, P2, Q,
+                      cv::CALIB_ZERO_DISPARITY, 0.0, size);
+
+    // Vertical pairs are matched on transposed images. The first image of the matcher is the one whose
+    // points have the larger coordinate along the baseline.
+    const bool bVertical = std::fabs(P2.at<double>(1,3)) > std::fabs(P2.at<double>(0,3));
+    const double Tb = P2.at<double>(bVertical ? 1 : 0, 3);
+    const bool bSwap = Tb > 0.0;
+    const double f = P1.at<double>(0,0);
+    const float baseline = static_cast<float>(std::fabs(Tb) / f);
+
+    KeyFrame* pKFLeft = bSwap ? pKF2 : pKF1;
+    const cv::Mat &RLeft = bSwap ? R2 : R1;
+    const cv::Mat &PLeft = bSwap ? P2 : P1;
+    Eigen::Matrix3d RLeftEig;
+    cv::cv2eigen(RLeft, RLeftEig);
+    const Eigen::Matrix3f Rrc = RLeftEig.cast<float>();
+
+    // Disparity range from the depths of the map points, with a margin
+    const std::vector<float> vDepths = MapPointDepths(pKFLeft, Rrc, pKFLeft->GetPose());
+    if(vDepths.size() < 20)
+        return false;
+    const float zMin = vDepths[vDepths.size() / 20], zMax = vDepths[vDepths.size() - 1 - vDepths.size() / 20];
+    const float dMin = static_cast<float>(f) * baseline / zMax, dMax = static_cast<float>(f) * baseline / zMin;
+    if(dMax < 1.f)
+        return false;
+    // Beyond 256 disparities the closest points of the pair are not matched
+    const int nMaxDisparities = 256;
+    const int minDisparity = static_cast<int>(std::floor(0.8f * dMin));
+    const int numDisparitiesRange = (static_cast<int>(std::ceil(1.25f * dMax)) - minDisparity + 15) / 16 * 16;
+    const bool bClamped = numDisparitiesRange > nMaxDisparities;
+    const int numDisparities = std::min(nMaxDisparities, numDisparitiesRange);
+
+    cv::Mat map1x, map1y, map2x, map2y;
+    cv::initUndistortRectifyMap(K1, pKF1->mDistCoef, R1, P1, size, CV_32FC1, map1x, map1y);
+    cv::initUndistortRectifyMap(K2, pKF2->mDistCoef, R2, P2, size, CV_32FC1, map2x, map2y);
+    cv::Mat rect1, rect2, valid;
+    cv::remap(color1, rect1, map1x, map1y, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    cv::remap(color2, rect2, map2x, map2y, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    cv::remap(cv::Mat(size, CV_8UC1, cv::Scalar(255)), valid, bSwap ? map2x : map1x, bSwap ? map2y : map1y,
+              cv::INTER_NEAREST, cv::BORDER_CONSTANT);
+
+    cv::Mat left, right;
+    if(bVertical)
+    {
+        cv::Mat validT;
+        cv::transpose(bSwap ? rect2 : rect1, left);
+        cv::transpose(bSwap ? rect1 : rect2, right);
+        cv::transpose(valid, validT);
+        valid = validT;
+    }
+    else
+    {
+        left = bSwap ? rect2 : rect1;
+        right = bSwap ? rect1 : rect2;
+    }
+    cv::Mat grayLeft, grayRight, disparity;
+    cv::cvtColor(left, grayLeft, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(right, grayRight, cv::COLOR_BGR2GRAY);
+
+    const int blockSize = 5;
+    cv::Ptr<cv::StereoSGBM> pMatcher = cv::StereoSGBM::create(minDisparity, std::max(16, numDisparities), blockSize,
+                                                              8 * blockSize * blockSize, 32 * blockSize * blockSize,
+                                                              1, 0, 10, 100, 2, cv::StereoSGBM::MODE_SGBM);
+    pMatcher->compute(grayLeft, grayRight, disparity);
+
+    // Triangulation in the rectified frame of the left camera, then to the world
+    const float cxLeft = static_cast<float>(PLeft.at<double>(0,2)), cyLeft = static_cast<float>(PLeft.at<double>(1,2));
+    const float fl = static_cast<float>(f);
+    const Sophus::SE3f Twc = pKFLeft->GetPoseInverse();
+    const Eigen::Matrix3f Rcr = Rrc.transpose();
+    for(int v = 0; v < disparity.rows; v += options.nStep)
+    {
+        const short* pDisp = disparity.ptr<short>(v);
+        const uchar* pValid = valid.ptr<uchar>(v);
+        const cv::Vec3b* pColor = left.ptr<cv::Vec3b>(v);
+        for(int u = 0; u < disparity.cols; u += options.nStep)
+        {
+            const float d = pDisp[u] / 16.f;
+            if(!pValid[u] || d <= minDisparity || d <= 0.f)
+                continue;
+            const float z = fl * baseline / d;
+            if(z < 0.5f * zMin || z > 2.f * zMax)
+                continue;
+            const float x = bVertical ? v : u, y = bVertical ? u : v;
+            const Eigen::Vector3f Xr((x - cxLeft) * z / fl, (y - cyLeft) * z / fl, z);
+            const Eigen::Vector3f Xw = Twc * (Rcr * Xr);
+
+            uint64_t key;
+            if(!VoxelKey(Xw, voxelSize, key))
+                continue;
+            const cv::Vec3b &bgr = pColor[u];
+            const Eigen::Vector3f rgb(static_cast<float>(bgr[2]), static_cast<float>(bgr[1]), static_cast<float>(bgr[0]));
+            const auto it = voxels.emplace(key, VoxelSum{Xw, rgb, 1});
+            if(!it.second)
+            {
+                it.first->second.pos += Xw;
+                it.first->second.color += rgb;
+                it.first->second.n++;
+            }
+        }
+    }
+    return bClamped;
+}
+
+} // namespace
+
+DepthDensifier::DepthDensifier(const Options &options, const std::function<cv::Mat(KeyFrame*)> &getImage):
+    mOptions(options), mGetImage(getImage)
+{
+    mOptions.nLevel = std::max(0, mOptions.nLevel);
+    mOptions.nStep = std::max(1, mOptions.nStep);
+    mOptions.nMinSupport = std::max(1, mOptions.nMinSupport);
+}
+
+std::vector<PointCloudFilter::Point> DepthDensifier::Densify(const std::vector<KeyFrame*> &vpKFs, const int nThreads)
+{
+    const int nWorkers = ResolveThreads(nThreads);
+    std::vector<PointCloudFilter::Point> vPoints;
+
+    std::vector<KeyFrame*> vpCandidates;
+    for(KeyFrame* pKF : vpKFs)
+        if(PyramidCamera::IsSupported(pKF))
+            vpCandidates.push_back(pKF);
+    std::sort(vpCandidates.begin(), vpCandidates.end(), KeyFrame::lId);
+    if(vpCandidates.empty())
+        return vPoints;
+
+    // Each keyframe with its best covisible keyframes with enough parallax, each pair once
+    const float minParallax = mOptions.minParallaxDeg * float(M_PI) / 180.f;
+    std::set<std::pair<KeyFrame*, KeyFrame*> > sPairs;
+    std::vector<std::pair<KeyFrame*, KeyFrame*> > vPairs;
+    std::vector<float> vMedianDepths;
+    for(KeyFrame* pKF : vpCandidates)
+    {
+        const std::vector<float> vDepths = MapPointDepths(pKF, Eigen::Matrix3f::Identity(), pKF->GetPose());
+        if(vDepths.empty())
+            continue;
+        const float medianDepth = vDepths[vDepths.size() / 2];
+        vMedianDepths.push_back(medianDepth);
+
+        int nPaired = 0;
+        for(KeyFrame* pKFi : pKF->GetBestCovisibilityKeyFrames(4 * mOptions.nNeighbours))
+        {
+            if(nPaired >= mOptions.nNeighbours)
+                break;
+            if(!PyramidCamera::IsSupported(pKFi))
+                continue;
+            const float baseline = (pKF->GetCameraCenter() - pKFi->GetCameraCenter()).norm();
+            if(std::atan2(baseline, medianDepth) < minParallax)
+                continue;
+            nPaired++;
+            std::pair<KeyFrame*, KeyFrame*> pair = pKF->mnId < pKFi->mnId ? std::make_pair(pKF, pKFi) : std::make_pair(pKFi, pKF);
+            if(sPairs.insert(pair).second)
+                vPairs.push_back(pair);
+        }
+    }
+    std::sort(vPairs.begin(), vPairs.end(), [](const std::pair<KeyFrame*, KeyFrame*> &a, const std::pair<KeyFrame*, KeyFrame*> &b) {
+        return a.first->mnId < b.first->mnId || (a.first->mnId == b.first->mnId && a.second->mnId < b.second->mnId);
+    });
+    if(vPairs.empty() || vMedianDepths.empty())
+        return vPoints;
+
+    float voxelSize = mOptions.voxelSize;
+    if(voxelSize <= 0.f)
+    {
+        std::nth_element(vMedianDepths.begin(), vMedianDepths.begin() + vMedianDepths.size() / 2, vMedianDepths.end());
+        const float fLevel = vpCandidates[0]->fx / float(1 << mOptions.nLevel);
+        voxelSize = vMedianDepths[vMedianDepths.size() / 2] * mOptions.nStep / fLevel;
+    }
+
+    // Batches of one pair per thread, merged in pair order
+    struct Fused
+    {
+        Eigen::Vector3f pos;
+        Eigen::Vector3f color;
+        int nPairs;
+    };
+    std::unordered_map<uint64_t, Fused> mFused;
+    size_t nDropped = 0, nClamped = 0;
+    std::vector<VoxelMap> vBatch(nWorkers);
+    std::vector<char> vbClamped(nWorkers);
+    for(size_t first = 0; first < vPairs.size(); first += nWorkers)
+    {
+        const size_t nBatch = std::min(vPairs.size() - first, static_cast<size_t>(nWorkers));
+        ParallelFor(nBatch, nWorkers, [&](size_t b) {
+            vBatch[b].clear();
+            vbClamped[b] = false;
+            KeyFrame* pKF1 = vPairs[first + b].first;
+            KeyFrame* pKF2 = vPairs[first + b].second;
+            const cv::Mat im1 = mGetImage(pKF1), im2 = mGetImage(pKF2);
+            if(!im1.empty() && !im2.empty())
+                vbClamped[b] = DensifyPair(pKF1, pKF2, im1, im2, mOptions, voxelSize, vBatch[b]);
+        });
+
+        for(size_t b = 0; b < nBatch; b++)
+        {
+            nClamped += vbClamped[b];
+            for(const std::pair<const uint64_t, VoxelSum> &voxel : vBatch[b])
+            {
+                const float invN = 1.f / voxel.second.n;
+                auto it = mFused.find(voxel.first);
+                if(it == mFused.end())
+                {
+                    if(mFused.size() >= static_cast<size_t>(mOptions.nMaxPoints))
+                    {
+                        nDropped++;
+                        continue;
+                    }
+                    mFused.emplace(voxel.first, Fused{voxel.second.pos * invN, voxel.second.color * invN, 1});
+                    continue;
+                }
+                it->second.pos += voxel.second.pos * invN;
+                it->second.color += voxel.second.color * invN;
+                it->second.nPairs++;
+            }
+            vBatch[b] = VoxelMap();
+        }
+    }
+
+    // Voxels confirmed by enough pairs, in key order
+    std::vector<uint64_t> vKeys;
+    for(const std::pair<const uint64_t, Fused> &voxel : mFused)
+        if(voxel.second.nPairs >= mOptions.nMinSupport)
+            vKeys.push_back(voxel.first);
+    std::sort(vKeys.begin(), vKeys.end());
+    vPoints.reserve(vKeys.size());
+    for(const uint64_t key : vKeys)
+    {
+        const Fused &voxel = mFused[key];
+        vPoints.push_back(PointCloudFilter::Point{voxel.pos / float(voxel.nPairs), voxel.color / float(voxel.nPairs), voxel.nPairs + 1});
+    }
+
+    std::cout << "Depth densification: " << vPairs.size() << " keyframe pairs, " << mFused.size() << " voxels of "
+              << voxelSize << ", " << vPoints.size() << " seen by " << mOptions.nMinSupport << "+ pairs";
+    if(nDropped > 0)
+        std::cout << " (" << nDropped << " voxels over the limit of " << mOptions.nMaxPoints << ")";
+    std::cout << std::endl;
+    if(nClamped > 0)
+        std::cout << "Depth densification: the disparity range of " << nClamped << " pairs was cut to 256, their closest "
+                  << "points are missing (a coarser pyramid level reduces the range)" << std::endl;
+    return vPoints;
+}
+
+} //namespace ORB_SLAM
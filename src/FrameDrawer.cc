@@ -27,7 +27,8 @@
 namespace ORB_SLAM3
 {
 
-FrameDrawer::FrameDrawer(Atlas* pAtlas):both(false),mpAtlas(pAtlas)
+FrameDrawer::FrameDrawer(Atlas* pAtlas):both(false),mpAtlas(pAtlas),mbViewerActive(false),mbSnapshotRequested(false),
+    mbSnapshotReady(false)
 {
     mState=Tracking::SYSTEM_NOT_READY;
     mIm = cv::Mat(480,640,CV_8UC3, cv::Scalar(0,0,0));
@@ -367,9 +368,42 @@ void FrameDrawer::DrawTextInfo(cv::Mat &im, int nState, cv::Mat &imText)
 
 }
 
+void FrameDrawer::SetViewerActive(const bool bActive)
+{
+    mbViewerActive = bActive;
+}
+
+bool FrameDrawer::NeedUpdate()
+{
+    return mbViewerActive || mbSnapshotRequested;
+}
+
+bool FrameDrawer::RequestSnapshot(const double minPeriod)
+{
+    unique_lock<mutex> lock(mMutex);
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(mbSnapshotRequested)
+        return true;
+    if(mbSnapshotReady && std::chrono::duration<double>(now - mtLastSnapshot).count() < minPeriod)
+        return false;
+
+    mtLastSnapshot = now;
+    mbSnapshotReady = false;
+    mbSnapshotRequested = true;
+    return true;
+}
+
+bool FrameDrawer::isSnapshotReady()
+{
+    unique_lock<mutex> lock(mMutex);
+    return mbSnapshotReady || mbViewerActive;
+}
+
 void FrameDrawer::Update(Tracking *pTracker)
 {
     unique_lock<mutex> lock(mMutex);
+    mbSnapshotRequested = false;
+    mbSnapshotReady = true;
     pTracker->mImGray.copyTo(mIm);
     mvCurrentKeys=pTracker->mCurrentFrame.mvKeys;
     mThDepth = pTracker->mCurrentFrame.mThDepth;//wanglian
@@ -0,0 +1,205 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GaussianPlyWriter.h"
+#include "PointCloudKnn.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <Eigen/Eigenvalues>
+#include <Eigen/Geometry>
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+
+bool LittleEndian()
+{
+    const uint16_t one = 1;
+    uint8_t first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+inline void PutFloat(char* &p, const float value, const bool bSwap)
+{
+    char bytes[4];
+    std::memcpy(bytes, &value, 4);
+    if(bSwap)
+    {
+        std::swap(bytes[0], bytes[3]);
+        std::swap(bytes[1], bytes[2]);
+    }
+    std::memcpy(p, bytes, 4);
+    p += 4;
+}
+
+inline void PutUChar(char* &p, const float value)
+{
+    *p++ = static_cast<char>(static_cast<uint8_t>(std::min(255.f, std::max(0.f, std::round(value)))));
+}
+
+// Local frame of each point from the PCA of its neighbours: the columns of vRotations are the axes by decreasing
+// variance, vSpreads the standard deviations along them. Points with fewer than 3 neighbours keep the identity
+// and a zero spread.
+void LocalFrames(const std::vector<Eigen::Vector3f> &vPoints, const int k, const int nThreads,
+                 std::vector<Eigen::Matrix3f> &vRotations, std::vector<Eigen::Vector3f> &vSpreads)
+{
+    std::vector<int> vNeighbours;
+    PointCloudKnn::Neighbours(vPoints, k, vNeighbours, nThreads);
+    const int kk = static_cast<int>(vNeighbours.size() / std::max<size_t>(1, vPoints.size()));
+    vRotations.assign(vPoints.size(), Eigen::Matrix3f::Identity());
+    vSpreads.assign(vPoints.size(), Eigen::Vector3f::Zero());
+
+    ParallelFor(vPoints.size(), 4096, nThreads, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++)
+        {
+            const int* neighbours = vNeighbours.data() + i * kk;
+            int n = 0;
+            while(n < kk && neighbours[n] >= 0)
+                n++;
+            if(n < 3)
+                continue;
+
+            // Covariance of the point and its neighbours, centred on their mean
+            Eigen::Vector3f mean = vPoints[i];
+            for(int j = 0; j < n; j++)
+                mean += vPoints[neighbours[j]];
+            mean /= float(n + 1);
+            Eigen::Matrix3f cov = (vPoints[i] - mean) * (vPoints[i] - mean).transpose();
+            for(int j = 0; j < n; j++)
+            {
+                const Eigen::Vector3f d = vPoints[neighbours[j]] - mean;
+                cov += d * d.transpose();
+            }
+            cov /= float(n + 1);
+
+            // Eigenvalues in increasing order, the axes are taken in decreasing order
+            const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(cov);
+            if(solver.info() != Eigen::Success)
+                continue;
+            Eigen::Matrix3f R;
+            R.col(0) = solver.eigenvectors().col(2);
+            R.col(1) = solver.eigenvectors().col(1);
+            R.col(2) = R.col(0).cross(R.col(1));
+            vRotations[i] = R;
+            for(int a = 0; a < 3; a++)
+                vSpreads[i][a] = std::sqrt(std::max(0.f, solver.eigenvalues()[2 - a]));
+        }
+    });
+}
+
+} // namespace
+
+bool GaussianPlyWriter::Save(const std::string &filename, const std::vector<Eigen::Vector3f> &vPoints,
+                             const std::vector<Eigen::Vector3f> &vColors, const std::vector<float> &vScales,
+                             const Options &options, const int nThreads)
+{
+    const size_t P = vPoints.size();
+    if(vColors.size() != P || (options.bScales && vScales.size() != P))
+    {
+        std::cerr << "Error: " << P << " points for " << vColors.size() << " colors and " << vScales.size()
+                  << " scales in " << filename << std::endl;
+        return false;
+    }
+    const int nWorkers = ResolveThreads(nThreads);
+
+    std::vector<Eigen::Matrix3f> vRotations;
+    std::vector<Eigen::Vector3f> vSpreads;
+    if(options.bRotations)
+        LocalFrames(vPoints, std::max(3, options.nPcaNeighbours), nWorkers, vRotations, vSpreads);
+
+    std::ofstream f(filename.c_str(), std::ios::out | std::ios::binary);
+    if(!f.is_open())
+    {
+        std::cerr << "Error: Failed to open file " << filename << " for writing!" << std::endl;
+        return false;
+    }
+
+    f << "ply\n";
+    f << "format binary_little_endian 1.0\n";
+    f << "element vertex " << P << "\n";
+    const char* const names[] = {"x", "y", "z", "nx", "ny", "nz"};
+    for(const char* name : names)
+        f << "property float " << name << "\n";
+    f << "property uchar red\n";
+    f << "property uchar green\n";
+    f << "property uchar blue\n";
+    if(options.bOpacity)
+        f << "property float opacity\n";
+    if(options.bScales)
+        for(int a = 0; a < 3; a++)
+            f << "property float scale_" << a << "\n";
+    if(options.bRotations)
+        for(int a = 0; a < 4; a++)
+            f << "property float rot_" << a << "\n";
+    f << "end_header\n";
+
+    const size_t stride = 6 * 4 + 3 + (options.bOpacity ? 4 : 0) + (options.bScales ? 3 * 4 : 0) + (options.bRotations ? 4 * 4 : 0);
+    const bool bSwap = !LittleEndian();
+    const float opacity = std::min(1.f - 1e-6f, std::max(1e-6f, options.opacity));
+    const float logitOpacity = std::log(opacity / (1.f - opacity));
+    std::vector<char> vBuffer(std::min<size_t>(P, CHUNK_VERTICES) * stride);
+    for(size_t begin = 0; begin < P; begin += CHUNK_VERTICES)
+    {
+        const size_t end = std::min(P, begin + CHUNK_VERTICES);
+        char* p = vBuffer.data();
+        for(size_t i = begin; i < end; i++)
+        {
+            const Eigen::Vector3f normal = options.bRotations && vSpreads[i][2] < vSpreads[i][1] ?
+                                           Eigen::Vector3f(vRotations[i].col(2)) : Eigen::Vector3f::Zero();
+            for(int a = 0; a < 3; a++)
+                PutFloat(p, vPoints[i][a], bSwap);
+            for(int a = 0; a < 3; a++)
+                PutFloat(p, normal[a], bSwap);
+            for(int a = 0; a < 3; a++)
+                PutUChar(p, vColors[i][a]);
+            if(options.bOpacity)
+                PutFloat(p, logitOpacity, bSwap);
+            if(options.bScales)
+            {
+                Eigen::Vector3f scale = Eigen::Vector3f::Constant(vScales[i]);
+                if(options.bRotations && vSpreads[i][0] > 0.f)
+                    for(int a = 0; a < 3; a++)
+                        scale[a] = vScales[i] * std::max(options.minScaleRatio, vSpreads[i][a] / vSpreads[i][0]);
+                for(int a = 0; a < 3; a++)
+                    PutFloat(p, std::log(scale[a]), bSwap);
+            }
+            if(options.bRotations)
+            {
+                const Eigen::Quaternionf q(vRotations[i]);
+                PutFloat(p, q.w(), bSwap);
+                PutFloat(p, q.x(), bSwap);
+                PutFloat(p, q.y(), bSwap);
+                PutFloat(p, q.z(), bSwap);
+            }
+        }
+        f.write(vBuffer.data(), static_cast<std::streamsize>((end - begin) * stride));
+    }
+    return static_cast<bool>(f);
+}
+
+} //namespace ORB_SLAM
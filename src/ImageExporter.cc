@@ -0,0 +1,338 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageExporter.h"
+#include "KeyFrame.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+#include <opencv2/imgcodecs.hpp>
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+
+std::string Extension(const ImageExporter::Format format)
+{
+    switch(format)
+    {
+        case ImageExporter::JPEG:
+            return ".jpg";
+        case ImageExporter::WEBP:
+            return ".webp";
+        default:
+            return ".png";
+    }
+}
+
+// Culled, or in a map that was reset
+bool IsRemoved(KeyFrame* pKF)
+{
+    return pKF->isBad() || !pKF->GetMap();
+}
+
+bool SameEncoding(const ImageExporter::Options &a, const ImageExporter::Options &b)
+{
+    return a.format == b.format && a.nPngLevel == b.nPngLevel && a.nJpegQuality == b.nJpegQuality;
+}
+
+} // namespace
+
+ImageExporter::ImageExporter(const std::function<cv::Mat(KeyFrame*)> &getImage):
+    mGetImage(getImage), mnPending(0), mbStop(false), mnEncodedBytes(0), mnGeneration(0), mbEncodeErrorShown(false)
+{
+}
+
+ImageExporter::~ImageExporter()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutexQueue);
+        mbStop = true;
+    }
+    mCondTask.notify_all();
+    for(std::thread &th : mvWorkers)
+        th.join();
+}
+
+void ImageExporter::SetOptions(const Options &options)
+{
+    bool bDrop;
+    {
+        std::unique_lock<std::mutex> lock(mMutexOptions);
+        bDrop = !SameEncoding(mOptions, options) || options.nMatureKeyFrames <= 0;
+        mOptions = options;
+        if(mOptions.nMatureKeyFrames <= 0)
+            mdpYoungKeyFrames.clear();
+    }
+    if(bDrop)
+    {
+        std::unique_lock<std::mutex> lock(mMutexEncoded);
+        ClearEncoded();
+        mnGeneration++;
+        mbEncodeErrorShown = false;
+    }
+}
+
+ImageExporter::Options ImageExporter::GetOptions()
+{
+    std::unique_lock<std::mutex> lock(mMutexOptions);
+    return mOptions;
+}
+
+std::string ImageExporter::Filename(KeyFrame* pKF)
+{
+    return std::to_string(pKF->mTimeStamp) + Extension(GetOptions().format);
+}
+
+void ImageExporter::AddKeyFrame(KeyFrame* pKF)
+{
+    KeyFrame* pMatureKF;
+    {
+        std::unique_lock<std::mutex> lock(mMutexOptions);
+        if(mOptions.nMatureKeyFrames <= 0)
+            return;
+        mdpYoungKeyFrames.push_back(pKF);
+        if(mdpYoungKeyFrames.size() <= static_cast<size_t>(mOptions.nMatureKeyFrames))
+            return;
+        pMatureKF = mdpYoungKeyFrames.front();
+        mdpYoungKeyFrames.pop_front();
+    }
+
+    DropRemovedKeyFrames();
+    if(IsRemoved(pMatureKF))
+        return;
+
+    Submit([this, pMatureKF]() {
+        std::vector<uchar> buffer;
+        GetEncoded(pMatureKF, true, buffer);
+    }, false);
+}
+
+size_t ImageExporter::Write(const std::vector<KeyFrame*> &vpKFs, const std::string &directory)
+{
+    std::atomic<size_t> nWritten(0);
+    for(KeyFrame* pKF : vpKFs)
+    {
+        if(!pKF || pKF->isBad())
+            continue;
+        Submit([this, pKF, &directory, &nWritten]() {
+            std::vector<uchar> buffer;
+            if(!GetEncoded(pKF, false, buffer))
+                return;
+            const std::string filename = directory + "/" + Filename(pKF);
+            std::ofstream f(filename.c_str(), std::ios::out | std::ios::binary);
+            f.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+            if(!f)
+                std::cerr << "Error: Failed to save image " << filename << std::endl;
+            else
+                nWritten++;
+        }, true);
+    }
+    WaitIdle();
+    return nWritten;
+}
+
+void ImageExporter::Clear()
+{
+    std::unique_lock<std::mutex> lock(mMutexEncoded);
+    ClearEncoded();
+    mnGeneration++;
+}
+
+void ImageExporter::AddMemoryUsage(MemoryUsage &usage)
+{
+    std::unique_lock<std::mutex> lock(mMutexEncoded);
+    usage.encodedImages += MemoryUsage::MapBytes(mmEncoded);
+    for(const std::pair<KeyFrame* const, std::vector<uchar> > &encoded : mmEncoded)
+        usage.encodedImages += MemoryUsage::VectorBytes(encoded.second);
+}
+
+void ImageExporter::ReleaseOldest(const size_t nBytes)
+{
+    std::unique_lock<std::mutex> lock(mMutexEncoded);
+    const size_t nTarget = mnEncodedBytes > nBytes ? mnEncodedBytes - nBytes : 0;
+    while(!mdpEncoded.empty() && mnEncodedBytes > nTarget)
+        EraseOldestEncoded();
+}
+
+void ImageExporter::DropRemovedKeyFrames()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutexOptions);
+        mdpYoungKeyFrames.erase(std::remove_if(mdpYoungKeyFrames.begin(), mdpYoungKeyFrames.end(), IsRemoved),
+                                mdpYoungKeyFrames.end());
+    }
+
+    std::unique_lock<std::mutex> lock(mMutexEncoded);
+    for(std::map<KeyFrame*, std::vector<uchar> >::iterator it = mmEncoded.begin(); it != mmEncoded.end();)
+    {
+        if(IsRemoved(it->first))
+        {
+            mnEncodedBytes -= MemoryUsage::VectorBytes(it->second);
+            it = mmEncoded.erase(it);
+        }
+        else
+            ++it;
+    }
+    mdpEncoded.erase(std::remove_if(mdpEncoded.begin(), mdpEncoded.end(), IsRemoved), mdpEncoded.end());
+}
+
+void ImageExporter::ClearEncoded()
+{
+    mmEncoded.clear();
+    mdpEncoded.clear();
+    mnEncodedBytes = 0;
+}
+
+void ImageExporter::EraseOldestEncoded()
+{
+    std::map<KeyFrame*, std::vector<uchar> >::iterator it = mmEncoded.find(mdpEncoded.front());
+    mdpEncoded.pop_front();
+    if(it == mmEncoded.end())
+        return;
+    mnEncodedBytes -= MemoryUsage::VectorBytes(it->second);
+    mmEncoded.erase(it);
+}
+
+bool ImageExporter::Submit(const std::function<void()> &task, const bool bBlock)
+{
+    const Options options = GetOptions();
+    std::unique_lock<std::mutex> lock(mMutexQueue);
+    const size_t nMaxQueued = static_cast<size_t>(std::max(1, options.nMaxQueued));
+    if(mvWorkers.empty())
+    {
+        const int nThreads = options.nThreads > 0 ? options.nThreads : std::max(1u, std::thread::hardware_concurrency());
+        for(int i = 0; i < nThreads; i++)
+            mvWorkers.emplace_back(&ImageExporter::Run, this);
+    }
+
+    if(!bBlock && mqTasks.size() >= nMaxQueued)
+        return false;
+    mCondSpace.wait(lock, [&]() { return mqTasks.size() < nMaxQueued; });
+    mqTasks.push_back(task);
+    mnPending++;
+    mCondTask.notify_one();
+    return true;
+}
+
+void ImageExporter::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mMutexQueue);
+    mCondIdle.wait(lock, [&]() { return mnPending == 0; });
+}
+
+void ImageExporter::Run()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutexQueue);
+            mCondTask.wait(lock, [&]() { return mbStop || !mqTasks.empty(); });
+            if(mqTasks.empty())
+                return;
+            task = mqTasks.front();
+            mqTasks.pop_front();
+        }
+        mCondSpace.notify_one();
+
+        task();
+
+        std::unique_lock<std::mutex> lock(mMutexQueue);
+        if(--mnPending == 0)
+            mCondIdle.notify_all();
+    }
+}
+
+bool ImageExporter::GetEncoded(KeyFrame* pKF, const bool bKeep, std::vector<uchar> &buffer)
+{
+    unsigned long nGeneration;
+    {
+        std::unique_lock<std::mutex> lock(mMutexEncoded);
+        mCondEncoded.wait(lock, [&]() { return !mspEncoding.count(pKF); });
+        std::map<KeyFrame*, std::vector<uchar> >::const_iterator it = mmEncoded.find(pKF);
+        if(it != mmEncoded.end())
+        {
+            buffer = it->second;
+            return true;
+        }
+        mspEncoding.insert(pKF);
+        nGeneration = mnGeneration;
+    }
+
+    const Options options = GetOptions();
+    const bool bOk = Encode(pKF, options, buffer);
+    {
+        std::unique_lock<std::mutex> lock(mMutexEncoded);
+        mspEncoding.erase(pKF);
+        if(bOk && bKeep && nGeneration == mnGeneration)
+        {
+            const std::vector<uchar> &encoded = mmEncoded[pKF] = buffer;
+            mdpEncoded.push_back(pKF);
+            mnEncodedBytes += MemoryUsage::VectorBytes(encoded);
+            const size_t nMaxBytes = static_cast<size_t>(options.nMaxEncodedMB) * 1024 * 1024;
+            while(options.nMaxEncodedMB > 0 && mnEncodedBytes > nMaxBytes)
+                EraseOldestEncoded();
+        }
+    }
+    mCondEncoded.notify_all();
+    return bOk;
+}
+
+bool ImageExporter::Encode(KeyFrame* pKF, const Options &options, std::vector<uchar> &buffer)
+{
+    buffer.clear();
+    const cv::Mat im = mGetImage(pKF);
+    if(im.empty())
+        return false;
+
+    std::vector<int> vParams;
+    if(options.format == JPEG)
+        vParams = {cv::IMWRITE_JPEG_QUALITY, std::min(100, std::max(0, options.nJpegQuality))};
+    else if(options.format == WEBP)
+        vParams = {cv::IMWRITE_WEBP_QUALITY, 101};
+    else
+        vParams = {cv::IMWRITE_PNG_COMPRESSION, std::min(9, std::max(0, options.nPngLevel))};
+
+    // Formats that OpenCV is built without throw
+    bool bOk = false;
+    std::string strError;
+    try
+    {
+        bOk = cv::imencode(Extension(options.format), im, buffer, vParams);
+    }
+    catch(const cv::Exception &e)
+    {
+        strError = e.what();
+    }
+    if(!bOk)
+    {
+        std::unique_lock<std::mutex> lock(mMutexEncoded);
+        if(!mbEncodeErrorShown)
+            std::cerr << "Error: Failed to encode the images as " << Extension(options.format) << " " << strError << std::endl;
+        mbEncodeErrorShown = true;
+    }
+    return bOk;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,110 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ImageUndistorter.h"
+
+#include <opencv2/imgproc.hpp>
+
+namespace ORB_SLAM3
+{
+
+ImageUndistorter::ImageUndistorter(const float fx, const float fy, const float cx, const float cy, const cv::Mat &distCoef,
+                                   const cv::Size &imageSize, const bool bCrop):
+    fx(fx), fy(fy), cx(cx), cy(cy), mSize(imageSize), mROI(0, 0, imageSize.width, imageSize.height)
+{
+    mbIdentity = distCoef.empty() || cv::countNonZero(distCoef) == 0;
+    if(mbIdentity)
+        return;
+
+    cv::Mat K = (cv::Mat_<float>(3,3) << fx, 0.f, cx, 0.f, fy, cy, 0.f, 0.f, 1.f);
+    cv::Mat mapX, mapY;
+    cv::initUndistortRectifyMap(K, distCoef, cv::Mat(), K, imageSize, CV_32FC1, mapX, mapY);
+
+    if(bCrop)
+    {
+        // Shrink the image borders, the one with more pixels sampled outside the source first,
+        // until the rectangle only holds valid pixels
+        const float maxX = imageSize.width - 1, maxY = imageSize.height - 1;
+        auto invalid = [&](const int x, const int y) {
+            const float u = mapX.at<float>(y,x), v = mapY.at<float>(y,x);
+            return u < 0.f || v < 0.f || u > maxX || v > maxY;
+        };
+
+        int x0 = 0, y0 = 0, x1 = imageSize.width - 1, y1 = imageSize.height - 1;
+        while(x0 < x1 && y0 < y1)
+        {
+            int nLeft = 0, nRight = 0, nTop = 0, nBottom = 0;
+            for(int y = y0; y <= y1; y++)
+            {
+                nLeft += invalid(x0,y);
+                nRight += invalid(x1,y);
+            }
+            for(int x = x0; x <= x1; x++)
+            {
+                nTop += invalid(x,y0);
+                nBottom += invalid(x,y1);
+            }
+
+            const int nMax = std::max(std::max(nLeft, nRight), std::max(nTop, nBottom));
+            if(nMax == 0)
+                break;
+            if(nLeft == nMax)
+                x0++;
+            else if(nRight == nMax)
+                x1--;
+            else if(nTop == nMax)
+                y0++;
+            else
+                y1--;
+        }
+
+        mROI = cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+        this->cx = cx - x0;
+        this->cy = cy - y0;
+        mSize = mROI.size();
+    }
+
+    // Fixed point tables remap faster
+    cv::convertMaps(mapX, mapY, mMap1, mMap2, CV_16SC2);
+}
+
+void ImageUndistorter::Undistort(const cv::Mat &im, cv::Mat &imOut) const
+{
+    if(mbIdentity)
+    {
+        imOut = im;
+        return;
+    }
+
+    cv::Mat imUn;
+    cv::remap(im, imUn, mMap1, mMap2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    imOut = imUn(mROI);
+}
+
+cv::Point2f ImageUndistorter::Map(const cv::Point2f &ptUn) const
+{
+    return cv::Point2f(ptUn.x - mROI.x, ptUn.y - mROI.y);
+}
+
+bool ImageUndistorter::IsInside(const cv::Point2f &pt) const
+{
+    return pt.x >= 0.f && pt.y >= 0.f && pt.x < mSize.width && pt.y < mSize.height;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,127 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ImuRingBuffer.h"
+
+#include <limits>
+
+namespace ORB_SLAM3
+{
+
+static uint64_t RoundUpPowerOfTwo(const size_t n)
+{
+    uint64_t p = 1;
+    while(p<n)
+        p <<= 1;
+    return p;
+}
+
+ImuRingBuffer::ImuRingBuffer(const size_t capacity):
+    mvBuffer(RoundUpPowerOfTwo(capacity), IMU::Point(0.f,0.f,0.f,0.f,0.f,0.f,0.0)),
+    mnMask(RoundUpPowerOfTwo(capacity)-1), mnHead(0), mnTail(0), mnStream(0),
+    mLastTimestamp(-std::numeric_limits<double>::max()), mnLastStream(0), mnDropped(0)
+{
+}
+
+bool ImuRingBuffer::Push(const IMU::Point &imuMeasurement)
+{
+    const uint64_t stream = mnStream.load(std::memory_order_acquire);
+    if(stream!=mnLastStream)
+    {
+        mLastTimestamp = -std::numeric_limits<double>::max();
+        mnLastStream = stream;
+    }
+
+    // The window extraction relies on ordered timestamps
+    if(imuMeasurement.t<mLastTimestamp)
+    {
+        mnDropped.fetch_add(1,std::memory_order_relaxed);
+        return false;
+    }
+
+    const uint64_t head = mnHead.load(std::memory_order_relaxed);
+    if(head-mnTail.load(std::memory_order_acquire)>mnMask)
+    {
+        mnDropped.fetch_add(1,std::memory_order_relaxed);
+        return false;
+    }
+
+    mvBuffer[head & mnMask] = imuMeasurement;
+    mLastTimestamp = imuMeasurement.t;
+    mnHead.store(head+1,std::memory_order_release);
+    return true;
+}
+
+uint64_t ImuRingBuffer::LowerBound(uint64_t first, uint64_t last, const double t) const
+{
+    while(first<last)
+    {
+        const uint64_t mid = first+(last-first)/2;
+        if(mvBuffer[mid & mnMask].t<t)
+            first = mid+1;
+        else
+            last = mid;
+    }
+    return first;
+}
+
+void ImuRingBuffer::ExtractWindow(const double t0, const double t1, std::vector<IMU::Point> &vImu)
+{
+    vImu.clear();
+
+    const uint64_t tail = mnTail.load(std::memory_order_relaxed);
+    const uint64_t head = mnHead.load(std::memory_order_acquire);
+    if(tail==head)
+        return;
+
+    const uint64_t first = LowerBound(tail,head,t0);
+    const uint64_t last = LowerBound(first,head,t1);
+    const uint64_t end = last<head ? last+1 : head;
+
+    vImu.reserve(end-first);
+    for(uint64_t i=first; i<end; i++)
+        vImu.push_back(mvBuffer[i & mnMask]);
+
+    // The sample at t1 (if any) starts the next window, keep it
+    mnTail.store(last,std::memory_order_release);
+}
+
+void ImuRingBuffer::Clear()
+{
+    mnStream.fetch_add(1,std::memory_order_acq_rel);
+    mnTail.store(mnHead.load(std::memory_order_acquire),std::memory_order_release);
+}
+
+size_t ImuRingBuffer::Size() const
+{
+    const uint64_t tail = mnTail.load(std::memory_order_acquire);
+    return mnHead.load(std::memory_order_acquire)-tail;
+}
+
+size_t ImuRingBuffer::Capacity() const
+{
+    return mvBuffer.size();
+}
+
+size_t ImuRingBuffer::Dropped() const
+{
+    return mnDropped.load(std::memory_order_relaxed);
+}
+
+} //namespace ORB_SLAM
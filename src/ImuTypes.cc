@@ -96,11 +96,16 @@ IntegratedRotation::IntegratedRotation(const Eigen::Vector3f &angVel, const Bias
     {
         deltaR = Eigen::Matrix3f::Identity() + W;
         rightJ = Eigen::Matrix3f::Identity();
+        deltaQ = Eigen::Quaternionf(1.0f, 0.5f*x, 0.5f*y, 0.5f*z);
+        deltaQ.normalize();
     }
     else
     {
-        deltaR = Eigen::Matrix3f::Identity() + W*sin(d)/d + W*W*(1.0f-cos(d))/d2;
-        rightJ = Eigen::Matrix3f::Identity() - W*(1.0f-cos(d))/d2 + W*W*(d-sin(d))/(d2*d);
+        const float s = sin(d), c = cos(d);
+        deltaR = Eigen::Matrix3f::Identity() + W*s/d + W*W*(1.0f-c)/d2;
+        rightJ = Eigen::Matrix3f::Identity() - W*(1.0f-c)/d2 + W*W*(d-s)/(d2*d);
+        const float sh = sin(0.5f*d)/d;
+        deltaQ = Eigen::Quaternionf(cos(0.5f*d), sh*x, sh*y, sh*z);
     }
 }
 
@@ -168,8 +173,10 @@ void Preintegrated::Initialize(const Bias &b_)
 void Preintegrated::Reintegrate()
 {
     std::unique_lock<std::mutex> lock(mMutex);
-    const std::vector<integrable> aux = mvMeasurements;
+    std::vector<integrable> aux;
+    aux.swap(mvMeasurements);
     Initialize(bu);
+    mvMeasurements.reserve(aux.size());
     for(size_t i=0;i<aux.size();i++)
         IntegrateNewMeasurement(aux[i].a,aux[i].w,aux[i].t);
 }
@@ -182,53 +189,80 @@ void Preintegrated::IntegrateNewMeasurement(const Eigen::Vector3f &acceleration,
     // Velocity is updated secondly, as it depends on previously computed rotation.
     // Rotation is the last to be updated.
 
-    //Matrices to compute covariance
-    Eigen::Matrix<float,9,9> A;
-    A.setIdentity();
-    Eigen::Matrix<float,9,6> B;
-    B.setZero();
-
     Eigen::Vector3f acc, accW;
     acc << acceleration(0)-b.bax, acceleration(1)-b.bay, acceleration(2)-b.baz;
     accW << angVel(0)-b.bwx, angVel(1)-b.bwy, angVel(2)-b.bwz;
 
-    avgA = (dT*avgA + dR*acc*dt)/(dT+dt);
+    const Eigen::Vector3f dRacc = dR*acc;
+    avgA = (dT*avgA + dRacc*dt)/(dT+dt);
     avgW = (dT*avgW + accW*dt)/(dT+dt);
 
     // Update delta position dP and velocity dV (rely on no-updated delta rotation)
-    dP = dP + dV*dt + 0.5f*dR*acc*dt*dt;
-    dV = dV + dR*acc*dt;
-
-    // Compute velocity and position parts of matrices A and B (rely on non-updated delta rotation)
-    Eigen::Matrix<float,3,3> Wacc = Sophus::SO3f::hat(acc);
-
-    A.block<3,3>(3,0) = -dR*dt*Wacc;
-    A.block<3,3>(6,0) = -0.5f*dR*dt*dt*Wacc;
-    A.block<3,3>(6,3) = Eigen::DiagonalMatrix<float,3>(dt, dt, dt);
-    B.block<3,3>(3,3) = dR*dt;
-    B.block<3,3>(6,3) = 0.5f*dR*dt*dt;
-
+    dP = dP + dV*dt + 0.5f*dRacc*dt*dt;
+    dV = dV + dRacc*dt;
+
+    // Non-zero blocks of the covariance propagation matrices (rely on non-updated delta rotation)
+    //     | dRi^T  0     0 |        | Jr*dt  0           |
+    // A = | Av     I     0 |    B = | 0      dR*dt       |
+    //     | Ap     I*dt  I |        | 0      0.5*dR*dt^2 |
+    const Eigen::Matrix3f Wacc = Sophus::SO3f::hat(acc);
+    const Eigen::Matrix3f dRWacc = dR*Wacc;
+    const Eigen::Matrix3f Av = -dt*dRWacc;
+    const Eigen::Matrix3f Ap = 0.5f*dt*Av;
 
     // Update position and velocity jacobians wrt bias correction
+    const Eigen::Matrix3f dRWaccJRg = dRWacc*JRg;
     JPa = JPa + JVa*dt -0.5f*dR*dt*dt;
-    JPg = JPg + JVg*dt -0.5f*dR*dt*dt*Wacc*JRg;
+    JPg = JPg + JVg*dt -0.5f*dt*dt*dRWaccJRg;
     JVa = JVa - dR*dt;
-    JVg = JVg - dR*dt*Wacc*JRg;
+    JVg = JVg - dt*dRWaccJRg;
 
-    // Update delta rotation
-    IntegratedRotation dRi(angVel,b,dt);
-    dR = NormalizeRotation(dR*dRi.deltaR);
-
-    // Compute rotation parts of matrices A and B
-    A.block<3,3>(0,0) = dRi.deltaR.transpose();
-    B.block<3,3>(0,0) = dRi.rightJ*dt;
+    // Acceleration noise mapped through the non-updated delta rotation
+    const Eigen::Matrix3f NaR = dR*Nga.diagonal().tail<3>().asDiagonal()*dR.transpose();
 
-    // Update covariance
-    C.block<9,9>(0,0) = A * C.block<9,9>(0,0) * A.transpose() + B*Nga*B.transpose();
+    // Update delta rotation. The product of unit quaternions only needs a renormalization
+    // to stay a rotation (instead of projecting the matrix product with an SVD)
+    IntegratedRotation dRi(angVel,b,dt);
+    Eigen::Quaternionf dQ = Eigen::Quaternionf(dR)*dRi.deltaQ;
+    dQ.normalize();
+    dR = dQ.toRotationMatrix();
+
+    const Eigen::Matrix3f Rt = dRi.deltaR.transpose();
+    const Eigen::Matrix3f JrDt = dRi.rightJ*dt;
+
+    // Update covariance C = A*C*A^T + B*Nga*B^T using the block structure of A and B
+    Eigen::Matrix3f C00 = C.block<3,3>(0,0), C01 = C.block<3,3>(0,3), C02 = C.block<3,3>(0,6);
+    Eigen::Matrix3f C11 = C.block<3,3>(3,3), C12 = C.block<3,3>(3,6), C22 = C.block<3,3>(6,6);
+
+    // M = A*C (rows of blocks), only the blocks needed for the upper triangle of M*A^T
+    const Eigen::Matrix3f M00 = Rt*C00, M01 = Rt*C01, M02 = Rt*C02;
+    const Eigen::Matrix3f M10 = Av*C00 + C01.transpose();
+    const Eigen::Matrix3f M11 = Av*C01 + C11;
+    const Eigen::Matrix3f M12 = Av*C02 + C12;
+    const Eigen::Matrix3f M20 = Ap*C00 + dt*C01.transpose() + C02.transpose();
+    const Eigen::Matrix3f M21 = Ap*C01 + dt*C11 + C12.transpose();
+    const Eigen::Matrix3f M22 = Ap*C02 + dt*C12 + C22;
+
+    C00 = M00*dRi.deltaR + JrDt*Nga.diagonal().head<3>().asDiagonal()*JrDt.transpose();
+    C01 = M00*Av.transpose() + M01;
+    C02 = M00*Ap.transpose() + dt*M01 + M02;
+    C11 = M10*Av.transpose() + M11 + dt*dt*NaR;
+    C12 = M10*Ap.transpose() + dt*M11 + M12 + 0.5f*dt*dt*dt*NaR;
+    C22 = M20*Ap.transpose() + dt*M21 + M22 + 0.25f*dt*dt*dt*dt*NaR;
+
+    C.block<3,3>(0,0) = C00;
+    C.block<3,3>(0,3) = C01;
+    C.block<3,3>(0,6) = C02;
+    C.block<3,3>(3,3) = C11;
+    C.block<3,3>(3,6) = C12;
+    C.block<3,3>(6,6) = C22;
+    C.block<3,3>(3,0) = C01.transpose();
+    C.block<3,3>(6,0) = C02.transpose();
+    C.block<3,3>(6,3) = C12.transpose();
     C.block<6,6>(9,9) += NgaWalk;
 
     // Update rotation jacobian wrt bias correction
-    JRg = dRi.deltaR.transpose()*JRg - dRi.rightJ*dt;
+    JRg = Rt*JRg - JrDt;
 
     // Total integrated time
     dT += dt;
@@ -250,9 +284,11 @@ void Preintegrated::MergePrevious(Preintegrated* pPrev)
     bav.baz = bu.baz;
 
     const std::vector<integrable > aux1 = pPrev->mvMeasurements;
-    const std::vector<integrable> aux2 = mvMeasurements;
+    std::vector<integrable> aux2;
+    aux2.swap(mvMeasurements);
 
     Initialize(bav);
+    mvMeasurements.reserve(aux1.size()+aux2.size());
     for(size_t i=0;i<aux1.size();i++)
         IntegrateNewMeasurement(aux1[i].a,aux1[i].w,aux1[i].t);
     for(size_t i=0;i<aux2.size();i++)
@@ -0,0 +1,574 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Instrumentation.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <limits>
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+std::atomic<int> Instrumentation::mnFlags(0);
+
+namespace
+{
+
+struct StageInfo
+{
+    const char* name;
+    bool bTime;
+};
+
+const StageInfo vStageInfo[Instrumentation::NUM_STAGES] =
+{
+    {"Stereo Rectification", true},
+    {"Image Resize", true},
+    {"ORB Extraction", true},
+    {"Stereo Matching", true},
+    {"IMU Preintegration", true},
+    {"Pose Prediction", true},
+    {"LM Track", true},
+    {"New KF decision", true},
+    {"Total Tracking", true},
+
+    {"KF Insertion", true},
+    {"MP Culling", true},
+    {"MP Creation", true},
+    {"LBA", true},
+    {"LBA aborted", true},
+    {"KF Culling", true},
+    {"Total Local Mapping", true},
+    {"LBA Edges", false},
+    {"LBA KF optimized", false},
+    {"LBA KF fixed", false},
+    {"LBA MP", false},
+
+    {"Database Query", true},
+    {"SE3 estimation", true},
+    {"Total Place Recognition", true},
+    {"Loop Fusion", true},
+    {"Loop Essential Graph", true},
+    {"Total Loop Closing", true},
+    {"Merge Maps", true},
+    {"Welding BA", true},
+    {"Merge Essential Graph", true},
+    {"Total Map Merging", true},
+    {"Merge KFs", false},
+    {"Merge MPs", false},
+    {"GBA", true},
+    {"GBA aborted", true},
+    {"GBA Map Update", true},
+    {"Total Full GBA", true},
+    {"GBA KFs", false},
+    {"GBA MPs", false}
+};
+
+// Log-linear buckets: exact below 64, then 32 sub-buckets per power of two (~3% resolution)
+// up to 2^40 (about 12 days in microseconds)
+const int nSubBuckets = 32;
+const int nMaxExponent = 40;
+const int nBuckets = (nMaxExponent-4)*nSubBuckets;
+
+inline int BucketIndex(uint64_t v)
+{
+    if(v>=(1ull<<nMaxExponent))
+        v = (1ull<<nMaxExponent)-1;
+    if(v<2*nSubBuckets)
+        return static_cast<int>(v);
+    const int shift = 63-__builtin_clzll(v)-5;
+    return shift*nSubBuckets+static_cast<int>(v>>shift);
+}
+
+inline double BucketValue(const int idx)
+{
+    if(idx<2*nSubBuckets)
+        return idx;
+    const int shift = idx/nSubBuckets-1;
+    const uint64_t sub = idx-shift*nSubBuckets;
+    return static_cast<double>(sub<<shift)+0.5*static_cast<double>((1ull<<shift)-1);
+}
+
+// Waits shorter than this are uncontended locks, they would only clutter the timeline
+const int64_t nMinWaitNs = 5000;
+
+struct TraceRecord
+{
+    const char* name;
+    const char* category;
+    int64_t start;
+    int64_t end;
+};
+
+// Ring of the last events of a thread. Only the owner writes, the head is published with release.
+struct TraceBuffer
+{
+    static const uint64_t nCapacity = 1<<15;
+
+    TraceBuffer(): mvEvents(nCapacity), mnHead(0) {}
+
+    vector<TraceRecord> mvEvents;
+    std::atomic<uint64_t> mnHead;
+};
+
+// Histograms and trace written by a single thread. Blocks are recycled when their thread exits so that
+// short-lived threads (e.g. global BA) do not grow the registry; in the timeline a block is one lane.
+struct ThreadHistograms
+{
+    std::atomic<uint64_t> counts[Instrumentation::NUM_STAGES][nBuckets];
+    std::atomic<uint64_t> sum[Instrumentation::NUM_STAGES];
+    std::atomic<uint64_t> max[Instrumentation::NUM_STAGES];
+    std::atomic<TraceBuffer*> mpTrace;
+    std::string mName;
+    bool bInUse;
+};
+
+struct Registry
+{
+    std::mutex mMutex;
+    std::vector<ThreadHistograms*> mvpBlocks;
+};
+
+Registry& GetRegistry()
+{
+    // Never destroyed, threads may still exit after static destruction starts
+    static Registry* pRegistry = new Registry();
+    return *pRegistry;
+}
+
+struct ThreadHandle
+{
+    ThreadHistograms* mpBlock = nullptr;
+
+    ThreadHistograms* Get()
+    {
+        if(mpBlock)
+            return mpBlock;
+
+        Registry &registry = GetRegistry();
+        unique_lock<mutex> lock(registry.mMutex);
+        for(ThreadHistograms* pBlock : registry.mvpBlocks)
+        {
+            if(!pBlock->bInUse)
+            {
+                // The histograms keep accumulating, the name belonged to the previous thread
+                pBlock->mName.clear();
+                mpBlock = pBlock;
+                break;
+            }
+        }
+        if(!mpBlock)
+        {
+            mpBlock = new ThreadHistograms();
+            registry.mvpBlocks.push_back(mpBlock);
+        }
+        mpBlock->bInUse = true;
+        return mpBlock;
+    }
+
+    ~ThreadHandle()
+    {
+        if(!mpBlock)
+            return;
+        Registry &registry = GetRegistry();
+        unique_lock<mutex> lock(registry.mMutex);
+        mpBlock->bInUse = false;
+    }
+};
+
+thread_local ThreadHandle threadHandle;
+
+struct Snapshot
+{
+    Snapshot(): counts(Instrumentation::NUM_STAGES*nBuckets,0), sum(Instrumentation::NUM_STAGES,0), max(Instrumentation::NUM_STAGES,0) {}
+
+    vector<uint64_t> counts;
+    vector<uint64_t> sum;
+    vector<uint64_t> max;
+};
+
+void TakeSnapshot(Snapshot &snapshot)
+{
+    Registry &registry = GetRegistry();
+    unique_lock<mutex> lock(registry.mMutex);
+    for(ThreadHistograms* pBlock : registry.mvpBlocks)
+    {
+        for(int s=0; s<Instrumentation::NUM_STAGES; s++)
+        {
+            uint64_t* pCounts = &snapshot.counts[s*nBuckets];
+            for(int i=0; i<nBuckets; i++)
+                pCounts[i] += pBlock->counts[s][i].load(std::memory_order_relaxed);
+            snapshot.sum[s] += pBlock->sum[s].load(std::memory_order_relaxed);
+            snapshot.max[s] = std::max(snapshot.max[s],pBlock->max[s].load(std::memory_order_relaxed));
+        }
+    }
+}
+
+// Statistics of the samples in current but not in previous (if given)
+vector<Instrumentation::StageStats> ComputeStats(const Snapshot &current, const Snapshot* pPrevious)
+{
+    vector<Instrumentation::StageStats> vStats;
+    vector<uint64_t> vCounts(nBuckets);
+    for(int s=0; s<Instrumentation::NUM_STAGES; s++)
+    {
+        uint64_t total = 0;
+        int lastBucket = 0;
+        for(int i=0; i<nBuckets; i++)
+        {
+            vCounts[i] = current.counts[s*nBuckets+i] - (pPrevious ? pPrevious->counts[s*nBuckets+i] : 0);
+            total += vCounts[i];
+            if(vCounts[i])
+                lastBucket = i;
+        }
+        if(total==0)
+            continue;
+
+        const double scale = vStageInfo[s].bTime ? 1e-3 : 1.0;
+
+        Instrumentation::StageStats stats;
+        stats.stage = static_cast<Instrumentation::eStage>(s);
+        stats.name = vStageInfo[s].name;
+        stats.unit = vStageInfo[s].bTime ? "ms" : "#";
+        stats.count = total;
+        stats.mean = scale*static_cast<double>(current.sum[s] - (pPrevious ? pPrevious->sum[s] : 0))/total;
+
+        const uint64_t n50 = (total*50+99)/100;
+        const uint64_t n99 = (total*99+99)/100;
+        uint64_t accum = 0;
+        stats.p50 = stats.p99 = 0.0;
+        for(int i=0; i<nBuckets; i++)
+        {
+            if(!vCounts[i])
+                continue;
+            if(accum<n50 && accum+vCounts[i]>=n50)
+                stats.p50 = scale*BucketValue(i);
+            if(accum<n99 && accum+vCounts[i]>=n99)
+            {
+                stats.p99 = scale*BucketValue(i);
+                break;
+            }
+            accum += vCounts[i];
+        }
+
+        // The exact maximum is only known for the whole run
+        stats.max = pPrevious ? scale*BucketValue(lastBucket) : scale*current.max[s];
+
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
+struct Exporter
+{
+    std::thread* mptExport = nullptr;
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    bool mbStop = false;
+};
+
+Exporter& GetExporter()
+{
+    static Exporter exporter;
+    return exporter;
+}
+
+void ExportLoop(const string filename, const double period, const std::function<void(const vector<Instrumentation::StageStats>&)> callback)
+{
+    Exporter &exporter = GetExporter();
+
+    ofstream f;
+    if(!filename.empty())
+    {
+        f.open(filename.c_str());
+        f << "#time[s],stage,unit,count,mean,p50,p99,max" << endl;
+        f << fixed << setprecision(4);
+    }
+
+    const std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    Snapshot previous;
+    TakeSnapshot(previous);
+
+    bool bStop = false;
+    while(!bStop)
+    {
+        {
+            unique_lock<mutex> lock(exporter.mMutex);
+            exporter.mCond.wait_for(lock,std::chrono::duration<double>(period),[&exporter]{return exporter.mbStop;});
+            bStop = exporter.mbStop;
+        }
+
+        Snapshot current;
+        TakeSnapshot(current);
+        const vector<Instrumentation::StageStats> vStats = ComputeStats(current,&previous);
+        previous = current;
+
+        const double t = std::chrono::duration_cast<std::chrono::duration<double> >(std::chrono::steady_clock::now() - tStart).count();
+        if(f.is_open())
+        {
+            for(const Instrumentation::StageStats &stats : vStats)
+                f << t << "," << stats.name << "," << stats.unit << "," << stats.count << "," << stats.mean << ","
+                  << stats.p50 << "," << stats.p99 << "," << stats.max << "\n";
+            f.flush();
+        }
+
+        if(callback && !vStats.empty())
+            callback(vStats);
+    }
+}
+
+} // namespace
+
+void Instrumentation::SetEnabled(const bool bEnabled)
+{
+    if(bEnabled)
+        mnFlags.fetch_or(HISTOGRAMS,std::memory_order_relaxed);
+    else
+        mnFlags.fetch_and(~HISTOGRAMS,std::memory_order_relaxed);
+}
+
+void Instrumentation::SetTracing(const bool bTracing)
+{
+    if(bTracing)
+        mnFlags.fetch_or(TRACING,std::memory_order_relaxed);
+    else
+        mnFlags.fetch_and(~TRACING,std::memory_order_relaxed);
+}
+
+void Instrumentation::SetThreadName(const string &name)
+{
+    ThreadHistograms* pBlock = threadHandle.Get();
+    unique_lock<mutex> lock(GetRegistry().mMutex);
+    pBlock->mName = name;
+}
+
+void Instrumentation::RecordStage(const eStage stage, const TimePoint start, const TimePoint end)
+{
+    const int flags = mnFlags.load(std::memory_order_relaxed);
+    if(flags & HISTOGRAMS)
+        Record(stage,static_cast<uint64_t>(end>start ? (end-start)/1000 : 0));
+    if(flags & TRACING)
+        TraceEvent(vStageInfo[stage].name,"stage",start,end);
+}
+
+void Instrumentation::TraceEvent(const char* name, const char* category, const TimePoint start, const TimePoint end)
+{
+    if(!IsTracing())
+        return;
+
+    ThreadHistograms* pBlock = threadHandle.Get();
+    TraceBuffer* pTrace = pBlock->mpTrace.load(std::memory_order_relaxed);
+    if(!pTrace)
+    {
+        pTrace = new TraceBuffer();
+        pBlock->mpTrace.store(pTrace,std::memory_order_release);
+    }
+
+    const uint64_t head = pTrace->mnHead.load(std::memory_order_relaxed);
+    TraceRecord &event = pTrace->mvEvents[head & (TraceBuffer::nCapacity-1)];
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.end = end;
+    pTrace->mnHead.store(head+1,std::memory_order_release);
+}
+
+void Instrumentation::TraceWaitEnd(const char* name, const TimePoint start)
+{
+    const TimePoint end = Now();
+    if(end && end-start>=nMinWaitNs)
+        TraceEvent(name,"wait",start,end);
+}
+
+void Instrumentation::Record(const eStage stage, const uint64_t value)
+{
+    // Only this thread writes its block, plain load/store keeps the histograms free of locked instructions
+    ThreadHistograms* pBlock = threadHandle.Get();
+    std::atomic<uint64_t> &bucket = pBlock->counts[stage][BucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+    pBlock->sum[stage].store(pBlock->sum[stage].load(std::memory_order_relaxed)+value,std::memory_order_relaxed);
+    if(value>pBlock->max[stage].load(std::memory_order_relaxed))
+        pBlock->max[stage].store(value,std::memory_order_relaxed);
+}
+
+void Instrumentation::RecordTime(const eStage stage, const double ms)
+{
+    if(IsEnabled())
+        Record(stage,static_cast<uint64_t>(std::max(0.0,ms*1e3)));
+}
+
+void Instrumentation::RecordCount(const eStage stage, const uint64_t n)
+{
+    if(IsEnabled())
+        Record(stage,n);
+}
+
+vector<Instrumentation::StageStats> Instrumentation::GetStats()
+{
+    Snapshot current;
+    TakeSnapshot(current);
+    return ComputeStats(current,static_cast<Snapshot*>(NULL));
+}
+
+const char* Instrumentation::StageName(const eStage stage)
+{
+    return vStageInfo[stage].name;
+}
+
+void Instrumentation::StartExport(const string &filename, const double period,
+                                  const std::function<void(const vector<StageStats>&)> &callback)
+{
+    StopExport();
+
+    Exporter &exporter = GetExporter();
+    unique_lock<mutex> lock(exporter.mMutex);
+    exporter.mbStop = false;
+    exporter.mptExport = new thread(&ExportLoop,filename,max(0.01,period),callback);
+}
+
+void Instrumentation::StopExport()
+{
+    Exporter &exporter = GetExporter();
+    thread* ptExport;
+    {
+        unique_lock<mutex> lock(exporter.mMutex);
+        ptExport = exporter.mptExport;
+        exporter.mptExport = nullptr;
+        exporter.mbStop = true;
+    }
+    exporter.mCond.notify_all();
+
+    if(ptExport)
+    {
+        ptExport->join();
+        delete ptExport;
+    }
+}
+
+void Instrumentation::PrintSummary(const string &filename)
+{
+    const vector<StageStats> vStats = GetStats();
+    if(vStats.empty())
+        return;
+
+    ofstream f;
+    if(!filename.empty())
+        f.open(filename.c_str());
+
+    ostringstream ss;
+    ss << fixed << setprecision(3);
+    ss << " STAGE STATS (count, mean, p50, p99, max)" << endl;
+    ss << "---------------------------" << endl;
+    for(const StageStats &stats : vStats)
+    {
+        ss << stats.name << " [" << stats.unit << "]: " << stats.count << ", " << stats.mean << ", "
+           << stats.p50 << ", " << stats.p99 << ", " << stats.max << endl;
+    }
+
+    cout << endl << ss.str() << endl;
+    if(f.is_open())
+        f << ss.str();
+}
+
+static string JsonEscape(const string &str)
+{
+    string out;
+    for(const char c : str)
+    {
+        if(c=='"' || c=='\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+bool Instrumentation::WriteTrace(const string &filename)
+{
+    // Copy the events first, the registry lock is not held while writing the file
+    vector<vector<TraceRecord> > vvEvents;
+    vector<string> vNames;
+    {
+        Registry &registry = GetRegistry();
+        unique_lock<mutex> lock(registry.mMutex);
+        for(ThreadHistograms* pBlock : registry.mvpBlocks)
+        {
+            vvEvents.push_back(vector<TraceRecord>());
+            vNames.push_back(pBlock->mName);
+
+            TraceBuffer* pTrace = pBlock->mpTrace.load(std::memory_order_acquire);
+            if(!pTrace)
+                continue;
+            const uint64_t head = pTrace->mnHead.load(std::memory_order_acquire);
+            // Skip a margin of the oldest slots, the owner may be overwriting them right now
+            const uint64_t margin = 256;
+            const uint64_t first = head>TraceBuffer::nCapacity-margin ? head-(TraceBuffer::nCapacity-margin) : 0;
+            vvEvents.back().reserve(head-first);
+            for(uint64_t i=first; i<head; i++)
+                vvEvents.back().push_back(pTrace->mvEvents[i & (TraceBuffer::nCapacity-1)]);
+        }
+    }
+
+    int64_t t0 = std::numeric_limits<int64_t>::max();
+    size_t nEvents = 0;
+    for(const vector<TraceRecord> &vEvents : vvEvents)
+    {
+        for(const TraceRecord &event : vEvents)
+            t0 = std::min(t0,event.start);
+        nEvents += vEvents.size();
+    }
+
+    ofstream f(filename.c_str());
+    if(!f.is_open())
+    {
+        cerr << "Failed to open trace file " << filename << endl;
+        return false;
+    }
+
+    f << fixed << setprecision(3);
+    f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+    bool bFirst = true;
+    for(size_t tid=0; tid<vvEvents.size(); tid++)
+    {
+        const string name = vNames[tid].empty() ? "Thread " + to_string(tid) : vNames[tid];
+        f << (bFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+          << ",\"args\":{\"name\":\"" << JsonEscape(name) << "\"}}";
+        bFirst = false;
+
+        for(const TraceRecord &event : vvEvents[tid])
+        {
+            f << ",\n{\"name\":\"" << JsonEscape(event.name) << "\",\"cat\":\"" << event.category
+              << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+              << ",\"ts\":" << (event.start-t0)*1e-3 << ",\"dur\":" << (event.end-event.start)*1e-3 << "}";
+        }
+    }
+    f << endl << "]}" << endl;
+
+    cout << "Trace with " << nEvents << " events saved to " << filename << endl;
+    return true;
+}
+
+} //namespace ORB_SLAM
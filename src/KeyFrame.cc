@@ -25,6 +25,8 @@ namespace ORB_SLAM3
 {
 
 long unsigned int KeyFrame::nNextId=0;
+vector<KeyFrame*> KeyFrame::mvpRebuiltGrids;
+mutex KeyFrame::mMutexRebuiltGrids;
 
 KeyFrame::KeyFrame():
         mnFrameId(0),  mTimeStamp(0), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
@@ -39,7 +41,7 @@ KeyFrame::KeyFrame():
         mbToBeErased(false), mbBad(false), mHalfBaseline(0), mbCurrentPlaceRecognition(false), mnMergeCorrectedForKF(0),
         NLeft(0),NRight(0), mnNumberOfOpt(0), mbHasVelocity(false)
 {
-
+    mbGridReleased = false;
 }
 
 KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
@@ -63,6 +65,7 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
 {
     mnId=nNextId++;
 
+    mbGridReleased = false;
     mGrid.resize(mnGridCols);
     if(F.Nleft != -1)  mGridRight.resize(mnGridCols);
     for(int i=0; i<mnGridCols;i++)
@@ -725,11 +728,24 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     if(nMaxCellY<0)
         return vIndices;
 
+    unique_lock<mutex> lock(mMutexGrid);
+    if(mGrid.empty())
+    {
+        AssignFeaturesToGrid();
+        // Hand the keyframe back to the memory policy so the rebuilt grid is released again
+        if(mbGridReleased)
+        {
+            mbGridReleased = false;
+            unique_lock<mutex> lock2(mMutexRebuiltGrids);
+            mvpRebuiltGrids.push_back(const_cast<KeyFrame*>(this));
+        }
+    }
+
     for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
+            const vector<size_t> &vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
             for(size_t j=0, jend=vCell.size(); j<jend; j++)
             {
                 const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[vCell[j]]
@@ -747,6 +763,94 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     return vIndices;
 }
 
+void KeyFrame::AssignFeaturesToGrid() const
+{
+    // Same assignment as Frame::AssignFeaturesToGrid, mMutexGrid must be locked
+    mGrid.assign(mnGridCols,vector<vector<size_t> >(mnGridRows));
+    if(NLeft != -1)
+        mGridRight.assign(mnGridCols,vector<vector<size_t> >(mnGridRows));
+
+    for(int i=0; i<N; i++)
+    {
+        const cv::KeyPoint &kp = (NLeft == -1) ? mvKeysUn[i]
+                                               : (i < NLeft) ? mvKeys[i]
+                                                             : mvKeysRight[i - NLeft];
+
+        const int nGridPosX = round((kp.pt.x-mnMinX)*mfGridElementWidthInv);
+        const int nGridPosY = round((kp.pt.y-mnMinY)*mfGridElementHeightInv);
+        if(nGridPosX<0 || nGridPosX>=mnGridCols || nGridPosY<0 || nGridPosY>=mnGridRows)
+            continue;
+
+        if(NLeft == -1 || i < NLeft)
+            mGrid[nGridPosX][nGridPosY].push_back(i);
+        else
+            mGridRight[nGridPosX][nGridPosY].push_back(i - NLeft);
+    }
+}
+
+void KeyFrame::ReleaseGrid()
+{
+    unique_lock<mutex> lock(mMutexGrid);
+    vector<vector<vector<size_t> > >().swap(mGrid);
+    vector<vector<vector<size_t> > >().swap(mGridRight);
+    mbGridReleased = true;
+}
+
+bool KeyFrame::HasGrid()
+{
+    unique_lock<mutex> lock(mMutexGrid);
+    return !mGrid.empty();
+}
+
+void KeyFrame::TakeRebuiltGrids(vector<KeyFrame*> &vpKFs)
+{
+    unique_lock<mutex> lock(mMutexRebuiltGrids);
+    vpKFs.swap(mvpRebuiltGrids);
+    mvpRebuiltGrids.clear();
+}
+
+static size_t GridBytes(const vector<vector<vector<size_t> > > &vGrid)
+{
+    size_t bytes = MemoryUsage::VectorBytes(vGrid);
+    for(const vector<vector<size_t> > &vCol : vGrid)
+    {
+        bytes += MemoryUsage::VectorBytes(vCol);
+        for(const vector<size_t> &vCell : vCol)
+            bytes += MemoryUsage::VectorBytes(vCell);
+    }
+    return bytes;
+}
+
+void KeyFrame::AddMemoryUsage(MemoryUsage &usage)
+{
+    usage.nKeyFrames++;
+    usage.keyFrameBase += sizeof(KeyFrame) + (mpImuPreintegrated ? sizeof(IMU::Preintegrated) : 0) +
+                          MemoryUsage::VectorBytes(mvLeftToRightMatch) + MemoryUsage::VectorBytes(mvRightToLeftMatch);
+    usage.keyFrameKeyPoints += MemoryUsage::VectorBytes(mvKeys) + MemoryUsage::VectorBytes(mvKeysUn) +
+                               MemoryUsage::VectorBytes(mvKeysRight) + MemoryUsage::VectorBytes(mvuRight) +
+                               MemoryUsage::VectorBytes(mvDepth);
+    usage.keyFrameDescriptors += mDescriptors.total()*mDescriptors.elemSize();
+    usage.keyFrameBoW += MemoryUsage::MapBytes(mBowVec) + MemoryUsage::MapBytes(mFeatVec);
+    for(DBoW2::FeatureVector::const_iterator it=mFeatVec.begin(); it!=mFeatVec.end(); it++)
+        usage.keyFrameBoW += MemoryUsage::VectorBytes(it->second);
+
+    {
+        unique_lock<mutex> lock(mMutexFeatures);
+        usage.keyFrameBase += MemoryUsage::VectorBytes(mvpMapPoints);
+    }
+    {
+        unique_lock<mutex> lock(mMutexConnections);
+        usage.keyFrameGraph += MemoryUsage::MapBytes(mConnectedKeyFrameWeights) +
+                               MemoryUsage::VectorBytes(mvpOrderedConnectedKeyFrames) +
+                               MemoryUsage::VectorBytes(mvOrderedWeights) + MemoryUsage::SetBytes(mspChildrens) +
+                               MemoryUsage::SetBytes(mspLoopEdges) + MemoryUsage::SetBytes(mspMergeEdges);
+    }
+    {
+        unique_lock<mutex> lock(mMutexGrid);
+        usage.keyFrameGrid += GridBytes(mGrid) + GridBytes(mGridRight);
+    }
+}
+
 bool KeyFrame::IsInImage(const float &x, const float &y) const
 {
     return (x>=mnMinX && x<mnMaxX && y>=mnMinY && y<mnMaxY);
@@ -0,0 +1,286 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "KeyFrameSelector.h"
+#include "KeyFrame.h"
+#include "MapPoint.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+
+#include <opencv2/imgproc.hpp>
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+
+// Variance of the Laplacian, at half resolution
+float BlurMeasure(const cv::Mat &im)
+{
+    cv::Mat gray, half, lap;
+    if(im.channels() == 3)
+        cv::cvtColor(im, gray, cv::COLOR_BGR2GRAY);
+    else if(im.channels() == 4)
+        cv::cvtColor(im, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = im;
+    cv::resize(gray, half, cv::Size(), 0.5, 0.5, cv::INTER_AREA);
+    cv::Laplacian(half, lap, CV_32F);
+    cv::Scalar mean, stddev;
+    cv::meanStdDev(lap, mean, stddev);
+    return static_cast<float>(stddev[0] * stddev[0]);
+}
+
+const char* DecisionName(const KeyFrameSelector::eDecision decision)
+{
+    switch(decision)
+    {
+    case KeyFrameSelector::KEPT: return "kept";
+    case KeyFrameSelector::REDUNDANT: return "redundant";
+    case KeyFrameSelector::BLURRED: return "blurred";
+    default: return "no_points";
+    }
+}
+
+} // namespace
+
+KeyFrameSelector::KeyFrameSelector(const Options &options, const std::function<cv::Mat(KeyFrame*)> &getImage):
+    mOptions(options), mGetImage(getImage), mnMapPoints(0), mnSeen(0), mnAtTarget(0)
+{
+}
+
+std::vector<KeyFrame*> KeyFrameSelector::Select(const std::vector<KeyFrame*> &vpKFs, const int nThreads)
+{
+    const int nWorkers = ResolveThreads(nThreads);
+    const int nTarget = std::max(1, mOptions.nTargetViews);
+    const float cosParallax = std::cos(mOptions.minParallaxDeg * float(M_PI) / 180.f);
+
+    std::vector<KeyFrame*> vpCandidates;
+    for(KeyFrame* pKF : vpKFs)
+        if(pKF && !pKF->isBad())
+            vpCandidates.push_back(pKF);
+    std::sort(vpCandidates.begin(), vpCandidates.end(), KeyFrame::lId);
+    const size_t N = vpCandidates.size();
+
+    // Viewing rays of the map points of each keyframe and the sharpness of its image
+    struct View
+    {
+        std::vector<MapPoint*> vpMPs;
+        std::vector<Eigen::Vector3f> vRays;
+        std::vector<int> vIndices;
+        float blur;
+    };
+    std::vector<View> vViews(N);
+    ParallelFor(N, nWorkers, [&](size_t k) {
+        KeyFrame* pKF = vpCandidates[k];
+        View &view = vViews[k];
+        const Eigen::Vector3f Ow = pKF->GetCameraCenter();
+        for(MapPoint* pMP : pKF->GetMapPointMatches())
+        {
+            if(!pMP || pMP->isBad())
+                continue;
+            const Eigen::Vector3f ray = pMP->GetWorldPos() - Ow;
+            const float norm = ray.norm();
+            if(norm <= 0.f)
+                continue;
+            view.vpMPs.push_back(pMP);
+            view.vRays.push_back(ray / norm);
+        }
+        const cv::Mat im = mGetImage ? mGetImage(pKF) : cv::Mat();
+        view.blur = im.empty() ? -1.f : BlurMeasure(im);
+    });
+
+    // Map point indices in the order of the keyframes
+    std::unordered_map<MapPoint*, int> mIndices;
+    std::vector<int> vAvailable;
+    for(View &view : vViews)
+    {
+        view.vIndices.reserve(view.vpMPs.size());
+        for(MapPoint* pMP : view.vpMPs)
+        {
+            const auto it = mIndices.emplace(pMP, static_cast<int>(vAvailable.size()));
+            if(it.second)
+                vAvailable.push_back(0);
+            view.vIndices.push_back(it.first->second);
+            vAvailable[it.first->second]++;
+        }
+    }
+    mnMapPoints = static_cast<int>(vAvailable.size());
+
+    std::vector<float> vBlurs;
+    for(const View &view : vViews)
+        if(view.blur >= 0.f)
+            vBlurs.push_back(view.blur);
+    float medianBlur = 0.f;
+    if(!vBlurs.empty())
+    {
+        std::nth_element(vBlurs.begin(), vBlurs.begin() + vBlurs.size() / 2, vBlurs.end());
+        medianBlur = vBlurs[vBlurs.size() / 2];
+    }
+
+    // Rays of the kept keyframes that see each point
+    std::vector<std::vector<Eigen::Vector3f> > vSelectedRays(vAvailable.size());
+    auto countNew = [&](const size_t k) {
+        const View &view = vViews[k];
+        int n = 0;
+        for(size_t j = 0; j < view.vIndices.size(); j++)
+        {
+            const std::vector<Eigen::Vector3f> &vRays = vSelectedRays[view.vIndices[j]];
+            if(static_cast<int>(vRays.size()) >= nTarget)
+                continue;
+            bool bNew = true;
+            for(const Eigen::Vector3f &ray : vRays)
+            {
+                if(ray.dot(view.vRays[j]) > cosParallax)
+                {
+                    bNew = false;
+                    break;
+                }
+            }
+            n += bNew;
+        }
+        return n;
+    };
+
+    mvEntries.assign(N, Entry());
+    std::vector<float> vWeights(N, 1.f);
+    for(size_t k = 0; k < N; k++)
+    {
+        Entry &entry = mvEntries[k];
+        entry.pKF = vpCandidates[k];
+        entry.nPoints = static_cast<int>(vViews[k].vIndices.size());
+        entry.nNewPoints = entry.nPoints;
+        entry.blur = vViews[k].blur;
+        entry.order = -1;
+        entry.decision = REDUNDANT;
+        if(entry.nPoints == 0)
+            entry.decision = NO_POINTS;
+        else if(medianBlur > 0.f && entry.blur >= 0.f)
+        {
+            if(entry.blur < mOptions.minBlurRatio * medianBlur)
+                entry.decision = BLURRED;
+            vWeights[k] = std::min(1.f, entry.blur / medianBlur);
+        }
+    }
+
+    // Lazy greedy selection: the number of new points of a keyframe only decreases as others are kept, so a
+    // rescored keyframe still ahead of the stale scores of the others is the best one
+    struct Candidate
+    {
+        float score;
+        size_t k;
+        bool operator<(const Candidate &other) const
+        {
+            return score < other.score || (score == other.score && k > other.k);
+        }
+    };
+    std::priority_queue<Candidate> queue;
+    for(size_t k = 0; k < N; k++)
+        if(mvEntries[k].decision == REDUNDANT)
+            queue.push(Candidate{vWeights[k] * mvEntries[k].nPoints, k});
+
+    int order = 0;
+    while(!queue.empty())
+    {
+        const Candidate top = queue.top();
+        queue.pop();
+        Entry &entry = mvEntries[top.k];
+        entry.nNewPoints = countNew(top.k);
+        if(entry.nNewPoints == 0 || entry.nNewPoints < mOptions.minNewPointsRatio * entry.nPoints)
+            continue;
+
+        const Candidate rescored{vWeights[top.k] * entry.nNewPoints, top.k};
+        if(!queue.empty() && rescored < queue.top())
+        {
+            queue.push(rescored);
+            continue;
+        }
+
+        entry.decision = KEPT;
+        entry.order = order++;
+        const View &view = vViews[top.k];
+        for(size_t j = 0; j < view.vIndices.size(); j++)
+        {
+            std::vector<Eigen::Vector3f> &vRays = vSelectedRays[view.vIndices[j]];
+            if(static_cast<int>(vRays.size()) < nTarget)
+                vRays.push_back(view.vRays[j]);
+        }
+    }
+
+    mnSeen = 0;
+    mnAtTarget = 0;
+    for(size_t i = 0; i < vSelectedRays.size(); i++)
+    {
+        const int n = static_cast<int>(vSelectedRays[i].size());
+        mnSeen += n > 0;
+        mnAtTarget += n >= std::min(nTarget, vAvailable[i]);
+    }
+
+    std::vector<KeyFrame*> vpSelected;
+    for(const Entry &entry : mvEntries)
+        if(entry.decision == KEPT)
+            vpSelected.push_back(entry.pKF);
+    return vpSelected;
+}
+
+void KeyFrameSelector::PrintSummary() const
+{
+    int nCounts[4] = {0, 0, 0, 0};
+    for(const Entry &entry : mvEntries)
+        nCounts[entry.decision]++;
+    std::cout << "View selection: " << nCounts[KEPT] << " of " << mvEntries.size() << " keyframes kept ("
+              << nCounts[REDUNDANT] << " redundant, " << nCounts[BLURRED] << " blurred, " << nCounts[NO_POINTS]
+              << " without points), " << mnSeen << " of " << mnMapPoints << " map points seen, " << mnAtTarget
+              << " at " << mOptions.nTargetViews << " views" << std::endl;
+}
+
+bool KeyFrameSelector::SaveReport(const std::string &filename) const
+{
+    std::ofstream f(filename.c_str());
+    if(!f.is_open())
+    {
+        std::cerr << "Error: Failed to open file " << filename << " for writing!" << std::endl;
+        return false;
+    }
+
+    int nKept = 0;
+    for(const Entry &entry : mvEntries)
+        nKept += entry.decision == KEPT;
+    f << "# Keyframes kept for the export: " << nKept << " of " << mvEntries.size() << std::endl;
+    f << "# Map points: " << mnMapPoints << ", seen by a kept keyframe: " << mnSeen << ", at the target of "
+      << mOptions.nTargetViews << " views: " << mnAtTarget << std::endl;
+    f << "# KEYFRAME_ID, TIMESTAMP, DECISION, ORDER, POINTS, NEW_POINTS, BLUR" << std::endl;
+    for(const Entry &entry : mvEntries)
+    {
+        f << entry.pKF->mnId << " " << std::fixed << std::setprecision(6) << entry.pKF->mTimeStamp << " "
+          << DecisionName(entry.decision) << " " << entry.order << " " << entry.nPoints << " " << entry.nNewPoints
+          << " " << std::setprecision(2) << entry.blur << std::endl;
+    }
+    return static_cast<bool>(f);
+}
+
+} //namespace ORB_SLAM
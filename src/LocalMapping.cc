@@ -23,7 +23,11 @@
 #include "Optimizer.h"
 #include "Converter.h"
 #include "GeometricTools.h"
+#include "Instrumentation.h"
+#include "ImageExporter.h"
+#ifdef WITH_ROS
 #include "ROSMassageCreate.h"
+#endif
 
 #include<mutex>
 #include<chrono>
@@ -34,6 +38,7 @@ namespace ORB_SLAM3
 LocalMapping::LocalMapping(System* pSys, Atlas *pAtlas, const float bMonocular, bool bInertial, const string &_strSeqName):
     mpSystem(pSys), mbMonocular(bMonocular), mbInertial(bInertial), mbResetRequested(false), mbResetRequestedActiveMap(false), mbFinishRequested(false), mbFinished(true), mpAtlas(pAtlas), bInitializing(false),
     mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true),
+    mnMemoryPolicyKFs(0), mbOverBudget(false), mpImageExporter(static_cast<ImageExporter*>(NULL)),
     mIdxInit(0), mScale(1.0), mInitSect(0), mbNotBA1(true), mbNotBA2(true), mIdxIteration(0), infoInertial(Eigen::MatrixXd::Zero(9,9))
 {
     mnMatchesInliers = 0;
@@ -44,12 +49,6 @@ LocalMapping::LocalMapping(System* pSys, Atlas *pAtlas, const float bMonocular,
 
     mNumLM = 0;
     mNumKFCulling=0;
-
-#ifdef REGISTER_TIMES
-    nLBA_exec = 0;
-    nLBA_abort = 0;
-#endif
-
 }
 
 void LocalMapping::SetLoopCloser(LoopClosing* pLoopCloser)
@@ -62,8 +61,21 @@ void LocalMapping::SetTracker(Tracking *pTracker)
     mpTracker=pTracker;
 }
 
+void LocalMapping::SetImageExporter(ImageExporter* pImageExporter)
+{
+    mpImageExporter=pImageExporter;
+}
+
+void LocalMapping::SetMemoryPolicy(const MemoryPolicy &policy)
+{
+    unique_lock<mutex> lock(mMutexMemoryPolicy);
+    mMemoryPolicy = policy;
+}
+
 void LocalMapping::Run()
 {
+    Instrumentation::SetThreadName("Local Mapping");
+
     mbFinished = false;
     int solve_idx = 0;
 
@@ -75,29 +87,17 @@ void LocalMapping::Run()
         // Check if there are keyframes in the queue
         if(CheckNewKeyFrames() && !mbBadImu)
         {
-#ifdef REGISTER_TIMES
-            double timeLBA_ms = 0;
-            double timeKFCulling_ms = 0;
+            const Instrumentation::TimePoint time_StartProcessKF = Instrumentation::Now();
 
-            std::chrono::steady_clock::time_point time_StartProcessKF = std::chrono::steady_clock::now();
-#endif
             // BoW conversion and insertion in Map
             ProcessNewKeyFrame();
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndProcessKF = std::chrono::steady_clock::now();
-
-            double timeProcessKF = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndProcessKF - time_StartProcessKF).count();
-            vdKFInsert_ms.push_back(timeProcessKF);
-#endif
+            const Instrumentation::TimePoint time_EndProcessKF = Instrumentation::Now();
+            Instrumentation::RecordInterval(Instrumentation::LM_KF_INSERT,time_StartProcessKF,time_EndProcessKF);
 
             // Check recent MapPoints
             MapPointCulling();
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndMPCulling = std::chrono::steady_clock::now();
-
-            double timeMPCulling = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndMPCulling - time_EndProcessKF).count();
-            vdMPCulling_ms.push_back(timeMPCulling);
-#endif
+            const Instrumentation::TimePoint time_EndMPCulling = Instrumentation::Now();
+            Instrumentation::RecordInterval(Instrumentation::LM_MP_CULLING,time_EndProcessKF,time_EndMPCulling);
 
             // Triangulate new MapPoints
             CreateNewMapPoints();
@@ -110,12 +110,11 @@ void LocalMapping::Run()
                 SearchInNeighbors();
             }
 
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndMPCreation = std::chrono::steady_clock::now();
+            // New points and fusions modified the neighbor keyframes, Tracking must rebuild its local map
+            mpCurrentKeyFrame->GetMap()->InformLocalMapChange();
 
-            double timeMPCreation = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndMPCreation - time_EndMPCulling).count();
-            vdMPCreation_ms.push_back(timeMPCreation);
-#endif
+            const Instrumentation::TimePoint time_EndMPCreation = Instrumentation::Now();
+            Instrumentation::RecordInterval(Instrumentation::LM_MP_CREATION,time_EndMPCulling,time_EndMPCreation);
 
             bool b_doneLBA = false;
             int num_FixedKF_BA = 0;
@@ -160,27 +159,17 @@ void LocalMapping::Run()
                     
                 }
 
-#ifdef REGISTER_TIMES
-                std::chrono::steady_clock::time_point time_EndLBA = std::chrono::steady_clock::now();
+                const Instrumentation::TimePoint time_EndLBA = Instrumentation::Now();
 
                 if(b_doneLBA)
                 {
-                    timeLBA_ms = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndLBA - time_EndMPCreation).count();
-                    vdLBA_ms.push_back(timeLBA_ms);
-
-                    nLBA_exec += 1;
-                    if(mbAbortBA)
-                    {
-                        nLBA_abort += 1;
-                    }
-                    vnLBA_edges.push_back(num_edges_BA);
-                    vnLBA_KFopt.push_back(num_OptKF_BA);
-                    vnLBA_KFfixed.push_back(num_FixedKF_BA);
-                    vnLBA_MPs.push_back(num_MPs_BA);
+                    Instrumentation::RecordInterval(mbAbortBA ? Instrumentation::LM_LBA_ABORTED : Instrumentation::LM_LBA,time_EndMPCreation,time_EndLBA);
+                    Instrumentation::RecordCount(Instrumentation::LM_LBA_EDGES,num_edges_BA);
+                    Instrumentation::RecordCount(Instrumentation::LM_LBA_KF_OPT,num_OptKF_BA);
+                    Instrumentation::RecordCount(Instrumentation::LM_LBA_KF_FIXED,num_FixedKF_BA);
+                    Instrumentation::RecordCount(Instrumentation::LM_LBA_MPS,num_MPs_BA);
                 }
 
-#endif
-
                 // Initialize IMU here
                 if(!mpCurrentKeyFrame->GetMap()->isImuInitialized() && mbInertial)
                 {
@@ -194,12 +183,7 @@ void LocalMapping::Run()
                 // Check redundant local Keyframes
                 KeyFrameCulling();
 
-#ifdef REGISTER_TIMES
-                std::chrono::steady_clock::time_point time_EndKFCulling = std::chrono::steady_clock::now();
-
-                timeKFCulling_ms = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndKFCulling - time_EndLBA).count();
-                vdKFCulling_ms.push_back(timeKFCulling_ms);
-#endif
+                Instrumentation::RecordInterval(Instrumentation::LM_KF_CULLING,time_EndLBA,Instrumentation::Now());
 
                 if ((mTinit<50.0f) && mbInertial)
                 {
@@ -246,13 +230,14 @@ void LocalMapping::Run()
                 }
             }
 
-#ifdef REGISTER_TIMES
-            vdLBASync_ms.push_back(timeKFCulling_ms);
-            vdKFCullingSync_ms.push_back(timeKFCulling_ms);
-#endif
-
             mpLoopCloser->InsertKeyFrame(mpCurrentKeyFrame);
 
+            ApplyMemoryPolicy();
+
+            if(mpImageExporter)
+                mpImageExporter->AddKeyFrame(mpCurrentKeyFrame);
+
+#ifdef WITH_ROS
             std::vector<KeyFrame*> allKFs = mpAtlas->GetAllKeyFrames();
             // 按照 mnId 排序，保证帧顺序稳定
             sort(allKFs.begin(), allKFs.end(), ORB_SLAM3::KeyFrame::lId);
@@ -282,9 +267,8 @@ void LocalMapping::Run()
                         // 检查是否为新增关键帧
                         if (mProcessedKeyFrames.find(keyFrameId) == mProcessedKeyFrames.end()) {
                             // 提取 RGB 数据
-                            auto itRGB = mpTracker->mnIdToBGRMap.find(keyFrameId);
-                            if (itRGB != mpTracker->mnIdToBGRMap.end()) {
-                                cv::Mat rgbImage = itRGB->second;
+                            cv::Mat rgbImage = mpTracker->GetFrameImage(keyFrameId);
+                            if (!rgbImage.empty()) {
 
                                 // 提取其他信息
                                 sensor_msgs::Image imageMsg = CreateRosImage(rgbImage, keyFrameId);
@@ -307,21 +291,19 @@ void LocalMapping::Run()
                     }
                 }
             }
-
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndLocalMap = std::chrono::steady_clock::now();
-
-            double timeLocalMap = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndLocalMap - time_StartProcessKF).count();
-            vdLMTotal_ms.push_back(timeLocalMap);
 #endif
+
+            Instrumentation::RecordInterval(Instrumentation::LM_TOTAL,time_StartProcessKF,Instrumentation::Now());
         }
         else if(Stop() && !mbBadImu)
         {
             // Safe area to stop
+            const Instrumentation::TimePoint time_StartStop = Instrumentation::Now();
             while(isStopped() && !CheckFinish())
             {
                 usleep(3000);
             }
+            Instrumentation::TraceWait("Stopped",time_StartStop);
             if(CheckFinish())
                 break;
         }
@@ -959,6 +941,64 @@ void LocalMapping::InterruptBA()
     mbAbortBA = true;
 }
 
+void LocalMapping::ApplyMemoryPolicy()
+{
+    // Keyframes checked against the budget, and grid window used when only the budget is set
+    const unsigned long nBudgetCheckPeriod = 10;
+    const int nBudgetGridWindow = 50;
+
+    MemoryPolicy policy;
+    {
+        unique_lock<mutex> lock(mMutexMemoryPolicy);
+        policy = mMemoryPolicy;
+    }
+
+    mnMemoryPolicyKFs++;
+    const bool bReport = policy.nReportPeriod>0 && mnMemoryPolicyKFs%policy.nReportPeriod==0;
+    const bool bCheckBudget = policy.nBudgetBytes>0 && mnMemoryPolicyKFs%nBudgetCheckPeriod==0;
+    if(bReport || bCheckBudget)
+    {
+        MemoryUsage usage = mpAtlas->GetMemoryUsage();
+        mpTracker->AddMemoryUsage(usage);
+        if(mpImageExporter)
+            mpImageExporter->AddMemoryUsage(usage);
+        if(bReport)
+            cout << usage.ToString();
+        if(bCheckBudget)
+        {
+            const bool bOverBudget = usage.Total()>policy.nBudgetBytes;
+            if(bOverBudget && !mbOverBudget)
+                cout << "Memory budget exceeded, releasing the grids and encoded images of old keyframes" << endl;
+            mbOverBudget = bOverBudget;
+            // Write encodes the released images again
+            if(bOverBudget && mpImageExporter)
+                mpImageExporter->ReleaseOldest(usage.Total()-policy.nBudgetBytes);
+        }
+    }
+
+    // Keyframes whose grid was rebuilt by a search since it was released
+    vector<KeyFrame*> vpRebuilt;
+    KeyFrame::TakeRebuiltGrids(vpRebuilt);
+
+    if(policy.nGridWindow<=0 && policy.nBudgetBytes==0)
+    {
+        mlpGridKeyFrames.clear();
+        return;
+    }
+
+    mlpGridKeyFrames.insert(mlpGridKeyFrames.end(),vpRebuilt.begin(),vpRebuilt.end());
+    mlpGridKeyFrames.push_back(mpCurrentKeyFrame);
+    if(policy.nGridWindow<=0 && !mbOverBudget)
+        return;
+
+    const size_t nWindow = policy.nGridWindow>0 ? policy.nGridWindow : nBudgetGridWindow;
+    while(mlpGridKeyFrames.size()>nWindow)
+    {
+        mlpGridKeyFrames.front()->ReleaseGrid();
+        mlpGridKeyFrames.pop_front();
+    }
+}
+
 void LocalMapping::KeyFrameCulling()
 {
     // Check redundant keyframes (only local keyframes)
@@ -1168,6 +1208,7 @@ void LocalMapping::ResetIfRequested()
             cout << "LM: Reseting Atlas in Local Mapping..." << endl;
             mlNewKeyFrames.clear();
             mlpRecentAddedMapPoints.clear();
+            mlpGridKeyFrames.clear();
             mbResetRequested = false;
             mbResetRequestedActiveMap = false;
 
@@ -1187,6 +1228,7 @@ void LocalMapping::ResetIfRequested()
             cout << "LM: Reseting current map in Local Mapping..." << endl;
             mlNewKeyFrames.clear();
             mlpRecentAddedMapPoints.clear();
+            mlpGridKeyFrames.clear();
 
             // Inertial parameters
             mTinit = 0.f;
@@ -1337,7 +1379,9 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
 
     // Before this line we are not changing the map
     {
+        const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
         unique_lock<mutex> lock(mpAtlas->GetCurrentMap()->mMutexMapUpdate);
+        Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
         if ((fabs(mScale - 1.f) > 0.00001) || !mbMonocular) {
             Sophus::SE3f Twg(mRwg.cast<float>().transpose(), Eigen::Vector3f::Zero());
             mpAtlas->GetCurrentMap()->ApplyScaledRotation(Twg, mScale, true);
@@ -1374,7 +1418,9 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
     Verbose::PrintMess("Global Bundle Adjustment finished\nUpdating map ...", Verbose::VERBOSITY_NORMAL);
 
     // Get Map Mutex
+    const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
     unique_lock<mutex> lock(mpAtlas->GetCurrentMap()->mMutexMapUpdate);
+    Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
 
     unsigned long GBAid = mpCurrentKeyFrame->mnId;
 
@@ -1530,7 +1576,9 @@ void LocalMapping::ScaleRefinement()
     
     Sophus::SO3d so3wg(mRwg);
     // Before this line we are not changing the map
+    const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
     unique_lock<mutex> lock(mpAtlas->GetCurrentMap()->mMutexMapUpdate);
+    Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
     std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
     if ((fabs(mScale-1.f)>0.002)||!mbMonocular)
     {
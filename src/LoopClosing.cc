@@ -24,6 +24,7 @@
 #include "Optimizer.h"
 #include "ORBmatcher.h"
 #include "G2oTypes.h"
+#include "Instrumentation.h"
 
 #include<mutex>
 #include<thread>
@@ -41,36 +42,6 @@ LoopClosing::LoopClosing(Atlas *pAtlas, KeyFrameDatabase *pDB, ORBVocabulary *pV
     mnCovisibilityConsistencyTh = 3;
     mpLastCurrentKF = static_cast<KeyFrame*>(NULL);
 
-#ifdef REGISTER_TIMES
-
-    vdDataQuery_ms.clear();
-    vdEstSim3_ms.clear();
-    vdPRTotal_ms.clear();
-
-    vdMergeMaps_ms.clear();
-    vdWeldingBA_ms.clear();
-    vdMergeOptEss_ms.clear();
-    vdMergeTotal_ms.clear();
-    vnMergeKFs.clear();
-    vnMergeMPs.clear();
-    nMerges = 0;
-
-    vdLoopFusion_ms.clear();
-    vdLoopOptEss_ms.clear();
-    vdLoopTotal_ms.clear();
-    vnLoopKFs.clear();
-    nLoop = 0;
-
-    vdGBA_ms.clear();
-    vdUpdateMap_ms.clear();
-    vdFGBATotal_ms.clear();
-    vnGBAKFs.clear();
-    vnGBAMPs.clear();
-    nFGBA_exec = 0;
-    nFGBA_abort = 0;
-
-#endif
-
     mstrFolderSubTraj = "SubTrajectories/";
     mnNumCorrection = 0;
     mnCorrectionGBA = 0;
@@ -89,6 +60,8 @@ void LoopClosing::SetLocalMapper(LocalMapping *pLocalMapper)
 
 void LoopClosing::Run()
 {
+    Instrumentation::SetThreadName("Loop Closing");
+
     mbFinished =false;
 
     while(1)
@@ -105,18 +78,11 @@ void LoopClosing::Run()
                 mpLastCurrentKF->mvpLoopCandKFs.clear();
                 mpLastCurrentKF->mvpMergeCandKFs.clear();
             }
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_StartPR = std::chrono::steady_clock::now();
-#endif
+            const Instrumentation::TimePoint time_StartPR = Instrumentation::Now();
 
             bool bFindedRegion = NewDetectCommonRegions();
 
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndPR = std::chrono::steady_clock::now();
-
-            double timePRTotal = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndPR - time_StartPR).count();
-            vdPRTotal_ms.push_back(timePRTotal);
-#endif
+            Instrumentation::RecordInterval(Instrumentation::LC_PR_TOTAL,time_StartPR,Instrumentation::Now());
             if(bFindedRegion)
             {
                 if(mbMergeDetected)
@@ -171,23 +137,14 @@ void LoopClosing::Run()
 
                         Verbose::PrintMess("*Merge detected", Verbose::VERBOSITY_QUIET);
 
-#ifdef REGISTER_TIMES
-                        std::chrono::steady_clock::time_point time_StartMerge = std::chrono::steady_clock::now();
-
-                        nMerges += 1;
-#endif
+                        const Instrumentation::TimePoint time_StartMerge = Instrumentation::Now();
                         // TODO UNCOMMENT
                         if (mpTracker->mSensor==System::IMU_MONOCULAR ||mpTracker->mSensor==System::IMU_STEREO || mpTracker->mSensor==System::IMU_RGBD)
                             MergeLocal2();
                         else
                             MergeLocal();
 
-#ifdef REGISTER_TIMES
-                        std::chrono::steady_clock::time_point time_EndMerge = std::chrono::steady_clock::now();
-
-                        double timeMergeTotal = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndMerge - time_StartMerge).count();
-                        vdMergeTotal_ms.push_back(timeMergeTotal);
-#endif
+                        Instrumentation::RecordInterval(Instrumentation::LC_MERGE_TOTAL,time_StartMerge,Instrumentation::Now());
 
                         Verbose::PrintMess("Merge finished!", Verbose::VERBOSITY_QUIET);
                     }
@@ -265,19 +222,9 @@ void LoopClosing::Run()
 
                         mvpLoopMapPoints = mvpLoopMPs;
 
-#ifdef REGISTER_TIMES
-                        std::chrono::steady_clock::time_point time_StartLoop = std::chrono::steady_clock::now();
-
-                        nLoop += 1;
-
-#endif
+                        const Instrumentation::TimePoint time_StartLoop = Instrumentation::Now();
                         CorrectLoop();
-#ifdef REGISTER_TIMES
-                        std::chrono::steady_clock::time_point time_EndLoop = std::chrono::steady_clock::now();
-
-                        double timeLoopTotal = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndLoop - time_StartLoop).count();
-                        vdLoopTotal_ms.push_back(timeLoopTotal);
-#endif
+                        Instrumentation::RecordInterval(Instrumentation::LC_LOOP_TOTAL,time_StartLoop,Instrumentation::Now());
 
                         mnNumCorrection += 1;
                     }
@@ -368,9 +315,7 @@ bool LoopClosing::NewDetectCommonRegions()
     bool bLoopDetectedInKF = false;
     bool bCheckSpatial = false;
 
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_StartEstSim3_1 = std::chrono::steady_clock::now();
-#endif
+    const Instrumentation::TimePoint time_StartEstSim3_1 = Instrumentation::Now();
     if(mnLoopNumCoincidences > 0)
     {
         bCheckSpatial = true;
@@ -462,17 +407,11 @@ bool LoopClosing::NewDetectCommonRegions()
 
         }
     }  
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_EndEstSim3_1 = std::chrono::steady_clock::now();
-
-        double timeEstSim3 = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndEstSim3_1 - time_StartEstSim3_1).count();
-#endif
+    const Instrumentation::TimePoint time_EndEstSim3_1 = Instrumentation::Now();
 
     if(mbMergeDetected || mbLoopDetected)
     {
-#ifdef REGISTER_TIMES
-        vdEstSim3_ms.push_back(timeEstSim3);
-#endif
+        Instrumentation::RecordInterval(Instrumentation::LC_EST_SIM3,time_StartEstSim3_1,time_EndEstSim3_1);
         mpKeyFrameDB->add(mpCurrentKF);
         return true;
     }
@@ -485,21 +424,12 @@ bool LoopClosing::NewDetectCommonRegions()
     if(!bMergeDetectedInKF || !bLoopDetectedInKF)
     {
         // Search in BoW
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_StartQuery = std::chrono::steady_clock::now();
-#endif
+        const Instrumentation::TimePoint time_StartQuery = Instrumentation::Now();
         mpKeyFrameDB->DetectNBestCandidates(mpCurrentKF, vpLoopBowCand, vpMergeBowCand,3);
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_EndQuery = std::chrono::steady_clock::now();
-
-        double timeDataQuery = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndQuery - time_StartQuery).count();
-        vdDataQuery_ms.push_back(timeDataQuery);
-#endif
+        Instrumentation::RecordInterval(Instrumentation::LC_DB_QUERY,time_StartQuery,Instrumentation::Now());
     }
 
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_StartEstSim3_2 = std::chrono::steady_clock::now();
-#endif
+    const Instrumentation::TimePoint time_StartEstSim3_2 = Instrumentation::Now();
     // Check the BoW candidates if the geometric candidate list is empty
     //Loop candidates
     if(!bLoopDetectedInKF && !vpLoopBowCand.empty())
@@ -512,12 +442,9 @@ bool LoopClosing::NewDetectCommonRegions()
         mbMergeDetected = DetectCommonRegionsFromBoW(vpMergeBowCand, mpMergeMatchedKF, mpMergeLastCurrentKF, mg2oMergeSlw, mnMergeNumCoincidences, mvpMergeMPs, mvpMergeMatchedMPs);
     }
 
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_EndEstSim3_2 = std::chrono::steady_clock::now();
-
-        timeEstSim3 += std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndEstSim3_2 - time_StartEstSim3_2).count();
-        vdEstSim3_ms.push_back(timeEstSim3);
-#endif
+    // Both geometric checks, without the database query
+    if(time_EndEstSim3_1 && time_StartEstSim3_2)
+        Instrumentation::RecordInterval(Instrumentation::LC_EST_SIM3,time_StartEstSim3_1,time_EndEstSim3_1+(Instrumentation::Now()-time_StartEstSim3_2));
 
     mpKeyFrameDB->add(mpCurrentKF);
 
@@ -993,10 +920,12 @@ void LoopClosing::CorrectLoop()
     }
 
     // Wait until Local Mapping has effectively stopped
+    const Instrumentation::TimePoint time_StartWaitLM = Instrumentation::Now();
     while(!mpLocalMapper->isStopped())
     {
         usleep(1000);
     }
+    Instrumentation::TraceWait("Wait LocalMapping stop",time_StartWaitLM);
 
     // Ensure current keyframe is updated
     //cout << "Start updating connections" << endl;
@@ -1023,22 +952,13 @@ void LoopClosing::CorrectLoop()
 
     Map* pLoopMap = mpCurrentKF->GetMap();
 
-#ifdef REGISTER_TIMES
-    /*KeyFrame* pKF = mpCurrentKF;
-    int numKFinLoop = 0;
-    while(pKF && pKF->mnId > mpLoopMatchedKF->mnId)
-    {
-        pKF = pKF->GetParent();
-        numKFinLoop += 1;
-    }
-    vnLoopKFs.push_back(numKFinLoop);*/
-
-    std::chrono::steady_clock::time_point time_StartFusion = std::chrono::steady_clock::now();
-#endif
+    const Instrumentation::TimePoint time_StartFusion = Instrumentation::Now();
 
     {
         // Get Map Mutex
+        const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
         unique_lock<mutex> lock(pLoopMap->mMutexMapUpdate);
+        Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
 
         const bool bImuInit = pLoopMap->isImuInitialized();
 
@@ -1166,12 +1086,9 @@ void LoopClosing::CorrectLoop()
     if(mpTracker->mSensor==System::IMU_MONOCULAR && !mpCurrentKF->GetMap()->GetIniertialBA2())
         bFixedScale=false;
 
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_EndFusion = std::chrono::steady_clock::now();
+    const Instrumentation::TimePoint time_EndFusion = Instrumentation::Now();
+    Instrumentation::RecordInterval(Instrumentation::LC_LOOP_FUSION,time_StartFusion,time_EndFusion);
 
-        double timeFusion = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndFusion - time_StartFusion).count();
-        vdLoopFusion_ms.push_back(timeFusion);
-#endif
     //cout << "Optimize essential graph" << endl;
     if(pLoopMap->IsInertial() && pLoopMap->isImuInitialized())
     {
@@ -1182,12 +1099,7 @@ void LoopClosing::CorrectLoop()
         //cout << "Loop -> Scale correction: " << mg2oLoopScw.scale() << endl;
         Optimizer::OptimizeEssentialGraph(pLoopMap, mpLoopMatchedKF, mpCurrentKF, NonCorrectedSim3, CorrectedSim3, LoopConnections, bFixedScale);
     }
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_EndOpt = std::chrono::steady_clock::now();
-
-    double timeOptEss = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndOpt - time_EndFusion).count();
-    vdLoopOptEss_ms.push_back(timeOptEss);
-#endif
+    Instrumentation::RecordInterval(Instrumentation::LC_LOOP_OPT_ESS,time_EndFusion,Instrumentation::Now());
 
     mpAtlas->InformNewBigChange();
 
@@ -1247,10 +1159,12 @@ void LoopClosing::MergeLocal()
     //cout << "Request Stop Local Mapping" << endl;
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
+    const Instrumentation::TimePoint time_StartWaitLM = Instrumentation::Now();
     while(!mpLocalMapper->isStopped())
     {
         usleep(1000);
     }
+    Instrumentation::TraceWait("Wait LocalMapping stop",time_StartWaitLM);
     //cout << "Local Map stopped" << endl;
 
     mpLocalMapper->EmptyQueue();
@@ -1263,9 +1177,7 @@ void LoopClosing::MergeLocal()
     //std::cout << "Merge local, Active map: " << pCurrentMap->GetId() << std::endl;
     //std::cout << "Merge local, Non-Active map: " << pMergeMap->GetId() << std::endl;
 
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_StartMerge = std::chrono::steady_clock::now();
-#endif
+    const Instrumentation::TimePoint time_StartMerge = Instrumentation::Now();
 
     // Ensure current keyframe is updated
     mpCurrentKF->UpdateConnections();
@@ -1413,10 +1325,8 @@ void LoopClosing::MergeLocal()
     vNonCorrectedSim3[mpCurrentKF]=g2oNonCorrectedScw;
 
 
-#ifdef REGISTER_TIMES
-    vnMergeKFs.push_back(spLocalWindowKFs.size() + spMergeConnectedKFs.size());
-    vnMergeMPs.push_back(spLocalWindowMPs.size() + spMapPointMerge.size());
-#endif
+    Instrumentation::RecordCount(Instrumentation::LC_MERGE_KFS,spLocalWindowKFs.size() + spMergeConnectedKFs.size());
+    Instrumentation::RecordCount(Instrumentation::LC_MERGE_MPS,spLocalWindowMPs.size() + spMapPointMerge.size());
     for(KeyFrame* pKFi : spLocalWindowKFs)
     {
         if(!pKFi || pKFi->isBad())
@@ -1606,12 +1516,8 @@ void LoopClosing::MergeLocal()
 
     //std::cout << "[Merge]: Start welding bundle adjustment" << std::endl;
 
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_StartWeldingBA = std::chrono::steady_clock::now();
-
-    double timeMergeMaps = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_StartWeldingBA - time_StartMerge).count();
-    vdMergeMaps_ms.push_back(timeMergeMaps);
-#endif
+    const Instrumentation::TimePoint time_StartWeldingBA = Instrumentation::Now();
+    Instrumentation::RecordInterval(Instrumentation::LC_MERGE_MAPS,time_StartMerge,time_StartWeldingBA);
 
     bool bStop = false;
     vpLocalCurrentWindowKFs.clear();
@@ -1627,12 +1533,8 @@ void LoopClosing::MergeLocal()
         Optimizer::LocalBundleAdjustment(mpCurrentKF, vpLocalCurrentWindowKFs, vpMergeConnectedKFs,&bStop);
     }
 
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_EndWeldingBA = std::chrono::steady_clock::now();
-
-    double timeWeldingBA = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndWeldingBA - time_StartWeldingBA).count();
-    vdWeldingBA_ms.push_back(timeWeldingBA);
-#endif
+    const Instrumentation::TimePoint time_EndWeldingBA = Instrumentation::Now();
+    Instrumentation::RecordInterval(Instrumentation::LC_MERGE_WELDING_BA,time_StartWeldingBA,time_EndWeldingBA);
     //std::cout << "[Merge]: Welding bundle adjustment finished" << std::endl;
 
     // Loop closed. Release Local Mapping.
@@ -1706,10 +1608,12 @@ void LoopClosing::MergeLocal()
 
         mpLocalMapper->RequestStop();
         // Wait until Local Mapping has effectively stopped
+        const Instrumentation::TimePoint time_StartWaitLM = Instrumentation::Now();
         while(!mpLocalMapper->isStopped())
         {
             usleep(1000);
         }
+        Instrumentation::TraceWait("Wait LocalMapping stop",time_StartWaitLM);
 
         // Optimize graph (and update the loop position for each element form the begining to the end)
         if(mpTracker->mSensor != System::MONOCULAR)
@@ -1750,12 +1654,7 @@ void LoopClosing::MergeLocal()
         }
     }
 
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_EndOptEss = std::chrono::steady_clock::now();
-
-    double timeOptEss = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndOptEss - time_EndWeldingBA).count();
-    vdMergeOptEss_ms.push_back(timeOptEss);
-#endif
+    Instrumentation::RecordInterval(Instrumentation::LC_MERGE_OPT_ESS,time_EndWeldingBA,Instrumentation::Now());
 
 
     mpLocalMapper->Release();
@@ -1820,10 +1719,12 @@ void LoopClosing::MergeLocal2()
     //cout << "Request Stop Local Mapping" << endl;
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
+    const Instrumentation::TimePoint time_StartWaitLM = Instrumentation::Now();
     while(!mpLocalMapper->isStopped())
     {
         usleep(1000);
     }
+    Instrumentation::TraceWait("Wait LocalMapping stop",time_StartWaitLM);
     //cout << "Local Map stopped" << endl;
 
     Map* pCurrentMap = mpCurrentKF->GetMap();
@@ -1833,7 +1734,9 @@ void LoopClosing::MergeLocal2()
         float s_on = mSold_new.scale();
         Sophus::SE3f T_on(mSold_new.rotation().cast<float>(), mSold_new.translation().cast<float>());
 
+        const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
         unique_lock<mutex> lock(mpAtlas->GetCurrentMap()->mMutexMapUpdate);
+        Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
 
         //cout << "KFs before empty: " << mpAtlas->GetCurrentMap()->KeyFramesInMap() << endl;
         mpLocalMapper->EmptyQueue();
@@ -1862,7 +1765,9 @@ void LoopClosing::MergeLocal2()
         ba << 0., 0., 0.;
         Optimizer::InertialOptimization(pCurrentMap,bg,ba);
         IMU::Bias b (ba[0],ba[1],ba[2],bg[0],bg[1],bg[2]);
+        const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
         unique_lock<mutex> lock(mpAtlas->GetCurrentMap()->mMutexMapUpdate);
+        Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
         mpTracker->UpdateFrameIMU(1.0f,b,mpTracker->GetLastKeyFrame());
 
         // Set map initialized
@@ -2133,7 +2038,9 @@ void LoopClosing::SearchAndFuse(const KeyFrameAndPose &CorrectedPosesMap, vector
         int numFused = matcher.Fuse(pKFi,Scw,vpMapPoints,4,vpReplacePoints);
 
         // Get Map Mutex
+        const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
         unique_lock<mutex> lock(pMap->mMutexMapUpdate);
+        Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
         const int nLP = vpMapPoints.size();
         for(int i=0; i<nLP;i++)
         {
@@ -2178,7 +2085,9 @@ void LoopClosing::SearchAndFuse(const vector<KeyFrame*> &vConectedKFs, vector<Ma
         matcher.Fuse(pKF,Scw,vpMapPoints,4,vpReplacePoints);
 
         // Get Map Mutex
+        const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
         unique_lock<mutex> lock(pMap->mMutexMapUpdate);
+        Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
         const int nLP = vpMapPoints.size();
         for(int i=0; i<nLP;i++)
         {
@@ -2267,16 +2176,17 @@ void LoopClosing::ResetIfRequested()
 
 void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoopKF)
 {  
-    Verbose::PrintMess("Starting Global Bundle Adjustment", Verbose::VERBOSITY_NORMAL);
+    Instrumentation::SetThreadName("Global BA");
 
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_StartFGBA = std::chrono::steady_clock::now();
+    Verbose::PrintMess("Starting Global Bundle Adjustment", Verbose::VERBOSITY_NORMAL);
 
-    nFGBA_exec += 1;
+    const Instrumentation::TimePoint time_StartFGBA = Instrumentation::Now();
 
-    vnGBAKFs.push_back(pActiveMap->GetAllKeyFrames().size());
-    vnGBAMPs.push_back(pActiveMap->GetAllMapPoints().size());
-#endif
+    if(Instrumentation::IsEnabled())
+    {
+        Instrumentation::RecordCount(Instrumentation::LC_GBA_KFS,pActiveMap->KeyFramesInMap());
+        Instrumentation::RecordCount(Instrumentation::LC_GBA_MPS,pActiveMap->MapPointsInMap());
+    }
 
     const bool bImuInit = pActiveMap->isImuInitialized();
 
@@ -2285,17 +2195,8 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
     else
         Optimizer::FullInertialBA(pActiveMap,7,false,nLoopKF,&mbStopGBA);
 
-#ifdef REGISTER_TIMES
-    std::chrono::steady_clock::time_point time_EndGBA = std::chrono::steady_clock::now();
-
-    double timeGBA = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndGBA - time_StartFGBA).count();
-    vdGBA_ms.push_back(timeGBA);
-
-    if(mbStopGBA)
-    {
-        nFGBA_abort += 1;
-    }
-#endif
+    const Instrumentation::TimePoint time_EndGBA = Instrumentation::Now();
+    Instrumentation::RecordInterval(mbStopGBA ? Instrumentation::LC_GBA_ABORTED : Instrumentation::LC_GBA,time_StartFGBA,time_EndGBA);
 
     int idx =  mnFullBAIdx;
     // Optimizer::GlobalBundleAdjustemnt(mpMap,10,&mbStopGBA,nLoopKF,false);
@@ -2320,13 +2221,17 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
             mpLocalMapper->RequestStop();
             // Wait until Local Mapping has effectively stopped
 
+            const Instrumentation::TimePoint time_StartWaitLM = Instrumentation::Now();
             while(!mpLocalMapper->isStopped() && !mpLocalMapper->isFinished())
             {
                 usleep(1000);
             }
+            Instrumentation::TraceWait("Wait LocalMapping stop",time_StartWaitLM);
 
             // Get Map Mutex
+            const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
             unique_lock<mutex> lock(pActiveMap->mMutexMapUpdate);
+            Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
             // cout << "LC: Update Map Mutex adquired" << endl;
 
             //pActiveMap->PrintEssentialGraph();
@@ -2493,15 +2398,9 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 
             mpLocalMapper->Release();
 
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndUpdateMap = std::chrono::steady_clock::now();
-
-            double timeUpdateMap = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndUpdateMap - time_EndGBA).count();
-            vdUpdateMap_ms.push_back(timeUpdateMap);
-
-            double timeFGBA = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndUpdateMap - time_StartFGBA).count();
-            vdFGBATotal_ms.push_back(timeFGBA);
-#endif
+            const Instrumentation::TimePoint time_EndUpdateMap = Instrumentation::Now();
+            Instrumentation::RecordInterval(Instrumentation::LC_GBA_UPDATE_MAP,time_EndGBA,time_EndUpdateMap);
+            Instrumentation::RecordInterval(Instrumentation::LC_GBA_TOTAL,time_StartFGBA,time_EndUpdateMap);
             Verbose::PrintMess("Map updated!", Verbose::VERBOSITY_NORMAL);
         }
         mbFinishedGBA = true;
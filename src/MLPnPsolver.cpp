@@ -47,22 +47,22 @@
 ******************************************************************************/
 
 #include "MLPnPsolver.h"
+#include "ORBmatcher.h"
 
 #include <Eigen/Sparse>
 
 
 namespace ORB_SLAM3 {
     MLPnPsolver::MLPnPsolver(const Frame &F, const vector<MapPoint *> &vpMapPointMatches):
-            mnInliersi(0), mnIterations(0), mnBestInliers(0), N(0), mpCamera(F.mpCamera){
+            mnInliersi(0), mnIterations(0), mnBestInliers(0), N(0), mRansac(this), mpCamera(F.mpCamera){
         mvpMapPointMatches = vpMapPointMatches;
         mvBearingVecs.reserve(F.mvpMapPoints.size());
         mvP2D.reserve(F.mvpMapPoints.size());
         mvSigma2.reserve(F.mvpMapPoints.size());
         mvP3Dw.reserve(F.mvpMapPoints.size());
         mvKeyPointIndices.reserve(F.mvpMapPoints.size());
-        mvAllIndices.reserve(F.mvpMapPoints.size());
+        mvDescDist.reserve(F.mvpMapPoints.size());
 
-        int idx = 0;
         for(size_t i = 0, iend = mvpMapPointMatches.size(); i < iend; i++){
             MapPoint* pMP = vpMapPointMatches[i];
 
@@ -86,9 +86,8 @@ namespace ORB_SLAM3 {
                     mvP3Dw.push_back(pos);
 
                     mvKeyPointIndices.push_back(i);
-                    mvAllIndices.push_back(idx);
 
-                    idx++;
+                    mvDescDist.push_back(ORBmatcher::DescriptorDistance(pMP->GetDescriptor(),F.mDescriptors.row(i)));
                 }
             }
         }
@@ -109,102 +108,52 @@ namespace ORB_SLAM3 {
 	        return false;
 	    }
 
-	    vector<size_t> vAvailableIndices;
-
-	    int nCurrentIterations = 0;
-	    while(mnIterations<mRansacMaxIts || nCurrentIterations<nIterations)
+	    // Each new best hypothesis with enough inliers is refined
+	    int nRemainingIterations = nIterations;
+	    while(mRansac.Iterate(nRemainingIterations,mRansacMinInliers,bNoMore))
 	    {
-	        nCurrentIterations++;
-	        mnIterations++;
-
-	        vAvailableIndices = mvAllIndices;
-
-            //Bearing vectors and 3D points used for this ransac iteration
-            bearingVectors_t bearingVecs(mRansacMinSet);
-            points_t p3DS(mRansacMinSet);
-            vector<int> indexes(mRansacMinSet);
-
-	        // Get min set of points
-	        for(short i = 0; i < mRansacMinSet; ++i)
-	        {
-	            int randi = DUtils::Random::RandomInt(0, vAvailableIndices.size()-1);
-
-	            int idx = vAvailableIndices[randi];
-
-                bearingVecs[i] = mvBearingVecs[idx];
-                p3DS[i] = mvP3Dw[idx];
-                indexes[i] = i;
-
-	            vAvailableIndices[randi] = vAvailableIndices.back();
-	            vAvailableIndices.pop_back();
-	        }
-
-            //By the moment, we are using MLPnP without covariance info
-            cov3_mats_t covs(1);
-
-            //Result
-            transformation_t result;
-
-	        // Compute camera pose
-            computePose(bearingVecs,p3DS,covs,indexes,result);
+	        const transformation_t &result = mRansac.GetBestModel();
 
             //Save result
-            mRi[0][0] = result(0,0);
-            mRi[0][1] = result(0,1);
-            mRi[0][2] = result(0,2);
-
-            mRi[1][0] = result(1,0);
-            mRi[1][1] = result(1,1);
-            mRi[1][2] = result(1,2);
-
-            mRi[2][0] = result(2,0);
-            mRi[2][1] = result(2,1);
-            mRi[2][2] = result(2,2);
+            for(int r=0; r<3; r++)
+            {
+                for(int c=0; c<3; c++)
+                    mRi[r][c] = result(r,c);
+                mti[r] = result(r,3);
+            }
 
-            mti[0] = result(0,3);mti[1] = result(1,3);mti[2] = result(2,3);
+	        mvbBestInliers = mRansac.GetBestInliers();
+	        mnBestInliers = mRansac.GetBestNumInliers();
 
-	        // Check inliers
-	        CheckInliers();
+	        cv::Mat Rcw(3,3,CV_64F,mRi);
+	        cv::Mat tcw(3,1,CV_64F,mti);
+	        Rcw.convertTo(Rcw,CV_32F);
+	        tcw.convertTo(tcw,CV_32F);
+            mBestTcw.setIdentity();
+            mBestTcw.block<3,3>(0,0) = Converter::toMatrix3f(Rcw);
+            mBestTcw.block<3,1>(0,3) = Converter::toVector3f(tcw);
 
-	        if(mnInliersi>=mRansacMinInliers)
+	        if(Refine())
 	        {
-	            // If it is the best solution so far, save it
-	            if(mnInliersi>mnBestInliers)
-	            {
-	                mvbBestInliers = mvbInliersi;
-	                mnBestInliers = mnInliersi;
-
-	                cv::Mat Rcw(3,3,CV_64F,mRi);
-	                cv::Mat tcw(3,1,CV_64F,mti);
-	                Rcw.convertTo(Rcw,CV_32F);
-	                tcw.convertTo(tcw,CV_32F);
-                    mBestTcw.setIdentity();
-                    mBestTcw.block<3,3>(0,0) = Converter::toMatrix3f(Rcw);
-                    mBestTcw.block<3,1>(0,3) = Converter::toVector3f(tcw);
-
-                    Eigen::Matrix<double, 3, 3, Eigen::RowMajor> eigRcw(mRi[0]);
-                    Eigen::Vector3d eigtcw(mti);
-	            }
-
-	            if(Refine())
+	            nInliers = mnRefinedInliers;
+	            vbInliers = vector<bool>(mvpMapPointMatches.size(),false);
+	            for(int i=0; i<N; i++)
 	            {
-	                nInliers = mnRefinedInliers;
-	                vbInliers = vector<bool>(mvpMapPointMatches.size(),false);
-	                for(int i=0; i<N; i++)
-	                {
-	                    if(mvbRefinedInliers[i])
-	                        vbInliers[mvKeyPointIndices[i]] = true;
-	                }
-	                Tout = mRefinedTcw;
-	                return true;
+	                if(mvbRefinedInliers[i])
+	                    vbInliers[mvKeyPointIndices[i]] = true;
 	            }
-
+	            Tout = mRefinedTcw;
+	            return true;
 	        }
+
+	        if(bNoMore)
+	            break;
 	    }
 
-	    if(mnIterations>=mRansacMaxIts)
+	    mnIterations = mRansac.GetNumIterations();
+
+	    if(bNoMore)
 	    {
-	        bNoMore=true;
 	        if(mnBestInliers>=mRansacMinInliers)
 	        {
 	            nInliers=mnBestInliers;
@@ -222,6 +171,47 @@ namespace ORB_SLAM3 {
 	    return false;
 	}
 
+    bool MLPnPsolver::ComputeModel(const std::vector<size_t> &vSample, Model &model){
+        //Bearing vectors and 3D points used for this ransac iteration
+        bearingVectors_t bearingVecs(vSample.size());
+        points_t p3DS(vSample.size());
+        vector<int> indexes(vSample.size());
+
+        for(size_t i = 0; i < vSample.size(); ++i)
+        {
+            bearingVecs[i] = mvBearingVecs[vSample[i]];
+            p3DS[i] = mvP3Dw[vSample[i]];
+            indexes[i] = i;
+        }
+
+        //By the moment, we are using MLPnP without covariance info
+        cov3_mats_t covs(1);
+
+        // Compute camera pose
+        computePose(bearingVecs,p3DS,covs,indexes,model);
+
+        return model.allFinite();
+    }
+
+    bool MLPnPsolver::IsInlier(const Model &model, const size_t idx){
+        const point_t &p = mvP3Dw[idx];
+
+        const float xc = model(0,0)*p(0)+model(0,1)*p(1)+model(0,2)*p(2)+model(0,3);
+        const float yc = model(1,0)*p(0)+model(1,1)*p(1)+model(1,2)*p(2)+model(1,3);
+        const float zc = model(2,0)*p(0)+model(2,1)*p(1)+model(2,2)*p(2)+model(2,3);
+
+        cv::Point2f uv = mpCamera->project(cv::Point3f(xc,yc,zc));
+
+        const float distX = mvP2D[idx].x-uv.x;
+        const float distY = mvP2D[idx].y-uv.y;
+
+        return distX*distX+distY*distY<mvMaxError[idx];
+    }
+
+    void MLPnPsolver::SetSeed(unsigned int seed){
+        mRansac.SetSeed(seed);
+    }
+
 	void MLPnPsolver::SetRansacParameters(double probability, int minInliers, int maxIterations, int minSet, float epsilon, float th2){
 		mRansacProb = probability;
 	    mRansacMinInliers = minInliers;
@@ -257,6 +247,11 @@ namespace ORB_SLAM3 {
 	    mvMaxError.resize(mvSigma2.size());
 	    for(size_t i=0; i<mvSigma2.size(); i++)
 	        mvMaxError[i] = mvSigma2[i]*th2;
+
+	    mnIterations = 0;
+	    mRansac.SetRansacParameters(N,mRansacMinSet,mRansacProb,mRansacMinInliers,mRansacMaxIts);
+	    mRansac.SetQuality(mvDescDist);
+	    mRansac.SetSPRT(true,200.0);
 	}
 
     void MLPnPsolver::CheckInliers(){
@@ -27,7 +27,7 @@ namespace ORB_SLAM3
 long unsigned int Map::nNextId=0;
 
 Map::Map():mnMaxKFid(0),mnBigChangeIdx(0), mbImuInitialized(false), mnMapChange(0), mpFirstRegionKF(static_cast<KeyFrame*>(NULL)),
-mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false), mnLocalMapChangeIdx(0)
 {
     mnId=nNextId++;
     mThumbnail = static_cast<GLubyte*>(NULL);
@@ -35,7 +35,7 @@ mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNo
 
 Map::Map(int initKFid):mnInitKFid(initKFid), mnMaxKFid(initKFid),/*mnLastLoopKFid(initKFid),*/ mnBigChangeIdx(0), mIsInUse(false),
                        mHasTumbnail(false), mbBad(false), mbImuInitialized(false), mpFirstRegionKF(static_cast<KeyFrame*>(NULL)),
-                       mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+                       mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false), mnLocalMapChangeIdx(0)
 {
     mnId=nNextId++;
     mThumbnail = static_cast<GLubyte*>(NULL);
@@ -67,6 +67,7 @@ void Map::AddKeyFrame(KeyFrame *pKF)
         mpKFlowerID = pKF;
     }
     mspKeyFrames.insert(pKF);
+    mnLocalMapChangeIdx++;
     if(pKF->mnId>mnMaxKFid)
     {
         mnMaxKFid=pKF->mnId;
@@ -108,6 +109,7 @@ void Map::EraseKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexMap);
     mspKeyFrames.erase(pKF);
+    mnLocalMapChangeIdx++;
     if(mspKeyFrames.size()>0)
     {
         if(pKF->mnId == mpKFlowerID->mnId)
@@ -136,6 +138,7 @@ void Map::InformNewBigChange()
 {
     unique_lock<mutex> lock(mMutexMap);
     mnBigChangeIdx++;
+    mnLocalMapChangeIdx++;
 }
 
 int Map::GetLastBigChangeIdx()
@@ -162,6 +165,24 @@ long unsigned int Map::MapPointsInMap()
     return mspMapPoints.size();
 }
 
+void Map::AddMemoryUsage(MemoryUsage &usage)
+{
+    vector<KeyFrame*> vpKFs;
+    vector<MapPoint*> vpMPs;
+    {
+        unique_lock<mutex> lock(mMutexMap);
+        vpKFs.assign(mspKeyFrames.begin(),mspKeyFrames.end());
+        vpMPs.assign(mspMapPoints.begin(),mspMapPoints.end());
+        usage.keyFrameGraph += MemoryUsage::SetBytes(mspKeyFrames);
+        usage.mapPointBase += MemoryUsage::SetBytes(mspMapPoints);
+    }
+
+    for(KeyFrame* pKF : vpKFs)
+        pKF->AddMemoryUsage(usage);
+    for(MapPoint* pMP : vpMPs)
+        pMP->AddMemoryUsage(usage);
+}
+
 long unsigned int Map::KeyFramesInMap()
 {
     unique_lock<mutex> lock(mMutexMap);
@@ -231,6 +252,7 @@ void Map::clear()
     mvpKeyFrameOrigins.clear();
     mbIMU_BA1 = false;
     mbIMU_BA2 = false;
+    mnLocalMapChangeIdx++;
 }
 
 bool Map::IsInUse()
@@ -342,6 +364,7 @@ void Map::IncreaseChangeIndex()
 {
     unique_lock<mutex> lock(mMutexMap);
     mnMapChange++;
+    mnLocalMapChangeIdx++;
 }
 
 int Map::GetLastMapChange()
@@ -356,6 +379,18 @@ void Map::SetLastMapChange(int currentChangeId)
     mnMapChangeNotified = currentChangeId;
 }
 
+int Map::GetLocalMapChangeIdx()
+{
+    unique_lock<mutex> lock(mMutexMap);
+    return mnLocalMapChangeIdx;
+}
+
+void Map::InformLocalMapChange()
+{
+    unique_lock<mutex> lock(mMutexMap);
+    mnLocalMapChangeIdx++;
+}
+
 void Map::PreSave(std::set<GeometricCamera*> &spCams)
 {
     int nMPWithoutObs = 0;
@@ -21,12 +21,17 @@
 #include "KeyFrame.h"
 #include <pangolin/pangolin.h>
 #include <mutex>
+#include <algorithm>
 
 namespace ORB_SLAM3
 {
 
 
-MapDrawer::MapDrawer(Atlas* pAtlas, const string &strSettingPath, Settings* settings):mpAtlas(pAtlas)
+MapDrawer::MapDrawer(Atlas* pAtlas, const string &strSettingPath, Settings* settings):mpAtlas(pAtlas),
+    mpPointsMap(static_cast<Map*>(NULL)), mnPointsBigChangeIdx(-1), mnPointsChangeIdx(-1), mnPointsLocalChangeIdx(-1),
+    mnPointsInMap(0), mnPointRefreshCursor(0), mpKFsMap(static_cast<Map*>(NULL)), mnKFsBigChangeIdx(-1), mnKFsChangeIdx(-1),
+    mnKFsLocalChangeIdx(-1), mnKFsNumMaps(0), mnKFsOptions(-1), mnKFVertices(0), mnOriginKFVertices(0), mnGraphVertices(0),
+    mnInertialVertices(0)
 {
     if(settings){
         newParameterLoader(settings);
@@ -138,152 +143,319 @@ void MapDrawer::DrawMapPoints()
     if(!pActiveMap)
         return;
 
-    const vector<MapPoint*> &vpMPs = pActiveMap->GetAllMapPoints();
-    const vector<MapPoint*> &vpRefMPs = pActiveMap->GetReferenceMapPoints();
+    UpdateMapPointBuffers(pActiveMap);
 
-    set<MapPoint*> spRefMPs(vpRefMPs.begin(), vpRefMPs.end());
+    // Normal points in black, reference points in red, in a single draw call
+    glPointSize(mPointSize);
+    DrawBuffer(mPointVbo,&mPointCbo,GL_POINTS,mvpPointSlots.size());
+}
 
-    if(vpMPs.empty())
-        return;
+void MapDrawer::UpdateMapPointBuffers(Map* pMap)
+{
+    const int nBigChangeIdx = pMap->GetLastBigChangeIdx();
+    const int nChangeIdx = pMap->GetMapChangeIndex();
+    const int nLocalChangeIdx = pMap->GetLocalMapChangeIdx();
+    const long unsigned int nMPs = pMap->MapPointsInMap();
 
-    glPointSize(mPointSize);
-    glBegin(GL_POINTS);
-    glColor3f(0.0,0.0,0.0);
+    // A different map, or a loop closure / global BA moved the whole map: start from scratch
+    if(pMap!=mpPointsMap || nBigChangeIdx!=mnPointsBigChangeIdx)
+    {
+        mvpPointSlots.clear();
+        mmPointSlots.clear();
+        mvPointVertices.clear();
+        mvPointColors.clear();
+        mvpRefPoints.clear();
+        mvDirtyPointSlots.clear();
+        mnPointRefreshCursor = 0;
+
+        mpPointsMap = pMap;
+        mnPointsBigChangeIdx = nBigChangeIdx;
+        mnPointsChangeIdx = nChangeIdx;
+        mnPointsLocalChangeIdx = nLocalChangeIdx-1;
+    }
+
+    // Points were created or erased: new points take a slot at the end,
+    // the slot of an erased point is filled with the last one
+    if(nLocalChangeIdx!=mnPointsLocalChangeIdx || nMPs!=mnPointsInMap)
+    {
+        const vector<MapPoint*> vpMPs = pMap->GetAllMapPoints();
+        vector<bool> vbInMap(mvpPointSlots.size(),false);
+
+        for(MapPoint* pMP : vpMPs)
+        {
+            if(!pMP)
+                continue;
+            unordered_map<MapPoint*,size_t>::const_iterator it = mmPointSlots.find(pMP);
+            if(it!=mmPointSlots.end())
+                vbInMap[it->second] = true;
+            else
+                AddPointSlot(pMP);
+        }
+
+        // Backwards, so the slot moved into a hole has already been checked
+        for(size_t slot=vbInMap.size(); slot-->0;)
+        {
+            if(!vbInMap[slot])
+                RemovePointSlot(slot);
+        }
 
-    for(size_t i=0, iend=vpMPs.size(); i<iend;i++)
+        mnPointsLocalChangeIdx = nLocalChangeIdx;
+        mnPointsInMap = nMPs;
+    }
+
+    // Reference points (local map of Tracking)
+    const vector<MapPoint*> vpRefMPs = pMap->GetReferenceMapPoints();
+    for(MapPoint* pMP : mvpRefPoints)
     {
-        if(vpMPs[i]->isBad() || spRefMPs.count(vpMPs[i]))
+        unordered_map<MapPoint*,size_t>::const_iterator it = mmPointSlots.find(pMP);
+        if(it!=mmPointSlots.end())
+            SetPointSlotColor(it->second,false);
+    }
+    mvpRefPoints.clear();
+    for(MapPoint* pMP : vpRefMPs)
+    {
+        unordered_map<MapPoint*,size_t>::const_iterator it = mmPointSlots.find(pMP);
+        if(it==mmPointSlots.end())
             continue;
-        Eigen::Matrix<float,3,1> pos = vpMPs[i]->GetWorldPos();
-        glVertex3f(pos(0),pos(1),pos(2));
+        SetPointSlotColor(it->second,true);
+        mvpRefPoints.push_back(pMP);
     }
-    glEnd();
 
-    glPointSize(mPointSize);
-    glBegin(GL_POINTS);
-    glColor3f(1.0,0.0,0.0);
+    // Local BA moves the local map, which is refreshed right away. The rest of the map
+    // is refreshed a slice per redraw, so any other correction shows up after a few redraws
+    if(nChangeIdx!=mnPointsChangeIdx)
+    {
+        for(MapPoint* pMP : mvpRefPoints)
+            SetPointSlotPosition(mmPointSlots[pMP],pMP->GetWorldPos());
+        mnPointsChangeIdx = nChangeIdx;
+    }
 
-    for(set<MapPoint*>::iterator sit=spRefMPs.begin(), send=spRefMPs.end(); sit!=send; sit++)
+    const size_t nRefresh = min<size_t>(mvpPointSlots.size(),10000);
+    for(size_t i=0; i<nRefresh; i++)
     {
-        if((*sit)->isBad())
-            continue;
-        Eigen::Matrix<float,3,1> pos = (*sit)->GetWorldPos();
-        glVertex3f(pos(0),pos(1),pos(2));
+        if(mnPointRefreshCursor>=mvpPointSlots.size())
+            mnPointRefreshCursor = 0;
+        SetPointSlotPosition(mnPointRefreshCursor,mvpPointSlots[mnPointRefreshCursor]->GetWorldPos());
+        mnPointRefreshCursor++;
+    }
+
+    UploadPointSlots();
+}
+
+void MapDrawer::AddPointSlot(MapPoint* pMP)
+{
+    const size_t slot = mvpPointSlots.size();
+    const Eigen::Vector3f pos = pMP->GetWorldPos();
+
+    mvpPointSlots.push_back(pMP);
+    mmPointSlots[pMP] = slot;
+    mvPointVertices.insert(mvPointVertices.end(),{pos(0),pos(1),pos(2)});
+    mvPointColors.insert(mvPointColors.end(),{0,0,0});
+    mvDirtyPointSlots.push_back(slot);
+}
+
+void MapDrawer::RemovePointSlot(const size_t slot)
+{
+    const size_t last = mvpPointSlots.size()-1;
+    mmPointSlots.erase(mvpPointSlots[slot]);
 
+    if(slot!=last)
+    {
+        MapPoint* pMP = mvpPointSlots[last];
+        mvpPointSlots[slot] = pMP;
+        mmPointSlots[pMP] = slot;
+        for(int j=0; j<3; j++)
+        {
+            mvPointVertices[3*slot+j] = mvPointVertices[3*last+j];
+            mvPointColors[3*slot+j] = mvPointColors[3*last+j];
+        }
+        mvDirtyPointSlots.push_back(slot);
     }
 
-    glEnd();
+    mvpPointSlots.pop_back();
+    mvPointVertices.resize(3*last);
+    mvPointColors.resize(3*last);
 }
 
-void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const bool bDrawInertialGraph, const bool bDrawOptLba)
+void MapDrawer::SetPointSlotPosition(const size_t slot, const Eigen::Vector3f &pos)
 {
-    const float &w = mKeyFrameSize;
-    const float h = w*0.75;
-    const float z = w*0.6;
+    float* v = &mvPointVertices[3*slot];
+    if(v[0]==pos(0) && v[1]==pos(1) && v[2]==pos(2))
+        return;
 
-    Map* pActiveMap = mpAtlas->GetCurrentMap();
-    // DEBUG LBA
-    std::set<long unsigned int> sOptKFs = pActiveMap->msOptKFs;
-    std::set<long unsigned int> sFixedKFs = pActiveMap->msFixedKFs;
+    v[0] = pos(0);
+    v[1] = pos(1);
+    v[2] = pos(2);
+    mvDirtyPointSlots.push_back(slot);
+}
+
+void MapDrawer::SetPointSlotColor(const size_t slot, const bool bReference)
+{
+    const unsigned char red = bReference ? 255 : 0;
+    if(mvPointColors[3*slot]==red)
+        return;
+
+    mvPointColors[3*slot] = red;
+    mvDirtyPointSlots.push_back(slot);
+}
+
+void MapDrawer::UploadPointSlots()
+{
+    const size_t nSlots = mvpPointSlots.size();
+
+    // Grow the buffers geometrically, everything is uploaded after a reallocation
+    if(nSlots>mPointVbo.num_elements)
+    {
+        const size_t capacity = max<size_t>(2*nSlots,4096);
+        mPointVbo.Reinitialise(pangolin::GlArrayBuffer,capacity,GL_FLOAT,3,GL_DYNAMIC_DRAW);
+        mPointCbo.Reinitialise(pangolin::GlArrayBuffer,capacity,GL_UNSIGNED_BYTE,3,GL_DYNAMIC_DRAW);
+        mPointVbo.Upload(mvPointVertices.data(),nSlots*3*sizeof(float));
+        mPointCbo.Upload(mvPointColors.data(),nSlots*3*sizeof(unsigned char));
+        mvDirtyPointSlots.clear();
+        return;
+    }
+
+    if(mvDirtyPointSlots.empty())
+        return;
 
+    // Upload consecutive dirty slots together
+    sort(mvDirtyPointSlots.begin(),mvDirtyPointSlots.end());
+    mvDirtyPointSlots.erase(unique(mvDirtyPointSlots.begin(),mvDirtyPointSlots.end()),mvDirtyPointSlots.end());
+
+    size_t i=0;
+    while(i<mvDirtyPointSlots.size() && mvDirtyPointSlots[i]<nSlots)
+    {
+        const size_t first = mvDirtyPointSlots[i];
+        size_t last = first;
+        while(i+1<mvDirtyPointSlots.size() && mvDirtyPointSlots[i+1]==last+1 && mvDirtyPointSlots[i+1]<nSlots)
+            last = mvDirtyPointSlots[++i];
+        i++;
+
+        const size_t n = last-first+1;
+        mPointVbo.Upload(&mvPointVertices[3*first],n*3*sizeof(float),first*3*sizeof(float));
+        mPointCbo.Upload(&mvPointColors[3*first],n*3*sizeof(unsigned char),first*3*sizeof(unsigned char));
+    }
+    mvDirtyPointSlots.clear();
+}
+
+void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const bool bDrawInertialGraph, const bool bDrawOptLba)
+{
+    Map* pActiveMap = mpAtlas->GetCurrentMap();
     if(!pActiveMap)
         return;
 
-    const vector<KeyFrame*> vpKFs = pActiveMap->GetAllKeyFrames();
+    UpdateKeyFrameBuffers(pActiveMap,bDrawKF,bDrawGraph,bDrawInertialGraph,bDrawOptLba);
 
     if(bDrawKF)
     {
-        for(size_t i=0; i<vpKFs.size(); i++)
-        {
-            KeyFrame* pKF = vpKFs[i];
-            Eigen::Matrix4f Twc = pKF->GetPoseInverse().matrix();
-            unsigned int index_color = pKF->mnOriginMapId;
+        glLineWidth(mKeyFrameLineWidth);
+        DrawBuffer(mKFVbo,&mKFCbo,GL_LINES,mnKFVertices);
 
-            glPushMatrix();
+        // First KF of each map
+        glLineWidth(mKeyFrameLineWidth*5);
+        glColor3f(1.0f,0.0f,0.0f);
+        DrawBuffer(mOriginKFVbo,NULL,GL_LINES,mnOriginKFVertices);
+    }
 
-            glMultMatrixf((GLfloat*)Twc.data());
+    if(bDrawGraph)
+    {
+        glLineWidth(mGraphLineWidth);
+        glColor4f(0.0f,1.0f,0.0f,0.6f);
+        DrawBuffer(mGraphVbo,NULL,GL_LINES,mnGraphVertices);
+    }
 
-            if(!pKF->GetParent()) // It is the first KF in the map
-            {
-                glLineWidth(mKeyFrameLineWidth*5);
-                glColor3f(1.0f,0.0f,0.0f);
-                glBegin(GL_LINES);
-            }
-            else
-            {
-                //cout << "Child KF: " << vpKFs[i]->mnId << endl;
-                glLineWidth(mKeyFrameLineWidth);
-                if (bDrawOptLba) {
-                    if(sOptKFs.find(pKF->mnId) != sOptKFs.end())
-                    {
-                        glColor3f(0.0f,1.0f,0.0f); // Green -> Opt KFs
-                    }
-                    else if(sFixedKFs.find(pKF->mnId) != sFixedKFs.end())
-                    {
-                        glColor3f(1.0f,0.0f,0.0f); // Red -> Fixed KFs
-                    }
-                    else
-                    {
-                        glColor3f(0.0f,0.0f,1.0f); // Basic color
-                    }
-                }
-                else
-                {
-                    glColor3f(0.0f,0.0f,1.0f); // Basic color
-                }
-                glBegin(GL_LINES);
-            }
+    if(bDrawInertialGraph && pActiveMap->isImuInitialized())
+    {
+        glLineWidth(mGraphLineWidth);
+        glColor4f(1.0f,0.0f,0.0f,0.6f);
+        DrawBuffer(mInertialVbo,NULL,GL_LINES,mnInertialVertices);
+    }
+}
 
-            glVertex3f(0,0,0);
-            glVertex3f(w,h,z);
-            glVertex3f(0,0,0);
-            glVertex3f(w,-h,z);
-            glVertex3f(0,0,0);
-            glVertex3f(-w,-h,z);
-            glVertex3f(0,0,0);
-            glVertex3f(-w,h,z);
+void MapDrawer::UpdateKeyFrameBuffers(Map* pActiveMap, const bool bDrawKF, const bool bDrawGraph, const bool bDrawInertialGraph, const bool bDrawOptLba)
+{
+    const vector<Map*> vpMaps = mpAtlas->GetAllMaps();
+    const int nBigChangeIdx = pActiveMap->GetLastBigChangeIdx();
+    const int nChangeIdx = pActiveMap->GetMapChangeIndex();
+    const int nLocalChangeIdx = pActiveMap->GetLocalMapChangeIdx();
+    const bool bDrawInertial = bDrawInertialGraph && pActiveMap->isImuInitialized();
+    const int nOptions = (bDrawKF ? 1 : 0) | (bDrawGraph ? 2 : 0) | (bDrawInertial ? 4 : 0) | (bDrawOptLba ? 8 : 0);
+
+    // Keyframe poses only change with the map, rebuild the layers when it changes
+    if(pActiveMap==mpKFsMap && nBigChangeIdx==mnKFsBigChangeIdx && nChangeIdx==mnKFsChangeIdx &&
+       nLocalChangeIdx==mnKFsLocalChangeIdx && vpMaps.size()==mnKFsNumMaps && nOptions==mnKFsOptions)
+        return;
 
-            glVertex3f(w,h,z);
-            glVertex3f(w,-h,z);
+    mpKFsMap = pActiveMap;
+    mnKFsBigChangeIdx = nBigChangeIdx;
+    mnKFsChangeIdx = nChangeIdx;
+    mnKFsLocalChangeIdx = nLocalChangeIdx;
+    mnKFsNumMaps = vpMaps.size();
+    mnKFsOptions = nOptions;
 
-            glVertex3f(-w,h,z);
-            glVertex3f(-w,-h,z);
+    const vector<KeyFrame*> vpKFs = pActiveMap->GetAllKeyFrames();
 
-            glVertex3f(-w,h,z);
-            glVertex3f(w,h,z);
+    vector<float> vKFVertices, vKFColors, vOriginKFVertices;
+    if(bDrawKF)
+    {
+        // DEBUG LBA
+        std::set<long unsigned int> sOptKFs = pActiveMap->msOptKFs;
+        std::set<long unsigned int> sFixedKFs = pActiveMap->msFixedKFs;
+
+        for(Map* pMap : vpMaps)
+        {
+            const bool bActive = pMap==pActiveMap;
+            const vector<KeyFrame*> vpMapKFs = bActive ? vpKFs : pMap->GetAllKeyFrames();
+
+            for(KeyFrame* pKF : vpMapKFs)
+            {
+                const Sophus::SE3f Twc = pKF->GetPoseInverse();
 
-            glVertex3f(-w,-h,z);
-            glVertex3f(w,-h,z);
-            glEnd();
+                if(!pKF->GetParent()) // It is the first KF in the map
+                {
+                    AddFrustum(Twc,vOriginKFVertices);
+                    continue;
+                }
 
-            glPopMatrix();
+                float color[3] = {0.0f, 0.0f, 1.0f}; // Basic color
+                if(!bActive)
+                {
+                    const unsigned int index_color = pKF->mnOriginMapId % 6;
+                    color[0] = mfFrameColors[index_color][0];
+                    color[1] = mfFrameColors[index_color][1];
+                    color[2] = mfFrameColors[index_color][2];
+                }
+                else if(bDrawOptLba && sOptKFs.find(pKF->mnId) != sOptKFs.end())
+                {
+                    color[0] = 0.0f; color[1] = 1.0f; color[2] = 0.0f; // Green -> Opt KFs
+                }
+                else if(bDrawOptLba && sFixedKFs.find(pKF->mnId) != sFixedKFs.end())
+                {
+                    color[0] = 1.0f; color[1] = 0.0f; color[2] = 0.0f; // Red -> Fixed KFs
+                }
 
-            glEnd();
+                const size_t nPrev = vKFVertices.size();
+                AddFrustum(Twc,vKFVertices);
+                for(size_t i=nPrev; i<vKFVertices.size(); i+=3)
+                    vKFColors.insert(vKFColors.end(),{color[0],color[1],color[2]});
+            }
         }
     }
 
+    vector<float> vGraphVertices;
     if(bDrawGraph)
     {
-        glLineWidth(mGraphLineWidth);
-        glColor4f(0.0f,1.0f,0.0f,0.6f);
-        glBegin(GL_LINES);
-
-        // cout << "-----------------Draw graph-----------------" << endl;
         for(size_t i=0; i<vpKFs.size(); i++)
         {
             // Covisibility Graph
             const vector<KeyFrame*> vCovKFs = vpKFs[i]->GetCovisiblesByWeight(100);
             Eigen::Vector3f Ow = vpKFs[i]->GetCameraCenter();
-            if(!vCovKFs.empty())
+            for(vector<KeyFrame*>::const_iterator vit=vCovKFs.begin(), vend=vCovKFs.end(); vit!=vend; vit++)
             {
-                for(vector<KeyFrame*>::const_iterator vit=vCovKFs.begin(), vend=vCovKFs.end(); vit!=vend; vit++)
-                {
-                    if((*vit)->mnId<vpKFs[i]->mnId)
-                        continue;
-                    Eigen::Vector3f Ow2 = (*vit)->GetCameraCenter();
-                    glVertex3f(Ow(0),Ow(1),Ow(2));
-                    glVertex3f(Ow2(0),Ow2(1),Ow2(2));
-                }
+                if((*vit)->mnId<vpKFs[i]->mnId)
+                    continue;
+                Eigen::Vector3f Ow2 = (*vit)->GetCameraCenter();
+                vGraphVertices.insert(vGraphVertices.end(),{Ow(0),Ow(1),Ow(2),Ow2(0),Ow2(1),Ow2(2)});
             }
 
             // Spanning tree
@@ -291,8 +463,7 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const b
             if(pParent)
             {
                 Eigen::Vector3f Owp = pParent->GetCameraCenter();
-                glVertex3f(Ow(0),Ow(1),Ow(2));
-                glVertex3f(Owp(0),Owp(1),Owp(2));
+                vGraphVertices.insert(vGraphVertices.end(),{Ow(0),Ow(1),Ow(2),Owp(0),Owp(1),Owp(2)});
             }
 
             // Loops
@@ -302,96 +473,94 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const b
                 if((*sit)->mnId<vpKFs[i]->mnId)
                     continue;
                 Eigen::Vector3f Owl = (*sit)->GetCameraCenter();
-                glVertex3f(Ow(0),Ow(1),Ow(2));
-                glVertex3f(Owl(0),Owl(1),Owl(2));
+                vGraphVertices.insert(vGraphVertices.end(),{Ow(0),Ow(1),Ow(2),Owl(0),Owl(1),Owl(2)});
             }
         }
-
-        glEnd();
     }
 
-    if(bDrawInertialGraph && pActiveMap->isImuInitialized())
+    vector<float> vInertialVertices;
+    if(bDrawInertial)
     {
-        glLineWidth(mGraphLineWidth);
-        glColor4f(1.0f,0.0f,0.0f,0.6f);
-        glBegin(GL_LINES);
-
         //Draw inertial links
         for(size_t i=0; i<vpKFs.size(); i++)
         {
             KeyFrame* pKFi = vpKFs[i];
-            Eigen::Vector3f Ow = pKFi->GetCameraCenter();
             KeyFrame* pNext = pKFi->mNextKF;
             if(pNext)
             {
+                Eigen::Vector3f Ow = pKFi->GetCameraCenter();
                 Eigen::Vector3f Owp = pNext->GetCameraCenter();
-                glVertex3f(Ow(0),Ow(1),Ow(2));
-                glVertex3f(Owp(0),Owp(1),Owp(2));
+                vInertialVertices.insert(vInertialVertices.end(),{Ow(0),Ow(1),Ow(2),Owp(0),Owp(1),Owp(2)});
             }
         }
-
-        glEnd();
     }
 
-    vector<Map*> vpMaps = mpAtlas->GetAllMaps();
+    mnKFVertices = vKFVertices.size()/3;
+    mnOriginKFVertices = vOriginKFVertices.size()/3;
+    mnGraphVertices = vGraphVertices.size()/3;
+    mnInertialVertices = vInertialVertices.size()/3;
 
-    if(bDrawKF)
-    {
-        for(Map* pMap : vpMaps)
-        {
-            if(pMap == pActiveMap)
-                continue;
+    UploadBuffer(mKFVbo,vKFVertices.data(),mnKFVertices,GL_FLOAT,3,sizeof(float));
+    UploadBuffer(mKFCbo,vKFColors.data(),mnKFVertices,GL_FLOAT,3,sizeof(float));
+    UploadBuffer(mOriginKFVbo,vOriginKFVertices.data(),mnOriginKFVertices,GL_FLOAT,3,sizeof(float));
+    UploadBuffer(mGraphVbo,vGraphVertices.data(),mnGraphVertices,GL_FLOAT,3,sizeof(float));
+    UploadBuffer(mInertialVbo,vInertialVertices.data(),mnInertialVertices,GL_FLOAT,3,sizeof(float));
+}
 
-            vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+void MapDrawer::AddFrustum(const Sophus::SE3f &Twc, vector<float> &vVertices)
+{
+    const float &w = mKeyFrameSize;
+    const float h = w*0.75;
+    const float z = w*0.6;
 
-            for(size_t i=0; i<vpKFs.size(); i++)
-            {
-                KeyFrame* pKF = vpKFs[i];
-                Eigen::Matrix4f Twc = pKF->GetPoseInverse().matrix();
-                unsigned int index_color = pKF->mnOriginMapId;
+    const Eigen::Vector3f O = Twc.translation();
+    const Eigen::Vector3f P1 = Twc*Eigen::Vector3f(w,h,z);
+    const Eigen::Vector3f P2 = Twc*Eigen::Vector3f(w,-h,z);
+    const Eigen::Vector3f P3 = Twc*Eigen::Vector3f(-w,-h,z);
+    const Eigen::Vector3f P4 = Twc*Eigen::Vector3f(-w,h,z);
 
-                glPushMatrix();
+    const Eigen::Vector3f* vLines[16] = {&O,&P1, &O,&P2, &O,&P3, &O,&P4,
+                                         &P1,&P2, &P4,&P3, &P4,&P1, &P3,&P2};
+    for(int i=0; i<16; i++)
+        vVertices.insert(vVertices.end(),{(*vLines[i])(0),(*vLines[i])(1),(*vLines[i])(2)});
+}
 
-                glMultMatrixf((GLfloat*)Twc.data());
+void MapDrawer::UploadBuffer(pangolin::GlBuffer &buffer, const GLvoid* data, const size_t nElements, const GLenum datatype, const GLuint count, const size_t elementBytes)
+{
+    if(nElements==0)
+        return;
 
-                if(!vpKFs[i]->GetParent()) // It is the first KF in the map
-                {
-                    glLineWidth(mKeyFrameLineWidth*5);
-                    glColor3f(1.0f,0.0f,0.0f);
-                    glBegin(GL_LINES);
-                }
-                else
-                {
-                    glLineWidth(mKeyFrameLineWidth);
-                    glColor3f(mfFrameColors[index_color][0],mfFrameColors[index_color][1],mfFrameColors[index_color][2]);
-                    glBegin(GL_LINES);
-                }
+    if(nElements>buffer.num_elements)
+        buffer.Reinitialise(pangolin::GlArrayBuffer,max<size_t>(2*nElements,256),datatype,count,GL_DYNAMIC_DRAW);
+
+    buffer.Upload(data,nElements*count*elementBytes);
+}
 
-                glVertex3f(0,0,0);
-                glVertex3f(w,h,z);
-                glVertex3f(0,0,0);
-                glVertex3f(w,-h,z);
-                glVertex3f(0,0,0);
-                glVertex3f(-w,-h,z);
-                glVertex3f(0,0,0);
-                glVertex3f(-w,h,z);
+void MapDrawer::DrawBuffer(pangolin::GlBuffer &vbo, pangolin::GlBuffer *pCbo, const GLenum mode, const size_t nVertices)
+{
+    if(nVertices==0 || !vbo.IsValid())
+        return;
 
-                glVertex3f(w,h,z);
-                glVertex3f(w,-h,z);
+    if(pCbo)
+    {
+        pCbo->Bind();
+        glColorPointer(pCbo->count_per_element,pCbo->datatype,0,0);
+        glEnableClientState(GL_COLOR_ARRAY);
+    }
 
-                glVertex3f(-w,h,z);
-                glVertex3f(-w,-h,z);
+    vbo.Bind();
+    glVertexPointer(vbo.count_per_element,vbo.datatype,0,0);
+    glEnableClientState(GL_VERTEX_ARRAY);
 
-                glVertex3f(-w,h,z);
-                glVertex3f(w,h,z);
+    glDrawArrays(mode,0,nVertices);
 
-                glVertex3f(-w,-h,z);
-                glVertex3f(w,-h,z);
-                glEnd();
+    glDisableClientState(GL_VERTEX_ARRAY);
+    vbo.Unbind();
 
-                glPopMatrix();
-            }
-        }
+    if(pCbo)
+    {
+        glDisableClientState(GL_COLOR_ARRAY);
+        pCbo->Unbind();
     }
 }
 
@@ -438,6 +607,72 @@ void MapDrawer::DrawCurrentCamera(pangolin::OpenGlMatrix &Twc)
 }
 
 
+cv::Mat MapDrawer::DrawMapImage(const int size)
+{
+    cv::Mat im(size,size,CV_8UC3,cv::Scalar(255,255,255));
+
+    Map* pActiveMap = mpAtlas->GetCurrentMap();
+    if(!pActiveMap)
+        return im;
+
+    vector<KeyFrame*> vpKFs = pActiveMap->GetAllKeyFrames();
+    sort(vpKFs.begin(),vpKFs.end(),KeyFrame::lId);
+    const vector<MapPoint*> vpMPs = pActiveMap->GetAllMapPoints();
+    const vector<MapPoint*> vpRefMPs = pActiveMap->GetReferenceMapPoints();
+
+    Eigen::Vector3f Ocur;
+    {
+        unique_lock<mutex> lock(mMutexCamera);
+        Ocur = mCameraPose.translation();
+    }
+
+    // Fit the trajectory and the current camera with a margin around them
+    vector<Eigen::Vector3f> vOw;
+    vOw.reserve(vpKFs.size());
+    float minX = Ocur(0), maxX = Ocur(0), minZ = Ocur(2), maxZ = Ocur(2);
+    for(KeyFrame* pKF : vpKFs)
+    {
+        if(pKF->isBad())
+            continue;
+        const Eigen::Vector3f Ow = pKF->GetCameraCenter();
+        vOw.push_back(Ow);
+        minX = min(minX,Ow(0)); maxX = max(maxX,Ow(0));
+        minZ = min(minZ,Ow(2)); maxZ = max(maxZ,Ow(2));
+    }
+
+    const float extent = max(max(maxX-minX,maxZ-minZ),1.f)*1.5f;
+    const float scale = size/extent;
+    const float cx = 0.5f*(minX+maxX), cz = 0.5f*(minZ+maxZ);
+    auto toPixel = [&](const Eigen::Vector3f &x)
+    {
+        return cv::Point(cvRound((x(0)-cx)*scale + 0.5f*size), cvRound(0.5f*size - (x(2)-cz)*scale));
+    };
+    const cv::Rect rect(0,0,size,size);
+
+    for(MapPoint* pMP : vpMPs)
+    {
+        const cv::Point pt = toPixel(pMP->GetWorldPos());
+        if(rect.contains(pt))
+            im.at<cv::Vec3b>(pt) = cv::Vec3b(0,0,0);
+    }
+
+    for(MapPoint* pMP : vpRefMPs)
+    {
+        if(!pMP || pMP->isBad())
+            continue;
+        const cv::Point pt = toPixel(pMP->GetWorldPos());
+        if(rect.contains(pt))
+            cv::circle(im,pt,1,cv::Scalar(0,0,255),-1);
+    }
+
+    for(size_t i=1; i<vOw.size(); i++)
+        cv::line(im,toPixel(vOw[i-1]),toPixel(vOw[i]),cv::Scalar(255,0,0),1);
+
+    cv::circle(im,toPixel(Ocur),4,cv::Scalar(0,255,0),-1);
+
+    return im;
+}
+
 void MapDrawer::SetCurrentCameraPose(const Sophus::SE3f &Tcw)
 {
     unique_lock<mutex> lock(mMutexCamera);
@@ -408,6 +408,16 @@ cv::Mat MapPoint::GetDescriptor()
     return mDescriptor.clone();
 }
 
+void MapPoint::AddMemoryUsage(MemoryUsage &usage)
+{
+    usage.nMapPoints++;
+    usage.mapPointBase += sizeof(MapPoint);
+
+    unique_lock<mutex> lock(mMutexFeatures);
+    usage.mapPointDescriptors += mDescriptor.total()*mDescriptor.elemSize();
+    usage.mapPointObservations += MemoryUsage::MapBytes(mObservations);
+}
+
 tuple<int,int> MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexFeatures);
@@ -0,0 +1,86 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include "MemoryUsage.h"
+
+#include <sstream>
+#include <iomanip>
+
+namespace ORB_SLAM3
+{
+
+MemoryUsage::MemoryUsage():
+    nKeyFrames(0), nMapPoints(0), nImages(0), keyFrameBase(0), keyFrameKeyPoints(0), keyFrameDescriptors(0),
+    keyFrameGrid(0), keyFrameBoW(0), keyFrameGraph(0), mapPointBase(0), mapPointDescriptors(0),
+    mapPointObservations(0), images(0), encodedImages(0)
+{
+}
+
+size_t MemoryUsage::Total() const
+{
+    return keyFrameBase + keyFrameKeyPoints + keyFrameDescriptors + keyFrameGrid + keyFrameBoW + keyFrameGraph +
+           mapPointBase + mapPointDescriptors + mapPointObservations + images + encodedImages;
+}
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage &other)
+{
+    nKeyFrames += other.nKeyFrames;
+    nMapPoints += other.nMapPoints;
+    nImages += other.nImages;
+    keyFrameBase += other.keyFrameBase;
+    keyFrameKeyPoints += other.keyFrameKeyPoints;
+    keyFrameDescriptors += other.keyFrameDescriptors;
+    keyFrameGrid += other.keyFrameGrid;
+    keyFrameBoW += other.keyFrameBoW;
+    keyFrameGraph += other.keyFrameGraph;
+    mapPointBase += other.mapPointBase;
+    mapPointDescriptors += other.mapPointDescriptors;
+    mapPointObservations += other.mapPointObservations;
+    images += other.images;
+    encodedImages += other.encodedImages;
+    return *this;
+}
+
+std::string MemoryUsage::ToString() const
+{
+    const double MB = 1.0/(1024.0*1024.0);
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "Memory usage: " << Total()*MB << " MB (" << nKeyFrames << " KFs, " << nMapPoints << " MPs, "
+       << nImages << " images)" << std::endl;
+    ss << "  KF objects      " << keyFrameBase*MB << " MB" << std::endl;
+    ss << "  KF keypoints    " << keyFrameKeyPoints*MB << " MB" << std::endl;
+    ss << "  KF descriptors  " << keyFrameDescriptors*MB << " MB" << std::endl;
+    ss << "  KF grids        " << keyFrameGrid*MB << " MB" << std::endl;
+    ss << "  KF BoW          " << keyFrameBoW*MB << " MB" << std::endl;
+    ss << "  KF graph        " << keyFrameGraph*MB << " MB" << std::endl;
+    ss << "  MP objects      " << mapPointBase*MB << " MB" << std::endl;
+    ss << "  MP descriptors  " << mapPointDescriptors*MB << " MB" << std::endl;
+    ss << "  MP observations " << mapPointObservations*MB << " MB" << std::endl;
+    ss << "  Images          " << images*MB << " MB" << std::endl;
+    ss << "  Encoded images  " << encodedImages*MB << " MB" << std::endl;
+    return ss.str();
+}
+
+MemoryPolicy::MemoryPolicy(): nReportPeriod(0), nGridWindow(0), nBudgetBytes(0), bKeyFrameImagesOnly(false)
+{
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,143 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PointCloudFilter.h"
+#include "PointCloudKnn.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+namespace ORB_SLAM3
+{
+
+void PointCloudFilter::Apply(const Options &options, std::vector<Point> &vPoints, const int nThreads)
+{
+    std::cout << "Point cloud filter: " << vPoints.size() << " points";
+    if(options.nMinObservations > 0)
+    {
+        FilterObservations(vPoints, options.nMinObservations);
+        std::cout << ", " << vPoints.size() << " with " << options.nMinObservations << "+ observations";
+    }
+    if(options.nOutlierNeighbours > 0)
+    {
+        RemoveStatisticalOutliers(vPoints, options.nOutlierNeighbours, options.outlierStdRatio, nThreads);
+        std::cout << ", " << vPoints.size() << " inliers";
+    }
+    if(options.voxelSize > 0.f)
+    {
+        VoxelDownsample(vPoints, options.voxelSize);
+        std::cout << ", " << vPoints.size() << " voxels of " << options.voxelSize;
+    }
+    std::cout << std::endl;
+}
+
+void PointCloudFilter::FilterObservations(std::vector<Point> &vPoints, const int nMinObservations)
+{
+    size_t n = 0;
+    for(const Point &point : vPoints)
+    {
+        if(point.nObs >= nMinObservations)
+            vPoints[n++] = point;
+    }
+    vPoints.resize(n);
+}
+
+void PointCloudFilter::RemoveStatisticalOutliers(std::vector<Point> &vPoints, const int k, const float stdRatio,
+                                                 const int nThreads)
+{
+    // Too few points for k neighbours
+    if(vPoints.size() <= static_cast<size_t>(k))
+        return;
+
+    std::vector<Eigen::Vector3f> vPos(vPoints.size());
+    for(size_t i = 0; i < vPoints.size(); i++)
+        vPos[i] = vPoints[i].pos;
+    std::vector<float> vMeanDist;
+    PointCloudKnn::MeanDistances(vPos, k, vMeanDist, nThreads);
+
+    // Mean and sample standard deviation of the distances, in double as Open3D
+    double sum = 0.0, sum2 = 0.0;
+    for(const float dist : vMeanDist)
+    {
+        sum += dist;
+        sum2 += double(dist) * dist;
+    }
+    const double N = static_cast<double>(vMeanDist.size());
+    const double mean = sum / N;
+    const double std = std::sqrt(std::max(0.0, (sum2 - sum * mean) / (N - 1.0)));
+    const double threshold = mean + stdRatio * std;
+
+    size_t n = 0;
+    for(size_t i = 0; i < vPoints.size(); i++)
+    {
+        if(vMeanDist[i] <= threshold)
+            vPoints[n++] = vPoints[i];
+    }
+    vPoints.resize(n);
+}
+
+void PointCloudFilter::VoxelDownsample(std::vector<Point> &vPoints, const float voxelSize)
+{
+    if(vPoints.empty())
+        return;
+
+    Eigen::Vector3f minn = vPoints[0].pos;
+    for(const Point &point : vPoints)
+        minn = minn.cwiseMin(point.pos);
+
+    // 21 bits per axis, enough for 2M voxels along each
+    auto key = [&](const Eigen::Vector3f &pos) {
+        const Eigen::Vector3f v = (pos - minn) / voxelSize;
+        uint64_t code = 0;
+        for(int k = 0; k < 3; k++)
+            code |= static_cast<uint64_t>(std::min(std::floor(v[k]), float((1 << 21) - 1))) << (21 * k);
+        return code;
+    };
+
+    std::unordered_map<uint64_t, size_t> mVoxels;
+    mVoxels.reserve(vPoints.size());
+    std::vector<Point> vSums;
+    std::vector<int> vCounts;
+    for(const Point &point : vPoints)
+    {
+        const auto it = mVoxels.emplace(key(point.pos), vSums.size());
+        if(it.second)
+        {
+            vSums.push_back(point);
+            vCounts.push_back(1);
+            continue;
+        }
+        Point &sum = vSums[it.first->second];
+        sum.pos += point.pos;
+        sum.color += point.color;
+        sum.nObs += point.nObs;
+        vCounts[it.first->second]++;
+    }
+
+    for(size_t i = 0; i < vSums.size(); i++)
+    {
+        vSums[i].pos /= static_cast<float>(vCounts[i]);
+        vSums[i].color /= static_cast<float>(vCounts[i]);
+    }
+    vPoints.swap(vSums);
+}
+
+} //namespace ORB_SLAM
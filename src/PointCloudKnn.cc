@@ -0,0 +1,342 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PointCloudKnn.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+
+struct MinMax
+{
+    Eigen::Vector3f minn;
+    Eigen::Vector3f maxx;
+};
+
+uint32_t PrepMorton(uint32_t x)
+{
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// 10 bits per axis, as coord2Morton in simple_knn.cu
+uint32_t Coord2Morton(const Eigen::Vector3f &coord, const Eigen::Vector3f &minn, const Eigen::Vector3f &extent)
+{
+    const uint32_t x = PrepMorton(static_cast<uint32_t>((coord.x() - minn.x()) / extent.x() * ((1 << 10) - 1)));
+    const uint32_t y = PrepMorton(static_cast<uint32_t>((coord.y() - minn.y()) / extent.y() * ((1 << 10) - 1)));
+    const uint32_t z = PrepMorton(static_cast<uint32_t>((coord.z() - minn.z()) / extent.z() * ((1 << 10) - 1)));
+    return x | (y << 1) | (z << 2);
+}
+
+inline float DistBoxPoint(const MinMax &box, const Eigen::Vector3f &p)
+{
+    float dist = 0.f;
+    for(int k = 0; k < 3; k++)
+    {
+        if(p[k] < box.minn[k] || p[k] > box.maxx[k])
+        {
+            const float diff = std::min(std::fabs(p[k] - box.minn[k]), std::fabs(p[k] - box.maxx[k]));
+            dist += diff * diff;
+        }
+    }
+    return dist;
+}
+
+// Insert the squared distance and the index of the point into the k best, kept sorted
+inline void InsertKBest(float dist, uint32_t index, float* knn, uint32_t* knnIdx, const int k)
+{
+    if(dist >= knn[k - 1])
+        return;
+    for(int j = 0; j < k; j++)
+    {
+        if(knn[j] > dist)
+        {
+            std::swap(knn[j], dist);
+            std::swap(knnIdx[j], index);
+        }
+    }
+}
+
+inline void UpdateKBest(const Eigen::Vector3f &ref, const Eigen::Vector3f &point, const uint32_t index, float* knn,
+                        uint32_t* knnIdx, const int k)
+{
+    const Eigen::Vector3f d = point - ref;
+    InsertKBest(d.x() * d.x() + d.y() * d.y() + d.z() * d.z(), index, knn, knnIdx, k);
+}
+
+MinMax Bounds(const std::vector<Eigen::Vector3f> &vPoints, const size_t begin, const size_t end)
+{
+    MinMax box;
+    box.minn.setConstant(FLT_MAX);
+    box.maxx.setConstant(-FLT_MAX);
+    for(size_t i = begin; i < end; i++)
+    {
+        box.minn = box.minn.cwiseMin(vPoints[i]);
+        box.maxx = box.maxx.cwiseMax(vPoints[i]);
+    }
+    return box;
+}
+
+// Stable LSD radix sort of the 30 bit Morton codes, the indices of equal codes stay in order like
+// cub::DeviceRadixSort::SortPairs
+void SortByCode(std::vector<uint32_t> &vCodes, std::vector<uint32_t> &vIndices)
+{
+    const int BITS = 10;
+    std::vector<uint32_t> vCodesTmp(vCodes.size()), vIndicesTmp(vIndices.size());
+    for(int shift = 0; shift < 30; shift += BITS)
+    {
+        std::vector<size_t> vOffsets((1 << BITS) + 1, 0);
+        for(const uint32_t code : vCodes)
+            vOffsets[((code >> shift) & ((1 << BITS) - 1)) + 1]++;
+        for(size_t b = 1; b < vOffsets.size(); b++)
+            vOffsets[b] += vOffsets[b - 1];
+        for(size_t i = 0; i < vCodes.size(); i++)
+        {
+            const size_t dst = vOffsets[(vCodes[i] >> shift) & ((1 << BITS) - 1)]++;
+            vCodesTmp[dst] = vCodes[i];
+            vIndicesTmp[dst] = vIndices[i];
+        }
+        vCodes.swap(vCodesTmp);
+        vIndices.swap(vIndicesTmp);
+    }
+}
+
+// Calls result(i, best, neighbours) with the k smallest squared distances of each point i, sorted, and the
+// indices of these neighbours (UINT32_MAX past the last neighbour)
+void SearchKnn(const std::vector<Eigen::Vector3f> &vPoints, const int k, const int nThreads,
+               const std::function<void(size_t, const float*, const uint32_t*)> &result)
+{
+    const int BOX_SIZE = PointCloudKnn::BOX_SIZE;
+    const size_t P = vPoints.size();
+    if(P == 0)
+        return;
+    const int nWorkers = ResolveThreads(nThreads);
+    const size_t GRAIN = 4096;
+
+    // Morton order inside the bounding box, flat axes get a unit extent
+    const MinMax bounds = Bounds(vPoints, 0, P);
+    Eigen::Vector3f extent = bounds.maxx - bounds.minn;
+    for(int k = 0; k < 3; k++)
+        if(!(extent[k] > 0.f))
+            extent[k] = 1.f;
+
+    std::vector<uint32_t> vCodes(P), vIndices(P);
+    ParallelFor(P, GRAIN, nWorkers, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++)
+        {
+            vCodes[i] = Coord2Morton(vPoints[i], bounds.minn, extent);
+            vIndices[i] = static_cast<uint32_t>(i);
+        }
+    });
+    SortByCode(vCodes, vIndices);
+
+    // The coordinates are also kept per axis for the distances to the points of a box, which vectorize
+    std::vector<Eigen::Vector3f> vSorted(P);
+    std::vector<float> vX(P), vY(P), vZ(P);
+    for(size_t i = 0; i < P; i++)
+    {
+        vSorted[i] = vPoints[vIndices[i]];
+        vX[i] = vSorted[i].x();
+        vY[i] = vSorted[i].y();
+        vZ[i] = vSorted[i].z();
+    }
+
+    // Boxes of BOX_SIZE consecutive points, then each level merges the pairs of boxes of the level below
+    std::vector<std::vector<MinMax> > vLevels(1, std::vector<MinMax>((P + BOX_SIZE - 1) / BOX_SIZE));
+    ParallelFor(vLevels[0].size(), 64, nWorkers, [&](size_t begin, size_t end) {
+        for(size_t b = begin; b < end; b++)
+            vLevels[0][b] = Bounds(vSorted, b * BOX_SIZE, std::min(P, (b + 1) * BOX_SIZE));
+    });
+    while(vLevels.back().size() > 1)
+    {
+        const std::vector<MinMax> &vBelow = vLevels.back();
+        std::vector<MinMax> vLevel((vBelow.size() + 1) / 2);
+        for(size_t b = 0; b < vLevel.size(); b++)
+        {
+            vLevel[b] = vBelow[2 * b];
+            if(2 * b + 1 < vBelow.size())
+            {
+                vLevel[b].minn = vLevel[b].minn.cwiseMin(vBelow[2 * b + 1].minn);
+                vLevel[b].maxx = vLevel[b].maxx.cwiseMax(vBelow[2 * b + 1].maxx);
+            }
+        }
+        vLevels.push_back(vLevel);
+    }
+    const int nLevels = static_cast<int>(vLevels.size());
+
+    struct Node
+    {
+        int level;
+        size_t box;
+        float dist;
+    };
+
+    ParallelFor(P, GRAIN, nWorkers, [&](size_t begin, size_t end) {
+        std::vector<Node> vStack;
+        for(size_t idx = begin; idx < end; idx++)
+        {
+            const Eigen::Vector3f &point = vSorted[idx];
+            float best[PointCloudKnn::MAX_K];
+            uint32_t bestIdx[PointCloudKnn::MAX_K];
+            std::fill(best, best + k, FLT_MAX);
+            std::fill(bestIdx, bestIdx + k, UINT32_MAX);
+
+            // The neighbours along the curve bound the distance of the boxes worth visiting
+            for(size_t i = idx >= size_t(k) ? idx - k : 0; i <= std::min(P - 1, idx + k); i++)
+            {
+                if(i == idx)
+                    continue;
+                UpdateKBest(point, vSorted[i], static_cast<uint32_t>(i), best, bestIdx, k);
+            }
+            const float reject = best[k - 1];
+            std::fill(best, best + k, FLT_MAX);
+            std::fill(bestIdx, bestIdx + k, UINT32_MAX);
+
+            vStack.assign(1, Node{nLevels - 1, 0, DistBoxPoint(vLevels[nLevels - 1][0], point)});
+            while(!vStack.empty())
+            {
+                const Node node = vStack.back();
+                vStack.pop_back();
+                if(node.dist > reject || node.dist > best[k - 1])
+                    continue;
+                const int level = node.level;
+                const size_t b = node.box;
+
+                if(level == 0)
+                {
+                    const size_t i0 = b * BOX_SIZE;
+                    const int n = static_cast<int>(std::min(P, i0 + BOX_SIZE) - i0);
+                    float dist2[BOX_SIZE];
+                    for(int j = 0; j < n; j++)
+                    {
+                        const float dx = vX[i0 + j] - point.x(), dy = vY[i0 + j] - point.y(), dz = vZ[i0 + j] - point.z();
+                        dist2[j] = dx * dx + dy * dy + dz * dz;
+                    }
+                    for(int j = 0; j < n; j++)
+                    {
+                        if(i0 + j != idx)
+                            InsertKBest(dist2[j], static_cast<uint32_t>(i0 + j), best, bestIdx, k);
+                    }
+                    continue;
+                }
+
+                // Push the farther child first so that the nearer one is visited first
+                const std::vector<MinMax> &vBelow = vLevels[level - 1];
+                const Node first{level - 1, 2 * b, DistBoxPoint(vBelow[2 * b], point)};
+                if(2 * b + 1 < vBelow.size())
+                {
+                    const Node second{level - 1, 2 * b + 1, DistBoxPoint(vBelow[2 * b + 1], point)};
+                    vStack.push_back(first.dist <= second.dist ? second : first);
+                    vStack.push_back(first.dist <= second.dist ? first : second);
+                }
+                else
+                    vStack.push_back(first);
+            }
+
+            for(int j = 0; j < k && bestIdx[j] != UINT32_MAX; j++)
+                bestIdx[j] = vIndices[bestIdx[j]];
+            result(vIndices[idx], best, bestIdx);
+        }
+    });
+}
+
+} // namespace
+
+void PointCloudKnn::MeanSquaredDistances(const std::vector<Eigen::Vector3f> &vPoints, std::vector<float> &vMeanDist2,
+                                         const int nThreads)
+{
+    vMeanDist2.assign(vPoints.size(), 0.f);
+    SearchKnn(vPoints, K, nThreads, [&](size_t i, const float* best, const uint32_t*) {
+        float sum = 0.f;
+        for(int j = 0; j < K; j++)
+            sum += best[j];
+        vMeanDist2[i] = sum / K;
+    });
+}
+
+void PointCloudKnn::MeanDistances(const std::vector<Eigen::Vector3f> &vPoints, const int k, std::vector<float> &vMeanDist,
+                                  const int nThreads)
+{
+    const int kk = std::max(1, std::min(k, int(MAX_K)));
+    vMeanDist.assign(vPoints.size(), 0.f);
+    SearchKnn(vPoints, kk, nThreads, [&](size_t i, const float* best, const uint32_t*) {
+        if(best[kk - 1] == FLT_MAX)
+        {
+            vMeanDist[i] = FLT_MAX;
+            return;
+        }
+        float sum = 0.f;
+        for(int j = 0; j < kk; j++)
+            sum += std::sqrt(best[j]);
+        vMeanDist[i] = sum / kk;
+    });
+}
+
+void PointCloudKnn::Neighbours(const std::vector<Eigen::Vector3f> &vPoints, const int k, std::vector<int> &vNeighbours,
+                               const int nThreads)
+{
+    const int kk = std::max(1, std::min(k, int(MAX_K)));
+    vNeighbours.assign(vPoints.size() * kk, -1);
+    SearchKnn(vPoints, kk, nThreads, [&](size_t i, const float*, const uint32_t* neighbours) {
+        for(int j = 0; j < kk && neighbours[j] != UINT32_MAX; j++)
+            vNeighbours[i * kk + j] = static_cast<int>(neighbours[j]);
+    });
+}
+
+void PointCloudKnn::InitialScales(const std::vector<Eigen::Vector3f> &vPoints, std::vector<float> &vScales,
+                                  const int nThreads)
+{
+    MeanSquaredDistances(vPoints, vScales, nThreads);
+    for(float &scale : vScales)
+        scale = std::sqrt(std::max(scale, 1e-7f));
+}
+
+bool PointCloudKnn::SaveScales(const std::string &filename, const std::vector<float> &vScales)
+{
+    std::ofstream f(filename.c_str());
+    if(!f.is_open())
+    {
+        std::cerr << "Error: Failed to open file " << filename << " for writing!" << std::endl;
+        return false;
+    }
+
+    f << "# Initial Gaussian scale of each point of points3D.txt, in the same order:" << std::endl;
+    f << "#   sqrt of the mean squared distance to the " << K << " nearest neighbours" << std::endl;
+    f << std::setprecision(9);
+    for(const float scale : vScales)
+        f << scale << "\n";
+    return static_cast<bool>(f);
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,381 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PoseRefiner.h"
+#include "KeyFrame.h"
+#include "MapPoint.h"
+#include "ParallelFor.h"
+#include "PyramidCamera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+
+typedef Eigen::Matrix<double,6,6> Matrix6d;
+typedef Eigen::Matrix<double,6,1> Vector6d;
+
+// Residuals under which a level is not aligned
+const int MIN_RESIDUALS = 100;
+
+// A template pixel: its point in the keyframe, its intensity and the Jacobian of the intensity with respect to
+// a perturbation exp(delta) of the point
+struct TemplatePixel
+{
+    Eigen::Vector3f p;
+    float intensity;
+    Eigen::Matrix<float,6,1> J;
+};
+
+struct Neighbour
+{
+    KeyFrame* pKF;
+    Sophus::SE3f Tcw;
+    const std::vector<cv::Mat>* pPyramid;
+};
+
+// Undistorted gray pyramid of a keyframe image, with the calibration of the undistorted keypoints
+std::vector<cv::Mat> GrayPyramid(KeyFrame* pKF, const cv::Mat &im, const int nLevels)
+{
+    cv::Mat gray;
+    if(im.channels() == 3)
+        cv::cvtColor(im, gray, cv::COLOR_BGR2GRAY);
+    else if(im.channels() == 4)
+        cv::cvtColor(im, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = im;
+
+    if(!pKF->mDistCoef.empty() && cv::countNonZero(pKF->mDistCoef) > 0)
+    {
+        const cv::Mat K = (cv::Mat_<float>(3,3) << pKF->fx, 0.f, pKF->cx, 0.f, pKF->fy, pKF->cy, 0.f, 0.f, 1.f);
+        cv::Mat undistorted;
+        cv::undistort(gray, undistorted, K, pKF->mDistCoef);
+        gray = undistorted;
+    }
+
+    std::vector<cv::Mat> vPyramid(1, gray);
+    for(int l = 1; l < nLevels; l++)
+    {
+        cv::Mat down;
+        cv::pyrDown(vPyramid.back(), down);
+        vPyramid.push_back(down);
+    }
+    return vPyramid;
+}
+
+// Bilinear intensity at (x, y), false when a neighbour pixel is out of the image
+inline bool Sample(const cv::Mat &im, const float x, const float y, float &value)
+{
+    if(!(x >= 0.f && y >= 0.f && x < im.cols - 1.f && y < im.rows - 1.f))
+        return false;
+    const int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+    const float ax = x - x0, ay = y - y0;
+    const uchar* r0 = im.ptr<uchar>(y0) + x0;
+    const uchar* r1 = im.ptr<uchar>(y0 + 1) + x0;
+    value = (1.f - ay) * ((1.f - ax) * r0[0] + ax * r0[1]) + ay * ((1.f - ax) * r1[0] + ax * r1[1]);
+    return true;
+}
+
+// 4x4 patches around the observations, back-projected at the depth of their map point
+std::vector<TemplatePixel> BuildTemplate(const cv::Mat &im, const PyramidCamera &cam, const int level,
+                                         const std::vector<cv::Point2f> &vPixels, const std::vector<float> &vDepths)
+{
+    const float scale = 1.f / float(1 << level);
+    std::vector<TemplatePixel> vTemplate;
+    vTemplate.reserve(16 * vPixels.size());
+    for(size_t i = 0; i < vPixels.size(); i++)
+    {
+        const float z = vDepths[i];
+        const float u = vPixels[i].x * scale, v = vPixels[i].y * scale;
+        for(int dy = -2; dy < 2; dy++)
+        {
+            for(int dx = -2; dx < 2; dx++)
+            {
+                const float x = u + dx, y = v + dy;
+                float I, Ixm, Ixp, Iym, Iyp;
+                if(!Sample(im, x, y, I) || !Sample(im, x - 1.f, y, Ixm) || !Sample(im, x + 1.f, y, Ixp) ||
+                   !Sample(im, x, y - 1.f, Iym) || !Sample(im, x, y + 1.f, Iyp))
+                    continue;
+                const float gx = 0.5f * (Ixp - Ixm), gy = 0.5f * (Iyp - Iym);
+
+                TemplatePixel pixel;
+                pixel.p = Eigen::Vector3f((x - cam.cx) / cam.fx * z, (y - cam.cy) / cam.fy * z, z);
+                pixel.intensity = I;
+                // d I / d p through the projection, then d p / d delta = [I, -[p]x]
+                const float invZ = 1.f / z;
+                const Eigen::Vector3f dIdp(gx * cam.fx * invZ, gy * cam.fy * invZ,
+                                           -(gx * cam.fx * pixel.p.x() + gy * cam.fy * pixel.p.y()) * invZ * invZ);
+                pixel.J.head<3>() = dIdp;
+                pixel.J.tail<3>() = pixel.p.cross(dIdp);
+                vTemplate.push_back(pixel);
+            }
+        }
+    }
+    return vTemplate;
+}
+
+// Mean Huber cost of the template warped into the neighbours with the keyframe pose Twk, and the normal
+// equations of the inverse compositional step when H is given. The brightness offset of each neighbour is the
+// median of its residuals.
+float Evaluate(const std::vector<TemplatePixel> &vTemplate, const std::vector<Neighbour> &vNeighbours,
+               const int level, const Sophus::SE3f &Twk, const float huberDelta, int &nResiduals,
+               Matrix6d* pH = NULL, Vector6d* pb = NULL)
+{
+    if(pH)
+    {
+        pH->setZero();
+        pb->setZero();
+    }
+    nResiduals = 0;
+    double cost = 0.0;
+    std::vector<float> vResiduals(vTemplate.size());
+    std::vector<float> vSorted;
+    for(const Neighbour &neighbour : vNeighbours)
+    {
+        const cv::Mat &im = (*neighbour.pPyramid)[level];
+        const PyramidCamera cam(neighbour.pKF, level);
+        const Sophus::SE3f Tnk = neighbour.Tcw * Twk;
+        vSorted.clear();
+        for(size_t i = 0; i < vTemplate.size(); i++)
+        {
+            vResiduals[i] = NAN;
+            const Eigen::Vector3f pn = Tnk * vTemplate[i].p;
+            if(pn.z() <= 0.f)
+                continue;
+            float I;
+            if(!Sample(im, cam.fx * pn.x() / pn.z() + cam.cx, cam.fy * pn.y() / pn.z() + cam.cy, I))
+                continue;
+            vResiduals[i] = I - vTemplate[i].intensity;
+            vSorted.push_back(vResiduals[i]);
+        }
+        if(vSorted.size() < static_cast<size_t>(MIN_RESIDUALS))
+            continue;
+        std::nth_element(vSorted.begin(), vSorted.begin() + vSorted.size() / 2, vSorted.end());
+        const float bias = vSorted[vSorted.size() / 2];
+
+        for(size_t i = 0; i < vTemplate.size(); i++)
+        {
+            if(std::isnan(vResiduals[i]))
+                continue;
+            const float r = vResiduals[i] - bias;
+            const float absR = std::fabs(r);
+            const float w = absR <= huberDelta ? 1.f : huberDelta / absR;
+            cost += absR <= huberDelta ? 0.5 * r * r : huberDelta * (absR - 0.5 * huberDelta);
+            nResiduals++;
+            if(pH)
+            {
+                const Vector6d J = vTemplate[i].J.cast<double>();
+                pH->noalias() += double(w) * J * J.transpose();
+                pb->noalias() += double(w * r) * J;
+            }
+        }
+    }
+    return nResiduals > 0 ? static_cast<float>(cost / nResiduals) : 0.f;
+}
+
+struct RefineResult
+{
+    Sophus::SE3f Tcw;
+    bool bRefined;
+    float initialError;
+    float finalError;
+    float translationRatio;
+    float rotationDeg;
+};
+
+} // namespace
+
+PoseRefiner::PoseRefiner(const Options &options, const std::function<cv::Mat(KeyFrame*)> &getImage):
+    mOptions(options), mGetImage(getImage)
+{
+    mOptions.nLevels = std::max(1, mOptions.nLevels);
+    mOptions.nFinestLevel = std::min(std::max(0, mOptions.nFinestLevel), mOptions.nLevels - 1);
+    mOptions.nIterations = std::max(1, mOptions.nIterations);
+}
+
+std::vector<Sophus::SE3f> PoseRefiner::Refine(const std::vector<KeyFrame*> &vpKFs, const int nThreads)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const int nWorkers = ResolveThreads(nThreads);
+
+    // Neighbour candidates of each keyframe, and every keyframe whose pyramid is needed
+    std::vector<std::vector<KeyFrame*> > vvpCandidates(vpKFs.size());
+    std::unordered_map<KeyFrame*, size_t> mPyramidIndex;
+    std::vector<KeyFrame*> vpPyramidKFs;
+    auto AddPyramid = [&](KeyFrame* pKF) {
+        if(mPyramidIndex.emplace(pKF, vpPyramidKFs.size()).second)
+            vpPyramidKFs.push_back(pKF);
+    };
+    for(size_t k = 0; k < vpKFs.size(); k++)
+    {
+        if(!PyramidCamera::IsSupported(vpKFs[k]))
+            continue;
+        AddPyramid(vpKFs[k]);
+        for(KeyFrame* pKFi : vpKFs[k]->GetBestCovisibilityKeyFrames(2 * mOptions.nNeighbours))
+        {
+            if(!PyramidCamera::IsSupported(pKFi))
+                continue;
+            vvpCandidates[k].push_back(pKFi);
+            AddPyramid(pKFi);
+        }
+    }
+
+    // Each image is undistorted and downsampled once, the refinements only read the pyramids
+    std::vector<std::vector<cv::Mat> > vPyramids(vpPyramidKFs.size());
+    ParallelFor(vpPyramidKFs.size(), nWorkers, [&](size_t i) {
+        const cv::Mat im = mGetImage(vpPyramidKFs[i]);
+        if(!im.empty())
+            vPyramids[i] = GrayPyramid(vpPyramidKFs[i], im, mOptions.nLevels);
+    });
+
+    std::vector<RefineResult> vResults(vpKFs.size());
+    ParallelFor(vpKFs.size(), nWorkers, [&](size_t k) {
+        KeyFrame* pKF = vpKFs[k];
+        RefineResult &result = vResults[k];
+        result.bRefined = false;
+        if(!pKF)
+            return;
+        result.Tcw = pKF->GetPose();
+        if(!PyramidCamera::IsSupported(pKF))
+            return;
+        const std::vector<cv::Mat> &vPyramid = vPyramids[mPyramidIndex.at(pKF)];
+        if(vPyramid.empty())
+            return;
+
+        // Observations of the map points with their depths
+        const Sophus::SE3f Tcw = result.Tcw;
+        const std::vector<MapPoint*> vpMapPoints = pKF->GetMapPointMatches();
+        std::vector<cv::Point2f> vPixels;
+        std::vector<float> vDepths;
+        for(size_t i = 0; i < vpMapPoints.size() && i < pKF->mvKeysUn.size(); i++)
+        {
+            MapPoint* pMP = vpMapPoints[i];
+            if(!pMP || pMP->isBad())
+                continue;
+            const float z = (Tcw * pMP->GetWorldPos()).z();
+            if(z <= 0.f)
+                continue;
+            vPixels.push_back(pKF->mvKeysUn[i].pt);
+            vDepths.push_back(z);
+        }
+        if(vPixels.size() < 20)
+            return;
+        std::vector<float> vSortedDepths = vDepths;
+        std::nth_element(vSortedDepths.begin(), vSortedDepths.begin() + vSortedDepths.size() / 2, vSortedDepths.end());
+        const float medianDepth = vSortedDepths[vSortedDepths.size() / 2];
+
+        std::vector<Neighbour> vNeighbours;
+        for(KeyFrame* pKFi : vvpCandidates[k])
+        {
+            if(static_cast<int>(vNeighbours.size()) >= mOptions.nNeighbours)
+                break;
+            const std::vector<cv::Mat> &vPyramidi = vPyramids[mPyramidIndex.at(pKFi)];
+            if(vPyramidi.empty() || vPyramidi[0].size() != vPyramid[0].size())
+                continue;
+            vNeighbours.push_back(Neighbour{pKFi, pKFi->GetPose(), &vPyramidi});
+        }
+        if(vNeighbours.empty())
+            return;
+
+        // Coarse to fine Gauss-Newton; a step that does not lower the cost ends the level
+        const Sophus::SE3f Twk0 = Tcw.inverse();
+        Sophus::SE3f Twk = Twk0;
+        std::vector<TemplatePixel> vFinest;
+        for(int level = mOptions.nLevels - 1; level >= mOptions.nFinestLevel; level--)
+        {
+            std::vector<TemplatePixel> vTemplate = BuildTemplate(vPyramid[level], PyramidCamera(pKF, level), level,
+                                                                 vPixels, vDepths);
+            Matrix6d H;
+            Vector6d b;
+            int n;
+            float cost = Evaluate(vTemplate, vNeighbours, level, Twk, mOptions.huberDelta, n, &H, &b);
+            for(int it = 0; it < mOptions.nIterations && n >= MIN_RESIDUALS; it++)
+            {
+                const Vector6d delta = H.ldlt().solve(b);
+                if(!delta.allFinite())
+                    break;
+                const Sophus::SE3f Twk1 = Twk * Sophus::SE3f::exp(-delta.cast<float>());
+                Matrix6d H1;
+                Vector6d b1;
+                int n1;
+                const float cost1 = Evaluate(vTemplate, vNeighbours, level, Twk1, mOptions.huberDelta, n1, &H1, &b1);
+                if(n1 < MIN_RESIDUALS || cost1 >= cost)
+                    break;
+                Twk = Twk1;
+                cost = cost1;
+                H = H1;
+                b = b1;
+                n = n1;
+                if(delta.norm() < 1e-6)
+                    break;
+            }
+            if(level == mOptions.nFinestLevel)
+                vFinest.swap(vTemplate);
+        }
+
+        // Keep the refined pose only if it explains the finest level better and stays close to the BA pose
+        int n0, n1;
+        result.initialError = Evaluate(vFinest, vNeighbours, mOptions.nFinestLevel, Twk0, mOptions.huberDelta, n0);
+        result.finalError = Evaluate(vFinest, vNeighbours, mOptions.nFinestLevel, Twk, mOptions.huberDelta, n1);
+        result.translationRatio = (Twk.translation() - Twk0.translation()).norm() / medianDepth;
+        result.rotationDeg = (Twk0.so3().inverse() * Twk.so3()).log().norm() * 180.f / float(M_PI);
+        if(n0 >= MIN_RESIDUALS && n1 >= MIN_RESIDUALS && result.finalError < result.initialError &&
+           result.translationRatio <= mOptions.maxTranslationRatio && result.rotationDeg <= mOptions.maxRotationDeg)
+        {
+            result.Tcw = Twk.inverse();
+            result.bRefined = true;
+        }
+    });
+
+    std::vector<Sophus::SE3f> vTcw;
+    vTcw.reserve(vResults.size());
+    int nRefined = 0;
+    double initialError = 0.0, finalError = 0.0, translationRatio = 0.0, rotationDeg = 0.0;
+    for(const RefineResult &result : vResults)
+    {
+        vTcw.push_back(result.Tcw);
+        if(!result.bRefined)
+            continue;
+        nRefined++;
+        initialError += result.initialError;
+        finalError += result.finalError;
+        translationRatio += result.translationRatio;
+        rotationDeg += result.rotationDeg;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Pose refinement: " << nRefined << " of " << vpKFs.size() << " keyframes refined in " << seconds << " s";
+    if(nRefined > 0)
+        std::cout << ", photometric error " << initialError / nRefined << " -> " << finalError / nRefined
+                  << ", mean change " << 100.0 * translationRatio / nRefined << "% of the depth and "
+                  << rotationDeg / nRefined << " deg";
+    std::cout << std::endl;
+    return vTcw;
+}
+
+} //namespace ORB_SLAM
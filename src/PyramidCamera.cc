@@ -0,0 +1,48 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PyramidCamera.h"
+#include "KeyFrame.h"
+#include "CameraModels/GeometricCamera.h"
+
+namespace ORB_SLAM3
+{
+
+PyramidCamera::PyramidCamera(KeyFrame* pKF, const int level)
+{
+    // cv::pyrDown keeps the even pixels, pixel x is at x / 2 one level down
+    const float scale = 1.f / float(1 << level);
+    fx = pKF->fx * scale;
+    fy = pKF->fy * scale;
+    cx = pKF->cx * scale;
+    cy = pKF->cy * scale;
+}
+
+bool PyramidCamera::IsSupported(KeyFrame* pKF)
+{
+    return pKF && !pKF->isBad() && pKF->mpCamera && pKF->mpCamera->GetType() == GeometricCamera::CAM_PINHOLE;
+}
+
+cv::Mat PyramidCamera::K() const
+{
+    return (cv::Mat_<double>(3,3) << fx, 0.0, cx,
+                                     0.0, fy, cy,
+                                     0.0, 0.0, 1.0);
+}
+
+} //namespace ORB_SLAM
@@ -34,7 +34,7 @@ namespace ORB_SLAM3
 
 Sim3Solver::Sim3Solver(KeyFrame *pKF1, KeyFrame *pKF2, const vector<MapPoint *> &vpMatched12, const bool bFixScale,
                        vector<KeyFrame*> vpKeyFrameMatchedMP):
-    mnIterations(0), mnBestInliers(0), mbFixScale(bFixScale),
+    mnIterations(0), mnBestInliers(0), mbFixScale(bFixScale), mRansac(this),
     pCamera1(pKF1->mpCamera), pCamera2(pKF2->mpCamera)
 {
     bool bDifferentKFs = false;
@@ -63,10 +63,6 @@ Sim3Solver::Sim3Solver(KeyFrame *pKF1, KeyFrame *pKF2, const vector<MapPoint *>
     Eigen::Matrix3f Rcw2 = pKF2->GetRotation();
     Eigen::Vector3f tcw2 = pKF2->GetTranslation();
 
-    mvAllIndices.reserve(mN1);
-
-    size_t idx=0;
-
     KeyFrame* pKFm = pKF2; //Default variable
     for(int i1=0; i1<mN1; i1++)
     {
@@ -109,8 +105,7 @@ Sim3Solver::Sim3Solver(KeyFrame *pKF1, KeyFrame *pKF2, const vector<MapPoint *>
             Eigen::Vector3f X3D2w = pMP2->GetWorldPos();
             mvX3Dc2.push_back(Rcw2*X3D2w+tcw2);
 
-            mvAllIndices.push_back(idx);
-            idx++;
+            mvDescDist.push_back(ORBmatcher::DescriptorDistance(pMP1->GetDescriptor(),pMP2->GetDescriptor()));
         }
     }
 
@@ -128,8 +123,6 @@ void Sim3Solver::SetRansacParameters(double probability, int minInliers, int max
 
     N = mvpMapPoints1.size(); // number of correspondences
 
-    mvbInliersi.resize(N);
-
     // Adjust Parameters according to number of correspondences
     float epsilon = (float)mRansacMinInliers/N;
 
@@ -144,75 +137,20 @@ void Sim3Solver::SetRansacParameters(double probability, int minInliers, int max
     mRansacMaxIts = max(1,min(nIterations,mRansacMaxIts));
 
     mnIterations = 0;
+
+    mRansac.SetRansacParameters(N,3,mRansacProb,mRansacMinInliers,mRansacMaxIts);
+    mRansac.SetQuality(mvDescDist);
+    mRansac.SetSPRT(true,50.0);
 }
 
 Eigen::Matrix4f Sim3Solver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInliers, int &nInliers)
 {
-    bNoMore = false;
-    vbInliers = vector<bool>(mN1,false);
-    nInliers=0;
-
-    if(N<mRansacMinInliers)
-    {
-        bNoMore = true;
+    bool bConverge;
+    Eigen::Matrix4f T12 = iterate(nIterations,bNoMore,vbInliers,nInliers,bConverge);
+    if(!bConverge)
         return Eigen::Matrix4f::Identity();
-    }
-
-    vector<size_t> vAvailableIndices;
 
-    Eigen::Matrix3f P3Dc1i;
-    Eigen::Matrix3f P3Dc2i;
-
-    int nCurrentIterations = 0;
-    while(mnIterations<mRansacMaxIts && nCurrentIterations<nIterations)
-    {
-        nCurrentIterations++;
-        mnIterations++;
-
-        vAvailableIndices = mvAllIndices;
-
-        // Get min set of points
-        for(short i = 0; i < 3; ++i)
-        {
-            int randi = DUtils::Random::RandomInt(0, vAvailableIndices.size()-1);
-
-            int idx = vAvailableIndices[randi];
-
-            P3Dc1i.col(i) = mvX3Dc1[idx];
-            P3Dc2i.col(i) = mvX3Dc2[idx];
-
-            vAvailableIndices[randi] = vAvailableIndices.back();
-            vAvailableIndices.pop_back();
-        }
-
-        ComputeSim3(P3Dc1i,P3Dc2i);
-
-        CheckInliers();
-
-        if(mnInliersi>=mnBestInliers)
-        {
-            mvbBestInliers = mvbInliersi;
-            mnBestInliers = mnInliersi;
-            mBestT12 = mT12i;
-            mBestRotation = mR12i;
-            mBestTranslation = mt12i;
-            mBestScale = ms12i;
-
-            if(mnInliersi>mRansacMinInliers)
-            {
-                nInliers = mnInliersi;
-                for(int i=0; i<N; i++)
-                    if(mvbInliersi[i])
-                        vbInliers[mvnIndices1[i]] = true;
-                return mBestT12;
-            }
-        }
-    }
-
-    if(mnIterations>=mRansacMaxIts)
-        bNoMore=true;
-
-    return Eigen::Matrix4f::Identity();
+    return T12;
 }
 
 Eigen::Matrix4f Sim3Solver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInliers, int &nInliers, bool &bConverge)
@@ -228,69 +166,68 @@ Eigen::Matrix4f Sim3Solver::iterate(int nIterations, bool &bNoMore, vector<bool>
         return Eigen::Matrix4f::Identity();
     }
 
-    vector<size_t> vAvailableIndices;
+    const int nBestBefore = mRansac.GetBestNumInliers();
+    const bool bFound = mRansac.Iterate(nIterations,mRansacMinInliers+1,bNoMore);
+    mnIterations = mRansac.GetNumIterations();
 
-    Eigen::Matrix3f P3Dc1i;
-    Eigen::Matrix3f P3Dc2i;
-
-    int nCurrentIterations = 0;
-
-    Eigen::Matrix4f bestSim3;
+    if(mRansac.GetBestNumInliers()>nBestBefore)
+    {
+        const Model &best = mRansac.GetBestModel();
+        mvbBestInliers = mRansac.GetBestInliers();
+        mnBestInliers = mRansac.GetBestNumInliers();
+        mBestT12 = best.T12;
+        mBestRotation = best.R12;
+        mBestTranslation = best.t12;
+        mBestScale = best.s12;
+    }
 
-    while(mnIterations<mRansacMaxIts && nCurrentIterations<nIterations)
+    if(bFound)
     {
-        nCurrentIterations++;
-        mnIterations++;
+        nInliers = mnBestInliers;
+        for(int i=0; i<N; i++)
+            if(mvbBestInliers[i])
+                vbInliers[mvnIndices1[i]] = true;
+        bConverge = true;
+        return mBestT12;
+    }
 
-        vAvailableIndices = mvAllIndices;
+    if(mnBestInliers>0)
+        return mBestT12;
 
-        // Get min set of points
-        for(short i = 0; i < 3; ++i)
-        {
-            int randi = DUtils::Random::RandomInt(0, vAvailableIndices.size()-1);
+    return Eigen::Matrix4f::Identity();
+}
 
-            int idx = vAvailableIndices[randi];
+bool Sim3Solver::ComputeModel(const std::vector<size_t> &vSample, Model &model)
+{
+    Eigen::Matrix3f P3Dc1i;
+    Eigen::Matrix3f P3Dc2i;
 
-            P3Dc1i.col(i) = mvX3Dc1[idx];
-            P3Dc2i.col(i) = mvX3Dc2[idx];
+    for(short i = 0; i < 3; ++i)
+    {
+        P3Dc1i.col(i) = mvX3Dc1[vSample[i]];
+        P3Dc2i.col(i) = mvX3Dc2[vSample[i]];
+    }
 
-            vAvailableIndices[randi] = vAvailableIndices.back();
-            vAvailableIndices.pop_back();
-        }
+    ComputeSim3(P3Dc1i,P3Dc2i);
 
-        ComputeSim3(P3Dc1i,P3Dc2i);
+    model.R12 = mR12i;
+    model.t12 = mt12i;
+    model.s12 = ms12i;
+    model.T12 = mT12i;
+    model.T21 = mT21i;
 
-        CheckInliers();
+    return model.T12.allFinite() && model.T21.allFinite();
+}
 
-        if(mnInliersi>=mnBestInliers)
-        {
-            mvbBestInliers = mvbInliersi;
-            mnBestInliers = mnInliersi;
-            mBestT12 = mT12i;
-            mBestRotation = mR12i;
-            mBestTranslation = mt12i;
-            mBestScale = ms12i;
-
-            if(mnInliersi>mRansacMinInliers)
-            {
-                nInliers = mnInliersi;
-                for(int i=0; i<N; i++)
-                    if(mvbInliersi[i])
-                        vbInliers[mvnIndices1[i]] = true;
-                bConverge = true;
-                return mBestT12;
-            }
-            else
-            {
-                bestSim3 = mBestT12;
-            }
-        }
-    }
+bool Sim3Solver::IsInlier(const Model &model, const size_t idx)
+{
+    const Eigen::Vector3f P2c1 = model.T12.block<3,3>(0,0)*mvX3Dc2[idx]+model.T12.block<3,1>(0,3);
+    const Eigen::Vector3f P1c2 = model.T21.block<3,3>(0,0)*mvX3Dc1[idx]+model.T21.block<3,1>(0,3);
 
-    if(mnIterations>=mRansacMaxIts)
-        bNoMore=true;
+    const Eigen::Vector2f dist1 = mvP1im1[idx] - pCamera1->project(P2c1);
+    const Eigen::Vector2f dist2 = pCamera2->project(P1c2) - mvP2im2[idx];
 
-    return bestSim3;
+    return dist1.dot(dist1)<mvnMaxError1[idx] && dist2.dot(dist2)<mvnMaxError2[idx];
 }
 
 Eigen::Matrix4f Sim3Solver::find(vector<bool> &vbInliers12, int &nInliers)
@@ -412,32 +349,6 @@ void Sim3Solver::ComputeSim3(Eigen::Matrix3f &P1, Eigen::Matrix3f &P2)
 }
 
 
-void Sim3Solver::CheckInliers()
-{
-    vector<Eigen::Vector2f> vP1im2, vP2im1;
-    Project(mvX3Dc2,vP2im1,mT12i,pCamera1);
-    Project(mvX3Dc1,vP1im2,mT21i,pCamera2);
-
-    mnInliersi=0;
-
-    for(size_t i=0; i<mvP1im1.size(); i++)
-    {
-        Eigen::Vector2f dist1 = mvP1im1[i] - vP2im1[i];
-        Eigen::Vector2f dist2 = vP1im2[i] - mvP2im2[i];
-
-        const float err1 = dist1.dot(dist1);
-        const float err2 = dist2.dot(dist2);
-
-        if(err1<mvnMaxError1[i] && err2<mvnMaxError2[i])
-        {
-            mvbInliersi[i]=true;
-            mnInliersi++;
-        }
-        else
-            mvbInliersi[i]=false;
-    }
-}
-
 Eigen::Matrix4f Sim3Solver::GetEstimatedTransformation()
 {
     return mBestT12;
@@ -15,14 +15,18 @@
 * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
 * If not, see <http://www.gnu.org/licenses/>.
 */
+#ifdef WITH_ROS
 #include <cv_bridge/cv_bridge.h>
 #include <sensor_msgs/Image.h>
 #include <rosbag/bag.h>
 #include <rosbag/view.h>
 #include <rosbag/query.h>
 #include <rosbag/message_instance.h>
+#endif
 #include "System.h"
 #include "Converter.h"
+#include "Instrumentation.h"
+#include "PointCloudKnn.h"
 #include <thread>
 #include <pangolin/pangolin.h>
 #include <iomanip>
@@ -44,7 +48,11 @@ Verbose::eLevel Verbose::th = Verbose::VERBOSITY_NORMAL;
 System::System(const string &strVocFile, const string &strSettingsFile, const eSensor sensor,
                const bool bUseViewer, const int initFr, const string &strSequence):
     mSensor(sensor), mpViewer(static_cast<Viewer*>(NULL)), mbReset(false), mbResetActiveMap(false),
-    mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mbShutDown(false)
+    mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mbShutDown(false),
+    mbExportUndistort(false), mbExportCropToValid(false),
+    mbExportViewSelection(false), mpExportSelector(static_cast<KeyFrameSelector*>(NULL)), mbExportDensify(false),
+    mbExportRefinePoses(false), mbExportPly(false),
+    mpImageExporter(static_cast<ImageExporter*>(NULL))
 {
     // Output welcome message
     cout << endl <<
@@ -108,6 +116,184 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
         activeLC = static_cast<int>(fsSettings["loopClosing"]) != 0;
     }
 
+    node = fsSettings["System.Instrumentation"];
+    if(!node.empty() && static_cast<int>(node) != 0)
+    {
+        string strInstrumentationFile;
+        double instrumentationPeriod = 1.0;
+        node = fsSettings["System.InstrumentationFile"];
+        if(!node.empty() && node.isString())
+            strInstrumentationFile = (string)node;
+        node = fsSettings["System.InstrumentationPeriod"];
+        if(!node.empty() && node.isReal())
+            instrumentationPeriod = node.real();
+        EnableInstrumentation(true,strInstrumentationFile,instrumentationPeriod);
+    }
+
+    node = fsSettings["System.Tracing"];
+    if(!node.empty() && static_cast<int>(node) != 0)
+    {
+        string strTraceFile = "Trace.json";
+        node = fsSettings["System.TraceFile"];
+        if(!node.empty() && node.isString())
+            strTraceFile = (string)node;
+        EnableTracing(true,strTraceFile);
+    }
+
+    node = fsSettings["System.ExportUndistort"];
+    if(!node.empty() && node.isInt() && static_cast<int>(node) != 0)
+    {
+        node = fsSettings["System.ExportCropToValid"];
+        SetExportUndistortion(true, !node.empty() && node.isInt() && static_cast<int>(node) != 0);
+    }
+
+    ImageExporter::Options imageOptions;
+    node = fsSettings["System.ExportImageFormat"];
+    if(!node.empty() && node.isString())
+    {
+        const string strFormat = node.string();
+        if(strFormat == "jpg" || strFormat == "jpeg")
+            imageOptions.format = ImageExporter::JPEG;
+        else if(strFormat == "webp")
+            imageOptions.format = ImageExporter::WEBP;
+        else if(strFormat != "png")
+            cerr << "Unknown System.ExportImageFormat " << strFormat << ", the images are exported as PNG" << endl;
+    }
+    node = fsSettings["System.ExportPngLevel"];
+    if(!node.empty() && node.isInt())
+        imageOptions.nPngLevel = static_cast<int>(node);
+    node = fsSettings["System.ExportJpegQuality"];
+    if(!node.empty() && node.isInt())
+        imageOptions.nJpegQuality = static_cast<int>(node);
+    node = fsSettings["System.ExportImageThreads"];
+    if(!node.empty() && node.isInt())
+        imageOptions.nThreads = static_cast<int>(node);
+    node = fsSettings["System.ExportImageQueue"];
+    if(!node.empty() && node.isInt())
+        imageOptions.nMaxQueued = static_cast<int>(node);
+    node = fsSettings["System.ExportEncodeAfterKeyFrames"];
+    if(!node.empty() && node.isInt())
+        imageOptions.nMatureKeyFrames = static_cast<int>(node);
+    node = fsSettings["System.ExportEncodedCacheMB"];
+    if(!node.empty() && node.isInt())
+        imageOptions.nMaxEncodedMB = static_cast<int>(node);
+
+    PointCloudFilter::Options filterOptions;
+    node = fsSettings["System.ExportMinObservations"];
+    if(!node.empty() && node.isInt())
+        filterOptions.nMinObservations = static_cast<int>(node);
+    node = fsSettings["System.ExportOutlierNeighbours"];
+    if(!node.empty() && node.isInt())
+        filterOptions.nOutlierNeighbours = static_cast<int>(node);
+    node = fsSettings["System.ExportOutlierStdRatio"];
+    if(!node.empty() && (node.isInt() || node.isReal()))
+        filterOptions.outlierStdRatio = node.real();
+    node = fsSettings["System.ExportVoxelSize"];
+    if(!node.empty() && (node.isInt() || node.isReal()))
+        filterOptions.voxelSize = node.real();
+    if(filterOptions.Enabled())
+        SetExportPointCloudFilter(filterOptions);
+
+    node = fsSettings["System.ExportDensify"];
+    if(!node.empty() && node.isInt() && static_cast<int>(node) != 0)
+    {
+        DepthDensifier::Options densifyOptions;
+        node = fsSettings["System.ExportDensifyNeighbours"];
+        if(!node.empty() && node.isInt())
+            densifyOptions.nNeighbours = static_cast<int>(node);
+        node = fsSettings["System.ExportDensifyLevel"];
+        if(!node.empty() && node.isInt())
+            densifyOptions.nLevel = static_cast<int>(node);
+        node = fsSettings["System.ExportDensifyStep"];
+        if(!node.empty() && node.isInt())
+            densifyOptions.nStep = static_cast<int>(node);
+        node = fsSettings["System.ExportDensifyMinSupport"];
+        if(!node.empty() && node.isInt())
+            densifyOptions.nMinSupport = static_cast<int>(node);
+        node = fsSettings["System.ExportDensifyMaxPoints"];
+        if(!node.empty() && node.isInt())
+            densifyOptions.nMaxPoints = static_cast<int>(node);
+        node = fsSettings["System.ExportDensifyVoxelSize"];
+        if(!node.empty() && (node.isInt() || node.isReal()))
+            densifyOptions.voxelSize = node.real();
+        SetExportDensification(true, densifyOptions);
+    }
+
+    node = fsSettings["System.ExportRefinePoses"];
+    if(!node.empty() && node.isInt() && static_cast<int>(node) != 0)
+    {
+        PoseRefiner::Options refineOptions;
+        node = fsSettings["System.ExportRefineNeighbours"];
+        if(!node.empty() && node.isInt())
+            refineOptions.nNeighbours = static_cast<int>(node);
+        node = fsSettings["System.ExportRefineLevels"];
+        if(!node.empty() && node.isInt())
+            refineOptions.nLevels = static_cast<int>(node);
+        node = fsSettings["System.ExportRefineIterations"];
+        if(!node.empty() && node.isInt())
+            refineOptions.nIterations = static_cast<int>(node);
+        SetExportPoseRefinement(true, refineOptions);
+    }
+
+    node = fsSettings["System.ExportPly"];
+    if(!node.empty() && node.isInt() && static_cast<int>(node) != 0)
+    {
+        GaussianPlyWriter::Options plyOptions;
+        node = fsSettings["System.ExportPlyScales"];
+        if(!node.empty() && node.isInt())
+            plyOptions.bScales = static_cast<int>(node) != 0;
+        node = fsSettings["System.ExportPlyRotations"];
+        if(!node.empty() && node.isInt())
+            plyOptions.bRotations = static_cast<int>(node) != 0;
+        node = fsSettings["System.ExportPlyOpacity"];
+        if(!node.empty() && (node.isInt() || node.isReal()))
+        {
+            plyOptions.bOpacity = node.real() > 0.0;
+            if(plyOptions.bOpacity)
+                plyOptions.opacity = node.real();
+        }
+        node = fsSettings["System.ExportPlyPcaNeighbours"];
+        if(!node.empty() && node.isInt())
+            plyOptions.nPcaNeighbours = static_cast<int>(node);
+        SetExportGaussianPly(true, plyOptions);
+    }
+
+    node = fsSettings["System.ExportViewSelection"];
+    if(!node.empty() && node.isInt() && static_cast<int>(node) != 0)
+    {
+        KeyFrameSelector::Options viewOptions;
+        node = fsSettings["System.ExportViewTargetViews"];
+        if(!node.empty() && node.isInt())
+            viewOptions.nTargetViews = static_cast<int>(node);
+        node = fsSettings["System.ExportViewMinParallax"];
+        if(!node.empty() && (node.isInt() || node.isReal()))
+            viewOptions.minParallaxDeg = node.real();
+        node = fsSettings["System.ExportViewMinNewPoints"];
+        if(!node.empty() && (node.isInt() || node.isReal()))
+            viewOptions.minNewPointsRatio = node.real();
+        node = fsSettings["System.ExportViewMinBlurRatio"];
+        if(!node.empty() && (node.isInt() || node.isReal()))
+            viewOptions.minBlurRatio = node.real();
+        SetExportViewSelection(true, viewOptions);
+    }
+
+    MemoryPolicy memoryPolicy;
+    node = fsSettings["System.MemoryReportKeyFrames"];
+    if(!node.empty() && node.isInt())
+        memoryPolicy.nReportPeriod = static_cast<int>(node);
+    node = fsSettings["System.KeyFrameGridWindow"];
+    if(!node.empty() && node.isInt())
+        memoryPolicy.nGridWindow = static_cast<int>(node);
+    node = fsSettings["System.MemoryBudgetMB"];
+    if(!node.empty() && (node.isInt() || node.isReal()))
+        memoryPolicy.nBudgetBytes = static_cast<size_t>(node.real()*1024.0*1024.0);
+    node = fsSettings["System.KeyFrameImagesOnly"];
+    if(!node.empty() && node.isInt())
+        memoryPolicy.bKeyFrameImagesOnly = static_cast<int>(node) != 0;
+
+    // Tracking runs in the thread that calls TrackMonocular/TrackStereo/TrackRGBD
+    Instrumentation::SetThreadName("Tracking");
+
     mStrVocabularyFilePath = strVocFile;
 
     bool loadedAtlas = false;
@@ -226,6 +412,19 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     mpLoopCloser->SetTracker(mpTracker);
     mpLoopCloser->SetLocalMapper(mpLocalMapper);
 
+    // The export images, undistorted as the rest of the export
+    mpImageExporter = new ImageExporter([this](KeyFrame* pKF) {
+        cv::Mat im = mpTracker->GetFrameImage(pKF->mnFrameId);
+        const std::shared_ptr<ImageUndistorter> pUndistorter = GetExportUndistorter();
+        if (!im.empty() && pUndistorter)
+            pUndistorter->Undistort(im, im);
+        return im;
+    });
+    SetExportImageOptions(imageOptions);
+    mpLocalMapper->SetImageExporter(mpImageExporter);
+
+    SetMemoryPolicy(memoryPolicy);
+
     //usleep(10*1000*1000);
 
     //Initialize the Viewer thread and launch
@@ -233,6 +432,7 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     //if(false) // TODO
     {
         mpViewer = new Viewer(this, mpFrameDrawer,mpMapDrawer,mpTracker,strSettingsFile,settings_);
+        mpFrameDrawer->SetViewerActive(true);
         mptViewer = new thread(&Viewer::Run, mpViewer);
         mpTracker->SetViewer(mpViewer);
         mpLoopCloser->mpViewer = mpViewer;
@@ -259,6 +459,8 @@ Sophus::SE3f System::TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight,
         exit(-1);
     }
 
+    Instrumentation::ScopedTimer timerTotal(Instrumentation::TRACK_TOTAL);
+
     cv::Mat imLeftToFeed, imRightToFeed;
     if(settings_ && settings_->needToRectify()){
         cv::Mat M1l = settings_->M1l();
@@ -343,6 +545,8 @@ Sophus::SE3f System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const
         exit(-1);
     }
 
+    Instrumentation::ScopedTimer timerTotal(Instrumentation::TRACK_TOTAL);
+
     cv::Mat imToFeed = im.clone();
     cv::Mat imDepthToFeed = depthmap.clone();
     if(settings_ && settings_->needToResize()){
@@ -423,7 +627,9 @@ Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp,
         cerr << "ERROR: you called TrackMonocular but input sensor was not set to Monocular nor Monocular-Inertial." << endl;
         exit(-1);
     }
-    
+
+    Instrumentation::ScopedTimer timerTotal(Instrumentation::TRACK_TOTAL);
+
     cv::Mat imToFeed = im.clone();
     if(settings_ && settings_->needToResize()){
         cv::Mat resizedIm;
@@ -567,9 +773,11 @@ void System::Shutdown()
     /*if(mpViewer)
         pangolin::BindToContext("ORB-SLAM2: Map Viewer");*/
 
-#ifdef REGISTER_TIMES
-    mpTracker->PrintTimeStats();
-#endif
+    Instrumentation::StopExport();
+    if(Instrumentation::IsEnabled())
+        Instrumentation::PrintSummary(mStrLatencySummaryFile);
+    if(Instrumentation::IsTracing() && !mStrTraceFile.empty())
+        SaveTrace(mStrTraceFile);
 
 
 }
@@ -644,7 +852,7 @@ void System::SaveKeyPointsAndMapPoints(const std::string &filename) {
 
     std::cout << std::endl << "Saving key points and map points to " << filename << " ..." << std::endl;
 
-    std::vector<KeyFrame*> vpKFs = mpAtlas->GetAllKeyFrames();
+    std::vector<KeyFrame*> vpKFs = GetExportKeyFrames(mpAtlas->GetAllKeyFrames());
     std::sort(vpKFs.begin(), vpKFs.end(), KeyFrame::lId);
 
     std::ofstream f(filename);
@@ -653,9 +861,35 @@ void System::SaveKeyPointsAndMapPoints(const std::string &filename) {
         return;
     }
 
+    {
+        unique_lock<mutex> lock(mMutexExport);
+        if (mpExportSelector) {
+            const size_t slash = filename.find_last_of('/');
+            mpExportSelector->SaveReport((slash == string::npos ? string(".") : filename.substr(0, slash)) + "/view_selection.txt");
+        }
+    }
+
+    // Photometrically refined poses, the BA poses otherwise
+    bool bRefine;
+    PoseRefiner::Options refineOptions;
+    {
+        unique_lock<mutex> lock(mMutexExport);
+        bRefine = mbExportRefinePoses;
+        refineOptions = mExportRefineOptions;
+    }
+    vector<Sophus::SE3f> vTcw;
+    if (bRefine) {
+        PoseRefiner refiner(refineOptions, [this](KeyFrame* pKF) {
+            return mpTracker->GetFrameImage(pKF->mnFrameId);
+        });
+        vTcw = refiner.Refine(vpKFs);
+    }
+
     f << std::fixed;
 
     cout<<" the number of the keyframes is : "<<vpKFs.size()<<endl;
+
+    const std::shared_ptr<ImageUndistorter> pUndistorter = GetExportUndistorter();
     
     for (size_t i = 0; i < vpKFs.size(); ++i) {
         KeyFrame* pKF = vpKFs[i];
@@ -664,23 +898,25 @@ void System::SaveKeyPointsAndMapPoints(const std::string &filename) {
 
         std::vector<cv::KeyPoint> keypoints = pKF->mvKeysUn;
         set<MapPoint*> mappoints = pKF->GetMapPoints();
+        if (pUndistorter) {
+            for (cv::KeyPoint &kp : keypoints)
+                kp.pt = pUndistorter->Map(kp.pt);
+        }
 
-        Sophus::SE3f Tcw = pKF->GetPose();
+        Sophus::SE3f Tcw = bRefine ? vTcw[i] : pKF->GetPose();
 
         Eigen::Quaternionf q = Tcw.unit_quaternion();
         Eigen::Vector3f t = Tcw.translation();
 
         f << pKF->mnId << " " << std::setprecision(20) << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << " " << t(0) << " " << t(1) << " " << t(2)<< " " << 1;
 
-        std::ostringstream oss_time;
-        oss_time << std::fixed << std::setprecision(6) << pKF->mTimeStamp; // Adjust precision as needed
-        std::string timestampStr = oss_time.str();
-
-        f << " " << std::setprecision(7) << timestampStr + ".png" << std::endl;
+        f << " " << mpImageExporter->Filename(pKF) << std::endl;
 
         int feature_id = 1;
         for (size_t j = 0; j < keypoints.size(); ++j) {
             MapPoint* mp = pKF->GetMapPoint(j);
+            if (pUndistorter && !pUndistorter->IsInside(keypoints[j].pt))
+                continue;
             if (mp && !mp->isBad()) {
                 Eigen::Vector3f eigenPos = mp->GetWorldPos();
                 cv::Point3f pos(eigenPos.x(), eigenPos.y(), eigenPos.z());
@@ -756,9 +992,9 @@ void System::SavePointcloud(const string &filename) {
                     int v = std::get<0>(uv);
 
                     // Check if the KeyFrame's RGB information is available
-                    auto it = mpTracker->mnIdToBGRMap.find(pKF->mnFrameId);
-                    if (it != mpTracker->mnIdToBGRMap.end()) {
-                        cv::Mat bgrImage = it->second; // RGB image of the KeyFrame
+                    cv::Mat bgrImage = mpTracker->GetFrameImage(pKF->mnFrameId);
+                    if (!bgrImage.empty()) {
+                        // RGB image of the KeyFrame
                         // save bgrImage naming with mTimeStamp
 
                         if (!bgrImage.empty() && bgrImage.rows > v && bgrImage.cols > u ) {
@@ -802,32 +1038,40 @@ void System::SavePointcloudFromKeyframes(const std::string &filename, const std:
         return;
     }
 
-    const vector<KeyFrame*>& vpKeyFrames = pActiveMap->GetAllKeyFrames();
+    const vector<KeyFrame*> vpKeyFrames = GetExportKeyFrames(pActiveMap->GetAllKeyFrames());
+
+    // Undistort, encode and write the images on the pool of the exporter, which reuses the images it encoded
+    // during SLAM
+    mpImageExporter->Write(vpKeyFrames, imagesDirectory);
 
     // Write header
     outFile << "# 3D point list with one line of data per point:" << endl;
     outFile << "#   POINT3D_ID, X, Y, Z, R, G, B, ERROR, TRACK[] as (IMAGE_ID, POINT2D_IDX)" << endl;
 
-    // Traverse all KeyFrames
+    PointCloudFilter::Options filterOptions;
+    {
+        unique_lock<mutex> lock(mMutexExport);
+        filterOptions = mExportFilterOptions;
+    }
+    const bool bFilter = filterOptions.Enabled();
+
+    // Traverse all KeyFrames, keeping the written points for their initial scales and the PLY. When filtering,
+    // the colors of each map point are summed instead and the points are written after the filter.
+    vector<Eigen::Vector3f> vWrittenPoints;
+    vector<Eigen::Vector3f> vWrittenColors;
+    vector<PointCloudFilter::Point> vFilterPoints;
+    vector<int> vColorCounts;
+    std::unordered_map<MapPoint*, size_t> mFilterIndices;
     for (KeyFrame* pKF : vpKeyFrames) {
         if (!pKF || pKF->isBad()) continue;
 
         // Get the image and its corresponding map points
-        auto it = mpTracker->mnIdToBGRMap.find(pKF->mnFrameId);
-        if (it == mpTracker->mnIdToBGRMap.end() || it->second.empty()) {
+        cv::Mat bgrImage = mpTracker->GetFrameImage(pKF->mnFrameId);
+        if (bgrImage.empty()) {
             cerr << "Warning: No valid image for KeyFrame " << pKF->mnFrameId << endl;
             continue;
         }
 
-        cv::Mat bgrImage = it->second;
-        // Save bgrImage to file if not already saved
-        if (!bgrImage.empty()) {
-            string imageFilename = imagesDirectory + "/" + std::to_string(pKF->mTimeStamp) + ".png";
-            if (!cv::imwrite(imageFilename, bgrImage)) {
-                cerr << "Error: Failed to save image " << imageFilename << endl;
-            }
-        }        
-
         const vector<MapPoint*>& vpMapPoints = pKF->GetMapPointMatches();
         int ID = 1;
         for (size_t i = 0; i < vpMapPoints.size(); ++i) {
@@ -847,22 +1091,252 @@ void System::SavePointcloudFromKeyframes(const std::string &filename, const std:
                     // Extract RGB values
                     cv::Vec3b color = bgrImage.at<cv::Vec3b>(v, u);
 
+                    if (bFilter) {
+                        const Eigen::Vector3f rgb(static_cast<float>(color[2]), static_cast<float>(color[1]), static_cast<float>(color[0]));
+                        const auto it = mFilterIndices.emplace(pMP, vFilterPoints.size());
+                        if (it.second) {
+                            vFilterPoints.push_back(PointCloudFilter::Point{worldPos, rgb, pMP->Observations()});
+                            vColorCounts.push_back(1);
+                        }
+                        else {
+                            vFilterPoints[it.first->second].color += rgb;
+                            vColorCounts[it.first->second]++;
+                        }
+                        continue;
+                    }
+
                     // Write the 3D point and color to the file
                     outFile << std::setprecision(20) << ID <<" "<< pos.x << " " << pos.y << " " << pos.z << " "
                             << static_cast<int>(color[2]) << " " // Red
                             << static_cast<int>(color[1]) << " " // Green
                             << static_cast<int>(color[0]) << " " << "0"<< " "  << "0" << " " <<"0" << endl;
+                    vWrittenPoints.push_back(worldPos);
+                    vWrittenColors.push_back(Eigen::Vector3f(static_cast<float>(color[2]), static_cast<float>(color[1]), static_cast<float>(color[0])));
                     ID++;
                 }
             }
         }
     }
 
+    // Dense points from stereo between covisible keyframes
+    bool bDensify;
+    DepthDensifier::Options densifyOptions;
+    {
+        unique_lock<mutex> lock(mMutexExport);
+        bDensify = mbExportDensify;
+        densifyOptions = mExportDensifyOptions;
+    }
+    vector<PointCloudFilter::Point> vDensePoints;
+    if (bDensify) {
+        DepthDensifier densifier(densifyOptions, [this](KeyFrame* pKF) {
+            return mpTracker->GetFrameImage(pKF->mnFrameId);
+        });
+        vDensePoints = densifier.Densify(vpKeyFrames);
+    }
+
+    auto writePoint = [&](const size_t id, const PointCloudFilter::Point &point) {
+        const Eigen::Vector3f rgb = point.color.array().round().min(255.f).max(0.f);
+        outFile << std::setprecision(20) << id << " " << point.pos.x() << " " << point.pos.y() << " " << point.pos.z() << " "
+                << static_cast<int>(rgb[0]) << " " << static_cast<int>(rgb[1]) << " " << static_cast<int>(rgb[2]) << " "
+                << "0" << " " << "0" << " " << "0" << endl;
+        vWrittenPoints.push_back(point.pos);
+        vWrittenColors.push_back(rgb);
+    };
+
+    if (bFilter) {
+        for (size_t i = 0; i < vFilterPoints.size(); i++)
+            vFilterPoints[i].color /= static_cast<float>(vColorCounts[i]);
+        vFilterPoints.insert(vFilterPoints.end(), vDensePoints.begin(), vDensePoints.end());
+        PointCloudFilter::Apply(filterOptions, vFilterPoints);
+
+        for (size_t i = 0; i < vFilterPoints.size(); i++)
+            writePoint(i + 1, vFilterPoints[i]);
+    }
+    else {
+        // After the sparse points
+        for (const PointCloudFilter::Point &point : vDensePoints)
+            writePoint(vWrittenPoints.size() + 1, point);
+    }
+
     // Close the file
     outFile.close();
     cout << "Pointcloud saved to " << filename << " using KeyFrame-based method." << endl;
+
+    // Initial Gaussian scales from the 3 nearest neighbours, so that the trainer does not run simple-knn
+    string basename = filename;
+    if (basename.size() > 4 && basename.compare(basename.size() - 4, 4, ".txt") == 0)
+        basename.erase(basename.size() - 4);
+    const string scalesFilename = basename + "_scales.txt";
+    vector<float> vScales;
+    PointCloudKnn::InitialScales(vWrittenPoints, vScales);
+    if (PointCloudKnn::SaveScales(scalesFilename, vScales))
+        cout << "Initial scales saved to " << scalesFilename << endl;
+
+    // The same points as the PLY the trainer would convert points3D.txt to, with the Gaussian parameters
+    bool bPly;
+    GaussianPlyWriter::Options plyOptions;
+    {
+        unique_lock<mutex> lock(mMutexExport);
+        bPly = mbExportPly;
+        plyOptions = mExportPlyOptions;
+    }
+    if (bPly) {
+        const string plyFilename = basename + ".ply";
+        if (GaussianPlyWriter::Save(plyFilename, vWrittenPoints, vWrittenColors, vScales, plyOptions))
+            cout << "Initial Gaussians saved to " << plyFilename << endl;
+    }
+}
+
+bool System::SaveCameraCOLMAP(const std::string &filename)
+{
+    ofstream outFile(filename.c_str());
+    if (!outFile.is_open()) {
+        cerr << "Error: Failed to open output file " << filename << endl;
+        return false;
+    }
+
+    float fx, fy, cx, cy;
+    cv::Size size;
+    const std::shared_ptr<ImageUndistorter> pUndistorter = GetExportUndistorter();
+    if (pUndistorter) {
+        fx = pUndistorter->fx; fy = pUndistorter->fy; cx = pUndistorter->cx; cy = pUndistorter->cy;
+        size = pUndistorter->mSize;
+    }
+    else {
+        // Calibration of the tracked images, which already includes the image scale
+        KeyFrame* pKF = NULL;
+        cv::Mat im;
+        for (KeyFrame* pKFi : mpAtlas->GetAllKeyFrames()) {
+            im = mpTracker->GetFrameImage(pKFi->mnFrameId);
+            if (!pKFi->isBad() && !im.empty()) {
+                pKF = pKFi;
+                break;
+            }
+        }
+        if (!pKF) {
+            cerr << "Error: No keyframe image to take the camera from" << endl;
+            return false;
+        }
+        fx = pKF->fx; fy = pKF->fy; cx = pKF->cx; cy = pKF->cy;
+        size = im.size();
+    }
+
+    outFile << "#   CAMERA_ID, MODEL, WIDTH, HEIGHT, PARAMS[]" << endl;
+    outFile << "1 PINHOLE " << size.width << " " << size.height << " " << fixed << setprecision(6)
+            << fx << " " << fy << " " << cx << " " << cy << endl;
+
+    cout << "Camera parameters successfully saved to " << filename << endl;
+    return true;
+}
+
+void System::SetExportUndistortion(const bool bUndistort, const bool bCropToValid)
+{
+    {
+        unique_lock<mutex> lock(mMutexExport);
+        mbExportUndistort = bUndistort;
+        mbExportCropToValid = bCropToValid;
+        mpExportUndistorter.reset();
+    }
+
+    // After the swap, so that the images encoded with the previous undistortion, even those in progress, are dropped
+    if (mpImageExporter)
+        mpImageExporter->Clear();
+}
+
+void System::SetExportImageOptions(const ImageExporter::Options &options)
+{
+    mpImageExporter->SetOptions(options);
+}
+
+void System::SetExportPointCloudFilter(const PointCloudFilter::Options &options)
+{
+    unique_lock<mutex> lock(mMutexExport);
+    mExportFilterOptions = options;
+}
+
+void System::SetExportDensification(const bool bDensify, const DepthDensifier::Options &options)
+{
+    unique_lock<mutex> lock(mMutexExport);
+    mbExportDensify = bDensify;
+    mExportDensifyOptions = options;
+}
+
+void System::SetExportPoseRefinement(const bool bRefine, const PoseRefiner::Options &options)
+{
+    unique_lock<mutex> lock(mMutexExport);
+    mbExportRefinePoses = bRefine;
+    mExportRefineOptions = options;
+}
+
+void System::SetExportGaussianPly(const bool bPly, const GaussianPlyWriter::Options &options)
+{
+    unique_lock<mutex> lock(mMutexExport);
+    mbExportPly = bPly;
+    mExportPlyOptions = options;
+}
+
+void System::SetExportViewSelection(const bool bSelect, const KeyFrameSelector::Options &options)
+{
+    unique_lock<mutex> lock(mMutexExport);
+    mbExportViewSelection = bSelect;
+    mExportViewOptions = options;
+    delete mpExportSelector;
+    mpExportSelector = static_cast<KeyFrameSelector*>(NULL);
+    mvpExportSelectionInput.clear();
+    mspExportKeyFrames.clear();
 }
 
+std::vector<KeyFrame*> System::GetExportKeyFrames(const std::vector<KeyFrame*> &vpKFs)
+{
+    unique_lock<mutex> lock(mMutexExport);
+    if (!mbExportViewSelection)
+        return vpKFs;
+
+    // The exporters share the selection as long as the atlas keeps the same keyframes
+    vector<KeyFrame*> vpAllKFs = mpAtlas->GetAllKeyFrames();
+    std::sort(vpAllKFs.begin(), vpAllKFs.end(), KeyFrame::lId);
+    if (!mpExportSelector || vpAllKFs != mvpExportSelectionInput) {
+        delete mpExportSelector;
+        mpExportSelector = new KeyFrameSelector(mExportViewOptions, [this](KeyFrame* pKF) {
+            return mpTracker->GetFrameImage(pKF->mnFrameId);
+        });
+        const vector<KeyFrame*> vpSelected = mpExportSelector->Select(vpAllKFs);
+        mspExportKeyFrames = set<KeyFrame*>(vpSelected.begin(), vpSelected.end());
+        mvpExportSelectionInput = vpAllKFs;
+        mpExportSelector->PrintSummary();
+    }
+
+    vector<KeyFrame*> vpSelected;
+    for (KeyFrame* pKF : vpKFs)
+        if (mspExportKeyFrames.count(pKF))
+            vpSelected.push_back(pKF);
+    return vpSelected;
+}
+
+std::shared_ptr<ImageUndistorter> System::GetExportUndistorter()
+{
+    unique_lock<mutex> lock(mMutexExport);
+    if (!mbExportUndistort || mpExportUndistorter)
+        return mpExportUndistorter;
+
+    // Calibration and image size of the first keyframe with an image
+    for (KeyFrame* pKF : mpAtlas->GetAllKeyFrames()) {
+        if (pKF->isBad())
+            continue;
+        cv::Mat im = mpTracker->GetFrameImage(pKF->mnFrameId);
+        if (im.empty())
+            continue;
+        if (pKF->mpCamera->GetType() != GeometricCamera::CAM_PINHOLE) {
+            cerr << "Warning: only pinhole images are undistorted for the export" << endl;
+            mbExportUndistort = false;
+            return mpExportUndistorter;
+        }
+        mpExportUndistorter.reset(new ImageUndistorter(pKF->fx, pKF->fy, pKF->cx, pKF->cy, pKF->mDistCoef,
+                                                       im.size(), mbExportCropToValid));
+        break;
+    }
+    return mpExportUndistorter;
+}
 
 float System::CalculateReprojectionErrorForMapPoint(MapPoint* pMP)
 {
@@ -957,6 +1431,22 @@ void System::SaveKeyFrameTrajectoryTUM(const string &filename)
     f.close();
 }
 
+void System::GetKeyFrameTrajectory(vector<double> &vTimestamps, vector<Eigen::Vector3f> &vTwc)
+{
+    vector<KeyFrame*> vpKFs = mpAtlas->GetAllKeyFrames();
+    sort(vpKFs.begin(),vpKFs.end(),KeyFrame::lId);
+
+    vTimestamps.clear();
+    vTwc.clear();
+    for(KeyFrame* pKF : vpKFs)
+    {
+        if(pKF->isBad())
+            continue;
+        vTimestamps.push_back(pKF->mTimeStamp);
+        vTwc.push_back(pKF->GetCameraCenter());
+    }
+}
+
 void System::SaveTrajectoryEuRoC(const string &filename)
 {
 
@@ -1680,22 +2170,70 @@ float System::GetImageScale()
     return mpTracker->GetImageScale();
 }
 
-#ifdef REGISTER_TIMES
-void System::InsertRectTime(double& time)
+bool System::RequestSnapshot(const double minPeriod)
 {
-    mpTracker->vdRectStereo_ms.push_back(time);
+    return mpFrameDrawer->RequestSnapshot(minPeriod);
 }
 
-void System::InsertResizeTime(double& time)
+bool System::GetSnapshot(cv::Mat &imFrame, cv::Mat &imMap, const int mapSize)
 {
-    mpTracker->vdResizeImage_ms.push_back(time);
+    if(!mpFrameDrawer->isSnapshotReady())
+        return false;
+
+    imFrame = mpFrameDrawer->DrawFrame(mpTracker->GetImageScale());
+    imMap = mpMapDrawer->DrawMapImage(mapSize);
+    return true;
 }
 
-void System::InsertTrackTime(double& time)
+void System::EnableInstrumentation(const bool bEnable, const string &strExportFile, const double period)
 {
-    mpTracker->vdTrackTotal_ms.push_back(time);
+    Instrumentation::StopExport();
+    Instrumentation::SetEnabled(bEnable);
+    mStrLatencySummaryFile.clear();
+    if(bEnable && !strExportFile.empty())
+    {
+        Instrumentation::StartExport(strExportFile,period);
+
+        // The summary goes to the folder of the export file
+        const size_t slash = strExportFile.find_last_of('/');
+        mStrLatencySummaryFile = (slash==string::npos ? string() : strExportFile.substr(0,slash+1)) + "LatencyStats.txt";
+    }
+}
+
+void System::EnableTracing(const bool bEnable, const string &strTraceFile)
+{
+    Instrumentation::SetTracing(bEnable);
+    mStrTraceFile = strTraceFile;
+}
+
+bool System::SaveTrace(const string &filename)
+{
+    return Instrumentation::WriteTrace(filename);
+}
+
+MemoryUsage System::GetMemoryUsage()
+{
+    MemoryUsage usage = mpAtlas->GetMemoryUsage();
+    mpTracker->AddMemoryUsage(usage);
+    mpImageExporter->AddMemoryUsage(usage);
+    return usage;
+}
+
+void System::SetMemoryPolicy(const MemoryPolicy &policy)
+{
+    mpTracker->SetMemoryPolicy(policy);
+    mpLocalMapper->SetMemoryPolicy(policy);
+}
+
+void System::InsertRectTime(double& time)
+{
+    Instrumentation::RecordTime(Instrumentation::TRACK_RECT_STEREO,time);
+}
+
+void System::InsertResizeTime(double& time)
+{
+    Instrumentation::RecordTime(Instrumentation::TRACK_RESIZE_IMAGE,time);
 }
-#endif
 
 void System::SaveAtlas(int type){
     if(!mStrSaveAtlasToFile.empty())
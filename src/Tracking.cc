@@ -28,11 +28,16 @@
 #include "KannalaBrandt8.h"
 #include "MLPnPsolver.h"
 #include "GeometricTools.h"
+#include "Instrumentation.h"
 
 #include <iostream>
 
 #include <mutex>
 #include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <thread>
 
 
 using namespace std;
@@ -42,11 +47,14 @@ namespace ORB_SLAM3
 
 
 Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer, Atlas *pAtlas, KeyFrameDatabase* pKFDB, const string &strSettingPath, const int sensor, Settings* settings, const string &_nameSeq):
-    mState(NO_IMAGES_YET), mSensor(sensor), mTrackedFr(0), mbStep(false),
+    mState(NO_IMAGES_YET), mSensor(sensor), mbKeyFrameImagesOnly(false), mbInitialImageKept(false), mnInitialImageId(0), mTrackedFr(0), mbStep(false),
     mbOnlyTracking(false), mbMapUpdated(false), mbVO(false), mpORBVocabulary(pVoc), mpKeyFrameDB(pKFDB),
     mbReadyToInitializate(false), mpSystem(pSys), mpViewer(NULL), bStepByStep(false),
     mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpAtlas(pAtlas), mnLastRelocFrameId(0), time_recently_lost(5.0),
-    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL))
+    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL)),
+    mLocalMapUpdate(LOCAL_MAP_REBUILD), mbLocalMapCacheValid(false), mpLocalMapCacheMap(static_cast<Map*>(NULL)),
+    mnLocalMapCacheChangeIdx(0), mpLocalMapCacheLastKF(static_cast<KeyFrame*>(NULL)),
+    mnRelocThreads(max(1u, thread::hardware_concurrency()/2)), mnRelocTask(0), mnRelocRunning(0), mbRelocStop(false)
 {
     // Load camera parameters from settings file
     if(settings){
@@ -116,419 +124,12 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
             std::cout << " is unknown" << std::endl;
         }
     }
-
-#ifdef REGISTER_TIMES
-    vdRectStereo_ms.clear();
-    vdResizeImage_ms.clear();
-    vdORBExtract_ms.clear();
-    vdStereoMatch_ms.clear();
-    vdIMUInteg_ms.clear();
-    vdPosePred_ms.clear();
-    vdLMTrack_ms.clear();
-    vdNewKF_ms.clear();
-    vdTrackTotal_ms.clear();
-#endif
-}
-
-#ifdef REGISTER_TIMES
-double calcAverage(vector<double> v_times)
-{
-    double accum = 0;
-    for(double value : v_times)
-    {
-        accum += value;
-    }
-
-    return accum / v_times.size();
-}
-
-double calcDeviation(vector<double> v_times, double average)
-{
-    double accum = 0;
-    for(double value : v_times)
-    {
-        accum += pow(value - average, 2);
-    }
-    return sqrt(accum / v_times.size());
-}
-
-double calcAverage(vector<int> v_values)
-{
-    double accum = 0;
-    int total = 0;
-    for(double value : v_values)
-    {
-        if(value == 0)
-            continue;
-        accum += value;
-        total++;
-    }
-
-    return accum / total;
-}
-
-double calcDeviation(vector<int> v_values, double average)
-{
-    double accum = 0;
-    int total = 0;
-    for(double value : v_values)
-    {
-        if(value == 0)
-            continue;
-        accum += pow(value - average, 2);
-        total++;
-    }
-    return sqrt(accum / total);
 }
 
-void Tracking::LocalMapStats2File()
-{
-    ofstream f;
-    f.open("LocalMapTimeStats.txt");
-    f << fixed << setprecision(6);
-    f << "#Stereo rect[ms], MP culling[ms], MP creation[ms], LBA[ms], KF culling[ms], Total[ms]" << endl;
-    for(int i=0; i<mpLocalMapper->vdLMTotal_ms.size(); ++i)
-    {
-        f << mpLocalMapper->vdKFInsert_ms[i] << "," << mpLocalMapper->vdMPCulling_ms[i] << ","
-          << mpLocalMapper->vdMPCreation_ms[i] << "," << mpLocalMapper->vdLBASync_ms[i] << ","
-          << mpLocalMapper->vdKFCullingSync_ms[i] <<  "," << mpLocalMapper->vdLMTotal_ms[i] << endl;
-    }
-
-    f.close();
-
-    f.open("LBA_Stats.txt");
-    f << fixed << setprecision(6);
-    f << "#LBA time[ms], KF opt[#], KF fixed[#], MP[#], Edges[#]" << endl;
-    for(int i=0; i<mpLocalMapper->vdLBASync_ms.size(); ++i)
-    {
-        f << mpLocalMapper->vdLBASync_ms[i] << "," << mpLocalMapper->vnLBA_KFopt[i] << ","
-          << mpLocalMapper->vnLBA_KFfixed[i] << "," << mpLocalMapper->vnLBA_MPs[i] << ","
-          << mpLocalMapper->vnLBA_edges[i] << endl;
-    }
-
-
-    f.close();
-}
-
-void Tracking::TrackStats2File()
-{
-    ofstream f;
-    f.open("SessionInfo.txt");
-    f << fixed;
-    f << "Number of KFs: " << mpAtlas->GetAllKeyFrames().size() << endl;
-    f << "Number of MPs: " << mpAtlas->GetAllMapPoints().size() << endl;
-
-    f << "OpenCV version: " << CV_VERSION << endl;
-
-    f.close();
-
-    f.open("TrackingTimeStats.txt");
-    f << fixed << setprecision(6);
-
-    f << "#Image Rect[ms], Image Resize[ms], ORB ext[ms], Stereo match[ms], IMU preint[ms], Pose pred[ms], LM track[ms], KF dec[ms], Total[ms]" << endl;
-
-    for(int i=0; i<vdTrackTotal_ms.size(); ++i)
-    {
-        double stereo_rect = 0.0;
-        if(!vdRectStereo_ms.empty())
-        {
-            stereo_rect = vdRectStereo_ms[i];
-        }
-
-        double resize_image = 0.0;
-        if(!vdResizeImage_ms.empty())
-        {
-            resize_image = vdResizeImage_ms[i];
-        }
-
-        double stereo_match = 0.0;
-        if(!vdStereoMatch_ms.empty())
-        {
-            stereo_match = vdStereoMatch_ms[i];
-        }
-
-        double imu_preint = 0.0;
-        if(!vdIMUInteg_ms.empty())
-        {
-            imu_preint = vdIMUInteg_ms[i];
-        }
-
-        f << stereo_rect << "," << resize_image << "," << vdORBExtract_ms[i] << "," << stereo_match << "," << imu_preint << ","
-          << vdPosePred_ms[i] <<  "," << vdLMTrack_ms[i] << "," << vdNewKF_ms[i] << "," << vdTrackTotal_ms[i] << endl;
-    }
-
-    f.close();
-}
-
-void Tracking::PrintTimeStats()
-{
-    // Save data in files
-    TrackStats2File();
-    LocalMapStats2File();
-
-
-    ofstream f;
-    f.open("ExecMean.txt");
-    f << fixed;
-    //Report the mean and std of each one
-    std::cout << std::endl << " TIME STATS in ms (mean$\\pm$std)" << std::endl;
-    f << " TIME STATS in ms (mean$\\pm$std)" << std::endl;
-    cout << "OpenCV version: " << CV_VERSION << endl;
-    f << "OpenCV version: " << CV_VERSION << endl;
-    std::cout << "---------------------------" << std::endl;
-    std::cout << "Tracking" << std::setprecision(5) << std::endl << std::endl;
-    f << "---------------------------" << std::endl;
-    f << "Tracking" << std::setprecision(5) << std::endl << std::endl;
-    double average, deviation;
-    if(!vdRectStereo_ms.empty())
-    {
-        average = calcAverage(vdRectStereo_ms);
-        deviation = calcDeviation(vdRectStereo_ms, average);
-        std::cout << "Stereo Rectification: " << average << "$\\pm$" << deviation << std::endl;
-        f << "Stereo Rectification: " << average << "$\\pm$" << deviation << std::endl;
-    }
-
-    if(!vdResizeImage_ms.empty())
-    {
-        average = calcAverage(vdResizeImage_ms);
-        deviation = calcDeviation(vdResizeImage_ms, average);
-        std::cout << "Image Resize: " << average << "$\\pm$" << deviation << std::endl;
-        f << "Image Resize: " << average << "$\\pm$" << deviation << std::endl;
-    }
-
-    average = calcAverage(vdORBExtract_ms);
-    deviation = calcDeviation(vdORBExtract_ms, average);
-    std::cout << "ORB Extraction: " << average << "$\\pm$" << deviation << std::endl;
-    f << "ORB Extraction: " << average << "$\\pm$" << deviation << std::endl;
-
-    if(!vdStereoMatch_ms.empty())
-    {
-        average = calcAverage(vdStereoMatch_ms);
-        deviation = calcDeviation(vdStereoMatch_ms, average);
-        std::cout << "Stereo Matching: " << average << "$\\pm$" << deviation << std::endl;
-        f << "Stereo Matching: " << average << "$\\pm$" << deviation << std::endl;
-    }
-
-    if(!vdIMUInteg_ms.empty())
-    {
-        average = calcAverage(vdIMUInteg_ms);
-        deviation = calcDeviation(vdIMUInteg_ms, average);
-        std::cout << "IMU Preintegration: " << average << "$\\pm$" << deviation << std::endl;
-        f << "IMU Preintegration: " << average << "$\\pm$" << deviation << std::endl;
-    }
-
-    average = calcAverage(vdPosePred_ms);
-    deviation = calcDeviation(vdPosePred_ms, average);
-    std::cout << "Pose Prediction: " << average << "$\\pm$" << deviation << std::endl;
-    f << "Pose Prediction: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(vdLMTrack_ms);
-    deviation = calcDeviation(vdLMTrack_ms, average);
-    std::cout << "LM Track: " << average << "$\\pm$" << deviation << std::endl;
-    f << "LM Track: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(vdNewKF_ms);
-    deviation = calcDeviation(vdNewKF_ms, average);
-    std::cout << "New KF decision: " << average << "$\\pm$" << deviation << std::endl;
-    f << "New KF decision: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(vdTrackTotal_ms);
-    deviation = calcDeviation(vdTrackTotal_ms, average);
-    std::cout << "Total Tracking: " << average << "$\\pm$" << deviation << std::endl;
-    f << "Total Tracking: " << average << "$\\pm$" << deviation << std::endl;
-
-    // Local Mapping time stats
-    std::cout << std::endl << std::endl << std::endl;
-    std::cout << "Local Mapping" << std::endl << std::endl;
-    f << std::endl << "Local Mapping" << std::endl << std::endl;
-
-    average = calcAverage(mpLocalMapper->vdKFInsert_ms);
-    deviation = calcDeviation(mpLocalMapper->vdKFInsert_ms, average);
-    std::cout << "KF Insertion: " << average << "$\\pm$" << deviation << std::endl;
-    f << "KF Insertion: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vdMPCulling_ms);
-    deviation = calcDeviation(mpLocalMapper->vdMPCulling_ms, average);
-    std::cout << "MP Culling: " << average << "$\\pm$" << deviation << std::endl;
-    f << "MP Culling: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vdMPCreation_ms);
-    deviation = calcDeviation(mpLocalMapper->vdMPCreation_ms, average);
-    std::cout << "MP Creation: " << average << "$\\pm$" << deviation << std::endl;
-    f << "MP Creation: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vdLBA_ms);
-    deviation = calcDeviation(mpLocalMapper->vdLBA_ms, average);
-    std::cout << "LBA: " << average << "$\\pm$" << deviation << std::endl;
-    f << "LBA: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vdKFCulling_ms);
-    deviation = calcDeviation(mpLocalMapper->vdKFCulling_ms, average);
-    std::cout << "KF Culling: " << average << "$\\pm$" << deviation << std::endl;
-    f << "KF Culling: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vdLMTotal_ms);
-    deviation = calcDeviation(mpLocalMapper->vdLMTotal_ms, average);
-    std::cout << "Total Local Mapping: " << average << "$\\pm$" << deviation << std::endl;
-    f << "Total Local Mapping: " << average << "$\\pm$" << deviation << std::endl;
-
-    // Local Mapping LBA complexity
-    std::cout << "---------------------------" << std::endl;
-    std::cout << std::endl << "LBA complexity (mean$\\pm$std)" << std::endl;
-    f << "---------------------------" << std::endl;
-    f << std::endl << "LBA complexity (mean$\\pm$std)" << std::endl;
-
-    average = calcAverage(mpLocalMapper->vnLBA_edges);
-    deviation = calcDeviation(mpLocalMapper->vnLBA_edges, average);
-    std::cout << "LBA Edges: " << average << "$\\pm$" << deviation << std::endl;
-    f << "LBA Edges: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vnLBA_KFopt);
-    deviation = calcDeviation(mpLocalMapper->vnLBA_KFopt, average);
-    std::cout << "LBA KF optimized: " << average << "$\\pm$" << deviation << std::endl;
-    f << "LBA KF optimized: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vnLBA_KFfixed);
-    deviation = calcDeviation(mpLocalMapper->vnLBA_KFfixed, average);
-    std::cout << "LBA KF fixed: " << average << "$\\pm$" << deviation << std::endl;
-    f << "LBA KF fixed: " << average << "$\\pm$" << deviation << std::endl;
-
-    average = calcAverage(mpLocalMapper->vnLBA_MPs);
-    deviation = calcDeviation(mpLocalMapper->vnLBA_MPs, average);
-    std::cout << "LBA MP: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-    f << "LBA MP: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-
-    std::cout << "LBA executions: " << mpLocalMapper->nLBA_exec << std::endl;
-    std::cout << "LBA aborts: " << mpLocalMapper->nLBA_abort << std::endl;
-    f << "LBA executions: " << mpLocalMapper->nLBA_exec << std::endl;
-    f << "LBA aborts: " << mpLocalMapper->nLBA_abort << std::endl;
-
-    // Map complexity
-    std::cout << "---------------------------" << std::endl;
-    std::cout << std::endl << "Map complexity" << std::endl;
-    std::cout << "KFs in map: " << mpAtlas->GetAllKeyFrames().size() << std::endl;
-    std::cout << "MPs in map: " << mpAtlas->GetAllMapPoints().size() << std::endl;
-    f << "---------------------------" << std::endl;
-    f << std::endl << "Map complexity" << std::endl;
-    vector<Map*> vpMaps = mpAtlas->GetAllMaps();
-    Map* pBestMap = vpMaps[0];
-    for(int i=1; i<vpMaps.size(); ++i)
-    {
-        if(pBestMap->GetAllKeyFrames().size() < vpMaps[i]->GetAllKeyFrames().size())
-        {
-            pBestMap = vpMaps[i];
-        }
-    }
-
-    f << "KFs in map: " << pBestMap->GetAllKeyFrames().size() << std::endl;
-    f << "MPs in map: " << pBestMap->GetAllMapPoints().size() << std::endl;
-
-    f << "---------------------------" << std::endl;
-    f << std::endl << "Place Recognition (mean$\\pm$std)" << std::endl;
-    std::cout << "---------------------------" << std::endl;
-    std::cout << std::endl << "Place Recognition (mean$\\pm$std)" << std::endl;
-    average = calcAverage(mpLoopClosing->vdDataQuery_ms);
-    deviation = calcDeviation(mpLoopClosing->vdDataQuery_ms, average);
-    f << "Database Query: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Database Query: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdEstSim3_ms);
-    deviation = calcDeviation(mpLoopClosing->vdEstSim3_ms, average);
-    f << "SE3 estimation: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "SE3 estimation: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdPRTotal_ms);
-    deviation = calcDeviation(mpLoopClosing->vdPRTotal_ms, average);
-    f << "Total Place Recognition: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-    std::cout << "Total Place Recognition: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-
-    f << std::endl << "Loop Closing (mean$\\pm$std)" << std::endl;
-    std::cout << std::endl << "Loop Closing (mean$\\pm$std)" << std::endl;
-    average = calcAverage(mpLoopClosing->vdLoopFusion_ms);
-    deviation = calcDeviation(mpLoopClosing->vdLoopFusion_ms, average);
-    f << "Loop Fusion: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Loop Fusion: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdLoopOptEss_ms);
-    deviation = calcDeviation(mpLoopClosing->vdLoopOptEss_ms, average);
-    f << "Essential Graph: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Essential Graph: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdLoopTotal_ms);
-    deviation = calcDeviation(mpLoopClosing->vdLoopTotal_ms, average);
-    f << "Total Loop Closing: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-    std::cout << "Total Loop Closing: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-
-    f << "Numb exec: " << mpLoopClosing->nLoop << std::endl;
-    std::cout << "Num exec: " << mpLoopClosing->nLoop << std::endl;
-    average = calcAverage(mpLoopClosing->vnLoopKFs);
-    deviation = calcDeviation(mpLoopClosing->vnLoopKFs, average);
-    f << "Number of KFs: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Number of KFs: " << average << "$\\pm$" << deviation << std::endl;
-
-    f << std::endl << "Map Merging (mean$\\pm$std)" << std::endl;
-    std::cout << std::endl << "Map Merging (mean$\\pm$std)" << std::endl;
-    average = calcAverage(mpLoopClosing->vdMergeMaps_ms);
-    deviation = calcDeviation(mpLoopClosing->vdMergeMaps_ms, average);
-    f << "Merge Maps: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Merge Maps: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdWeldingBA_ms);
-    deviation = calcDeviation(mpLoopClosing->vdWeldingBA_ms, average);
-    f << "Welding BA: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Welding BA: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdMergeOptEss_ms);
-    deviation = calcDeviation(mpLoopClosing->vdMergeOptEss_ms, average);
-    f << "Optimization Ess.: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Optimization Ess.: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdMergeTotal_ms);
-    deviation = calcDeviation(mpLoopClosing->vdMergeTotal_ms, average);
-    f << "Total Map Merging: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-    std::cout << "Total Map Merging: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-
-    f << "Numb exec: " << mpLoopClosing->nMerges << std::endl;
-    std::cout << "Num exec: " << mpLoopClosing->nMerges << std::endl;
-    average = calcAverage(mpLoopClosing->vnMergeKFs);
-    deviation = calcDeviation(mpLoopClosing->vnMergeKFs, average);
-    f << "Number of KFs: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Number of KFs: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vnMergeMPs);
-    deviation = calcDeviation(mpLoopClosing->vnMergeMPs, average);
-    f << "Number of MPs: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Number of MPs: " << average << "$\\pm$" << deviation << std::endl;
-
-    f << std::endl << "Full GBA (mean$\\pm$std)" << std::endl;
-    std::cout << std::endl << "Full GBA (mean$\\pm$std)" << std::endl;
-    average = calcAverage(mpLoopClosing->vdGBA_ms);
-    deviation = calcDeviation(mpLoopClosing->vdGBA_ms, average);
-    f << "GBA: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "GBA: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdUpdateMap_ms);
-    deviation = calcDeviation(mpLoopClosing->vdUpdateMap_ms, average);
-    f << "Map Update: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Map Update: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vdFGBATotal_ms);
-    deviation = calcDeviation(mpLoopClosing->vdFGBATotal_ms, average);
-    f << "Total Full GBA: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-    std::cout << "Total Full GBA: " << average << "$\\pm$" << deviation << std::endl << std::endl;
-
-    f << "Numb exec: " << mpLoopClosing->nFGBA_exec << std::endl;
-    std::cout << "Num exec: " << mpLoopClosing->nFGBA_exec << std::endl;
-    f << "Numb abort: " << mpLoopClosing->nFGBA_abort << std::endl;
-    std::cout << "Num abort: " << mpLoopClosing->nFGBA_abort << std::endl;
-    average = calcAverage(mpLoopClosing->vnGBAKFs);
-    deviation = calcDeviation(mpLoopClosing->vnGBAKFs, average);
-    f << "Number of KFs: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Number of KFs: " << average << "$\\pm$" << deviation << std::endl;
-    average = calcAverage(mpLoopClosing->vnGBAMPs);
-    deviation = calcDeviation(mpLoopClosing->vnGBAMPs, average);
-    f << "Number of MPs: " << average << "$\\pm$" << deviation << std::endl;
-    std::cout << "Number of MPs: " << average << "$\\pm$" << deviation << std::endl;
-
-    f.close();
-
-}
-
-#endif
-
 Tracking::~Tracking()
 {
     //f_track_stats.close();
+    StopRelocalizationWorkers();
 
 }
 
@@ -1504,11 +1105,6 @@ Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat
     mCurrentFrame.mNameFile = filename;
     mCurrentFrame.mnDataset = mnNumDataset;
 
-#ifdef REGISTER_TIMES
-    vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-    vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
-#endif
-
     //cout << "Tracking start" << endl;
     Track();
     //cout << "Tracking end" << endl;
@@ -1553,10 +1149,6 @@ Sophus::SE3f Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, co
     mCurrentFrame.mNameFile = filename;
     mCurrentFrame.mnDataset = mnNumDataset;
 
-#ifdef REGISTER_TIMES
-    vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-#endif
-
     Track();
 
     return mCurrentFrame.GetPose();
@@ -1609,23 +1201,49 @@ Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &times
     if (mbRGB){
         cvtColor(originalBGR,originalBGR,cv::COLOR_RGB2BGR);
     }
-    mnIdToBGRMap[mCurrentFrame.mnId] = originalBGR;//wanglian construct hashmap: mnid to originalRGB
-
-#ifdef REGISTER_TIMES
-    vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-#endif
+    {
+        unique_lock<mutex> lock(mMutexBGRMap);
+        mnIdToBGRMap[mCurrentFrame.mnId] = originalBGR;//wanglian construct hashmap: mnid to originalRGB
+    }
 
     lastID = mCurrentFrame.mnId;
     Track();
 
+    // Only keyframe images are exported. A frame cannot become a keyframe after Track, except the reference
+    // frame of the monocular initialization: its image is kept until the initialization succeeds (the
+    // frame is then the first keyframe), replaces it or gives up.
+    if(mbKeyFrameImagesOnly)
+    {
+        const bool bPendingInitial = mState==NOT_INITIALIZED && mbReadyToInitializate;
+        if(mbInitialImageKept && !(bPendingInitial && mInitialFrame.mnId==mnInitialImageId))
+        {
+            if(mState!=OK)
+                EraseFrameImage(mnInitialImageId);
+            mbInitialImageKept = false;
+        }
+
+        if(bPendingInitial && mInitialFrame.mnId==mCurrentFrame.mnId)
+        {
+            mbInitialImageKept = true;
+            mnInitialImageId = mCurrentFrame.mnId;
+        }
+        else if(!mpLastKeyFrame || mpLastKeyFrame->mnFrameId != mCurrentFrame.mnId)
+            EraseFrameImage(mCurrentFrame.mnId);
+    }
+
     return mCurrentFrame.GetPose();
 }
 
 
 void Tracking::GrabImuData(const IMU::Point &imuMeasurement)
 {
-    unique_lock<mutex> lock(mMutexImuQueue);
-    mlQueueImuData.push_back(imuMeasurement);
+    if(!mImuBuffer.Push(imuMeasurement))
+    {
+        // Reported at the 1st, 2nd, 4th, 8th... dropped sample
+        const size_t nDropped = mImuBuffer.Dropped();
+        if((nDropped & (nDropped-1))==0)
+            Verbose::PrintMess(to_string(nDropped) + " IMU measurements dropped so far (buffer full or out of order)", Verbose::VERBOSITY_NORMAL);
+    }
 }
 
 void Tracking::PreintegrateIMU()
@@ -1638,49 +1256,15 @@ void Tracking::PreintegrateIMU()
         return;
     }
 
-    mvImuFromLastFrame.clear();
-    mvImuFromLastFrame.reserve(mlQueueImuData.size());
-    if(mlQueueImuData.size() == 0)
+    // Samples from the previous frame up to the first one at or after the current frame
+    mImuBuffer.ExtractWindow(mCurrentFrame.mpPrevFrame->mTimeStamp-mImuPer,mCurrentFrame.mTimeStamp-mImuPer,mvImuFromLastFrame);
+    if(mvImuFromLastFrame.empty())
     {
-        Verbose::PrintMess("Not IMU data in mlQueueImuData!!", Verbose::VERBOSITY_NORMAL);
+        Verbose::PrintMess("Not IMU data in the IMU buffer!!", Verbose::VERBOSITY_NORMAL);
         mCurrentFrame.setIntegrated();
         return;
     }
 
-    while(true)
-    {
-        bool bSleep = false;
-        {
-            unique_lock<mutex> lock(mMutexImuQueue);
-            if(!mlQueueImuData.empty())
-            {
-                IMU::Point* m = &mlQueueImuData.front();
-                cout.precision(17);
-                if(m->t<mCurrentFrame.mpPrevFrame->mTimeStamp-mImuPer)
-                {
-                    mlQueueImuData.pop_front();
-                }
-                else if(m->t<mCurrentFrame.mTimeStamp-mImuPer)
-                {
-                    mvImuFromLastFrame.push_back(*m);
-                    mlQueueImuData.pop_front();
-                }
-                else
-                {
-                    mvImuFromLastFrame.push_back(*m);
-                    break;
-                }
-            }
-            else
-            {
-                break;
-                bSleep = true;
-            }
-        }
-        if(bSleep)
-            usleep(500);
-    }
-
     const int n = mvImuFromLastFrame.size()-1;
     if(n==0){
         cout << "Empty IMU measurements vector!!!\n";
@@ -1827,8 +1411,7 @@ void Tracking::Track()
         if(mLastFrame.mTimeStamp>mCurrentFrame.mTimeStamp)
         {
             cerr << "ERROR: Frame with a timestamp older than previous frame detected!" << endl;
-            unique_lock<mutex> lock(mMutexImuQueue);
-            mlQueueImuData.clear();
+            mImuBuffer.Clear();
             CreateMapInAtlas();
             return;
         }
@@ -1875,22 +1458,17 @@ void Tracking::Track()
 
     if ((mSensor == System::IMU_MONOCULAR || mSensor == System::IMU_STEREO || mSensor == System::IMU_RGBD) && !mbCreatedMap)
     {
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_StartPreIMU = std::chrono::steady_clock::now();
-#endif
+        const Instrumentation::TimePoint time_StartPreIMU = Instrumentation::Now();
         PreintegrateIMU();
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_EndPreIMU = std::chrono::steady_clock::now();
-
-        double timePreImu = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndPreIMU - time_StartPreIMU).count();
-        vdIMUInteg_ms.push_back(timePreImu);
-#endif
+        Instrumentation::RecordInterval(Instrumentation::TRACK_IMU_PREINT,time_StartPreIMU,Instrumentation::Now());
 
     }
     mbCreatedMap = false;
 
     // Get Map Mutex -> Map cannot be changed
+    const Instrumentation::TimePoint time_StartWaitMap = Instrumentation::Now();
     unique_lock<mutex> lock(pCurrentMap->mMutexMapUpdate);
+    Instrumentation::TraceWait("Wait MapUpdate",time_StartWaitMap);
 
     mbMapUpdated = false;
 
@@ -1932,9 +1510,7 @@ void Tracking::Track()
         // System is initialized. Track Frame.
         bool bOK;
 
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_StartPosePred = std::chrono::steady_clock::now();
-#endif
+        const Instrumentation::TimePoint time_StartPosePred = Instrumentation::Now();
 
         // Initial camera pose estimation using motion model or relocalization (if tracking is lost)
         if(!mbOnlyTracking)
@@ -2115,17 +1691,9 @@ void Tracking::Track()
         if(!mCurrentFrame.mpReferenceKF)
             mCurrentFrame.mpReferenceKF = mpReferenceKF;
 
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_EndPosePred = std::chrono::steady_clock::now();
-
-        double timePosePred = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndPosePred - time_StartPosePred).count();
-        vdPosePred_ms.push_back(timePosePred);
-#endif
+        const Instrumentation::TimePoint time_StartLMTrack = Instrumentation::Now();
+        Instrumentation::RecordInterval(Instrumentation::TRACK_POSE_PRED,time_StartPosePred,time_StartLMTrack);
 
-
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_StartLMTrack = std::chrono::steady_clock::now();
-#endif
         // If we have an initial estimation of the camera pose and matching. Track the local map.
         if(!mbOnlyTracking)
         {
@@ -2197,17 +1765,15 @@ void Tracking::Track()
             }
         }
 
-#ifdef REGISTER_TIMES
-        std::chrono::steady_clock::time_point time_EndLMTrack = std::chrono::steady_clock::now();
-
-        double timeLMTrack = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndLMTrack - time_StartLMTrack).count();
-        vdLMTrack_ms.push_back(timeLMTrack);
-#endif
+        Instrumentation::RecordInterval(Instrumentation::TRACK_LOCAL_MAP,time_StartLMTrack,Instrumentation::Now());
 
-        // Update drawer
-        mpFrameDrawer->Update(this);
-        if(mCurrentFrame.isSet())
-            mpMapDrawer->SetCurrentCameraPose(mCurrentFrame.GetPose());
+        // Update drawer (headless: only when a snapshot was requested)
+        if(mpFrameDrawer->NeedUpdate())
+        {
+            mpFrameDrawer->Update(this);
+            if(mCurrentFrame.isSet())
+                mpMapDrawer->SetCurrentCameraPose(mCurrentFrame.GetPose());
+        }
 
         if(bOK || mState==RECENTLY_LOST)
         {
@@ -2245,9 +1811,7 @@ void Tracking::Track()
             }
             mlpTemporalPoints.clear();
 
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_StartNewKF = std::chrono::steady_clock::now();
-#endif
+            const Instrumentation::TimePoint time_StartNewKF = Instrumentation::Now();
             bool bNeedKF = NeedNewKeyFrame();
 
             // Check if we need to insert a new keyframe
@@ -2259,13 +1823,7 @@ void Tracking::Track()
                 
 
                 
-#ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndNewKF = std::chro
-            no::steady_clock::now();
-
-            double timeNewKF = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndNewKF - time_StartNewKF).count();
-            vdNewKF_ms.push_back(timeNewKF);
-#endif
+            Instrumentation::RecordInterval(Instrumentation::TRACK_NEW_KF,time_StartNewKF,Instrumentation::Now());
 
             // We allow points with high innovation (considererd outliers by the Huber Function)
             // pass to the new keyframe, so that bundle adjustment will finally decide
@@ -2442,6 +2000,7 @@ void Tracking::StereoInitialization()
 
         mvpLocalKeyFrames.push_back(pKFini);
         mvpLocalMapPoints=mpAtlas->GetAllMapPoints();
+        mbLocalMapCacheValid=false;
         mpReferenceKF = pKFini;
         mCurrentFrame.mpReferenceKF = pKFini;
 
@@ -2643,6 +2202,7 @@ void Tracking::CreateInitialMapMonocular()
     mvpLocalKeyFrames.push_back(pKFcur);
     mvpLocalKeyFrames.push_back(pKFini);
     mvpLocalMapPoints=mpAtlas->GetAllMapPoints();
+    mbLocalMapCacheValid=false;
     mpReferenceKF = pKFcur;
     mCurrentFrame.mpReferenceKF = pKFcur;
 
@@ -2706,6 +2266,7 @@ void Tracking::CreateMapInAtlas()
     mLastFrame = Frame();
     mCurrentFrame = Frame();
     mvIniMatches.clear();
+    mbLocalMapCacheValid = false;
 
     mbCreatedMap = true;
 }
@@ -3436,11 +2997,36 @@ void Tracking::UpdateLocalMap()
 
 void Tracking::UpdateLocalPoints()
 {
-    mvpLocalMapPoints.clear();
+    vector<KeyFrame*>* pvpKFs = &mvpLocalKeyFrames;
+
+    if(mLocalMapUpdate==LOCAL_MAP_REBUILD)
+    {
+        mvpLocalMapPoints.clear();
+    }
+    else
+    {
+        // The local keyframes still hold the same points, only remove the ones culled or replaced since the last frame
+        size_t nKept = 0;
+        for(size_t i=0; i<mvpLocalMapPoints.size(); i++)
+        {
+            MapPoint* pMP = mvpLocalMapPoints[i];
+            if(pMP->isBad())
+                continue;
+            pMP->mnTrackReferenceForFrame=mCurrentFrame.mnId;
+            mvpLocalMapPoints[nKept++]=pMP;
+        }
+        mvpLocalMapPoints.resize(nKept);
+
+        if(mLocalMapUpdate==LOCAL_MAP_REUSE)
+            return;
+
+        // Only the points of the keyframes that joined the local map have to be collected
+        pvpKFs = &mvpLocalKeyFramesAdded;
+    }
 
     int count_pts = 0;
 
-    for(vector<KeyFrame*>::const_reverse_iterator itKF=mvpLocalKeyFrames.rbegin(), itEndKF=mvpLocalKeyFrames.rend(); itKF!=itEndKF; ++itKF)
+    for(vector<KeyFrame*>::const_reverse_iterator itKF=pvpKFs->rbegin(), itEndKF=pvpKFs->rend(); itKF!=itEndKF; ++itKF)
     {
         KeyFrame* pKF = *itKF;
         const vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
@@ -3517,10 +3103,9 @@ void Tracking::UpdateLocalKeyFrames()
     int max=0;
     KeyFrame* pKFmax= static_cast<KeyFrame*>(NULL);
 
-    mvpLocalKeyFrames.clear();
-    mvpLocalKeyFrames.reserve(3*keyframeCounter.size());
-
     // All keyframes that observe a map point are included in the local map. Also check which keyframe shares most points
+    vector<KeyFrame*> vpSeedKFs;
+    vpSeedKFs.reserve(keyframeCounter.size());
     for(map<KeyFrame*,int>::const_iterator it=keyframeCounter.begin(), itEnd=keyframeCounter.end(); it!=itEnd; it++)
     {
         KeyFrame* pKF = it->first;
@@ -3534,8 +3119,42 @@ void Tracking::UpdateLocalKeyFrames()
             pKFmax=pKF;
         }
 
-        mvpLocalKeyFrames.push_back(pKF);
-        pKF->mnTrackReferenceForFrame = mCurrentFrame.mnId;
+        vpSeedKFs.push_back(pKF);
+    }
+
+    if(pKFmax)
+    {
+        mpReferenceKF = pKFmax;
+        mCurrentFrame.mpReferenceKF = mpReferenceKF;
+    }
+
+    // The rest of the local map only depends on these keyframes and on the covisibility graph. If neither
+    // changed since the last frame, the previous local map is still valid
+    Map* pCurrentMap = mpAtlas->GetCurrentMap();
+    const int nLocalMapChangeIdx = pCurrentMap->GetLocalMapChangeIdx();
+    const bool bSameMap = mbLocalMapCacheValid && pCurrentMap==mpLocalMapCacheMap &&
+                          nLocalMapChangeIdx==mnLocalMapCacheChangeIdx && mCurrentFrame.mpLastKeyFrame==mpLocalMapCacheLastKF;
+
+    if(bSameMap && vpSeedKFs==mvpLocalMapCacheSeedKFs)
+    {
+        for(vector<KeyFrame*>::const_iterator itKF=mvpLocalKeyFrames.begin(), itEndKF=mvpLocalKeyFrames.end(); itKF!=itEndKF; itKF++)
+            (*itKF)->mnTrackReferenceForFrame=mCurrentFrame.mnId;
+
+        mLocalMapUpdate = LOCAL_MAP_REUSE;
+        return;
+    }
+
+    vector<KeyFrame*> vpPrevLocalKFs;
+    if(bSameMap)
+        vpPrevLocalKFs.swap(mvpLocalKeyFrames);
+
+    mvpLocalKeyFrames.clear();
+    mvpLocalKeyFrames.reserve(3*keyframeCounter.size());
+
+    for(vector<KeyFrame*>::const_iterator itKF=vpSeedKFs.begin(), itEndKF=vpSeedKFs.end(); itKF!=itEndKF; itKF++)
+    {
+        mvpLocalKeyFrames.push_back(*itKF);
+        (*itKF)->mnTrackReferenceForFrame = mCurrentFrame.mnId;
     }
 
     // Include also some not-already-included keyframes that are neighbors to already-included keyframes
@@ -3609,11 +3228,36 @@ void Tracking::UpdateLocalKeyFrames()
         }
     }
 
-    if(pKFmax)
+    mbLocalMapCacheValid = true;
+    mpLocalMapCacheMap = pCurrentMap;
+    mnLocalMapCacheChangeIdx = nLocalMapChangeIdx;
+    mpLocalMapCacheLastKF = mCurrentFrame.mpLastKeyFrame;
+    mvpLocalMapCacheSeedKFs.swap(vpSeedKFs);
+
+    if(!bSameMap)
     {
-        mpReferenceKF = pKFmax;
-        mCurrentFrame.mpReferenceKF = mpReferenceKF;
+        mLocalMapUpdate = LOCAL_MAP_REBUILD;
+        return;
     }
+
+    // Same map, only the seed keyframes moved. The points of the kept keyframes are still valid,
+    // it is enough to add the points of the new ones unless some keyframe left the local map
+    vector<KeyFrame*> vpCurrLocalKFs = mvpLocalKeyFrames;
+    sort(vpCurrLocalKFs.begin(),vpCurrLocalKFs.end());
+    sort(vpPrevLocalKFs.begin(),vpPrevLocalKFs.end());
+
+    vector<KeyFrame*> vpRemovedKFs;
+    set_difference(vpPrevLocalKFs.begin(),vpPrevLocalKFs.end(),vpCurrLocalKFs.begin(),vpCurrLocalKFs.end(),back_inserter(vpRemovedKFs));
+
+    mvpLocalKeyFramesAdded.clear();
+    set_difference(vpCurrLocalKFs.begin(),vpCurrLocalKFs.end(),vpPrevLocalKFs.begin(),vpPrevLocalKFs.end(),back_inserter(mvpLocalKeyFramesAdded));
+
+    if(!vpRemovedKFs.empty())
+        mLocalMapUpdate = LOCAL_MAP_REBUILD;
+    else if(!mvpLocalKeyFramesAdded.empty())
+        mLocalMapUpdate = LOCAL_MAP_EXTEND;
+    else
+        mLocalMapUpdate = LOCAL_MAP_REUSE;
 }
 
 bool Tracking::Relocalization()
@@ -3633,157 +3277,218 @@ bool Tracking::Relocalization()
 
     const int nKFs = vpCandidateKFs.size();
 
-    // We perform first an ORB matching with each candidate
-    // If enough matches are found we setup a PnP solver
-    ORBmatcher matcher(0.75,true);
-
-    vector<MLPnPsolver*> vpMLPnPsolvers;
-    vpMLPnPsolvers.resize(nKFs);
-
-    vector<vector<MapPoint*> > vvpMapPointMatches;
-    vvpMapPointMatches.resize(nKFs);
-
-    vector<bool> vbDiscarded;
-    vbDiscarded.resize(nKFs);
-
-    int nCandidates=0;
+    // Candidates are processed concurrently. Each worker takes the next candidate and solves the pose
+    // on its own copy of the current frame. The first worker that finds a pose supported by enough
+    // inliers publishes its frame and the rest stop at their next RANSAC round.
+    atomic<int> nNextCandidate(0);
+    atomic<bool> bMatch(false);
+    Frame* pRelocFrame = static_cast<Frame*>(NULL);
 
-    for(int i=0; i<nKFs; i++)
+    auto worker = [&]()
     {
-        KeyFrame* pKF = vpCandidateKFs[i];
-        if(pKF->isBad())
-            vbDiscarded[i] = true;
-        else
+        while(!bMatch)
         {
-            int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
-            if(nmatches<15)
-            {
-                vbDiscarded[i] = true;
+            const int i = nNextCandidate++;
+            if(i>=nKFs)
+                break;
+
+            Frame* pFrame = RelocalizeFromCandidate(vpCandidateKFs[i], bMatch);
+            if(!pFrame)
                 continue;
-            }
+
+            bool bExpected = false;
+            if(bMatch.compare_exchange_strong(bExpected, true))
+                pRelocFrame = pFrame;
             else
-            {
-                MLPnPsolver* pSolver = new MLPnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
-                pSolver->SetRansacParameters(0.99,10,300,6,0.5,5.991);  //This solver needs at least 6 points
-                vpMLPnPsolvers[i] = pSolver;
-                nCandidates++;
-            }
+                delete pFrame;
         }
+    };
+
+    RunRelocalizationTask(worker);
+
+    if(!pRelocFrame)
+    {
+        return false;
+    }
+    else
+    {
+        mCurrentFrame.SetPose(pRelocFrame->GetPose());
+        mCurrentFrame.mvpMapPoints = pRelocFrame->mvpMapPoints;
+        mCurrentFrame.mvbOutlier = pRelocFrame->mvbOutlier;
+        delete pRelocFrame;
+
+        mnLastRelocFrameId = mCurrentFrame.mnId;
+        cout << "Relocalized!!" << endl;
+        return true;
     }
 
-    // Alternatively perform some iterations of P4P RANSAC
-    // Until we found a camera pose supported by enough inliers
-    bool bMatch = false;
+}
+
+Frame* Tracking::RelocalizeFromCandidate(KeyFrame* pKF, const atomic<bool> &bStop)
+{
+    if(pKF->isBad())
+        return static_cast<Frame*>(NULL);
+
+    // We perform first an ORB matching with the candidate
+    // If enough matches are found we setup a PnP solver
+    ORBmatcher matcher(0.75,true);
+    vector<MapPoint*> vpMapPointMatches;
+    int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vpMapPointMatches);
+    if(nmatches<15)
+        return static_cast<Frame*>(NULL);
+
+    // Seeded by the candidate, so that the hypotheses do not depend on the scheduling of the workers
+    MLPnPsolver solver(mCurrentFrame,vpMapPointMatches);
+    solver.SetSeed(pKF->mnId);
+    solver.SetRansacParameters(0.99,10,300,6,0.5,5.991);  //This solver needs at least 6 points
+
+    // The current frame is shared by all workers, the pose is optimized in a private copy
+    Frame* pFrame = new Frame(mCurrentFrame);
     ORBmatcher matcher2(0.9,true);
 
-    while(nCandidates>0 && !bMatch)
+    // Perform P4P RANSAC in rounds of 5 iterations
+    // Until we found a camera pose supported by enough inliers or another candidate succeeded
+    bool bNoMore = false;
+    while(!bNoMore && !bStop)
     {
-        for(int i=0; i<nKFs; i++)
-        {
-            if(vbDiscarded[i])
-                continue;
+        vector<bool> vbInliers;
+        int nInliers;
+        Eigen::Matrix4f eigTcw;
+        bool bTcw = solver.iterate(5,bNoMore,vbInliers,nInliers, eigTcw);
 
-            // Perform 5 Ransac Iterations
-            vector<bool> vbInliers;
-            int nInliers;
-            bool bNoMore;
+        // If a Camera Pose is computed, optimize
+        if(!bTcw)
+            continue;
 
-            MLPnPsolver* pSolver = vpMLPnPsolvers[i];
-            Eigen::Matrix4f eigTcw;
-            bool bTcw = pSolver->iterate(5,bNoMore,vbInliers,nInliers, eigTcw);
+        Sophus::SE3f Tcw(eigTcw);
+        pFrame->SetPose(Tcw);
 
-            // If Ransac reachs max. iterations discard keyframe
-            if(bNoMore)
+        set<MapPoint*> sFound;
+
+        const int np = vbInliers.size();
+
+        for(int j=0; j<np; j++)
+        {
+            if(vbInliers[j])
             {
-                vbDiscarded[i]=true;
-                nCandidates--;
+                pFrame->mvpMapPoints[j]=vpMapPointMatches[j];
+                sFound.insert(vpMapPointMatches[j]);
             }
+            else
+                pFrame->mvpMapPoints[j]=NULL;
+        }
 
-            // If a Camera Pose is computed, optimize
-            if(bTcw)
-            {
-                Sophus::SE3f Tcw(eigTcw);
-                mCurrentFrame.SetPose(Tcw);
-                // Tcw.copyTo(mCurrentFrame.mTcw);
+        int nGood = Optimizer::PoseOptimization(pFrame);
+
+        if(nGood<10)
+            continue;
 
-                set<MapPoint*> sFound;
+        for(int io =0; io<pFrame->N; io++)
+            if(pFrame->mvbOutlier[io])
+                pFrame->mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
 
-                const int np = vbInliers.size();
+        // If few inliers, search by projection in a coarse window and optimize again
+        if(nGood<50)
+        {
+            int nadditional =matcher2.SearchByProjection(*pFrame,pKF,sFound,10,100);
+
+            if(nadditional+nGood>=50)
+            {
+                nGood = Optimizer::PoseOptimization(pFrame);
 
-                for(int j=0; j<np; j++)
+                // If many inliers but still not enough, search by projection again in a narrower window
+                // the camera has been already optimized with many points
+                if(nGood>30 && nGood<50)
                 {
-                    if(vbInliers[j])
+                    sFound.clear();
+                    for(int ip =0; ip<pFrame->N; ip++)
+                        if(pFrame->mvpMapPoints[ip])
+                            sFound.insert(pFrame->mvpMapPoints[ip]);
+                    nadditional =matcher2.SearchByProjection(*pFrame,pKF,sFound,3,64);
+
+                    // Final optimization
+                    if(nGood+nadditional>=50)
                     {
-                        mCurrentFrame.mvpMapPoints[j]=vvpMapPointMatches[i][j];
-                        sFound.insert(vvpMapPointMatches[i][j]);
+                        nGood = Optimizer::PoseOptimization(pFrame);
+
+                        for(int io =0; io<pFrame->N; io++)
+                            if(pFrame->mvbOutlier[io])
+                                pFrame->mvpMapPoints[io]=NULL;
                     }
-                    else
-                        mCurrentFrame.mvpMapPoints[j]=NULL;
                 }
+            }
+        }
 
-                int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+        // If the pose is supported by enough inliers stop ransacs and continue
+        if(nGood>=50)
+            return pFrame;
+    }
 
-                if(nGood<10)
-                    continue;
+    delete pFrame;
+    return static_cast<Frame*>(NULL);
+}
 
-                for(int io =0; io<mCurrentFrame.N; io++)
-                    if(mCurrentFrame.mvbOutlier[io])
-                        mCurrentFrame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+void Tracking::RunRelocalizationTask(const std::function<void()> &task)
+{
+    unique_lock<mutex> lock(mMutexReloc);
 
-                // If few inliers, search by projection in a coarse window and optimize again
-                if(nGood<50)
-                {
-                    int nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,10,100);
+    // Workers loop over the tasks posted here, each one runs every task once
+    while(static_cast<int>(mvRelocWorkers.size())<mnRelocThreads-1)
+    {
+        const unsigned long nStart = mnRelocTask;
+        mvRelocWorkers.emplace_back([this, nStart]()
+        {
+            unique_lock<mutex> lockWorker(mMutexReloc);
+            unsigned long nDone = nStart;
+            while(true)
+            {
+                mCondRelocTask.wait(lockWorker, [&]() { return mbRelocStop || mnRelocTask!=nDone; });
+                if(mbRelocStop)
+                    return;
 
-                    if(nadditional+nGood>=50)
-                    {
-                        nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+                nDone = mnRelocTask;
+                const std::function<void()> currentTask = mRelocTask;
+                lockWorker.unlock();
+                currentTask();
+                lockWorker.lock();
 
-                        // If many inliers but still not enough, search by projection again in a narrower window
-                        // the camera has been already optimized with many points
-                        if(nGood>30 && nGood<50)
-                        {
-                            sFound.clear();
-                            for(int ip =0; ip<mCurrentFrame.N; ip++)
-                                if(mCurrentFrame.mvpMapPoints[ip])
-                                    sFound.insert(mCurrentFrame.mvpMapPoints[ip]);
-                            nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,3,64);
-
-                            // Final optimization
-                            if(nGood+nadditional>=50)
-                            {
-                                nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+                if(--mnRelocRunning==0)
+                    mCondRelocDone.notify_all();
+            }
+        });
+    }
 
-                                for(int io =0; io<mCurrentFrame.N; io++)
-                                    if(mCurrentFrame.mvbOutlier[io])
-                                        mCurrentFrame.mvpMapPoints[io]=NULL;
-                            }
-                        }
-                    }
-                }
+    mRelocTask = task;
+    mnRelocRunning = mvRelocWorkers.size();
+    mnRelocTask++;
+    lock.unlock();
+    mCondRelocTask.notify_all();
 
+    task();
 
-                // If the pose is supported by enough inliers stop ransacs and continue
-                if(nGood>=50)
-                {
-                    bMatch = true;
-                    break;
-                }
-            }
-        }
-    }
+    lock.lock();
+    mCondRelocDone.wait(lock, [&]() { return mnRelocRunning==0; });
+    mRelocTask = nullptr;
+}
 
-    if(!bMatch)
+void Tracking::StopRelocalizationWorkers()
+{
     {
-        return false;
-    }
-    else
-    {
-        mnLastRelocFrameId = mCurrentFrame.mnId;
-        cout << "Relocalized!!" << endl;
-        return true;
+        unique_lock<mutex> lock(mMutexReloc);
+        mbRelocStop = true;
     }
+    mCondRelocTask.notify_all();
+    for(thread &th : mvRelocWorkers)
+        th.join();
+    mvRelocWorkers.clear();
+    mbRelocStop = false;
+}
 
+void Tracking::SetRelocalizationThreads(const int nThreads)
+{
+    // The workers are started again with the new number at the next relocalization
+    StopRelocalizationWorkers();
+    mnRelocThreads = max(1, nThreads);
 }
 
 void Tracking::Reset(bool bLocMap)
@@ -3840,6 +3545,7 @@ void Tracking::Reset(bool bLocMap)
     mpReferenceKF = static_cast<KeyFrame*>(NULL);
     mpLastKeyFrame = static_cast<KeyFrame*>(NULL);
     mvIniMatches.clear();
+    mbLocalMapCacheValid = false;
 
     if(mpViewer)
         mpViewer->Release();
@@ -3929,6 +3635,7 @@ void Tracking::ResetActiveMap(bool bLocMap)
     mpReferenceKF = static_cast<KeyFrame*>(NULL);
     mpLastKeyFrame = static_cast<KeyFrame*>(NULL);
     mvIniMatches.clear();
+    mbLocalMapCacheValid = false;
 
     mbVelocity = false;
 
@@ -3938,6 +3645,34 @@ void Tracking::ResetActiveMap(bool bLocMap)
     Verbose::PrintMess("   End reseting! ", Verbose::VERBOSITY_NORMAL);
 }
 
+cv::Mat Tracking::GetFrameImage(const long unsigned int frameId)
+{
+    unique_lock<mutex> lock(mMutexBGRMap);
+    unordered_map<int, cv::Mat>::const_iterator it = mnIdToBGRMap.find(frameId);
+    if(it == mnIdToBGRMap.end())
+        return cv::Mat();
+    return it->second;
+}
+
+void Tracking::EraseFrameImage(const long unsigned int frameId)
+{
+    unique_lock<mutex> lock(mMutexBGRMap);
+    mnIdToBGRMap.erase(frameId);
+}
+
+void Tracking::AddMemoryUsage(MemoryUsage &usage)
+{
+    unique_lock<mutex> lock(mMutexBGRMap);
+    for(const pair<const int, cv::Mat> &image : mnIdToBGRMap)
+        usage.images += image.second.total()*image.second.elemSize();
+    usage.nImages += mnIdToBGRMap.size();
+}
+
+void Tracking::SetMemoryPolicy(const MemoryPolicy &policy)
+{
+    mbKeyFrameImagesOnly = policy.bKeyFrameImagesOnly;
+}
+
 vector<MapPoint*> Tracking::GetLocalMapMPS()
 {
     return mvpLocalMapPoints;
@@ -20,10 +20,12 @@
 
 #include "Converter.h"
 #include "GeometricTools.h"
+#include "Ransac.h"
 
 #include "Thirdparty/DBoW2/DUtils/Random.h"
 
 #include<thread>
+#include<algorithm>
 
 
 using namespace std;
@@ -36,6 +38,8 @@ namespace ORB_SLAM3
         mSigma = sigma;
         mSigma2 = sigma*sigma;
         mMaxIterations = iterations;
+
+        mnThreads = max(1,static_cast<int>(thread::hardware_concurrency()/2));
     }
 
     bool TwoViewReconstruction::Reconstruct(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const vector<int> &vMatches12,
@@ -65,6 +69,20 @@ namespace ORB_SLAM3
 
         const int N = mvMatches12.size();
 
+        mvMatchedU1.resize(N);
+        mvMatchedV1.resize(N);
+        mvMatchedU2.resize(N);
+        mvMatchedV2.resize(N);
+        for(int i=0; i<N; i++)
+        {
+            const cv::Point2f &pt1 = mvKeys1[mvMatches12[i].first].pt;
+            const cv::Point2f &pt2 = mvKeys2[mvMatches12[i].second].pt;
+            mvMatchedU1[i] = pt1.x;
+            mvMatchedV1[i] = pt1.y;
+            mvMatchedU2[i] = pt2.x;
+            mvMatchedV2[i] = pt2.y;
+        }
+
         // Indices for minimum set selection
         vector<size_t> vAllIndices;
         vAllIndices.reserve(N);
@@ -144,15 +162,72 @@ namespace ORB_SLAM3
         score = 0.0;
         vbMatchesInliers = vector<bool>(N,false);
 
+        // Perform the RANSAC iterations in batches split among the available threads.
+        // The number of iterations is adapted to the inlier ratio of the best hypothesis found so far
+        vector<Eigen::Matrix3f> vH21(mMaxIterations);
+        vector<float> vScores(mMaxIterations,0.f);
+        vector<int> vnInliers(mMaxIterations,0);
+
+        const int nBatch = mnThreads*8;
+        int nEvaluated = 0;
+        int nRequired = mMaxIterations;
+        int nMaxInliers = 0;
+        while(nEvaluated<nRequired)
+        {
+            const int nBatchEnd = min(nRequired,nEvaluated+nBatch);
+            const int nThreads = min(mnThreads,nBatchEnd-nEvaluated);
+            const int nItPerThread = (nBatchEnd-nEvaluated+nThreads-1)/nThreads;
+            vector<thread> vThreads;
+            for(int t=1; t<nThreads; t++)
+            {
+                const int itBegin = min(nBatchEnd,nEvaluated+t*nItPerThread);
+                const int itEnd = min(nBatchEnd,itBegin+nItPerThread);
+                vThreads.push_back(thread(&TwoViewReconstruction::EvaluateHomographies,this,itBegin,itEnd,cref(vPn1),cref(vPn2),cref(T1),cref(T2inv),ref(vH21),ref(vScores),ref(vnInliers)));
+            }
+            EvaluateHomographies(nEvaluated,min(nBatchEnd,nEvaluated+nItPerThread),vPn1,vPn2,T1,T2inv,vH21,vScores,vnInliers);
+            for(size_t t=0; t<vThreads.size(); t++)
+                vThreads[t].join();
+
+            for(int it=nEvaluated; it<nBatchEnd; it++)
+                nMaxInliers = max(nMaxInliers,vnInliers[it]);
+            nEvaluated = nBatchEnd;
+
+            if(N>0)
+                nRequired = RansacIterations(0.99,static_cast<float>(nMaxInliers)/N,8,mMaxIterations);
+        }
+
+        // Save the solution with highest score (the first one in case of tie, as in a serial run)
+        int bestIt = -1;
+        for(int it=0; it<nEvaluated; it++)
+        {
+            if(vScores[it]>score)
+            {
+                score = vScores[it];
+                bestIt = it;
+            }
+        }
+
+        if(bestIt<0)
+            return;
+
+        H21 = vH21[bestIt];
+        vector<unsigned char> vbBestInliers(N,0);
+        CheckHomography(H21, H21.inverse(), vbBestInliers, mSigma);
+        for(int i=0; i<N; i++)
+            vbMatchesInliers[i] = vbBestInliers[i];
+    }
+
+    void TwoViewReconstruction::EvaluateHomographies(const int itBegin, const int itEnd, const vector<cv::Point2f> &vPn1, const vector<cv::Point2f> &vPn2,
+                                                     const Eigen::Matrix3f &T1, const Eigen::Matrix3f &T2inv, vector<Eigen::Matrix3f> &vH21, vector<float> &vScores,
+                                                     vector<int> &vnInliers)
+    {
         // Iteration variables
         vector<cv::Point2f> vPn1i(8);
         vector<cv::Point2f> vPn2i(8);
         Eigen::Matrix3f H21i, H12i;
-        vector<bool> vbCurrentInliers(N,false);
-        float currentScore;
+        vector<unsigned char> vbCurrentInliers(mvMatches12.size(),0);
 
-        // Perform all RANSAC iterations and save the solution with highest score
-        for(int it=0; it<mMaxIterations; it++)
+        for(int it=itBegin; it<itEnd; it++)
         {
             // Select a minimum set
             for(size_t j=0; j<8; j++)
@@ -167,14 +242,9 @@ namespace ORB_SLAM3
             H21i = T2inv * Hn * T1;
             H12i = H21i.inverse();
 
-            currentScore = CheckHomography(H21i, H12i, vbCurrentInliers, mSigma);
-
-            if(currentScore>score)
-            {
-                H21 = H21i;
-                vbMatchesInliers = vbCurrentInliers;
-                score = currentScore;
-            }
+            vH21[it] = H21i;
+            vScores[it] = CheckHomography(H21i, H12i, vbCurrentInliers, mSigma);
+            vnInliers[it] = count(vbCurrentInliers.begin(),vbCurrentInliers.end(),1);
         }
     }
 
@@ -182,7 +252,7 @@ namespace ORB_SLAM3
     void TwoViewReconstruction::FindFundamental(vector<bool> &vbMatchesInliers, float &score, Eigen::Matrix3f &F21)
     {
         // Number of putative matches
-        const int N = vbMatchesInliers.size();
+        const int N = mvMatches12.size();
 
         // Normalize coordinates
         vector<cv::Point2f> vPn1, vPn2;
@@ -195,15 +265,72 @@ namespace ORB_SLAM3
         score = 0.0;
         vbMatchesInliers = vector<bool>(N,false);
 
+        // Perform the RANSAC iterations in batches split among the available threads.
+        // The number of iterations is adapted to the inlier ratio of the best hypothesis found so far
+        vector<Eigen::Matrix3f> vF21(mMaxIterations);
+        vector<float> vScores(mMaxIterations,0.f);
+        vector<int> vnInliers(mMaxIterations,0);
+
+        const int nBatch = mnThreads*8;
+        int nEvaluated = 0;
+        int nRequired = mMaxIterations;
+        int nMaxInliers = 0;
+        while(nEvaluated<nRequired)
+        {
+            const int nBatchEnd = min(nRequired,nEvaluated+nBatch);
+            const int nThreads = min(mnThreads,nBatchEnd-nEvaluated);
+            const int nItPerThread = (nBatchEnd-nEvaluated+nThreads-1)/nThreads;
+            vector<thread> vThreads;
+            for(int t=1; t<nThreads; t++)
+            {
+                const int itBegin = min(nBatchEnd,nEvaluated+t*nItPerThread);
+                const int itEnd = min(nBatchEnd,itBegin+nItPerThread);
+                vThreads.push_back(thread(&TwoViewReconstruction::EvaluateFundamentals,this,itBegin,itEnd,cref(vPn1),cref(vPn2),cref(T1),cref(T2t),ref(vF21),ref(vScores),ref(vnInliers)));
+            }
+            EvaluateFundamentals(nEvaluated,min(nBatchEnd,nEvaluated+nItPerThread),vPn1,vPn2,T1,T2t,vF21,vScores,vnInliers);
+            for(size_t t=0; t<vThreads.size(); t++)
+                vThreads[t].join();
+
+            for(int it=nEvaluated; it<nBatchEnd; it++)
+                nMaxInliers = max(nMaxInliers,vnInliers[it]);
+            nEvaluated = nBatchEnd;
+
+            if(N>0)
+                nRequired = RansacIterations(0.99,static_cast<float>(nMaxInliers)/N,8,mMaxIterations);
+        }
+
+        // Save the solution with highest score (the first one in case of tie, as in a serial run)
+        int bestIt = -1;
+        for(int it=0; it<nEvaluated; it++)
+        {
+            if(vScores[it]>score)
+            {
+                score = vScores[it];
+                bestIt = it;
+            }
+        }
+
+        if(bestIt<0)
+            return;
+
+        F21 = vF21[bestIt];
+        vector<unsigned char> vbBestInliers(N,0);
+        CheckFundamental(F21, vbBestInliers, mSigma);
+        for(int i=0; i<N; i++)
+            vbMatchesInliers[i] = vbBestInliers[i];
+    }
+
+    void TwoViewReconstruction::EvaluateFundamentals(const int itBegin, const int itEnd, const vector<cv::Point2f> &vPn1, const vector<cv::Point2f> &vPn2,
+                                                     const Eigen::Matrix3f &T1, const Eigen::Matrix3f &T2t, vector<Eigen::Matrix3f> &vF21, vector<float> &vScores,
+                                                     vector<int> &vnInliers)
+    {
         // Iteration variables
         vector<cv::Point2f> vPn1i(8);
         vector<cv::Point2f> vPn2i(8);
         Eigen::Matrix3f F21i;
-        vector<bool> vbCurrentInliers(N,false);
-        float currentScore;
+        vector<unsigned char> vbCurrentInliers(mvMatches12.size(),0);
 
-        // Perform all RANSAC iterations and save the solution with highest score
-        for(int it=0; it<mMaxIterations; it++)
+        for(int it=itBegin; it<itEnd; it++)
         {
             // Select a minimum set
             for(int j=0; j<8; j++)
@@ -218,14 +345,9 @@ namespace ORB_SLAM3
 
             F21i = T2t * Fn * T1;
 
-            currentScore = CheckFundamental(F21i, vbCurrentInliers, mSigma);
-
-            if(currentScore>score)
-            {
-                F21 = F21i;
-                vbMatchesInliers = vbCurrentInliers;
-                score = currentScore;
-            }
+            vF21[it] = F21i;
+            vScores[it] = CheckFundamental(F21i, vbCurrentInliers, mSigma);
+            vnInliers[it] = count(vbCurrentInliers.begin(),vbCurrentInliers.end(),1);
         }
     }
 
@@ -307,7 +429,7 @@ namespace ORB_SLAM3
         return svd2.matrixU() * Eigen::DiagonalMatrix<float,3>(w) * svd2.matrixV().transpose();
     }
 
-    float TwoViewReconstruction::CheckHomography(const Eigen::Matrix3f &H21, const Eigen::Matrix3f &H12, vector<bool> &vbMatchesInliers, float sigma)
+    float TwoViewReconstruction::CheckHomography(const Eigen::Matrix3f &H21, const Eigen::Matrix3f &H12, vector<unsigned char> &vbMatchesInliers, float sigma)
     {
         const int N = mvMatches12.size();
 
@@ -333,66 +455,85 @@ namespace ORB_SLAM3
 
         vbMatchesInliers.resize(N);
 
-        float score = 0;
-
         const float th = 5.991;
 
         const float invSigmaSquare = 1.0/(sigma*sigma);
 
-        for(int i=0; i<N; i++)
-        {
-            bool bIn = true;
+        const float* pU1 = mvMatchedU1.data();
+        const float* pV1 = mvMatchedV1.data();
+        const float* pU2 = mvMatchedU2.data();
+        const float* pV2 = mvMatchedV2.data();
+        unsigned char* pbIn = vbMatchesInliers.data();
+
+        // One partial score per lane, the lanes are independent and branch free
+        const int L = 8;
+        float vLaneScore[L] = {0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f};
 
-            const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
-            const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
+        const int Nblock = N - N%L;
+        for(int i0=0; i0<Nblock; i0+=L)
+        {
+            for(int l=0; l<L; l++)
+            {
+                const int i = i0+l;
+                const float u1 = pU1[i];
+                const float v1 = pV1[i];
+                const float u2 = pU2[i];
+                const float v2 = pV2[i];
+
+                // Reprojection error in first image
+                // x2in1 = H12*x2
+                const float w2in1inv = 1.f/(h31inv*u2+h32inv*v2+h33inv);
+                const float u2in1 = (h11inv*u2+h12inv*v2+h13inv)*w2in1inv;
+                const float v2in1 = (h21inv*u2+h22inv*v2+h23inv)*w2in1inv;
+                const float chiSquare1 = ((u1-u2in1)*(u1-u2in1)+(v1-v2in1)*(v1-v2in1))*invSigmaSquare;
+
+                // Reprojection error in second image
+                // x1in2 = H21*x1
+                const float w1in2inv = 1.f/(h31*u1+h32*v1+h33);
+                const float u1in2 = (h11*u1+h12*v1+h13)*w1in2inv;
+                const float v1in2 = (h21*u1+h22*v1+h23)*w1in2inv;
+                const float chiSquare2 = ((u2-u1in2)*(u2-u1in2)+(v2-v1in2)*(v2-v1in2))*invSigmaSquare;
+
+                const bool bIn1 = chiSquare1<=th;
+                const bool bIn2 = chiSquare2<=th;
+
+                vLaneScore[l] += (bIn1 ? th - chiSquare1 : 0.f) + (bIn2 ? th - chiSquare2 : 0.f);
+                pbIn[i] = bIn1 & bIn2;
+            }
+        }
 
-            const float u1 = kp1.pt.x;
-            const float v1 = kp1.pt.y;
-            const float u2 = kp2.pt.x;
-            const float v2 = kp2.pt.y;
+        float score = 0;
+        for(int l=0; l<L; l++)
+            score += vLaneScore[l];
 
-            // Reprojection error in first image
-            // x2in1 = H12*x2
+        for(int i=Nblock; i<N; i++)
+        {
+            const float u1 = pU1[i];
+            const float v1 = pV1[i];
+            const float u2 = pU2[i];
+            const float v2 = pV2[i];
 
-            const float w2in1inv = 1.0/(h31inv*u2+h32inv*v2+h33inv);
+            const float w2in1inv = 1.f/(h31inv*u2+h32inv*v2+h33inv);
             const float u2in1 = (h11inv*u2+h12inv*v2+h13inv)*w2in1inv;
             const float v2in1 = (h21inv*u2+h22inv*v2+h23inv)*w2in1inv;
+            const float chiSquare1 = ((u1-u2in1)*(u1-u2in1)+(v1-v2in1)*(v1-v2in1))*invSigmaSquare;
 
-            const float squareDist1 = (u1-u2in1)*(u1-u2in1)+(v1-v2in1)*(v1-v2in1);
-
-            const float chiSquare1 = squareDist1*invSigmaSquare;
-
-            if(chiSquare1>th)
-                bIn = false;
-            else
-                score += th - chiSquare1;
-
-            // Reprojection error in second image
-            // x1in2 = H21*x1
-
-            const float w1in2inv = 1.0/(h31*u1+h32*v1+h33);
+            const float w1in2inv = 1.f/(h31*u1+h32*v1+h33);
             const float u1in2 = (h11*u1+h12*v1+h13)*w1in2inv;
             const float v1in2 = (h21*u1+h22*v1+h23)*w1in2inv;
+            const float chiSquare2 = ((u2-u1in2)*(u2-u1in2)+(v2-v1in2)*(v2-v1in2))*invSigmaSquare;
 
-            const float squareDist2 = (u2-u1in2)*(u2-u1in2)+(v2-v1in2)*(v2-v1in2);
-
-            const float chiSquare2 = squareDist2*invSigmaSquare;
+            const bool bIn1 = chiSquare1<=th;
+            const bool bIn2 = chiSquare2<=th;
 
-            if(chiSquare2>th)
-                bIn = false;
-            else
-                score += th - chiSquare2;
-
-            if(bIn)
-                vbMatchesInliers[i]=true;
-            else
-                vbMatchesInliers[i]=false;
+            score += (bIn1 ? th - chiSquare1 : 0.f) + (bIn2 ? th - chiSquare2 : 0.f);
+            pbIn[i] = bIn1 & bIn2;
         }
 
         return score;
     }
 
-    float TwoViewReconstruction::CheckFundamental(const Eigen::Matrix3f &F21, vector<bool> &vbMatchesInliers, float sigma)
+    float TwoViewReconstruction::CheckFundamental(const Eigen::Matrix3f &F21, vector<unsigned char> &vbMatchesInliers, float sigma)
     {
         const int N = mvMatches12.size();
 
@@ -408,65 +549,84 @@ namespace ORB_SLAM3
 
         vbMatchesInliers.resize(N);
 
-        float score = 0;
-
         const float th = 3.841;
         const float thScore = 5.991;
 
         const float invSigmaSquare = 1.0/(sigma*sigma);
 
-        for(int i=0; i<N; i++)
-        {
-            bool bIn = true;
+        const float* pU1 = mvMatchedU1.data();
+        const float* pV1 = mvMatchedV1.data();
+        const float* pU2 = mvMatchedU2.data();
+        const float* pV2 = mvMatchedV2.data();
+        unsigned char* pbIn = vbMatchesInliers.data();
+
+        // One partial score per lane, the lanes are independent and branch free
+        const int L = 8;
+        float vLaneScore[L] = {0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f};
 
-            const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
-            const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
+        const int Nblock = N - N%L;
+        for(int i0=0; i0<Nblock; i0+=L)
+        {
+            for(int l=0; l<L; l++)
+            {
+                const int i = i0+l;
+                const float u1 = pU1[i];
+                const float v1 = pV1[i];
+                const float u2 = pU2[i];
+                const float v2 = pV2[i];
+
+                // Reprojection error in second image
+                // l2=F21x1=(a2,b2,c2)
+                const float a2 = f11*u1+f12*v1+f13;
+                const float b2 = f21*u1+f22*v1+f23;
+                const float c2 = f31*u1+f32*v1+f33;
+                const float num2 = a2*u2+b2*v2+c2;
+                const float chiSquare1 = num2*num2/(a2*a2+b2*b2)*invSigmaSquare;
+
+                // Reprojection error in second image
+                // l1 =x2tF21=(a1,b1,c1)
+                const float a1 = f11*u2+f21*v2+f31;
+                const float b1 = f12*u2+f22*v2+f32;
+                const float c1 = f13*u2+f23*v2+f33;
+                const float num1 = a1*u1+b1*v1+c1;
+                const float chiSquare2 = num1*num1/(a1*a1+b1*b1)*invSigmaSquare;
+
+                const bool bIn1 = chiSquare1<=th;
+                const bool bIn2 = chiSquare2<=th;
+
+                vLaneScore[l] += (bIn1 ? thScore - chiSquare1 : 0.f) + (bIn2 ? thScore - chiSquare2 : 0.f);
+                pbIn[i] = bIn1 & bIn2;
+            }
+        }
 
-            const float u1 = kp1.pt.x;
-            const float v1 = kp1.pt.y;
-            const float u2 = kp2.pt.x;
-            const float v2 = kp2.pt.y;
+        float score = 0;
+        for(int l=0; l<L; l++)
+            score += vLaneScore[l];
 
-            // Reprojection error in second image
-            // l2=F21x1=(a2,b2,c2)
+        for(int i=Nblock; i<N; i++)
+        {
+            const float u1 = pU1[i];
+            const float v1 = pV1[i];
+            const float u2 = pU2[i];
+            const float v2 = pV2[i];
 
             const float a2 = f11*u1+f12*v1+f13;
             const float b2 = f21*u1+f22*v1+f23;
             const float c2 = f31*u1+f32*v1+f33;
-
             const float num2 = a2*u2+b2*v2+c2;
-
-            const float squareDist1 = num2*num2/(a2*a2+b2*b2);
-
-            const float chiSquare1 = squareDist1*invSigmaSquare;
-
-            if(chiSquare1>th)
-                bIn = false;
-            else
-                score += thScore - chiSquare1;
-
-            // Reprojection error in second image
-            // l1 =x2tF21=(a1,b1,c1)
+            const float chiSquare1 = num2*num2/(a2*a2+b2*b2)*invSigmaSquare;
 
             const float a1 = f11*u2+f21*v2+f31;
             const float b1 = f12*u2+f22*v2+f32;
             const float c1 = f13*u2+f23*v2+f33;
-
             const float num1 = a1*u1+b1*v1+c1;
+            const float chiSquare2 = num1*num1/(a1*a1+b1*b1)*invSigmaSquare;
 
-            const float squareDist2 = num1*num1/(a1*a1+b1*b1);
-
-            const float chiSquare2 = squareDist2*invSigmaSquare;
-
-            if(chiSquare2>th)
-                bIn = false;
-            else
-                score += thScore - chiSquare2;
+            const bool bIn1 = chiSquare1<=th;
+            const bool bIn2 = chiSquare2<=th;
 
-            if(bIn)
-                vbMatchesInliers[i]=true;
-            else
-                vbMatchesInliers[i]=false;
+            score += (bIn1 ? thScore - chiSquare1 : 0.f) + (bIn2 ? thScore - chiSquare2 : 0.f);
+            pbIn[i] = bIn1 & bIn2;
         }
 
         return score;
@@ -497,10 +657,16 @@ namespace ORB_SLAM3
         vector<bool> vbTriangulated1,vbTriangulated2,vbTriangulated3, vbTriangulated4;
         float parallax1,parallax2, parallax3, parallax4;
 
-        int nGood1 = CheckRT(R1,t1,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D1, 4.0*mSigma2, vbTriangulated1, parallax1);
-        int nGood2 = CheckRT(R2,t1,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D2, 4.0*mSigma2, vbTriangulated2, parallax2);
-        int nGood3 = CheckRT(R1,t2,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D3, 4.0*mSigma2, vbTriangulated3, parallax3);
-        int nGood4 = CheckRT(R2,t2,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D4, 4.0*mSigma2, vbTriangulated4, parallax4);
+        int nGood1, nGood2, nGood3, nGood4;
+
+        // The hypotheses are independent, triangulate them in parallel
+        thread thread2([&](){ nGood2 = CheckRT(R2,t1,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D2, 4.0*mSigma2, vbTriangulated2, parallax2); });
+        thread thread3([&](){ nGood3 = CheckRT(R1,t2,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D3, 4.0*mSigma2, vbTriangulated3, parallax3); });
+        thread thread4([&](){ nGood4 = CheckRT(R2,t2,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D4, 4.0*mSigma2, vbTriangulated4, parallax4); });
+        nGood1 = CheckRT(R1,t1,mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K, vP3D1, 4.0*mSigma2, vbTriangulated1, parallax1);
+        thread2.join();
+        thread3.join();
+        thread4.join();
 
         int maxGood = max(nGood1,max(nGood2,max(nGood3,nGood4)));
 
@@ -699,21 +865,35 @@ namespace ORB_SLAM3
 
         // Instead of applying the visibility constraints proposed in the Faugeras' paper (which could fail for points seen with low parallax)
         // We reconstruct all hypotheses and check in terms of triangulated points and parallax
+        // The hypotheses are independent, they are triangulated in parallel and compared afterwards in order
+        vector<int> vnGood(8,0);
+        vector<float> vParallax(8,0.f);
+        vector<vector<cv::Point3f> > vvP3D(8);
+        vector<vector<bool> > vvbTriangulated(8);
+
+        vector<thread> vThreads;
+        for(size_t i=1; i<8; i++)
+        {
+            vThreads.push_back(thread([&,i](){
+                vnGood[i] = CheckRT(vR[i],vt[i],mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K,vvP3D[i], 4.0*mSigma2, vvbTriangulated[i], vParallax[i]);
+            }));
+        }
+        vnGood[0] = CheckRT(vR[0],vt[0],mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K,vvP3D[0], 4.0*mSigma2, vvbTriangulated[0], vParallax[0]);
+        for(size_t i=0; i<vThreads.size(); i++)
+            vThreads[i].join();
+
         for(size_t i=0; i<8; i++)
         {
-            float parallaxi;
-            vector<cv::Point3f> vP3Di;
-            vector<bool> vbTriangulatedi;
-            int nGood = CheckRT(vR[i],vt[i],mvKeys1,mvKeys2,mvMatches12,vbMatchesInliers,K,vP3Di, 4.0*mSigma2, vbTriangulatedi, parallaxi);
+            int nGood = vnGood[i];
 
             if(nGood>bestGood)
             {
                 secondBestGood = bestGood;
                 bestGood = nGood;
                 bestSolutionIdx = i;
-                bestParallax = parallaxi;
-                bestP3D = vP3Di;
-                bestTriangulated = vbTriangulatedi;
+                bestParallax = vParallax[i];
+                bestP3D.swap(vvP3D[i]);
+                bestTriangulated.swap(vvbTriangulated[i]);
             }
             else if(nGood>secondBestGood)
             {
@@ -18,6 +18,7 @@
 
 
 #include "Viewer.h"
+#include "Instrumentation.h"
 #include <pangolin/pangolin.h>
 
 #include <mutex>
@@ -161,6 +162,8 @@ bool Viewer::ParseViewerParamFile(cv::FileStorage &fSettings)
 
 void Viewer::Run()
 {
+    Instrumentation::SetThreadName("Viewer");
+
     mbFinished = false;
     mbStopped = false;
 
@@ -221,6 +224,8 @@ void Viewer::Run()
     cout << "Starting the Viewer" << endl;
     while(1)
     {
+        const Instrumentation::TimePoint time_StartDraw = Instrumentation::Now();
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         mpMapDrawer->GetCurrentOpenGLCameraMatrix(Twc,Ow);
@@ -316,6 +321,7 @@ void Viewer::Run()
             mpMapDrawer->DrawMapPoints();
 
         pangolin::FinishFrame();
+        Instrumentation::Trace("Draw Map",time_StartDraw,Instrumentation::Now());
 
         cv::Mat toShow;
         cv::Mat im = mpFrameDrawer->DrawFrame(trackedImageScale);